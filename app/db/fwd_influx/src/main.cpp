@@ -213,8 +213,18 @@ int main(int argc, char* argv[]) {
     tlm.set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
 
     measurement_info_t* m_info;
-    std::string msg;
-    std::string val;
+
+    // the line protocol message is written straight into this buffer, sized so every measurement fits
+    size_t max_msg = veh->device.length() + 1;
+    for(std::string meas : veh->measurements) {
+        m_info = veh->get_info(meas);
+        // name, '=', a comma and quotes around strings
+        max_msg += meas.length() + 4;
+        max_msg += (STRING_TYPE == m_info->type) ? m_info->size : MAX_CONVERSION_SIZE;
+    }
+
+    std::vector<char> msg(max_msg);
+    char* msg_end = msg.data() + msg.size();
     // uint32_t timestamp = 0;
     // unsigned char use_timestamp = 0;
 
@@ -243,12 +253,14 @@ int main(int argc, char* argv[]) {
         }
 
         // construct the message
-        msg = veh->device;
-        msg += " ";
+        char* pos = msg.data();
+        memcpy(pos, veh->device.c_str(), veh->device.length());
+        pos += veh->device.length();
+        *pos++ = ' ';
 
         unsigned char first = 1;
 
-        for(std::string meas : veh->measurements) {
+        for(std::string& meas : veh->measurements) {
             m_info = veh->get_info(meas);
 
             // skip if this measurement didn't update so we don't send redundant data
@@ -264,23 +276,31 @@ int main(int argc, char* argv[]) {
             }
             **/
 
+            char* start = pos;
+
             if(!first) {
-                msg += ",";
+                *pos++ = ',';
             }
-            first &= 0;
-
-
-            if(SUCCESS == tlm.get_str(m_info, &val)) {
-                msg += meas;
-                if(STRING_TYPE == m_info->type) {
-                    msg += "=\"";
-                    msg += val;
-                    msg += "\"";
-                } else {
-                    msg += "=";
-                    msg += val;
-                }
+
+            memcpy(pos, meas.c_str(), meas.length());
+            pos += meas.length();
+            *pos++ = '=';
+
+            if(STRING_TYPE == m_info->type) {
+                *pos++ = '"';
+            }
+
+            if(SUCCESS != tlm.get_str(m_info, pos, msg_end, &pos)) {
+                // drop this field
+                pos = start;
+                continue;
             }
+
+            if(STRING_TYPE == m_info->type) {
+                *pos++ = '"';
+            }
+
+            first = 0;
         }
 
         // TODO this probably didn't work because there's an extra comma at the end of the measurements line
@@ -294,7 +314,7 @@ int main(int argc, char* argv[]) {
         // send the message
         ssize_t sent = -1;
         // std::cout << msg << "\n";
-        sent = sendto(sockfd, msg.c_str(), msg.length(), 0,
+        sent = sendto(sockfd, msg.data(), pos - msg.data(), 0,
             (struct sockaddr*)&servaddr, sizeof(servaddr));
         if(sent == -1) {
             logger.log_message("Failed to send UDP message");
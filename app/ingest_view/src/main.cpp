@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <stdint.h>
+#include <unistd.h>
+#include <csignal>
+#include <arpa/inet.h>
+#include "lib/vcm/vcm.h"
+#include "lib/telemetry/IngestShm.h"
+#include "lib/dls/dls.h"
+#include "common/types.h"
+
+// view how each telemetry packet is arriving live (see lib/telemetry/IngestShm.h)
+// run as ingest_view [-f path_to_config_file]
+
+using namespace vcm;
+using namespace dls;
+
+
+bool killed = false;
+
+#define NUM_SIGNALS 5
+int signals[NUM_SIGNALS] = {
+                            SIGINT,
+                            SIGTERM,
+                            SIGSEGV,
+                            SIGFPE,
+                            SIGABRT
+                        };
+
+
+void sighandler(int) {
+    killed = true;
+}
+
+
+int main(int argc, char* argv[]) {
+    MsgLogger logger("ingest_view");
+
+    logger.log_message("starting ingest_view");
+
+    std::string config_file = "";
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-f")) {
+            if(i + 1 >= argc) {
+                logger.log_message("Must specify a path to the config file after using the -f option");
+                printf("Must specify a path to the config file after using the -f option\n");
+                return -1;
+            } else {
+                config_file = argv[++i];
+            }
+        } else {
+            std::string msg = "Invalid argument: ";
+            msg += argv[i];
+            logger.log_message(msg.c_str());
+            printf("Invalid argument: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    VCM* vcm;
+    if(config_file == "") {
+        vcm = new VCM(); // use default config file
+    } else {
+        vcm = new VCM(config_file); // use specified config file
+    }
+
+    if(FAILURE == vcm->init()) {
+        logger.log_message("failed to initialize VCM");
+        printf("failed to initialize VCM\n");
+        exit(-1);
+    }
+
+    IngestShm ingest;
+    if(FAILURE == ingest.init(vcm) || FAILURE == ingest.open()) {
+        logger.log_message("failed to attach to ingest shared memory");
+        printf("failed to attach to ingest shared memory\n");
+        exit(-1);
+    }
+
+    // add signal handlers
+    for(int i = 0; i < NUM_SIGNALS; i++) {
+        signal(signals[i], sighandler);
+    }
+
+    ingest_stats_t stats;
+    ingest_link_t link_stats;
+    ingest_relay_t relay_stats;
+    while(!killed) {
+        // clear the screen
+        printf("\033[2J\033[H");
+        printf("%-12s %12s %8s %12s %10s %10s %12s %10s %10s %10s\n", "packet", "received", "pkt/s", "bytes/s",
+               "size err", "drops", "queue max", "seq gaps", "seq err", "crc err");
+
+        for(uint32_t i = 0; i < vcm->num_packets; i++) {
+            packet_info_t* packet = vcm->packets[i];
+            if(packet->is_virtual) {
+                continue;
+            }
+
+            std::string name = std::to_string(packet->port);
+            if(packet->framed) {
+                name += ":" + std::to_string(packet->frame_id);
+            } else if(packet->transport == TRANSPORT_TCP) {
+                name = "tcp:" + name;
+            } else if(packet->transport == TRANSPORT_UNIX) {
+                name = "unix:" + packet->endpoint;
+            } else if(packet->transport == TRANSPORT_CAN) {
+                char id[16];
+                snprintf(id, sizeof(id), "0x%X", packet->can_id);
+                name = "can:" + packet->endpoint + ":" + id;
+            }
+
+            if(FAILURE == ingest.read(i, &stats)) {
+                printf("%-12s ERR\n", name.c_str());
+                continue;
+            }
+
+            printf("%-12s %12lu %8lu %12lu %10lu %10lu %12lu", name.c_str(), stats.packets, stats.packet_rate,
+                   stats.byte_rate, stats.size_mismatches, stats.kernel_drops, stats.queued_max);
+
+            if(packet->sequence) {
+                printf(" %10lu %10lu", stats.sequence_gaps, stats.sequence_errors);
+            } else {
+                printf(" %10s %10s", "-", "-");
+            }
+
+            if(packet->crc) {
+                printf(" %10lu\n", stats.crc_errors);
+            } else {
+                printf(" %10s\n", "-");
+            }
+
+            if(packet->delta) {
+                printf("  delta       lost %-10lu dropped %lu\n", stats.delta_lost, stats.delta_dropped);
+            }
+
+            // only on a replica, lag in milliseconds
+            if(stats.replica_lag_max > 0) {
+                printf("  replica     lag %-11.3f lag max %.3f\n", stats.replica_lag / 1000000.0,
+                       stats.replica_lag_max / 1000000.0);
+            }
+
+            // a row for each link of a packet sent over more than one, lag in microseconds
+            if(packet->ports.size() <= 1) {
+                continue;
+            }
+
+            for(uint32_t link = 0; link < packet->ports.size(); link++) {
+                if(FAILURE == ingest.read_link(i, link, &link_stats)) {
+                    printf("  link %-6u ERR\n", packet->ports[link]);
+                    continue;
+                }
+
+                double lag_mean = link_stats.behind ? (double)link_stats.lag_total / link_stats.behind / 1000.0 : 0.0;
+                printf("  link %-6u received %-10lu first %-10lu lag mean %-10.1f lag max %-10.1f lost %lu\n",
+                       packet->ports[link], link_stats.packets, link_stats.first, lag_mean,
+                       link_stats.lag_max / 1000.0, link_stats.lost);
+            }
+        }
+
+        // a row for each relay destination, datagrams go to the port they arrived on plus the offset
+        if(vcm->relays.size() > 0) {
+            printf("\n%-24s %12s %14s %10s\n", "relay", "sent", "bytes", "dropped");
+        }
+
+        for(uint32_t i = 0; i < vcm->relays.size(); i++) {
+            char addr[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &vcm->relays[i].addr, addr, sizeof(addr));
+            std::string name = std::string(addr) + " +" + std::to_string(vcm->relays[i].port_offset);
+
+            if(FAILURE == ingest.read_relay(i, &relay_stats)) {
+                printf("%-24s ERR\n", name.c_str());
+                continue;
+            }
+
+            printf("%-24s %12lu %14lu %10lu\n", name.c_str(), relay_stats.sent, relay_stats.bytes, relay_stats.dropped);
+        }
+
+        fflush(stdout);
+        sleep(1);
+    }
+
+    ingest.close();
+    return 0;
+}
@@ -23,7 +23,9 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
+#include "lib/convert/convert.h"
 #include "lib/dls/dls.h"
 #include "lib/telemetry/TelemetryViewer.h"
 #include "lib/vcm/vcm.h"
@@ -66,36 +68,42 @@ void sighandler(int) {
 
 /**
  * Fetches data and converts it into a JSON string
+ * Written into 'buffer' without allocating, returns the length of the string
  */
-std::string getJSONString(VCM *vcm, size_t max_size) {
+size_t getJSONString(VCM *vcm, char* buffer, size_t size) {
     tlm.update();
 
-    MsgLogger logger(logger_name);
-//    std::string jsonString = "{";
-    std::string jsonString = "";
-
+    char* pos = buffer;
+    char* end = buffer + size;
 
-    for (std::string measurement : vcm->measurements) {
+    for (std::string& measurement : vcm->measurements) {
         measurement_info_t *meas_info = vcm->get_info(measurement);
-        std::string *value = new std::string();
+        char* start = pos;
+
+        *pos++ = '"';
+        memcpy(pos, measurement.c_str(), measurement.length());
+        pos += measurement.length();
+        *pos++ = '"';
+        *pos++ = ':';
 
-        if (FAILURE == tlm.get_str(meas_info, value)) {
+        char* value = pos;
+        if (FAILURE == tlm.get_str(meas_info, pos, end, &pos)) {
+            MsgLogger logger(logger_name);
             logger.log_message("Failed to get telemetry data");
+
+            pos = start;
             continue;
         }
 
-        char pair_str[max_size];  // TODO: Causes warning about variable length. Fix it?
-
-        sprintf(pair_str, "\"%s\":%s,", measurement.c_str(), strcmp(value->c_str(), "") != 0 ? value->c_str() : "null");
-
-        jsonString.append(pair_str);
+        if (pos == value) {
+            memcpy(pos, "null", 4);
+            pos += 4;
+        }
 
-        delete value;
+        *pos++ = ',';
     }
 
-//    jsonString.append("\b \b}");
-
-    return jsonString;
+    return pos - buffer;
 }
 
 /**
@@ -126,29 +134,19 @@ int main(int argc, char* argv[]) {
     tlm.add_all();
     tlm.set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
 
-    unsigned int max_length = 0;
     size_t max_size = 0;
-    int fields = 0;
 
-    // Sets the max sizes
+    // Sets the max size of the JSON string
     for (std::string it : vcm->measurements) {
-        if (it.length() > max_length) {
-            max_length = it.length();
-        }
-
         measurement_info_t* info = vcm->get_info(it);
         // assuming info isn't NULL since it's in the vcm list
-        if (info->size > max_size) {
-            max_size = info->size;
-        }
-        fields++;
+        max_size += it.length() + 4; // Extra characters for JSON formatting
+        max_size += (STRING_TYPE == info->type) ? info->size : MAX_CONVERSION_SIZE;
     }
 
-    max_size += (fields * 4) + 2; // Extra characters for JSON formatting
-
     // Setup UDP server
     int sockfd;
-    char buffer[max_size];
+    std::vector<char> buffer(max_size);
     struct sockaddr_in server_addr;
     struct sockaddr_in client_addr;
     
@@ -201,10 +199,10 @@ int main(int argc, char* argv[]) {
             exit(0);
         }   
 
-        std::string jsonString = getJSONString(vcm, max_size);
+        size_t length = getJSONString(vcm, buffer.data(), buffer.size());
 
         // Send data to client
-        sendto(sockfd, jsonString.c_str(), jsonString.length(), 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
+        sendto(sockfd, buffer.data(), length, 0, (struct sockaddr *)&client_addr, sizeof(client_addr));
     }
 
     return 0;
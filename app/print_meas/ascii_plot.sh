@@ -1,3 +1,10 @@
 #!/bin/bash
 
-./print_meas $1 -g | feedgnuplot --domain --stream trigger --xlen 10000 --lines --points --terminal 'dumb 200,55' --xlabel milliseconds --exit --ymin $2 --ymax $3
+# usage: ./ascii_plot.sh MEASUREMENT ymin ymax [envelope period ms]
+# with an envelope period the min, mean and max of each period are plotted instead of every value
+
+if [ -z "$4" ]; then
+    ./print_meas $1 -g | feedgnuplot --domain --stream trigger --xlen 10000 --lines --points --terminal 'dumb 200,55' --xlabel milliseconds --exit --ymin $2 --ymax $3
+else
+    ./print_meas -e $4 $1 -g | feedgnuplot --domain --stream trigger --xlen 10000 --lines --points --terminal 'dumb 200,55' --xlabel milliseconds --exit --ymin $2 --ymax $3 --legend 0 min --legend 1 mean --legend 2 max
+fi
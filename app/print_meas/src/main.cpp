@@ -5,6 +5,7 @@
 #include <vector>
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <csignal>
 #include "lib/vcm/vcm.h"
 #include "lib/telemetry/TelemetryViewer.h"
@@ -13,8 +14,10 @@
 #include "common/types.h"
 
 // print measurements separated by spaces
-// run as printmeas [-f path_to_config_file] [space-separated list of measurement to print] [-t to print timestamp before measurements | -g to print in feedgnuplot format]
+// run as printmeas [-f path_to_config_file] [-e period_ms] [space-separated list of measurement to print] [-t to print timestamp before measurements | -g to print in feedgnuplot format]
 // if config file path not specified will use the default
+// with -e the min, mean and max of each measurement over every 'period_ms' milliseconds are printed
+// instead of every value, read from the envelopes kept by the history process (see EnvelopeShm.h)
 
 using namespace vcm;
 using namespace shm;
@@ -68,6 +71,68 @@ inline void print_timestamp() {
 }
 
 
+// print the min/mean/max of each measurement over the last completed bucket of 'period' milliseconds, every
+// 'period' milliseconds
+int print_envelopes(std::vector<measurement_info_t*>& meas_infos, uint32_t period,
+                    bool print_timestamps, bool print_replots) {
+    MsgLogger logger("print_meas", "print_envelopes");
+
+    std::vector<envelope_t> buckets;
+    struct timeval now;
+
+    while(1) {
+        usleep(period * 1000);
+
+        if(killed) {
+            exit(0);
+        }
+
+        gettimeofday(&now, NULL);
+        uint64_t t1 = ((uint64_t)now.tv_sec * 1000000) + now.tv_usec;
+
+        if(print_timestamps) {
+            print_timestamp();
+            printf(" ");
+        }
+
+        for(size_t i = 0; i < meas_infos.size(); i++) {
+            buckets.clear();
+
+            if(FAILURE == tlm.get_envelope_range(meas_infos[i], period, t1 - (3 * (uint64_t)period * 1000), t1, &buckets)) {
+                logger.log_message("failed to read envelope");
+                printf("failed to read envelope\n");
+                return -1;
+            }
+
+            // skip the bucket that is still filling up
+            envelope_t* last = NULL;
+            for(envelope_t& b : buckets) {
+                if(b.start + ((uint64_t)b.period * 1000) <= t1) {
+                    last = &b;
+                }
+            }
+
+            if(last == NULL) {
+                printf("- - -");
+            } else {
+                printf("%g %g %g", last->min, last->mean, last->max);
+            }
+
+            if(i != meas_infos.size() - 1) {
+                printf(" ");
+            }
+        }
+
+        if(print_replots) {
+            printf("\nreplot\n");
+        } else {
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+}
+
+
 int main(int argc, char* argv[]) {
     MsgLogger logger("print_meas");
 
@@ -93,6 +158,23 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    uint32_t envelope_period = 0;
+    if(index + 1 < (size_t)argc && !strcmp(argv[index], "-e")) {
+        try {
+            envelope_period = std::stoi(argv[index + 1], NULL, 10);
+        } catch(std::invalid_argument& ia) {
+            envelope_period = 0;
+        }
+
+        if(envelope_period == 0) {
+            logger.log_message("Must specify a non-zero period in milliseconds after using the -e option");
+            printf("Must specify a non-zero period in milliseconds after using the -e option\n");
+            return -1;
+        }
+
+        index += 2;
+    }
+
     bool print_timestamps = false;
     bool print_replots = false;
 
@@ -161,6 +243,10 @@ int main(int argc, char* argv[]) {
 
     tlm.set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
 
+    if(envelope_period) {
+        return print_envelopes(meas_infos, envelope_period, print_timestamps, print_replots);
+    }
+
     std::string str;
 
     while(1) {
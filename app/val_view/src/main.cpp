@@ -9,6 +9,7 @@
 #include "lib/vcm/vcm.h"
 #include "lib/telemetry/TelemetryViewer.h"
 #include "lib/dls/dls.h"
+#include "lib/convert/convert.h"
 #include "common/types.h"
 
 // view telemetry values live
@@ -101,42 +102,56 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // the whole screen is written into this buffer and printed at once
+    size_t max_screen = 0;
+    for(std::string it : vcm->measurements) {
+        measurement_info_t* info = vcm->get_info(it);
+        // name, padding, value (or "ERR") and a newline
+        max_screen += max_length + 2 + 3 + 1;
+        max_screen += (STRING_TYPE == info->type) ? info->size : MAX_CONVERSION_SIZE;
+    }
+
+    std::vector<char> screen(max_screen);
+    char* screen_end = screen.data() + screen.size();
+
     // clear the screen
     printf("\033[2J");
 
     measurement_info_t* m_info;
-    std::string val;
     while(1) {
         if(killed) {
             exit(0);
         }
 
-        for(std::string meas : vcm->measurements) {
+        char* pos = screen.data();
+
+        for(std::string& meas : vcm->measurements) {
             m_info = vcm->get_info(meas);
 
-            printf("%s  ", meas.c_str());
+            memcpy(pos, meas.c_str(), meas.length());
+            pos += meas.length();
 
             // print extra spaces
-            for(size_t i = 0; i < max_length - meas.length(); i++) {
-                printf(" ");
-            }
+            memset(pos, ' ', max_length - meas.length() + 2);
+            pos += max_length - meas.length() + 2;
 
             // if(tlm.updated(m_info)) {
             //     std::cout << "updated: ";
             // }
 
-            if(FAILURE == tlm.get_str(m_info, &val)) {
+            if(FAILURE == tlm.get_str(m_info, pos, screen_end, &pos)) {
                 logger.log_message("failed to convert telemetry value");
-                printf("failed to convert telemetry value\n");
 
-                std::cout << "ERR\n";
-                continue; // keep on going
-            } else {
-                std::cout << val << "\n";
+                memcpy(pos, "ERR", 3);
+                pos += 3;
             }
 
+            *pos++ = '\n';
         }
 
+        fwrite(screen.data(), 1, pos - screen.data(), stdout);
+        fflush(stdout);
+
         // update telemetry
         if(FAILURE == tlm.update()) {
             logger.log_message("failed to update telemetry");
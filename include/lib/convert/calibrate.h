@@ -0,0 +1,177 @@
+/*******************************************************************************
+* Name: calibrate.h
+*
+* Purpose: Calibration curves for turning raw measurements into engineering values
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* Calibrated measurements are declared in the VCM config file and computed
+* from their input measurement whenever they are read, nothing has to write
+* them (unlike virtual measurements calculated by triggers).
+*
+* Reading a single calibrated measurement decodes its input and evaluates the
+* curve (see 'value'). Readers that want every calibrated measurement in a
+* packet use a 'CalibrationBatch', which evaluates the whole packet in one
+* pass. Polynomials of the same degree are evaluated together with the
+* coefficients laid out by order then channel, so each step of Horner's method
+* is one loop over the channels that the compiler can vectorize.
+*
+* Piecewise calibrations evaluate to NaN outside of their ranges. Lookup tables
+* are clamped to their first and last points.
+*/
+
+namespace convert {
+namespace calibrate {
+
+    // evaluate the polynomial with 'n' coefficients 'c' (lowest order first) at 'x'
+    inline double poly(const double* c, size_t n, double x) {
+        double y = 0.0;
+
+        for(size_t i = n; i > 0; i--) {
+            y = (y * x) + c[i - 1];
+        }
+
+        return y;
+    }
+
+    // evaluate a calibration curve at 'x'
+    inline double evaluate(const vcm::calibration_t* cal, double x) {
+        switch(cal->kind) {
+            case vcm::CAL_POLY:
+                return poly(cal->coeffs.data(), cal->coeffs.size(), x);
+
+            case vcm::CAL_PIECEWISE:
+                for(const vcm::calibration_range_t& range : cal->ranges) {
+                    if(x >= range.low && x <= range.high) {
+                        return poly(range.coeffs.data(), range.coeffs.size(), x);
+                    }
+                }
+
+                // out of range
+                return NAN;
+
+            case vcm::CAL_TABLE:
+                {
+                    const std::vector<double>& xs = cal->x;
+                    const std::vector<double>& ys = cal->y;
+
+                    if(x <= xs.front()) {
+                        return ys.front();
+                    } else if(x >= xs.back()) {
+                        return ys.back();
+                    }
+
+                    // first point above x, guaranteed not to be the first or past the end
+                    size_t i = std::upper_bound(xs.begin(), xs.end(), x) - xs.begin();
+
+                    double t = (x - xs[i - 1]) / (xs[i] - xs[i - 1]);
+                    return ys[i - 1] + (t * (ys[i] - ys[i - 1]));
+                }
+        }
+
+        return NAN;
+    }
+
+    // degree of a calibration, used to group polynomials (0 for anything else)
+    inline size_t degree(const vcm::calibration_t* cal) {
+        if(cal->kind == vcm::CAL_POLY && cal->coeffs.size() > 0) {
+            return cal->coeffs.size() - 1;
+        }
+
+        return 0;
+    }
+
+    // decoders of calibrated measurements
+    inline double value(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        const vcm::measurement_info_t* input = meas->cal_input;
+        return evaluate(meas->calibration, input->decode_value(input, data));
+    }
+
+    inline float value_float(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return (float)value(meas, data);
+    }
+
+    inline void column(const vcm::measurement_info_t* meas, const uint8_t* data, size_t stride, size_t num, double* out) {
+        for(size_t i = 0; i < num; i++) {
+            out[i] = value(meas, data + (i * stride));
+        }
+    }
+
+} // namespace calibrate
+
+    // set the decoders of a calibrated measurement
+    // calibrated measurements can be read as a double or a float
+    inline void compile_calibration(vcm::measurement_info_t* meas) {
+        meas->decode_uint32 = NULL;
+        meas->decode_int32 = NULL;
+        meas->decode_uint64 = NULL;
+        meas->decode_int64 = NULL;
+        meas->decode_float = &calibrate::value_float;
+        meas->decode_double = &calibrate::value;
+        meas->decode_value = &calibrate::value;
+        meas->decode_array_uint32 = NULL;
+        meas->decode_array_int32 = NULL;
+        meas->decode_array_uint64 = NULL;
+        meas->decode_array_int64 = NULL;
+        meas->decode_array_float = NULL;
+        meas->decode_array_value = NULL;
+        meas->decode_column_value = &calibrate::column;
+    }
+
+    // evaluates every calibrated measurement in a packet at once
+    class CalibrationBatch {
+    public:
+        // set up for the calibrated measurements in packet 'packet_index'
+        RetType init(vcm::VCM* vcm, uint32_t packet_index);
+
+        // number of calibrated measurements in the packet
+        size_t size();
+
+        // evaluate every calibrated measurement in 'packet' (the raw packet)
+        // 'out' gets a value for each measurement in the order of the packet's 'calibrated' list
+        // NOTE: 'out' must hold at least 'size()' values
+        void evaluate(const uint8_t* packet, double* out);
+
+    private:
+        // polynomials of the same degree, 'count' channels starting at 'first'
+        // coefficients start at 'coeffs' and are stored by order then channel
+        typedef struct {
+            size_t first;
+            size_t count;
+            size_t degree;
+            size_t coeffs;
+        } poly_group_t;
+
+        // input of each channel and its offset into the packet
+        std::vector<const vcm::measurement_info_t*> inputs;
+        std::vector<size_t> offsets;
+
+        // curve of each channel
+        std::vector<const vcm::calibration_t*> curves;
+
+        std::vector<poly_group_t> groups;
+        std::vector<double> poly_coeffs;
+
+        // channels before this are polynomials, the rest are evaluated one at a time
+        size_t num_poly;
+
+        // decoded input values
+        std::vector<double> raw;
+    };
+
+} // namespace convert
+
+#endif
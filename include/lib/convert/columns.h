@@ -0,0 +1,79 @@
+/*******************************************************************************
+* Name: columns.h
+*
+* Purpose: Bulk decoding of many telemetry records into columns of values
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* Offline tools that go through large logs don't need a value at a time, they
+* need every value of a measurement over many records. A 'ColumnDecoder' is set
+* up once for a packet type and then takes a block of raw records of that
+* packet (e.g. read out of a log file) and decodes one column of doubles for
+* each measurement in the packet.
+*
+* Every column is decoded with the measurement's compiled column decoder (see
+* 'column' in lib/convert/decode.h), so there is no lookup or branching per
+* value. Records are split into chunks and the chunks are spread across
+* threads, each thread decodes every column of its chunks while the chunk is
+* still in cache.
+*
+* Array measurements get a column for each element. String measurements are
+* skipped.
+*
+* NOTE: integers are returned as doubles, 64-bit integers larger than 2^53 lose precision
+*/
+
+namespace convert {
+
+    // a column of decoded values
+    typedef struct {
+        vcm::measurement_info_t* meas;
+        uint32_t element;  // element of an array measurement, 0 otherwise
+        size_t offset;     // offset of the value into the packet
+    } column_t;
+
+    class ColumnDecoder {
+    public:
+        // constructor
+        ColumnDecoder();
+
+        // set up for the measurements in packet 'packet_index'
+        // records are decoded by 'threads' threads, 0 uses one thread for every core
+        RetType init(vcm::VCM* vcm, uint32_t packet_index, unsigned int threads = 0);
+
+        // decode 'num' records, the first starting at 'records' and each 'stride' bytes after the last
+        // 'out' gets a column for each entry of 'columns', column 'c' is 'out[c * num]' to 'out[(c * num) + num - 1]'
+        // returns FAILURE if 'stride' is smaller than the packet
+        // NOTE: 'out' must hold at least 'columns.size() * num' values
+        RetType decode(const uint8_t* records, size_t stride, size_t num, double* out);
+
+        // same as above for records packed back to back
+        RetType decode(const uint8_t* records, size_t num, double* out);
+
+        // the columns decoded, in the order they're written to 'out'
+        std::vector<column_t> columns;
+
+    private:
+        // decode records [first, last)
+        void decode_range(const uint8_t* records, size_t stride, size_t num,
+                          size_t first, size_t last, double* out);
+
+        size_t packet_size;
+        unsigned int num_threads;
+    };
+
+} // namespace convert
+
+#endif
@@ -8,30 +8,82 @@
 #include <stdint.h>
 #include <string>
 
-// can't convert any measurement larger than this
+// largest string a numeric measurement is converted to
 #define MAX_CONVERSION_SIZE 256 // bytes
 
 namespace convert {
-    // convert telemetry measurements to C data types
+    // convert a telemetry measurement to text
+    // ints are written in decimal, floats with the fewest digits that read back to the same value (e.g. "1.5"
+    // rather than "1.500000", "1e-07" rather than "0.000000"), strings up to their null terminator
+    // NOTE: floats used to be written with "%f", anything parsing the text should accept exponents
     RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                                         const uint8_t* data, std::string* dst);
+
+    // convert telemetry measurements to C data types
     RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                                         const uint8_t* data, uint32_t* dst);
     RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                                         const uint8_t* data, int32_t* dst);
+    RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
+                                        const uint8_t* data, uint64_t* dst);
+    RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
+                                        const uint8_t* data, int64_t* dst);
     RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                                         const uint8_t* data, float* dst);
     RetType convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                                         const uint8_t* data, double* dst);
 
+    // convert any numeric measurement (int or float of any supported size) to a double
+    RetType convert_value(vcm::measurement_info_t* measurement, const uint8_t* data, double* dst);
+
+    // convert every element of an array measurement
+    // 'data' points to the first element, 'dst' must hold at least 'max' elements
+    // returns FAILURE if the array has more than 'max' elements
+    // NOTE: the scalar conversions above only convert the first element of an array
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, uint32_t* dst, size_t max);
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, int32_t* dst, size_t max);
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, uint64_t* dst, size_t max);
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, int64_t* dst, size_t max);
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, float* dst, size_t max);
+    // any numeric measurement, each element widened to a double
+    RetType convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, double* dst, size_t max);
+
+    // timestamp of element 'index' of an array measurement in a packet received at 'timestamp'
+    // the last element is sampled at 'timestamp', earlier elements are spaced by the sample rate of the array
+    // if the array has no sample rate, 'interval' (time since the last packet holding the array) is spread over the elements
+    // all times are in microseconds
+    uint64_t sample_time(vcm::measurement_info_t* measurement, uint64_t timestamp, uint64_t interval, uint32_t index);
+
+    // write values as text into the buffer [first, last)
+    // return one past the last character written (nothing is null terminated)
+    // return NULL if the text doesn't fit
+    // floats are written with the fewest digits that read back to the same value
+    // NOTE: nothing is allocated, meant for exporters formatting every measurement of every packet
+    char* format(uint64_t val, char* first, char* last);
+    char* format(int64_t val, char* first, char* last);
+    char* format(float val, char* first, char* last);
+    char* format(double val, char* first, char* last);
+
+    // write a measurement as text into [first, last), ints and floats as the value overloads above do
+    // strings are copied up to their null terminator, arrays only write their first element
+    // sets 'end' to one past the last character written
+    // returns FAILURE if the measurement can't be converted or doesn't fit
+    RetType format(vcm::measurement_info_t* measurement, const uint8_t* data,
+                   char* first, char* last, char** end);
+
     // convert from C data type back to raw telemetry
     // NOTE: all assume 'output' is at least as large as the measurement size
+    // NOTE: bitfields can't be converted back, they only make up part of their parent
     RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                             uint8_t* output, std::string& val);
     RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                             uint8_t* output, uint32_t val);
     RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                             uint8_t* output, int32_t val);
+    RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
+                            uint8_t* output, uint64_t val);
+    RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
+                            uint8_t* output, int64_t val);
     RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
                             uint8_t* output, float val);
     RetType convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement,
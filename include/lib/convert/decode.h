@@ -0,0 +1,321 @@
+/*******************************************************************************
+* Name: decode.h
+*
+* Purpose: Compiled per-measurement decoders
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include "lib/vcm/vcm.h"
+
+/*
+* Every combination of measurement size, endianness, sign and type has its own
+* decoder instantiated from the templates below. When the VCM parses a
+* measurement it picks the decoders that fit it and stores them in the
+* measurement info (see 'compile_decoders'), so decoding a value is a single
+* indirect call with no branching on the measurement info.
+*
+* Bitfields decode their parent word and then shift and mask out their bits,
+* the shift and mask come from the measurement info.
+*
+* Array decoders run the scalar decoder over every element, see 'array'.
+* Column decoders run it over the same measurement in many records, see 'column'.
+*
+* Decoders only read 'data' and write nothing else, they are safe to call from
+* any thread.
+*/
+
+namespace convert {
+namespace decode {
+
+    // true if GSW is running on a big endian system
+    constexpr bool host_big = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+
+    inline uint16_t bswap(uint16_t v) { return __builtin_bswap16(v); }
+    inline uint32_t bswap(uint32_t v) { return __builtin_bswap32(v); }
+    inline uint64_t bswap(uint64_t v) { return __builtin_bswap64(v); }
+
+    // read 'SIZE' bytes stored big endian if 'BIG' (little endian otherwise)
+    // the result is zero extended
+    template<unsigned SIZE, bool BIG>
+    inline uint64_t load(const uint8_t* data) {
+        if constexpr(SIZE == 1) {
+            return data[0];
+        } else if constexpr(SIZE == 2 || SIZE == 4 || SIZE == 8) {
+            // native width, a load and maybe a byte swap
+            typedef typename std::conditional<SIZE == 2, uint16_t,
+                    typename std::conditional<SIZE == 4, uint32_t, uint64_t>::type>::type word_t;
+
+            word_t v;
+            memcpy(&v, data, SIZE);
+
+            if constexpr(BIG != host_big) {
+                v = bswap(v);
+            }
+
+            return v;
+        } else {
+            // odd sizes (3, 5, 6, 7 bytes), unrolled by the compiler
+            uint64_t v = 0;
+
+            for(unsigned i = 0; i < SIZE; i++) {
+                if constexpr(BIG) {
+                    v = (v << 8) | data[i];
+                } else {
+                    v |= (uint64_t)data[i] << (8 * i);
+                }
+            }
+
+            return v;
+        }
+    }
+
+    // sign extend the low 'SIZE' bytes of 'v'
+    template<unsigned SIZE>
+    inline int64_t sign_extend(uint64_t v) {
+        if constexpr(SIZE == 8) {
+            return (int64_t)v;
+        } else {
+            const unsigned shift = 64 - (8 * SIZE);
+            return (int64_t)(v << shift) >> shift;
+        }
+    }
+
+    // sign extend the low 'width' bits of 'v'
+    inline int64_t sign_extend_bits(uint64_t v, unsigned width) {
+        const unsigned shift = 64 - width;
+        return (int64_t)(v << shift) >> shift;
+    }
+
+    // whole integer measurements
+    template<unsigned SIZE, bool BIG>
+    uint64_t to_uint64(const vcm::measurement_info_t*, const uint8_t* data) {
+        return load<SIZE, BIG>(data);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    int64_t to_int64(const vcm::measurement_info_t*, const uint8_t* data) {
+        return sign_extend<SIZE>(load<SIZE, BIG>(data));
+    }
+
+    template<unsigned SIZE, bool BIG>
+    uint32_t to_uint32(const vcm::measurement_info_t*, const uint8_t* data) {
+        return (uint32_t)load<SIZE, BIG>(data);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    int32_t to_int32(const vcm::measurement_info_t*, const uint8_t* data) {
+        return (int32_t)sign_extend<SIZE>(load<SIZE, BIG>(data));
+    }
+
+    template<unsigned SIZE, bool BIG, bool SIGNED>
+    double int_value(const vcm::measurement_info_t*, const uint8_t* data) {
+        if constexpr(SIGNED) {
+            return (double)sign_extend<SIZE>(load<SIZE, BIG>(data));
+        } else {
+            return (double)load<SIZE, BIG>(data);
+        }
+    }
+
+    // bitfields, a load of the parent then a shift and mask
+    template<unsigned SIZE, bool BIG>
+    inline uint64_t field(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return (load<SIZE, BIG>(data) >> meas->bit_offset) & meas->bit_mask;
+    }
+
+    template<unsigned SIZE, bool BIG>
+    uint64_t field_uint64(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return field<SIZE, BIG>(meas, data);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    int64_t field_int64(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return sign_extend_bits(field<SIZE, BIG>(meas, data), meas->bit_width);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    uint32_t field_uint32(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return (uint32_t)field<SIZE, BIG>(meas, data);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    int32_t field_int32(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return (int32_t)sign_extend_bits(field<SIZE, BIG>(meas, data), meas->bit_width);
+    }
+
+    template<unsigned SIZE, bool BIG, bool SIGNED>
+    double field_value(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        if constexpr(SIGNED) {
+            return (double)sign_extend_bits(field<SIZE, BIG>(meas, data), meas->bit_width);
+        } else {
+            return (double)field<SIZE, BIG>(meas, data);
+        }
+    }
+
+    // floating point measurements
+    template<bool BIG>
+    float to_float(const vcm::measurement_info_t*, const uint8_t* data) {
+        uint32_t bits = (uint32_t)load<sizeof(float), BIG>(data);
+
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    template<bool BIG>
+    double to_double(const vcm::measurement_info_t*, const uint8_t* data) {
+        uint64_t bits = load<sizeof(double), BIG>(data);
+
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    template<bool BIG>
+    double float_value(const vcm::measurement_info_t* meas, const uint8_t* data) {
+        return to_float<BIG>(meas, data);
+    }
+
+    // decode every element of an array with a scalar decoder
+    // the decoder is a template argument so it's inlined into the loop, which
+    // lets the compiler vectorize the loads, byte swaps and widening
+    template<typename T, T (*DECODE)(const vcm::measurement_info_t*, const uint8_t*), unsigned SIZE>
+    void array(const vcm::measurement_info_t* meas, const uint8_t* data, T* out) {
+        const uint32_t count = meas->count;
+
+        for(uint32_t i = 0; i < count; i++) {
+            out[i] = DECODE(meas, data + ((size_t)i * SIZE));
+        }
+    }
+
+    // decode the same measurement out of 'num' records that are 'stride' bytes apart
+    // like 'array' the decoder is inlined, so the loop is a strided gather of the
+    // raw words followed by the byte swap and widening
+    template<double (*DECODE)(const vcm::measurement_info_t*, const uint8_t*)>
+    void column(const vcm::measurement_info_t* meas, const uint8_t* data, size_t stride, size_t num, double* out) {
+        for(size_t i = 0; i < num; i++) {
+            out[i] = DECODE(meas, data + (i * stride));
+        }
+    }
+
+    // pick the integer decoders for a measurement 'SIZE' bytes long
+    template<unsigned SIZE, bool BIG>
+    inline void select_int(vcm::measurement_info_t* meas) {
+        bool is_signed = (meas->sign == vcm::SIGNED_TYPE);
+
+        if(meas->bit_width) {
+            if(is_signed) {
+                if(meas->bit_width <= 32) {
+                    meas->decode_int32 = &field_int32<SIZE, BIG>;
+                    meas->decode_array_int32 = &array<int32_t, field_int32<SIZE, BIG>, SIZE>;
+                }
+
+                meas->decode_int64 = &field_int64<SIZE, BIG>;
+                meas->decode_value = &field_value<SIZE, BIG, true>;
+                meas->decode_array_int64 = &array<int64_t, field_int64<SIZE, BIG>, SIZE>;
+                meas->decode_array_value = &array<double, field_value<SIZE, BIG, true>, SIZE>;
+                meas->decode_column_value = &column<field_value<SIZE, BIG, true>>;
+            } else {
+                if(meas->bit_width <= 32) {
+                    meas->decode_uint32 = &field_uint32<SIZE, BIG>;
+                    meas->decode_array_uint32 = &array<uint32_t, field_uint32<SIZE, BIG>, SIZE>;
+                }
+
+                meas->decode_uint64 = &field_uint64<SIZE, BIG>;
+                meas->decode_value = &field_value<SIZE, BIG, false>;
+                meas->decode_array_uint64 = &array<uint64_t, field_uint64<SIZE, BIG>, SIZE>;
+                meas->decode_array_value = &array<double, field_value<SIZE, BIG, false>, SIZE>;
+                meas->decode_column_value = &column<field_value<SIZE, BIG, false>>;
+            }
+        } else if(is_signed) {
+            if constexpr(SIZE <= sizeof(int32_t)) {
+                meas->decode_int32 = &to_int32<SIZE, BIG>;
+                meas->decode_array_int32 = &array<int32_t, to_int32<SIZE, BIG>, SIZE>;
+            }
+
+            meas->decode_int64 = &to_int64<SIZE, BIG>;
+            meas->decode_value = &int_value<SIZE, BIG, true>;
+            meas->decode_array_int64 = &array<int64_t, to_int64<SIZE, BIG>, SIZE>;
+            meas->decode_array_value = &array<double, int_value<SIZE, BIG, true>, SIZE>;
+            meas->decode_column_value = &column<int_value<SIZE, BIG, true>>;
+        } else {
+            if constexpr(SIZE <= sizeof(uint32_t)) {
+                meas->decode_uint32 = &to_uint32<SIZE, BIG>;
+                meas->decode_array_uint32 = &array<uint32_t, to_uint32<SIZE, BIG>, SIZE>;
+            }
+
+            meas->decode_uint64 = &to_uint64<SIZE, BIG>;
+            meas->decode_value = &int_value<SIZE, BIG, false>;
+            meas->decode_array_uint64 = &array<uint64_t, to_uint64<SIZE, BIG>, SIZE>;
+            meas->decode_array_value = &array<double, int_value<SIZE, BIG, false>, SIZE>;
+            meas->decode_column_value = &column<int_value<SIZE, BIG, false>>;
+        }
+    }
+
+    template<bool BIG>
+    inline void select(vcm::measurement_info_t* meas) {
+        if(meas->type == vcm::INT_TYPE) {
+            switch(meas->size) {
+                case 1: select_int<1, BIG>(meas); break;
+                case 2: select_int<2, BIG>(meas); break;
+                case 3: select_int<3, BIG>(meas); break;
+                case 4: select_int<4, BIG>(meas); break;
+                case 5: select_int<5, BIG>(meas); break;
+                case 6: select_int<6, BIG>(meas); break;
+                case 7: select_int<7, BIG>(meas); break;
+                case 8: select_int<8, BIG>(meas); break;
+                default: break; // too big to decode
+            }
+        } else if(meas->type == vcm::FLOAT_TYPE) {
+            if(meas->size == sizeof(float)) {
+                meas->decode_float = &to_float<BIG>;
+                meas->decode_value = &float_value<BIG>;
+                meas->decode_array_float = &array<float, to_float<BIG>, sizeof(float)>;
+                meas->decode_array_value = &array<double, float_value<BIG>, sizeof(float)>;
+                meas->decode_column_value = &column<float_value<BIG>>;
+            } else if(meas->size == sizeof(double)) {
+                meas->decode_double = &to_double<BIG>;
+                meas->decode_value = &to_double<BIG>;
+                meas->decode_array_value = &array<double, to_double<BIG>, sizeof(double)>;
+                meas->decode_column_value = &column<to_double<BIG>>;
+            }
+        }
+    }
+
+} // namespace decode
+
+    // set the decoders of 'meas' based on its size, endianness, sign, type and bit range
+    // decoders that don't fit the measurement are set to NULL
+    inline void compile_decoders(vcm::measurement_info_t* meas) {
+        meas->decode_uint32 = NULL;
+        meas->decode_int32 = NULL;
+        meas->decode_uint64 = NULL;
+        meas->decode_int64 = NULL;
+        meas->decode_float = NULL;
+        meas->decode_double = NULL;
+        meas->decode_value = NULL;
+        meas->decode_array_uint32 = NULL;
+        meas->decode_array_int32 = NULL;
+        meas->decode_array_uint64 = NULL;
+        meas->decode_array_int64 = NULL;
+        meas->decode_array_float = NULL;
+        meas->decode_array_value = NULL;
+        meas->decode_column_value = NULL;
+
+        if(meas->endianness == vcm::GSW_BIG_ENDIAN) {
+            decode::select<true>(meas);
+        } else {
+            decode::select<false>(meas);
+        }
+    }
+
+} // namespace convert
+
+#endif
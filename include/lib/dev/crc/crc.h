@@ -0,0 +1,35 @@
+/*
+*   CRC32C (Castagnoli) checksums
+*
+*   Uses the CPU's CRC instructions when it has them (SSE4.2 on x86, the CRC
+*   extension on ARMv8), checked once when the library is loaded, otherwise a
+*   table-driven version that takes eight bytes at a time.
+*
+*   Telemetry packets can carry a CRC32C of every byte in the packet except
+*   the 4 byte CRC itself (marked with 'crc' in the VCM config file), the
+*   vehicle computes it the same way with 'crc32c_packet'.
+*
+*   Will Merges @ RIT Launch Initiative
+*/
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// size of a CRC32C in a packet
+#define CRC32C_SIZE 4
+
+// CRC32C of 'len' bytes at 'data', continuing from 'crc' (0 to start a new one)
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len);
+
+// same as 'crc32c', always using the table (e.g. to check it against the CRC instructions)
+uint32_t crc32c_table(uint32_t crc, const uint8_t* data, size_t len);
+
+// CRC32C of a 'size' byte packet, skipping the CRC in it at 'offset'
+uint32_t crc32c_packet(const uint8_t* packet, size_t size, size_t offset);
+
+// 1 if the CRC instructions are used, 0 for the table
+int crc32c_hw();
+
+#endif
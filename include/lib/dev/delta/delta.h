@@ -0,0 +1,87 @@
+/*
+*   Delta encoding of telemetry packets
+*
+*   Sends a stream of fixed size packets over a slow link (like an XBee radio)
+*   as keyframes (the whole packet) and deltas against the last packet sent.
+*   A delta is the XOR of the packet with the last one, run-length encoded so
+*   bytes that didn't change cost next to nothing.
+*
+*   Every datagram starts with a two byte header:
+*       [kind: DELTA_KEYFRAME or DELTA_XOR] [count: one more than the last datagram's, wrapping at 255]
+*
+*   followed by the whole packet for a keyframe, or runs for a delta:
+*       [0x00 - 0x7F] (n - 1) then n bytes to XOR with the last packet, n is 1 to 128
+*       [0x80 - 0xFF] 0x80 | (n - 1), n bytes that didn't change
+*   bytes after the last run didn't change either, a delta with no runs is the same packet again
+*
+*   A delta only applies to the packet right before it. If the count skips
+*   ahead a datagram was lost and the decoder drops deltas until the next
+*   keyframe, so the encoder sends one every so often to resync. A keyframe is
+*   taken whatever its count, so a restarted encoder resyncs with its first one.
+*
+*   Nothing is allocated, the encoder and decoder keep their packet in a buffer
+*   the caller gives them, so this builds the same for the flight side.
+*
+*   Will Merges @ RIT Launch Initiative
+*/
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// datagram kinds
+#define DELTA_KEYFRAME 0x00
+#define DELTA_XOR      0x01
+
+#define DELTA_HEADER_SIZE 2
+
+// largest datagram a packet of 'size' bytes encodes to, a delta that wouldn't be smaller than a keyframe is sent as one
+#define DELTA_MAX_SIZE(size) ((size) + DELTA_HEADER_SIZE)
+
+typedef enum {
+    DELTA_OK,      // decoded, the packet is in the decoder's buffer
+    DELTA_WAITING, // a delta with nothing to apply to (a datagram was lost), waiting for a keyframe
+    DELTA_OLD,     // a delta from before the last one, arrived out of order or twice
+    DELTA_ERR      // bad datagram, deltas are dropped until the next keyframe
+} delta_ret_t;
+
+typedef struct {
+    uint8_t* last;              // last packet sent, 'size' bytes
+    size_t size;
+    uint32_t keyframe_interval; // most datagrams between keyframes
+    uint32_t since_keyframe;
+    uint8_t count;              // count of the next datagram
+    int keyframe;               // the next datagram is a keyframe
+} delta_encoder_t;
+
+typedef struct {
+    uint8_t* packet;            // last packet decoded, 'size' bytes
+    size_t size;
+    uint8_t next;               // count of the datagram expected next
+    int started;                // a datagram has arrived, gaps in the count can be seen
+    int synced;                 // 'packet' holds the packet the next delta applies to
+} delta_decoder_t;
+
+// encode packets of 'size' bytes with 'last' ('size' bytes) as the encoder's copy of the last packet sent
+// at least every 'keyframe_interval' datagrams is a keyframe, the first one always is
+void delta_encoder_init(delta_encoder_t* enc, uint8_t* last, size_t size, uint32_t keyframe_interval);
+
+// encode 'packet' into 'out' (at least DELTA_MAX_SIZE(size) bytes)
+// returns the size of the datagram to send
+size_t delta_encode(delta_encoder_t* enc, const uint8_t* packet, uint8_t* out);
+
+// send the next packet as a keyframe (e.g. the receiver asked for one or the link was reset)
+void delta_force_keyframe(delta_encoder_t* enc);
+
+// decode packets of 'size' bytes into 'packet' ('size' bytes)
+void delta_decoder_init(delta_decoder_t* dec, uint8_t* packet, size_t size);
+
+// decode a 'len' byte datagram, on DELTA_OK the packet is in 'dec->packet'
+// 'missed' is set to the number of datagrams that never arrived before this one
+delta_ret_t delta_decode(delta_decoder_t* dec, const uint8_t* data, size_t len, uint32_t* missed);
+
+// drop deltas until the next keyframe, for when the packet decoded turns out to be bad (e.g. its CRC failed)
+void delta_desync(delta_decoder_t* dec);
+
+#endif
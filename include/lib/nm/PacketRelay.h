@@ -0,0 +1,87 @@
+/*******************************************************************************
+* Name: PacketRelay.h
+*
+* Purpose: Forwards received datagrams to other ground stations
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef NM_PACKET_RELAY_H
+#define NM_PACKET_RELAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* Sends every datagram decom receives, unchanged, to each destination listed
+* with 'relay' in the VCM config file, so another ground station (or anything
+* else listening) gets the raw packets without its own link to the vehicle.
+* A datagram goes to the port it arrived on plus the destination's port offset,
+* so a second GSW with the same config file receives it like the vehicle sent
+* it to them.
+*
+* Datagrams are queued as they're received and sent with as few 'sendmmsg'
+* calls as possible when the caller is done with a batch. Nothing is copied,
+* so the datagrams have to stay where they are until 'flush'.
+*
+* The socket is nonblocking so relaying never holds up receiving. If the
+* socket's send buffer is full whatever is still queued is dropped, and
+* counted, rather than waiting for room.
+*/
+
+namespace nm {
+
+    // counters of one destination
+    typedef struct {
+        uint64_t sent;      // datagrams sent
+        uint64_t bytes;     // bytes sent
+        uint64_t dropped;   // datagrams that couldn't be sent (send buffer full or the send failed)
+    } relay_count_t;
+
+    class PacketRelay {
+    public:
+        // constructor
+        PacketRelay();
+
+        // destructor
+        ~PacketRelay();
+
+        // relay to 'destinations', up to 'max_queued' datagrams (to any destination) are queued before they're sent
+        RetType init(const std::vector<vcm::relay_info_t>& destinations, size_t max_queued = 256);
+
+        // queue 'size' bytes at 'data' that arrived on 'port' to be sent to every destination
+        // sends everything queued first if the queue is full
+        void queue(uint16_t port, const uint8_t* data, size_t size);
+
+        // send everything queued
+        void flush();
+
+        // counters of each destination since they were last cleared, in the order they're listed in the config
+        std::vector<relay_count_t> counts;
+
+        // zero 'counts'
+        void clear_counts();
+
+    private:
+        int sockfd;
+
+        std::vector<struct sockaddr_in> destinations;
+        std::vector<uint16_t> port_offsets;
+
+        // queued datagrams, 'num_queued' of 'max_queued'
+        std::vector<struct mmsghdr> msgs;
+        std::vector<struct iovec> iovs;
+        std::vector<struct sockaddr_in> addrs;
+        std::vector<uint32_t> dest_index; // destination of each queued datagram
+        size_t num_queued;
+        size_t max_queued;
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*******************************************************************************
+* Name: PacketRing.h
+*
+* Purpose: Captures UDP datagrams from a network interface with a TPACKET_V3 ring
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef NM_PACKET_RING_H
+#define NM_PACKET_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <linux/if_packet.h>
+#include "common/types.h"
+
+/*
+* An AF_PACKET socket with a TPACKET_V3 receive ring mapped into our memory.
+* The kernel copies every frame off the interface that passes a filter
+* straight into the ring, skipping the UDP socket layer, and hands the ring
+* over a block of frames at a time. Datagrams are parsed where they sit in the
+* ring, so the only copy after that is whatever the caller does with them.
+*
+* The filter is a classic BPF program built from the ports given to 'init', it
+* drops everything that isn't an IPv4 UDP datagram to one of those ports.
+* Only ethernet (and loopback) interfaces without VLAN tags are supported.
+* IP fragments are dropped since they can't be put back together here, so
+* datagrams have to fit in the interface MTU.
+*
+* The kernel's UDP stack still sees every datagram as well, if nothing is bound
+* to a port it answers with ICMP port unreachable. Multicast groups still have
+* to be joined with a UDP socket.
+*
+* Needs CAP_NET_RAW.
+*/
+
+namespace nm {
+
+    // a UDP datagram in the ring
+    typedef struct {
+        // destination port
+        uint16_t port;
+
+        // where the datagram came from
+        struct sockaddr_in src;
+
+        // payload
+        uint8_t* data;
+
+        // size of the payload from the UDP header
+        size_t size;
+
+        // how much of the payload was captured, less than 'size' if the frame was cut off
+        size_t length;
+    } ring_datagram_t;
+
+    class PacketRing {
+    public:
+        // constructor
+        PacketRing();
+
+        // destructor
+        ~PacketRing();
+
+        // capture UDP datagrams to 'ports' on 'interface'
+        // the ring is 'num_blocks' blocks of 'block_size' bytes (a multiple of the page size)
+        // a block is handed over when it's full or 'block_timeout' milliseconds after its first frame
+        RetType init(std::string& interface, std::vector<uint16_t>& ports, size_t block_size = 1 << 18,
+                     size_t num_blocks = 32, uint32_t block_timeout = 4);
+
+        // file descriptor to poll, readable when a block is ready
+        int get_socket();
+
+        // start reading the next block the kernel has handed over
+        // returns NOCHANGE if there isn't one yet
+        RetType next_block();
+
+        // get the next datagram in the current block
+        // returns false once every datagram in the block has been read
+        bool next(ring_datagram_t* datagram);
+
+        // give the current block back to the kernel, datagrams from it can't be used after this
+        void release_block();
+
+        // frames received and dropped because the ring was full since the last call
+        RetType stats(uint32_t* packets, uint32_t* drops);
+
+    private:
+        // make the filter program for 'ports'
+        RetType attach_filter(std::vector<uint16_t>& ports);
+
+        int sockfd;
+        int ifindex;
+
+        uint8_t* ring;
+        size_t ring_size;
+        size_t block_size;
+        size_t num_blocks;
+
+        // current block and where we are in it
+        size_t block;
+        struct tpacket_block_desc* current;
+        struct tpacket3_hdr* frame;
+        uint32_t frames_left;
+    };
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*******************************************************************************
+* Name: TransportReceivers.h
+*
+* Purpose: Receivers for telemetry packets that don't arrive as UDP datagrams
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef NM_TRANSPORT_RECEIVERS_H
+#define NM_TRANSPORT_RECEIVERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "lib/nm/nm.h"
+#include "common/types.h"
+
+/*
+* Each transport a packet can be sent over (see vcm::transport_t) has a
+* receiver that looks the same as the UDP one: 'rx_batch' fills the batch
+* buffers with whole packets, one per buffer, and the socket can be waited on
+* with poll/epoll. So decom runs every transport through the same loop and
+* the same shared memory writes.
+*
+*   TcpReceiver  - listens on a port for the sender to connect, then splits the
+*                  stream into records: the packet's size (2 bytes, big endian)
+*                  followed by the packet
+*   UnixReceiver - a Unix domain datagram socket bound to a path
+*   CanReceiver  - a raw SocketCAN socket on an interface, filtered to one CAN
+*                  id, each frame's data is a packet (CAN FD for up to 64 bytes)
+*
+* For testing on one machine, TCP and Unix sockets work over loopback as they
+* are, CAN needs a virtual interface:
+*   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+* and 'cansend vcan0 123#0102030405060708' (can-utils) sends a frame.
+*/
+
+namespace nm {
+
+    class TcpReceiver: public NetworkReceiver {
+    public:
+        // constructor
+        TcpReceiver();
+
+        // destructor
+        ~TcpReceiver();
+
+        // listen on TCP port 'port' for a connection, a new connection replaces the last one
+        // 'rx_timeout', 'buffer_size' and 'batch_size' are the same as for a NetworkReceiver
+        // records bigger than 'buffer_size' are cut off, with their real size in 'batch_lengths'
+        RetType init(uint16_t port, size_t rx_timeout = 0, size_t buffer_size = 2048, size_t batch_size = 1);
+
+        // overrides base class 'rx', receives one record
+        ssize_t rx();
+
+        // overrides base class 'rx_batch', takes up to 'batch_size' whole records from the stream
+        int rx_batch();
+
+        // overrides base class 'set_nonblocking'
+        RetType set_nonblocking();
+
+    private:
+        // wait for records and take up to 'max' of them
+        int receive(size_t max);
+
+        // move up to 'max' whole records out of the stream into the batch buffers
+        int take_records(size_t max);
+
+        // keep 'pending_fd' readable while there are whole records left in the stream
+        void update_pending();
+
+        void accept_connection();
+        void read_stream();
+        void drop_connection();
+
+        // 'sockfd' is an epoll set of these, so the receiver can be waited on like any other socket
+        // records left over from a full batch were already read from the connection, 'pending_fd' (an eventfd)
+        // is what wakes up a level triggered wait for them
+        int listen_fd;
+        int conn_fd;
+        int pending_fd;
+        bool pending;
+
+        // milliseconds 'rx_batch' waits for a record, -1 to block
+        int timeout;
+
+        // bytes read from the connection that haven't been taken yet, 'stream_used' bytes from 'stream_start'
+        uint8_t* stream;
+        size_t stream_size;
+        size_t stream_start;
+        size_t stream_used;
+    };
+
+    class UnixReceiver: public NetworkReceiver {
+    public:
+        // receive datagrams on a Unix domain socket at 'path', replacing any socket left there
+        // 'rx_timeout', 'buffer_size' and 'batch_size' are the same as for a NetworkReceiver
+        RetType init(std::string& path, size_t rx_timeout = 0, size_t buffer_size = 2048, size_t batch_size = 1);
+    };
+
+    class CanReceiver: public NetworkReceiver {
+    public:
+        // receive frames with 'can_id' on SocketCAN interface 'interface', ids above 0x7FF are extended ids
+        // 'rx_timeout' and 'batch_size' are the same as for a NetworkReceiver, packets are at most 64 bytes
+        RetType init(std::string& interface, uint32_t can_id, size_t rx_timeout = 0, size_t batch_size = 1);
+
+        // overrides base class 'rx', the frame's data is left in 'rx_buffer'
+        ssize_t rx();
+
+        // overrides base class 'rx_batch', the data of each frame is left in its buffer
+        int rx_batch();
+
+    private:
+        // replace the frame in 'buffer' with its data, returns the size of the data or 0 if it isn't a frame
+        size_t unpack(uint8_t* buffer, size_t size);
+    };
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*******************************************************************************
+* Name: UringReceiver.h
+*
+* Purpose: Receives packets from many network receivers through io_uring
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef NM_URING_RECEIVER_H
+#define NM_URING_RECEIVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include "lib/nm/nm.h"
+#include "common/types.h"
+
+/*
+* Each socket gets one multishot recvmsg request that stays armed, so after
+* setup no system calls are made to receive packets. The kernel picks a buffer
+* for each packet from a ring of buffers we give it (a provided buffer ring)
+* and posts a completion, 'wait' only enters the kernel when no completions
+* are ready. Buffers are handed back by writing them to the ring after the
+* packets in them have been used.
+*
+* With 'sqpoll' a kernel thread takes submissions so we don't have to enter
+* the kernel to re-arm requests either, at the cost of the thread spinning.
+*
+* Needs linux 6.0 or later (multishot recvmsg). 'init' and 'add' return
+* FAILURE if the kernel doesn't support what's needed or io_uring is disabled,
+* the caller should use the sockets normally ('rx'/'rx_batch') instead.
+*/
+
+namespace nm {
+
+    // something 'wait' received
+    typedef struct {
+        // tag of the socket or watched file descriptor
+        void* tag;
+
+        // received packet, NULL if a watched file descriptor is readable
+        uint8_t* data;
+
+        // size of the packet, larger than what's in 'data' if it was truncated
+        size_t size;
+
+        // how much of the packet is in 'data'
+        size_t length;
+
+        // where the packet came from
+        struct sockaddr_in* addr;
+
+        // used by 'release'
+        uint32_t socket;
+        uint16_t buffer;
+    } uring_packet_t;
+
+    class UringReceiver {
+    public:
+        // constructor
+        UringReceiver();
+
+        // destructor
+        ~UringReceiver();
+
+        // set up a ring for up to 'max_sockets' sockets and watched file descriptors
+        // each socket gets 'num_buffers' buffers, a power of 2 no more than 32768
+        // if 'sqpoll' is set a kernel thread polls for submissions
+        // returns FAILURE if io_uring isn't available
+        RetType init(uint32_t max_sockets, uint32_t num_buffers, bool sqpoll = false);
+
+        // receive packets of up to 'buffer_size' bytes on the socket of 'net'
+        // 'tag' is given back with every packet from this socket
+        // returns FAILURE if the socket can't be received on (e.g. multishot receive isn't supported)
+        RetType add(NetworkReceiver* net, size_t buffer_size, void* tag);
+
+        // get a packet with NULL data and 'tag' whenever 'fd' becomes readable
+        RetType watch(int fd, void* tag);
+
+        // wait up to 'timeout' milliseconds for something to be received (0 waits forever)
+        // up to 'max' packets are stored in 'packets', the buffers they're in are ours until they're released
+        // returns the number of packets stored, 0 on timeout or signal, or -1 on error
+        int wait(uring_packet_t* packets, uint32_t max, uint32_t timeout);
+
+        // give the buffers of 'num' packets from 'wait' back to be received into again
+        void release(uring_packet_t* packets, int num);
+
+    private:
+        // state of each socket or watched file descriptor
+        struct socket_s;
+
+        // copy 'entry' into the submission queue, it's submitted on the next 'enter'
+        RetType queue(const struct io_uring_sqe* entry);
+
+        // submit queued entries, waiting for 'min_complete' completions for up to 'timeout' milliseconds
+        // returns -1 and sets errno on error
+        int enter(uint32_t min_complete, uint32_t timeout);
+
+        // queue the multishot receive (or poll) for 'socket'
+        RetType arm(uint32_t socket);
+
+        int ring_fd;
+        bool sqpoll;
+
+        // submission queue
+        void* sq_ring;
+        size_t sq_ring_size;
+        uint32_t* sq_head;
+        uint32_t* sq_tail;
+        uint32_t* sq_flags;
+        uint32_t sq_mask;
+        uint32_t sq_entries;
+        uint32_t* sq_array;
+        struct io_uring_sqe* sqes;
+        size_t sqes_size;
+        uint32_t to_submit;
+
+        // completion queue
+        void* cq_ring;
+        size_t cq_ring_size;
+        uint32_t* cq_head;
+        uint32_t* cq_tail;
+        uint32_t cq_mask;
+        struct io_uring_cqe* cqes;
+
+        socket_s* sockets;
+        uint32_t max_sockets;
+        uint32_t num_sockets;
+        uint32_t num_buffers;
+    };
+}
+
+#endif
@@ -18,6 +18,7 @@ namespace nm {
     // listens on a port
     // if the port is used as an auto port for a network device, writes address to shared memory when it receives
     // NOTE: should only have one per port! or else the packets get split between the two
+    //       unless that's what's wanted, see 'steer_by_source'
     class NetworkReceiver {
     public:
         // constructor
@@ -31,23 +32,72 @@ namespace nm {
         // if multicast_addr is non-zero, joins the multicast group to listen for packets
         // if rx_timeout is > 0, receives timeout after that many millsec, otherwise it blocks indefinitely
         // stores received data in a buffer of size 'buffer_size'
-        RetType init(uint16_t port, uint32_t multicast_addr = 0, size_t rx_timeout = 0, size_t buffer_size = 2048);
+        // 'rx_batch' can receive up to 'batch_size' packets at once, each into its own buffer
+        RetType init(uint16_t port, uint32_t multicast_addr = 0, size_t rx_timeout = 0, size_t buffer_size = 2048,
+                     size_t batch_size = 1);
 
         // stores received data
         uint8_t* rx_buffer;
 
+        // stores data received by 'rx_batch', 'batch_size' buffers of 'buffer_size' bytes
+        // the first buffer is 'rx_buffer'
+        uint8_t** batch_buffers;
+
+        // size of each packet received by 'rx_batch', larger than the buffer if the packet was truncated
+        size_t* batch_lengths;
+
+        // source address of each packet received by 'rx_batch'
+        struct sockaddr_in* batch_addrs;
+
+        // packets the kernel dropped because the socket's receive buffer was full, since the socket was opened
+        // the kernel tells us with the next packet that makes it in (SO_RXQ_OVFL), 'rx_batch' keeps this up to date
+        uint32_t kernel_drops;
+
+        // roughly how many bytes were waiting in the socket when 'rx_batch' was last called
+        // the packets it returned, plus what the kernel still had charged to the receive buffer if the batch was full
+        size_t queued;
+
         // receive a packet
         // blocking if rx_timeout < 0
         // returns how many bytes were read, or -1 on error
         virtual ssize_t rx();
 
+        // receive up to 'batch_size' packets with one system call
+        // blocks like 'rx' until the first packet, then takes whatever else is already queued
+        // returns how many packets were received, or -1 on error
+        virtual int rx_batch();
+
+        // called with the source address of a packet received without 'rx' or 'rx_batch' (e.g. by a UringReceiver)
+        virtual void received_from(struct sockaddr_in* addr);
+
+        // socket file descriptor, can be used with poll/epoll
+        // -1 if not initialized
+        int get_socket();
+
+        // make 'rx' return -1 (errno EAGAIN) instead of blocking when nothing has been received
+        virtual RetType set_nonblocking();
+
+        // split packets to the port between 'workers' receivers on it (its reuseport group) by where they came from
+        // every packet from a source address and port goes to the same receiver so each source stays in order
+        // only needs to be called on one receiver in the group, calling it on more just replaces the program
+        // NOTE: only unicast packets are split, multicast packets are delivered to every receiver on the port
+        RetType steer_by_source(uint32_t workers);
+
     private:
         bool inited;
 
     protected:
+        // allocate 'batch_size' receive buffers of 'buffer_size' bytes for 'sockfd'
+        void alloc_batch(size_t buffer_size, size_t batch_size);
+
         size_t buffer_size;
         int sockfd;
         struct sockaddr_in remote_addr;
+
+        size_t batch_size;
+        struct mmsghdr* msgs;
+        struct iovec* iovs;
+        uint8_t* controls;
     };
 
     // receives packets over the network from a device with an auto configuration
@@ -67,10 +117,18 @@ namespace nm {
         // if multicast_addr is non-zero, joins the multicast group to listen for packets
         // if rx_timeout is > 0, receives timeout after that many millsec, otherwise it blocks
         // stores received data in a buffer of size 'buffer_size'
-        RetType init(vcm::VCM* vcm, uint16_t port, uint32_t multicast_addr = 0, size_t rx_timeout = 0, size_t buffer_size = 2048);
+        // 'rx_batch' can receive up to 'batch_size' packets at once, each into its own buffer
+        RetType init(vcm::VCM* vcm, uint16_t port, uint32_t multicast_addr = 0, size_t rx_timeout = 0,
+                     size_t buffer_size = 2048, size_t batch_size = 1);
 
         // overrides base class 'rx'
         ssize_t rx();
+
+        // overrides base class 'rx_batch', the source address of the last packet is saved
+        int rx_batch();
+
+        // overrides base class 'received_from'
+        void received_from(struct sockaddr_in* addr);
     private:
         NmShm* shm;
         uint32_t device_id;
@@ -0,0 +1,100 @@
+/*******************************************************************************
+* Name: sched.h
+*
+* Purpose: Real-time scheduling, CPU affinity and memory locking profiles for
+*          GSW processes
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef SCHED_PROFILE_H
+#define SCHED_PROFILE_H
+
+#include <sched.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* A schedule file (listed in the VCM config file as 'schedule = [file]') gives
+* processes a scheduling profile, one line per process:
+*   [process] [option] [value] [option] [value] ...
+*
+* Options:
+*   priority [1-99]                 run with the SCHED_FIFO real-time policy at this priority,
+*                                   the highest priority ready process always runs first
+*   cpus [list]                     only run on these CPUs, e.g. '2', '2,3' or '1-3'
+*   mlock [current | all | onfault] lock memory into RAM so it's never paged out,
+*                                   'current' locks what's mapped now, 'all' also locks
+*                                   anything mapped later, 'onfault' locks pages of either
+*                                   once they're first touched
+*
+* Processes apply their own profile when they start, processes without one (or
+* without a schedule file) run on the default scheduler on any CPU.
+*
+* Real-time priorities and memory locking need CAP_SYS_NICE and CAP_IPC_LOCK
+* (or a high enough RLIMIT_RTPRIO and RLIMIT_MEMLOCK), a process that can't
+* apply its profile logs it and runs without it.
+*
+* NOTE: a SCHED_FIFO process that never blocks starves everything else on its
+* CPUs of lower priority, linux keeps 5% of each second for everyone else by default.
+*/
+
+namespace sched {
+
+    typedef enum {
+        LOCK_NONE,     // nothing locked
+        LOCK_CURRENT,  // everything mapped now
+        LOCK_ALL,      // everything mapped now or later
+        LOCK_ONFAULT   // everything mapped now or later, once touched
+    } mlock_policy_t;
+
+    // scheduling profile of a process
+    typedef struct {
+        std::string process;
+        int priority;         // SCHED_FIFO priority, 0 for the default scheduler
+        bool pinned;          // only runs on 'cpus'
+        cpu_set_t cpus;
+        mlock_policy_t mlock;
+    } profile_t;
+
+    // read every profile in the schedule file of 'vcm'
+    // returns FILENOTFOUND if the vehicle has no schedule file
+    RetType parse_schedule_file(vcm::VCM* vcm, std::vector<profile_t>* profiles);
+
+    // set the scheduling policy and CPU affinity of the calling thread, and the memory locking of the process
+    // threads started after this inherit the policy and affinity
+    RetType apply_profile(profile_t* profile);
+
+    // apply the profile of 'process' from the schedule file of 'vcm'
+    // returns SUCCESS if there's no profile for the process
+    // NOTE: memory locks aren't inherited by forked children, children should apply their profile again
+    RetType apply(vcm::VCM* vcm, const std::string& process);
+
+    // wake-up latency distribution, in microseconds
+    typedef struct {
+        uint64_t samples;
+        double min;
+        double mean;
+        double p50;
+        double p99;
+        double p999;
+        double max;
+
+        // number of wake-ups later than each of 'LATENCY_BUCKETS' and not the next
+        std::vector<uint64_t> histogram;
+    } latency_t;
+
+    // histogram bucket bounds, microseconds
+    static const double LATENCY_BUCKETS[] = {0, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+    static const size_t NUM_LATENCY_BUCKETS = sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]);
+
+    // sleep until every 'period' microseconds for 'duration' milliseconds, timing how late each wake-up is
+    // runs with the scheduling of the calling thread, so apply a profile first to see what it gets
+    RetType measure_latency(uint32_t period, uint32_t duration, latency_t* latency);
+}
+
+#endif
@@ -35,6 +35,7 @@ namespace shm {
         RetType detach();
 
         // destroy the current shared memory block
+        // the block goes away once every process detaches, this detaches us
         // NOTE: must have called create or attach first
         RetType destroy();
 
@@ -0,0 +1,153 @@
+/*******************************************************************************
+* Name: EnvelopeShm.h
+*
+* Purpose: Downsampled min/max/mean envelopes of telemetry measurements
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef ENVSHM_H
+#define ENVSHM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "lib/telemetry/HistoryShm.h"
+#include "lib/vcm/vcm.h"
+#include "lib/shm/shm.h"
+#include "common/types.h"
+
+/*
+* Envelope shared memory holds downsampled aggregates of every measurement
+* listed in the VCM history file. Each measurement has a ring of buckets for
+* each tier, a tier being a bucket period (e.g. 100 ms, 1 s and 10 s). Every
+* bucket holds the min, max, sum and count of the samples that fell into it.
+*
+* The tiers are set in the history file with a line like:
+*   tiers 100 1000 10000
+* periods are in milliseconds, if no tiers are given 100 ms, 1 s and 10 s are used.
+*
+* Buckets are updated incrementally as samples come in (by the history
+* process), so a plot of hours of data only has to read a few hundred buckets
+* instead of decoding every sample.
+*
+* Like HistoryShm there is a single writer and readers never lock. Each bucket
+* has a sequence number that is odd while the writer is changing it, a reader
+* copies the bucket and tries again if the sequence number changed.
+*
+* Timestamps are microseconds since the epoch.
+*/
+
+using namespace shm;
+using namespace vcm;
+
+// number of buckets kept for each tier of each measurement
+#define ENVELOPE_NUM_BUCKETS 600
+
+// one downsampled bucket
+typedef struct {
+    uint64_t start;  // start of the bucket, microseconds since the epoch
+    uint32_t period; // length of the bucket in milliseconds
+    uint32_t count;  // number of samples in the bucket
+    double min;
+    double max;
+    double mean;
+} envelope_t;
+
+class EnvelopeShm {
+public:
+    // constructor
+    EnvelopeShm();
+
+    // destructor
+    virtual ~EnvelopeShm();
+
+    // initialize the object using 'vcm'
+    // parses the history file listed in the VCM config file
+    // returns FILENOTFOUND if the vehicle has no history file
+    RetType init(VCM* vcm);
+
+    // attach to shared memory
+    RetType open();
+
+    // detach from shared memory
+    RetType close();
+
+    // create shared memory
+    // NOTE: does not attach!
+    RetType create();
+
+    // destroy shared memory, even if it was made from an older history file
+    // NOTE: doesn't need to be attached
+    RetType destroy();
+
+    // true if envelopes are kept for 'meas'
+    bool tracked(measurement_info_t* meas);
+
+    // add a sample of 'meas' to the current bucket of every tier
+    // timestamps should be non-decreasing, samples older than the current bucket are dropped
+    // NOTE: only one process should ever append (e.g. the history process)
+    RetType append(measurement_info_t* meas, uint64_t timestamp, double value);
+
+    // read buckets of 'period' milliseconds of 'meas' that overlap [t0, t1], oldest first
+    // each is merged from the buckets of the coarsest tier no longer than 'period' (preferring one that fits
+    // evenly into it) that start in it, a bucket of the tier is never split
+    // returns FAILURE if every tier is longer than 'period'
+    // NOTE: the newest bucket may still be filling up
+    RetType read(measurement_info_t* meas, uint32_t period, uint64_t t0, uint64_t t1,
+                 std::vector<envelope_t>* out);
+
+    // measurements envelopes are kept for
+    std::vector<measurement_info_t*> measurements;
+
+    // tier periods in milliseconds
+    std::vector<uint32_t> tiers;
+
+private:
+    // a single bucket in shared memory
+    typedef struct {
+        uint32_t seq;   // odd while the bucket is being written
+        uint32_t count;
+        uint64_t start;
+        double min;
+        double max;
+        double sum;
+    } bucket_t;
+
+    // ring of buckets for one tier of one measurement
+    typedef struct {
+        uint32_t head; // bucket currently being added to
+        uint32_t used; // number of buckets that hold data
+    } ring_t;
+
+    // layout at the start of shared memory
+    typedef struct {
+        uint32_t num_series;
+        uint32_t num_tiers;
+        uint32_t num_buckets;
+        uint32_t pad;
+    } envelope_header_t;
+
+    // shares the config directory key file with history shared memory (see HistoryShm.h), 0xFB is free from
+    // telemetry's ids until there are over 125 packets
+    static const int shm_key_id = 0xFB;
+
+    ring_t* get_ring(uint32_t series, uint32_t tier);
+    bucket_t* get_bucket(uint32_t series, uint32_t tier, uint32_t bucket);
+
+    // index into the series table for each tracked measurement
+    std::unordered_map<measurement_info_t*, uint32_t> index;
+
+    Shm* shm;
+
+    // needs to be stored with the object so Shm class has a valid pointer
+    std::string key_filename;
+
+    size_t rings_offset;
+    size_t buckets_offset;
+    size_t total_size;
+};
+
+#endif
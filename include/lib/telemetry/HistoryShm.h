@@ -0,0 +1,162 @@
+/*******************************************************************************
+* Name: HistoryShm.h
+*
+* Purpose: Compressed in-memory time-series history of telemetry measurements
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef HISTSHM_H
+#define HISTSHM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "lib/vcm/vcm.h"
+#include "lib/shm/shm.h"
+#include "common/types.h"
+
+/*
+* History shared memory holds a ring of compressed blocks for every measurement
+* listed in the VCM history file. The whole history lives in a single shared
+* memory block so the number of tracked measurements is not limited by the
+* number of shared memory keys available.
+*
+* Each block holds a run of (timestamp, value) samples compressed the same way
+* Facebook's Gorilla time-series database does it:
+*   timestamps are stored as a delta-of-delta with a variable length prefix code
+*   values are doubles stored as the XOR with the previous value, only the
+*   meaningful bits of the XOR are written
+* Slowly changing telemetry compresses to a couple bits per sample, so hours of
+* data fit in a few megabytes.
+*
+* There is only ever one writer (the history process) and it never blocks.
+* Readers do not lock anything, instead every block has a generation number
+* that the writer bumps when it recycles the block. A reader copies a block and
+* throws it away if the generation changed while it was copying. The sample
+* count of a block is published after the bits of the sample are written, so a
+* reader never decodes a partially written sample.
+*
+* Timestamps are microseconds since the epoch.
+*/
+
+using namespace shm;
+using namespace vcm;
+
+// default number of blocks kept for each measurement
+#define HISTORY_DEFAULT_BLOCKS 64
+
+// size of each compressed block in bytes (including the block header)
+#define HISTORY_BLOCK_SIZE 4096
+
+// parsed contents of a VCM history file
+typedef struct {
+    std::vector<measurement_info_t*> measurements; // measurements to keep a history of
+    std::vector<uint32_t> num_blocks;              // number of blocks kept for each measurement
+    std::vector<uint32_t> tiers;                   // envelope tier periods in milliseconds (see EnvelopeShm.h)
+} history_config_t;
+
+// parse the history file listed in the VCM config file
+// returns FILENOTFOUND if the vehicle has no history file
+// returns FAILURE if the file is invalid
+RetType parse_history_file(VCM* vcm, history_config_t* config);
+
+class HistoryShm {
+public:
+    // constructor
+    HistoryShm();
+
+    // destructor
+    virtual ~HistoryShm();
+
+    // initialize the object using 'vcm'
+    // parses the history file listed in the VCM config file
+    // returns FILENOTFOUND if the vehicle has no history file
+    RetType init(VCM* vcm);
+
+    // attach to shared memory
+    RetType open();
+
+    // detach from shared memory
+    RetType close();
+
+    // create shared memory
+    // NOTE: does not attach!
+    RetType create();
+
+    // destroy shared memory, even if it was made from an older history file
+    // NOTE: doesn't need to be attached
+    RetType destroy();
+
+    // true if a history is kept for 'meas'
+    bool tracked(measurement_info_t* meas);
+
+    // append a sample to the history of 'meas'
+    // timestamps should be non-decreasing, older samples are dropped
+    // NOTE: only one process should ever append (e.g. the history process)
+    RetType append(measurement_info_t* meas, uint64_t timestamp, double value);
+
+    // decode every sample of 'meas' with a timestamp in [t0, t1]
+    // samples are appended to 'times' and 'values' oldest first
+    RetType read(measurement_info_t* meas, uint64_t t0, uint64_t t1,
+                 std::vector<uint64_t>* times, std::vector<double>* values);
+
+    // measurements a history is kept for
+    std::vector<measurement_info_t*> measurements;
+
+private:
+    // header at the start of every compressed block
+    // the encoder state is kept here so appending never needs to decode
+    typedef struct {
+        uint32_t gen;          // generation, odd while the block is being recycled
+        uint32_t count;        // number of samples in the block
+        uint64_t t_first;      // timestamp of the first sample
+        uint64_t t_last;       // timestamp of the last sample
+        uint32_t bits;         // number of bits written
+        int64_t last_delta;    // last timestamp delta
+        uint64_t last_value;   // bits of the last value
+        uint8_t last_leading;  // leading zeros of the last stored XOR
+        uint8_t last_trailing; // trailing zeros of the last stored XOR
+    } block_header_t;
+
+    // per measurement ring information
+    typedef struct {
+        uint32_t num_blocks; // number of blocks in the ring
+        uint32_t head;       // block currently being appended to
+        uint32_t used;       // number of blocks that hold data
+        uint32_t pad;
+        uint64_t offset;     // offset of the first block from the start of shared memory
+    } series_t;
+
+    // layout at the start of shared memory
+    typedef struct {
+        uint32_t num_series;
+        uint32_t block_size;
+    } history_header_t;
+
+    // shares the config directory key file with telemetry and ingest shared memory (see IngestShm.h), ftok only
+    // keeps the low 8 bits so 0xFD is free until there are over 126 packets
+    static const int shm_key_id = 0xFD;
+
+    // start a fresh block in the ring of 'series'
+    block_header_t* next_block(series_t* series);
+
+    // decode a copy of a block
+    static void decode(const uint8_t* block, uint64_t t0, uint64_t t1,
+                       std::vector<uint64_t>* times, std::vector<double>* values);
+
+    // index into the series table for each tracked measurement
+    std::unordered_map<measurement_info_t*, uint32_t> index;
+    std::vector<uint32_t> num_blocks;
+
+    Shm* shm;
+
+    // needs to be stored with the object so Shm class has a valid pointer
+    std::string key_filename;
+
+    size_t total_size;
+};
+
+#endif
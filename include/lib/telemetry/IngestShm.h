@@ -0,0 +1,243 @@
+/*******************************************************************************
+* Name: IngestShm.h
+*
+* Purpose: Counters of how each telemetry packet is arriving over the network
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef INGESTSHM_H
+#define INGESTSHM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <time.h>
+#include "lib/vcm/vcm.h"
+#include "lib/shm/shm.h"
+#include "common/types.h"
+
+/*
+* Ingest shared memory holds counters for every telemetry packet that show
+* how it's arriving, so a bad link (or decom falling behind) can be seen while
+* it's happening instead of from gaps in the logs afterwards:
+*   - datagrams and bytes received, and the rate of each over the last second
+*   - datagrams of the wrong size
+*   - datagrams the kernel dropped because the socket's receive buffer was full
+*   - the most bytes seen waiting in the socket at once
+*   - sequence numbers that were skipped, or went backwards, for packets with
+*     one (marked with 'sequence' in the VCM config file)
+*   - packets that failed their CRC, for packets with one (marked with 'crc'
+*     in the VCM config file), these aren't written to telemetry shared memory
+*
+* Each packet's counters are only written by the decom process receiving it,
+* or the workers receiving it if its port has more than one ('workers' in the
+* VCM config file). Every counter is a 64 bit word updated and read atomically,
+* so nobody locks, but the counters of a packet aren't read all at the same
+* instant. Workers add up their sockets' drops, and the queue counter is the
+* most any one of them had waiting.
+*
+* The counters of a framed packet count its frames. Every framed packet on a
+* port shares the port's socket, so they all have the same drop and queue
+* counters. Datagrams that couldn't be split (unknown frame id or a cut off
+* frame) count as size mismatches of the first packet on the port.
+*
+* Packets that arrive over more than one link (one port each, see
+* LinkMerger.h) also have counters for each link, in the order the ports are
+* listed: copies received, copies that arrived before any other link's, how far
+* behind the first copy the rest arrived, and packets that never arrived on the
+* link but did on another. The packet's own counters are for every copy, from
+* every link, except the sequence counters, which only see the first copy.
+*
+* Delta encoded packets count the datagrams that went missing, going by the
+* count in their header, and the ones dropped because they were out of order
+* or there was no keyframe to apply them to.
+*
+* Each relay destination ('relay' in the VCM config file, see
+* lib/nm/PacketRelay.h) has counters of the datagrams sent to it and dropped,
+* added up over every decom process.
+*
+* On a replica ground station (see proc/replicate) packets arrive from the
+* replication daemon instead of decom. It counts what it writes as received,
+* and how long each copy took to get from the primary to us: from when the
+* primary saw the packet in its shared memory to when we wrote it to ours.
+* The lag goes by both clocks, so they need to be kept in sync (e.g. NTP).
+*
+* Counters carry on across decom restarts, they start over from zero when
+* shared memory is made for a reloaded config.
+*/
+
+using namespace shm;
+using namespace vcm;
+
+// counters of one packet
+typedef struct {
+    uint64_t packets;         // datagrams (or frames) received
+    uint64_t bytes;           // bytes received
+    uint64_t packet_rate;     // packets per second over the last second
+    uint64_t byte_rate;       // bytes per second over the last second
+    uint64_t size_mismatches; // datagrams of the wrong size, not written to telemetry shared memory
+    uint64_t kernel_drops;    // datagrams dropped by the kernel because the socket's receive buffer was full
+    uint64_t queued_max;      // most bytes seen waiting in the socket at once
+    uint64_t sequence_gaps;   // packets missing going by the sequence number
+    uint64_t sequence_errors; // sequence numbers that repeated or went backwards
+    uint64_t sequence;        // last sequence number received
+    uint64_t delta_lost;      // datagrams of a delta encoded packet that never arrived, going by their count
+    uint64_t delta_dropped;   // datagrams of a delta encoded packet dropped, waiting for a keyframe or out of order
+    uint64_t crc_errors;      // packets that failed their CRC, not written to telemetry shared memory
+    uint64_t replica_lag;     // nanoseconds the last copy took to get from the primary, on a replica
+    uint64_t replica_lag_max; // most nanoseconds a copy took to get from the primary, on a replica
+} ingest_stats_t;
+
+// counters of one link of a packet that arrives over more than one
+typedef struct {
+    uint64_t packets;         // copies received on the link
+    uint64_t first;           // copies that arrived before any other link's
+    uint64_t behind;          // copies that arrived after another link's
+    uint64_t lag_total;       // nanoseconds the 'behind' copies arrived after the first, added up
+    uint64_t lag_max;         // most nanoseconds a copy arrived after the first
+    uint64_t lost;            // packets that arrived on another link but never on this one
+} ingest_link_t;
+
+// counters of one relay destination
+typedef struct {
+    uint64_t sent;            // datagrams sent
+    uint64_t bytes;           // bytes sent
+    uint64_t dropped;         // datagrams that couldn't be sent
+} ingest_relay_t;
+
+class IngestShm {
+public:
+    // constructor
+    IngestShm();
+
+    // destructor
+    virtual ~IngestShm();
+
+    // initialize the object using 'vcm'
+    RetType init(VCM* vcm);
+
+    // attach to shared memory
+    RetType open();
+
+    // detach from shared memory
+    RetType close();
+
+    // create shared memory
+    // NOTE: does not attach!
+    RetType create();
+
+    // destroy shared memory
+    // NOTE: must be attached already!
+    RetType destroy();
+
+    // replace shared memory made for an older config with a new one for this config
+    // processes attached to the old one keep it until they detach
+    RetType reload();
+
+    // NOTE: only the process (or workers) receiving a packet should update its counters
+    // updates are dropped if shared memory isn't attached
+
+    // count 'num' datagrams (or frames) of 'packet_id' totalling 'bytes' bytes, 'mismatched' of them the wrong size
+    void received(uint32_t packet_id, uint64_t num, uint64_t bytes, uint64_t mismatched);
+
+    // check the sequence number of a correctly sized 'packet_id' at 'data', if it has one
+    void sequence(uint32_t packet_id, const uint8_t* data);
+
+    // the socket 'packet_id' is received on has dropped 'drops' datagrams since it was opened
+    // and had 'queued' bytes waiting (see NetworkReceiver::kernel_drops and NetworkReceiver::queued)
+    // 'link' is the index of the socket's port in the packet's ports
+    void socket(uint32_t packet_id, uint32_t drops, size_t queued, uint32_t link = 0);
+
+    // a copy of 'packet_id' arrived on 'link', 'first' if no other link's copy arrived before it
+    // only counted for packets with more than one port, as are the rest of the link counters
+    void link_copy(uint32_t packet_id, uint32_t link, bool first);
+
+    // a copy of 'packet_id' arrived on 'link' 'lag' nanoseconds after another link's
+    void link_lag(uint32_t packet_id, uint32_t link, uint64_t lag);
+
+    // 'num' packets of 'packet_id' arrived on other links but never on 'link'
+    void link_lost(uint32_t packet_id, uint32_t link, uint64_t num);
+
+    // 'lost' datagrams of delta encoded 'packet_id' never arrived before the last one, which was 'dropped' if it
+    // couldn't be decoded (see lib/dev/delta/delta.h)
+    void delta(uint32_t packet_id, uint32_t lost, bool dropped);
+
+    // a correctly sized 'packet_id' failed its CRC
+    void bad_crc(uint32_t packet_id);
+
+    // a copy of 'packet_id' was replicated from the primary, taking 'lag' nanoseconds
+    void replicated(uint32_t packet_id, uint64_t lag);
+
+    // 'sent' datagrams totalling 'bytes' bytes were relayed to destination 'relay' and 'dropped' couldn't be
+    // unlike the other counters any decom process can update these
+    void relayed(uint32_t relay, uint64_t sent, uint64_t bytes, uint64_t dropped);
+
+    // update the rates of every packet this process has counted
+    // should be called at least once a second, does nothing if it hasn't been a second since the last update
+    void tick();
+
+    // read the counters of 'packet_id'
+    RetType read(uint32_t packet_id, ingest_stats_t* stats);
+
+    // read the counters of 'link' of 'packet_id'
+    // returns FAILURE if the packet doesn't arrive over more than one link
+    RetType read_link(uint32_t packet_id, uint32_t link, ingest_link_t* stats);
+
+    // read the counters of relay destination 'relay'
+    RetType read_relay(uint32_t relay, ingest_relay_t* stats);
+
+    // number of packets with counters
+    uint32_t num_packets;
+
+private:
+    // layout at the start of shared memory
+    typedef struct {
+        uint32_t num_packets;
+        uint32_t num_links;   // link counters after the packet counters
+        uint32_t num_relays;  // relay counters after the link counters
+        uint32_t pad;
+    } ingest_header_t;
+
+    // what the writer of a packet keeps to itself
+    typedef struct {
+        bool active;        // this process has counted the packet
+        bool have_sequence; // a sequence number has been received since we started
+        uint32_t drops[MAX_PACKET_PORTS]; // drop count of each link's socket at the last update
+        uint64_t packets;   // counters at the start of the rate window
+        uint64_t bytes;
+    } writer_t;
+
+    // shares the config directory key file with telemetry shared memory, which uses 0, 2i+1, 2(i+1) and
+    // -2(i+1) for packet i, ftok only keeps the low 8 bits so 0xFF is free until there are over 127 packets
+    static const int shm_key_id = 0xFF;
+
+    ingest_stats_t* get_stats(uint32_t packet_id);
+
+    // NULL if the packet doesn't have link counters
+    ingest_link_t* get_link(uint32_t packet_id, uint32_t link);
+
+    // NULL if there's no such relay
+    ingest_relay_t* get_relay(uint32_t relay);
+
+    std::vector<packet_info_t*> packets;
+    std::vector<writer_t> writers;
+
+    // index of the first link counters of each packet, -1 if it only has one port
+    std::vector<int64_t> first_link;
+    uint32_t num_links;
+    uint32_t num_relays;
+
+    // start of the rate window
+    struct timespec window;
+
+    Shm* shm;
+
+    // needs to be stored with the object so Shm class has a valid pointer
+    std::string key_filename;
+
+    size_t total_size;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*******************************************************************************
+* Name: LinkMerger.h
+*
+* Purpose: Merges copies of a telemetry packet that arrive over redundant links
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef LINKMERGER_H
+#define LINKMERGER_H
+
+#include <stdint.h>
+#include <vector>
+#include "lib/vcm/vcm.h"
+#include "lib/telemetry/IngestShm.h"
+#include "common/types.h"
+
+/*
+* A vehicle can send the same packet over more than one link (e.g. an umbilical
+* and a radio), each to its own port. Listing every port a packet arrives on
+* ('[port],[port] {' in the VCM config file) has decom receive on all of them and
+* merge the copies: the first copy to arrive is written to shared memory and
+* logged, copies that arrive after it on the other links are dropped. We get
+* whichever link is faster for each packet without anything downstream seeing
+* it twice.
+*
+* Copies are matched by sequence number if the packet has one, otherwise by a
+* hash of their contents. A copy only matches one that arrived less than
+* MERGE_WINDOW before it. Without a sequence number the same contents again on
+* the same link is a new packet, with one it's a repeat and is dropped.
+* Packets are remembered in a slot picked by their sequence number, or without
+* one in order of arrival (hashes can land anywhere), where only the oldest is
+* pushed out to make room.
+*
+* A first copy with a sequence number up to MERGE_SLOTS behind the newest one
+* written (the other link lost it but got a newer one through) is logged but not
+* written, shared memory only moves forward. Further behind, or MERGE_RESTART
+* late ones in a row, is taken as the vehicle starting over.
+*
+* Each link's copies, arrival lag and losses are counted in ingest shared memory
+* (see IngestShm.h). A link lost a packet if another link's copy of it arrived
+* but its own never did, which is counted once the packet is old enough to be
+* pushed out of the merger.
+*/
+
+// packets remembered for matching copies
+#define MERGE_SLOTS 1024
+
+// longest a copy can arrive after the first and still be matched to it (nanoseconds)
+#define MERGE_WINDOW 1000000000ULL
+
+// late first copies in a row after which the vehicle is taken to have started its sequence over
+#define MERGE_RESTART 16
+
+class LinkMerger {
+public:
+    // what to do with a copy
+    typedef enum {
+        MERGE_NEW,      // first copy of a packet newer than any written, log and write it
+        MERGE_LATE,     // first copy of a packet older than one already written, log it only
+        MERGE_DUPLICATE // another copy of a packet that already arrived, drop it
+    } merge_t;
+
+    // constructor
+    LinkMerger();
+
+    // merge the copies of 'packet_id' from each of its ports
+    // link counters go to 'ingest', which doesn't need to be attached
+    RetType init(VCM* vcm, uint32_t packet_id, IngestShm* ingest);
+
+    // a correctly sized copy of the packet at 'data' arrived on 'link' (index into the packet's ports)
+    merge_t merge(uint32_t link, const uint8_t* data);
+
+private:
+    typedef struct {
+        uint64_t key;  // sequence number or hash of the packet
+        uint64_t time; // when the first copy arrived (nanoseconds, monotonic)
+        uint8_t first; // link the first copy arrived on
+        uint8_t seen;  // links a copy arrived on, one bit each
+        bool used;
+    } slot_t;
+
+    // count a loss for every link that never got the packet in 'slot'
+    void evict(slot_t* slot);
+
+    // newest packet without a sequence number hashed to 'key' that arrived less than MERGE_WINDOW before 'now'
+    // returns NULL if there isn't one
+    slot_t* find(uint64_t key, uint64_t now);
+
+    packet_info_t* packet;
+    uint32_t packet_id;
+    IngestShm* ingest;
+
+    std::vector<slot_t> slots;
+
+    // without a sequence number 'slots' is a ring in order of arrival, this is the oldest
+    size_t next;
+
+    // sequence numbers wrap around at the size of the measurement
+    uint64_t mask;
+
+    // newest sequence number written
+    uint64_t last;
+    bool have_last;
+
+    // late first copies in a row
+    uint32_t late_run;
+};
+
+#endif
@@ -11,6 +11,7 @@
 #define TELSHM_H
 
 #include <unordered_map>
+#include <string>
 #include <stdint.h>
 #include <semaphore.h>
 #include "lib/vcm/vcm.h"
@@ -35,6 +36,16 @@
 * too high to make this method better than sharing a single lock for a small number
 * of packets. The master nonce could still be updated and used as a way to block
 * until any packet has changed.
+*
+* Shared memory is keyed off of the config directory rather than the config file,
+* editors replace the file when saving it which would change the key.
+*
+* The config can be reloaded while GSW is running (see 'reload'). Each packet's
+* info block holds the layout of the packet (see 'VCM::packet_layout'), packets
+* whose layout didn't change keep their blocks and data, the rest are recreated.
+* Every reload bumps the generation in the master block, processes check
+* 'reloaded' at a safe point and start over with the new config when it's set.
+* Until then they keep the old blocks of any packet that changed.
 */
 
 using namespace shm;
@@ -70,9 +81,22 @@ public:
     RetType create();
 
     // destroy all shared memory for a vehicle
-    // NOTE: must be attached already!
+    // destroys every packet in shared memory, even if it was created from an older config
+    // NOTE: doesn't need to be attached
     RetType destroy();
 
+    // switch shared memory over to the layout of the VCM this object was initialized with
+    // packets with the same layout as before are left alone, changed packets are recreated
+    // (empty), new packets are created and packets no longer in the config are destroyed
+    // readers blocked on telemetry are woken up once so they can check 'reloaded', readers that don't
+    // check just go back to blocking on the packets they were attached to
+    // NOTE: must NOT be attached, only one process should ever reload (e.g. shmctl)
+    RetType reload();
+
+    // true if shared memory was reloaded with a new config since this object attached
+    // the object should be thrown out and a new one made with the new config
+    bool reloaded();
+
     // write the packet size bytes from 'data' to telemetry block number 'packet_id'
     // does not do any size check, data must be at least as large as the packet size
     // if any bytes fail to write FAILURE is returned
@@ -82,6 +106,12 @@ public:
     //       in cases where it's guaranteed there's only every 1 writer (e.g. decom) it's okay to write without a lock
     RetType write(uint32_t packet_id, uint8_t* data);
 
+    // write 'num' packets at once, 'data[i]' is written to telemetry block number 'packet_ids[i]'
+    // all of them are written while holding the lock once and readers are woken up once
+    // a packet can be in the list more than once, the last one is what ends up in shared memory
+    // NOTE: makes same locking assumptions as 'write'
+    RetType write(uint32_t* packet_ids, uint8_t** data, size_t num);
+
     // clear telemetry block corresponding to 'packet_id' with value 'val'
     // returns FAULURE if any bytes fail to clear
     // NOTE: this is a blocking operation
@@ -123,6 +153,15 @@ public:
     // otherwise returns SUCCESS
     RetType packet_updated(uint32_t packet_id, bool* updated);
 
+    // set 'nonce' to the nonce of the last write to 'packet_id' before the last call to 'read_lock'
+    // a later write to a packet always has a larger nonce (until the 32 bit nonce wraps around)
+    // MUST be called after read_lock, returns FAILURE if shm is not currently read locked
+    RetType packet_nonce(uint32_t packet_id, uint32_t* nonce);
+
+    // true if 'packet_id' has been written since its shared memory was created, before that it's all zeros
+    // NOTE: only stays true or false while the packet is write locked (see write_lock)
+    bool written(uint32_t packet_id);
+
     // check a list of 'num' packet ids for which was updated more recently
     // sets 'recent' to the more recently updated packet_id
     // must be read locked before calling this function, returns FAILURE otherwise
@@ -178,6 +217,8 @@ private:
     // info block for locking main shared memory
     typedef struct {
         uint32_t nonce; // nonce that updates every write
+        uint32_t generation; // incremented every time the config is reloaded
+        uint32_t num_packets; // number of packets in the current config
         uint32_t readers;
         uint32_t writers;
         sem_t rmutex;
@@ -186,8 +227,28 @@ private:
         sem_t resource;
     } shm_info_t;
 
+    // info block for each packet
+    typedef struct {
+        uint32_t nonce; // nonce of the last write, must be first
+        uint32_t written; // non-zero once the packet has been written
+        uint64_t layout; // layout of the packet held in the packet block
+    } packet_shm_info_t;
+
+    // create the blocks for packet 'i', the nonce starts at 'nonce'
+    RetType create_packet(size_t i, uint32_t nonce);
+
+    // destroy the blocks of an old packet 'i' (whatever size they are)
+    RetType destroy_old_packet(size_t i);
+
     read_mode_t read_mode;
 
+    // config directory, the shared memory key
+    std::string key_filename;
+
+    uint64_t* layouts; // layout of each packet in the config
+    uint32_t generation; // generation when attached
+    uint32_t woken_generation; // last generation a blocking read_lock returned early for
+
     size_t num_packets; // number of packets
     uint32_t last_nonce; // last master nonce
     uint32_t* last_nonces; // list of previous nonces for all packets
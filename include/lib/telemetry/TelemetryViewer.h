@@ -11,7 +11,11 @@
 #define TELVIEW_H
 
 #include <stdint.h>
+#include <vector>
 #include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/HistoryShm.h"
+#include "lib/telemetry/EnvelopeShm.h"
+#include "lib/convert/calibrate.h"
 #include "lib/vcm/vcm.h"
 #include "common/types.h"
 
@@ -79,11 +83,26 @@ public:
     // set 'val' to the value of a telemetry measurement
     // converts raw telemetry data into usable types
     // returns FAILURE if type conversion is impossible
-    RetType get_str(measurement_info_t* meas, std::string* val);
+    RetType get_str(measurement_info_t* meas, std::string* val); // floats in their shortest form (see convert::convert_to)
     RetType get_float(measurement_info_t* meas, float* val);
     RetType get_double(measurement_info_t* meas, double* val);
     RetType get_int(measurement_info_t* meas, int* val);
     RetType get_uint(measurement_info_t* meas, unsigned int* val);
+    RetType get_int64(measurement_info_t* meas, int64_t* val);
+    RetType get_uint64(measurement_info_t* meas, uint64_t* val);
+    // any numeric measurement as a double
+    RetType get_value(measurement_info_t* meas, double* val);
+    // set 'val' to every element of an array measurement, 'val' holds at least 'max' elements
+    // returns FAILURE if the array has more than 'max' elements (meas->count)
+    RetType get_array(measurement_info_t* meas, uint32_t* val, size_t max);
+    RetType get_array(measurement_info_t* meas, int32_t* val, size_t max);
+    RetType get_array(measurement_info_t* meas, uint64_t* val, size_t max);
+    RetType get_array(measurement_info_t* meas, int64_t* val, size_t max);
+    RetType get_array(measurement_info_t* meas, float* val, size_t max);
+    RetType get_array(measurement_info_t* meas, double* val, size_t max); // any numeric measurement
+    // write the value as text into [first, last) with no allocation (see convert::format)
+    // sets 'end' to one past the last character written, returns FAILURE if it doesn't fit
+    RetType get_str(measurement_info_t* meas, char* first, char* last, char** end);
     // place up to meas->size bytes into 'buffer'
     RetType get_raw(measurement_info_t* meas, uint8_t* buffer);
 
@@ -93,6 +112,9 @@ public:
     RetType get_double(std::string& meas, double* val);
     RetType get_int(std::string& meas, int* val);
     RetType get_uint(std::string& meas, unsigned int* val);
+    RetType get_int64(std::string& meas, int64_t* val);
+    RetType get_uint64(std::string& meas, uint64_t* val);
+    RetType get_value(std::string& meas, double* val);
     RetType get_raw(std::string& meas, uint8_t* buffer);
     RetType get_raw(measurement_info_t* meas, uint8_t** buffer); // no copy
 
@@ -102,6 +124,38 @@ public:
     // return true if the measurement was updated in the last call to 'update'
     bool updated(measurement_info_t* meas);
 
+    // get the recorded history of a measurement (see HistoryShm.h)
+    // every sample with a timestamp in [t0, t1] is appended to 'times' and 'values', oldest first
+    // timestamps are microseconds since the epoch
+    // returns FAILURE if no history is kept for the measurement
+    // NOTE: does not need to be updated, history is read straight from shared memory
+    RetType get_history_range(measurement_info_t* meas, uint64_t t0, uint64_t t1,
+                              std::vector<uint64_t>* times, std::vector<double>* values);
+    RetType get_history_range(std::string& meas, uint64_t t0, uint64_t t1,
+                              std::vector<uint64_t>* times, std::vector<double>* values);
+
+    // get the last 'seconds' of recorded history of a measurement
+    RetType get_history_last(measurement_info_t* meas, double seconds,
+                             std::vector<uint64_t>* times, std::vector<double>* values);
+    RetType get_history_last(std::string& meas, double seconds,
+                             std::vector<uint64_t>* times, std::vector<double>* values);
+
+    // get the downsampled min/max/mean envelope of a measurement (see EnvelopeShm.h)
+    // every bucket of 'period' milliseconds overlapping [t0, t1] is appended to 'out', oldest first
+    // buckets are merged from the coarsest tier with a period no longer than 'period'
+    // returns FAILURE if no envelopes are kept for the measurement
+    // NOTE: does not need to be updated, envelopes are read straight from shared memory
+    RetType get_envelope_range(measurement_info_t* meas, uint32_t period, uint64_t t0, uint64_t t1,
+                               std::vector<envelope_t>* out);
+    RetType get_envelope_range(std::string& meas, uint32_t period, uint64_t t0, uint64_t t1,
+                               std::vector<envelope_t>* out);
+
+    // get the envelope of the last 'seconds' of a measurement
+    RetType get_envelope_last(measurement_info_t* meas, uint32_t period, double seconds,
+                              std::vector<envelope_t>* out);
+    RetType get_envelope_last(std::string& meas, uint32_t period, double seconds,
+                              std::vector<envelope_t>* out);
+
 private:
     TelemetryShm* shm;
     bool rm_shm = false;
@@ -117,6 +171,22 @@ private:
 
     uint8_t** packet_buffers;
     size_t* packet_sizes;
+
+    // calibrated measurements of each tracked packet, evaluated whenever the packet updates
+    // NULL for packets without calibrated measurements
+    convert::CalibrationBatch** calibrations;
+    double** calibrated;
+
+    // set 'index' to the location of 'meas' that was updated most recently
+    RetType latest_location(measurement_info_t* meas, size_t* index);
+
+    // attached the first time history is requested
+    HistoryShm* history;
+    RetType open_history();
+
+    // attached the first time an envelope is requested
+    EnvelopeShm* envelope;
+    RetType open_envelope();
 };
 
 #endif
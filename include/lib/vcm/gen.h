@@ -0,0 +1,174 @@
+/*******************************************************************************
+* Name: gen.h
+*
+* Purpose: Support for vehicle headers generated by 'vcm gen'
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef VCM_GEN_H
+#define VCM_GEN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "lib/vcm/vcm.h"
+#include "lib/convert/decode.h"
+#include "lib/convert/calibrate.h"
+
+/*
+* 'vcm gen' (proc/tool/vcm) reads a VCM config and writes a header with a
+* packed struct for every packet. Each measurement is a run of raw bytes in the
+* struct with inline accessors that decode it with the endianness, size and
+* sign from the config baked in, so reading a value compiles down to a load and
+* maybe a byte swap, with no lookup by name:
+*
+*   const sample_device::packet0_t* p = (const sample_device::packet0_t*)tshm.get_buffer(sample_device::packet0_t::index);
+*   uint32_t test = p->TEST();
+*
+* The generated header also has the measurement ids (see 'VCM::get_info(uint32_t)')
+* and a fingerprint of each packet's layout. A program built against a
+* generated header should check it matches the config it's running with
+* ('matches' in the generated header) since the config can change after the
+* program was built.
+*
+* Everything here is used by the generated code, it isn't meant to be called
+* directly.
+*/
+
+namespace vcm {
+namespace gen {
+
+    // integers, zero or sign extended
+    template<unsigned SIZE, bool BIG>
+    inline uint64_t get_uint(const uint8_t* data) {
+        return convert::decode::load<SIZE, BIG>(data);
+    }
+
+    template<unsigned SIZE, bool BIG>
+    inline int64_t get_int(const uint8_t* data) {
+        return convert::decode::sign_extend<SIZE>(convert::decode::load<SIZE, BIG>(data));
+    }
+
+    // write the low 'SIZE' bytes of 'v'
+    template<unsigned SIZE, bool BIG>
+    inline void set_uint(uint8_t* data, uint64_t v) {
+        if constexpr(SIZE == 2 || SIZE == 4 || SIZE == 8) {
+            typedef typename std::conditional<SIZE == 2, uint16_t,
+                    typename std::conditional<SIZE == 4, uint32_t, uint64_t>::type>::type word_t;
+
+            word_t w = (word_t)v;
+
+            if constexpr(BIG != convert::decode::host_big) {
+                w = convert::decode::bswap(w);
+            }
+
+            memcpy(data, &w, SIZE);
+        } else {
+            for(unsigned i = 0; i < SIZE; i++) {
+                if constexpr(BIG) {
+                    data[SIZE - 1 - i] = (uint8_t)(v >> (8 * i));
+                } else {
+                    data[i] = (uint8_t)(v >> (8 * i));
+                }
+            }
+        }
+    }
+
+    // bitfields of an integer
+    template<unsigned SIZE, bool BIG, unsigned OFFSET, uint64_t MASK>
+    inline uint64_t get_bits(const uint8_t* data) {
+        return (convert::decode::load<SIZE, BIG>(data) >> OFFSET) & MASK;
+    }
+
+    template<unsigned SIZE, bool BIG, unsigned OFFSET, uint64_t MASK, unsigned WIDTH>
+    inline int64_t get_signed_bits(const uint8_t* data) {
+        return convert::decode::sign_extend_bits(get_bits<SIZE, BIG, OFFSET, MASK>(data), WIDTH);
+    }
+
+    // read-modify-write of the parent integer, bits of 'v' outside the field are dropped
+    template<unsigned SIZE, bool BIG, unsigned OFFSET, uint64_t MASK>
+    inline void set_bits(uint8_t* data, uint64_t v) {
+        uint64_t word = convert::decode::load<SIZE, BIG>(data);
+        word = (word & ~(MASK << OFFSET)) | ((v & MASK) << OFFSET);
+        set_uint<SIZE, BIG>(data, word);
+    }
+
+    // floating point
+    template<bool BIG>
+    inline float get_float(const uint8_t* data) {
+        uint32_t bits = (uint32_t)convert::decode::load<sizeof(float), BIG>(data);
+
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    template<bool BIG>
+    inline double get_double(const uint8_t* data) {
+        uint64_t bits = convert::decode::load<sizeof(double), BIG>(data);
+
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    template<bool BIG>
+    inline void set_float(uint8_t* data, float v) {
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        set_uint<sizeof(float), BIG>(data, bits);
+    }
+
+    template<bool BIG>
+    inline void set_double(uint8_t* data, double v) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        set_uint<sizeof(double), BIG>(data, bits);
+    }
+
+    // copy a string into a field of 'size' bytes, the rest of the field is zeroed
+    // NOTE: not NUL terminated if the string fills the field
+    inline void set_string(uint8_t* data, size_t size, const char* s) {
+        size_t len = strnlen(s, size);
+        memcpy(data, s, len);
+        memset(data + len, 0, size - len);
+    }
+
+    // lookup table calibration with 'n' points, same as CAL_TABLE in lib/convert/calibrate.h
+    inline double table(const double* xs, const double* ys, size_t n, double x) {
+        if(x <= xs[0]) {
+            return ys[0];
+        } else if(x >= xs[n - 1]) {
+            return ys[n - 1];
+        }
+
+        size_t i = 1;
+        while(xs[i] <= x) {
+            i++;
+        }
+
+        double t = (x - xs[i - 1]) / (xs[i] - xs[i - 1]);
+        return ys[i - 1] + (t * (ys[i] - ys[i - 1]));
+    }
+
+    // true if 'vcm' has the 'num' packet layouts 'layouts'
+    inline bool matches(VCM* vcm, const uint64_t* layouts, uint32_t num) {
+        if(vcm->num_packets != num) {
+            return false;
+        }
+
+        for(uint32_t i = 0; i < num; i++) {
+            if(vcm->packet_layout(i) != layouts[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+} // namespace gen
+} // namespace vcm
+
+#endif
@@ -0,0 +1,181 @@
+/*******************************************************************************
+* Name: image.h
+*
+* Purpose: Layout of compiled binary VCM images
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef VCM_IMAGE_H
+#define VCM_IMAGE_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+* A VCM image is a config file that has already been parsed, written out by
+* 'vcm compile' (proc/tool/vcm) next to the config file as '<config file>.img'.
+* When a VCM is initialized it maps the image read-only instead of parsing the
+* text config if the image exists and is newer than the config file. Every
+* process maps the same file so the pages are shared.
+*
+* Everything in the image is referenced by byte offset from the start of the
+* image (or index into a table), so it doesn't matter where it's mapped:
+*
+*   | header | strings | measurements | locations | packets | ports | nets | relays | calibrations | ranges | numbers | index |
+*
+* Strings are NUL terminated and referenced by offset into the string table.
+* File names (triggers, constants, history, schedule) are stored relative to the
+* config directory, the same way they're written in the config file.
+*
+* The index is an open addressing hash table of measurement names (FNV-1a,
+* linear probing), each slot holds a measurement index plus one, zero is empty.
+*
+* Images are in the byte order of the machine that compiled them and start
+* with 'VCM_IMAGE_MAGIC', an image from a machine with the other byte order
+* fails the magic check. Images with a different 'VCM_IMAGE_VERSION' are
+* ignored and the text config is parsed instead.
+*/
+
+namespace vcm {
+namespace image {
+
+    // 'VCMI' when read on the machine that wrote it
+    static const uint32_t VCM_IMAGE_MAGIC = 0x494d4356;
+
+    // bump whenever anything below changes
+    static const uint32_t VCM_IMAGE_VERSION = 10;
+
+    // suffix added to the config file name
+    static const char* const VCM_IMAGE_SUFFIX = ".img";
+
+    // a table of 'count' entries starting 'offset' bytes into the image
+    typedef struct {
+        uint64_t offset;
+        uint32_t count;
+        uint32_t pad;
+    } table_t;
+
+    typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t size;          // total size of the image in bytes
+
+        // strings
+        uint32_t device;
+        uint32_t trigger_file;  // offsets into the string table, zero if not set
+        uint32_t const_file;
+        uint32_t history_file;
+        uint32_t schedule_file;
+
+        uint32_t multicast_addr;
+        uint16_t port;
+        uint8_t protocol;
+        uint8_t frame_id_size;
+        uint8_t frame_id_endianness;
+        uint8_t pad[3];
+
+        table_t strings;        // 'count' is the size of the table in bytes
+        table_t measurements;
+        table_t locations;
+        table_t packets;
+        table_t ports;          // uint16_t ports of every packet
+        table_t nets;
+        table_t relays;
+        table_t calibrations;
+        table_t ranges;
+        table_t numbers;
+        table_t index;
+    } header_t;
+
+    typedef struct {
+        uint32_t name;          // offset into the string table
+        uint32_t size;
+        uint32_t count;
+        uint8_t endianness;
+        uint8_t type;
+        uint8_t sign;
+        uint8_t bit_offset;
+        uint8_t bit_width;
+        uint8_t pad[3];
+        uint32_t cal_input;     // index of the input measurement plus one, zero if not calibrated
+        uint32_t calibration;   // index into the calibration table
+        uint32_t first_location;
+        uint32_t num_locations;
+        uint64_t bit_mask;
+        double sample_rate;
+    } measurement_t;
+
+    typedef struct {
+        uint64_t offset;
+        uint32_t packet_index;
+        uint32_t pad;
+    } location_t;
+
+    typedef struct {
+        uint64_t size;
+        uint32_t timeout;
+        uint16_t port;
+        uint8_t is_virtual;
+        uint8_t framed;
+        uint32_t frame_id;
+        uint32_t sequence;      // index of the sequence number measurement plus one, zero if there isn't one
+        uint32_t workers;
+        uint32_t first_port;    // 'num_ports' ports starting at 'first_port' in the port table
+        uint32_t num_ports;
+        uint32_t crc;           // index of the CRC measurement plus one, zero if there isn't one
+        uint32_t endpoint;      // offset into the string table, zero for UDP and TCP
+        uint32_t can_id;
+        uint8_t delta;
+        uint8_t transport;
+        uint8_t pad[6];
+    } packet_t;
+
+    // network devices, only automatic configuration is supported
+    typedef struct {
+        uint32_t name;          // offset into the string table
+        uint16_t port;
+        uint16_t pad;
+    } net_t;
+
+    typedef struct {
+        uint32_t addr;          // network byte order
+        uint16_t port_offset;
+        uint16_t pad;
+    } relay_t;
+
+    // numbers are indices into the number table
+    // CAL_POLY: 'num' coefficients starting at 'first'
+    // CAL_PIECEWISE: 'num' ranges starting at 'first' in the range table
+    // CAL_TABLE: 'num' x values starting at 'first' followed by 'num' y values
+    typedef struct {
+        uint32_t kind;
+        uint32_t first;
+        uint32_t num;
+        uint32_t pad;
+    } calibration_t;
+
+    typedef struct {
+        double low;
+        double high;
+        uint32_t first;         // 'num' coefficients starting at 'first' in the number table
+        uint32_t num;
+    } range_t;
+
+    // hash of a measurement name for the index
+    inline uint32_t hash(const char* s, size_t len) {
+        uint32_t h = 2166136261u;
+
+        for(size_t i = 0; i < len; i++) {
+            h ^= (uint8_t)s[i];
+            h *= 16777619u;
+        }
+
+        return h;
+    }
+
+} // namespace image
+} // namespace vcm
+
+#endif
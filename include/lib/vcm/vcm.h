@@ -19,6 +19,21 @@
 
 #define DEFAULT_CONFIG_DIR "data/default"
 
+// most decom processes that can receive on one port
+#define MAX_PORT_WORKERS 64
+
+// most ports (links) one packet can arrive on
+#define MAX_PACKET_PORTS 8
+
+// most destinations decom can relay datagrams to
+#define MAX_RELAYS 16
+
+// largest packet that fits in one CAN FD frame
+#define MAX_CAN_PACKET_SIZE 64
+
+// largest CAN id, ids above 0x7FF are extended (29 bit) ids
+#define MAX_CAN_ID 0x1FFFFFFF
+
 // TODO make endianess per measurement rather than per file
 
 // responsible for translating config file into addresses in shared mem
@@ -46,6 +61,14 @@ namespace vcm {
         UDP, PROTOCOL_NOT_SET
     } protocol_t;
 
+    // how a telemetry packet gets to the ground station (see lib/nm/TransportReceivers.h for the receivers)
+    typedef enum {
+        TRANSPORT_UDP,  // datagrams to a port, '[port] {'
+        TRANSPORT_TCP,  // a stream of records to a port, each the packet's size (2 bytes, big endian) then the packet, 'tcp [port] {'
+        TRANSPORT_UNIX, // datagrams to a Unix domain socket, 'unix [path] {'
+        TRANSPORT_CAN   // CAN (or CAN FD) frames with one id on a SocketCAN interface, 'can [interface] [id] {'
+    } transport_t;
+
     typedef enum {
         ADDR_AUTO,   // automatically determine IP address
         ADDR_STATIC  // statically set IP address
@@ -59,11 +82,56 @@ namespace vcm {
         void* addr_info; // depends on address mode
     } net_info_t;
 
+    // a destination decom forwards every datagram it receives to, unchanged (see lib/nm/PacketRelay.h)
+    typedef struct {
+        uint32_t addr;        // IPv4 address in network byte order, unicast or multicast
+        uint16_t port_offset; // datagrams go to the port they arrived on plus this
+    } relay_info_t;
+
+    struct measurement_info_s;
+
     typedef struct {
         size_t size;
         uint32_t timeout; // time before packet is considered stale (in milliseconds) TODO implement this
         uint16_t port; // in host order (NOT network order)
         bool is_virtual;
+
+        // every port the packet arrives on, one per link it's sent over, the first is 'port' (empty if virtual)
+        // listed like '[port],[port] {' in the config file, decom merges the copies from each link
+        std::vector<uint16_t> ports;
+
+        // UDP unless the config file says otherwise, TCP packets have a port like UDP packets do
+        // Unix and CAN packets have no ports, they're found by 'endpoint' (and 'can_id')
+        transport_t transport;
+        std::string endpoint; // Unix socket path or CAN interface name
+        uint32_t can_id;
+
+        // framed packets share a port with other framed packets, each datagram holds one or more frames
+        // a frame is a packet id ('frame_id_size' bytes) followed by the packet
+        bool framed;
+        uint32_t frame_id; // id in the frame header, unique on the port
+
+        // delta encoded packets are sent as keyframes and XOR deltas against the last packet (see lib/dev/delta/delta.h)
+        // decom puts the whole packet back together, marked by '[port] delta {' in the config file
+        bool delta;
+
+        // unsigned integer the vehicle counts up by one every time it sends the packet, NULL if there isn't one
+        // marked by following a measurement in the packet with 'sequence' in the config file
+        struct measurement_info_s* sequence;
+        size_t sequence_offset; // offset of 'sequence' in the packet
+
+        // 4 byte CRC32C of every other byte in the packet, NULL if there isn't one (see lib/dev/crc/crc.h)
+        // marked by following a measurement in the packet with 'crc' in the config file
+        struct measurement_info_s* crc;
+        size_t crc_offset; // offset of 'crc' in the packet
+
+        // number of decom processes receiving on the packet's port, each with its own socket
+        // set for every packet on the port with 'workers [port] [number]' in the config file, 1 if not set
+        uint32_t workers;
+
+        // calibrated measurements found in this packet, polynomials first ordered by degree
+        // (see lib/convert/calibrate.h)
+        std::vector<struct measurement_info_s*> calibrated;
     } packet_info_t;
 
     typedef struct {
@@ -71,12 +139,92 @@ namespace vcm {
         uint32_t packet_index; // which packet
     } location_info_t;
 
+    typedef enum {
+        CAL_POLY,      // polynomial (linear calibrations are first order polynomials)
+        CAL_PIECEWISE, // a polynomial for each range of input values
+        CAL_TABLE      // lookup table with linear interpolation
+    } calibration_kind_t;
+
+    // one range of a piecewise calibration
+    typedef struct {
+        double low;                 // lowest input value of the range
+        double high;                // highest input value of the range
+        std::vector<double> coeffs; // polynomial coefficients, lowest order first
+    } calibration_range_t;
+
+    // calibration curve, turns a raw value into an engineering value
     typedef struct {
+        calibration_kind_t kind;
+        std::vector<double> coeffs;              // CAL_POLY, lowest order first
+        std::vector<calibration_range_t> ranges; // CAL_PIECEWISE, first matching range is used
+        std::vector<double> x;                   // CAL_TABLE, ascending input values
+        std::vector<double> y;                   // CAL_TABLE, output value at each input value
+    } calibration_t;
+
+    // compiled decoders, read a measurement value from raw telemetry (see lib/convert/decode.h)
+    typedef uint32_t (*decode_uint32_t)(const struct measurement_info_s* meas, const uint8_t* data);
+    typedef int32_t (*decode_int32_t)(const struct measurement_info_s* meas, const uint8_t* data);
+    typedef uint64_t (*decode_uint64_t)(const struct measurement_info_s* meas, const uint8_t* data);
+    typedef int64_t (*decode_int64_t)(const struct measurement_info_s* meas, const uint8_t* data);
+    typedef float (*decode_float_t)(const struct measurement_info_s* meas, const uint8_t* data);
+    typedef double (*decode_double_t)(const struct measurement_info_s* meas, const uint8_t* data);
+
+    // compiled array decoders, decode every element of an array measurement into 'out'
+    typedef void (*decode_array_uint32_t)(const struct measurement_info_s* meas, const uint8_t* data, uint32_t* out);
+    typedef void (*decode_array_int32_t)(const struct measurement_info_s* meas, const uint8_t* data, int32_t* out);
+    typedef void (*decode_array_uint64_t)(const struct measurement_info_s* meas, const uint8_t* data, uint64_t* out);
+    typedef void (*decode_array_int64_t)(const struct measurement_info_s* meas, const uint8_t* data, int64_t* out);
+    typedef void (*decode_array_float_t)(const struct measurement_info_s* meas, const uint8_t* data, float* out);
+    typedef void (*decode_array_double_t)(const struct measurement_info_s* meas, const uint8_t* data, double* out);
+
+    // compiled column decoders, decode the measurement out of 'num' records 'stride' bytes apart into 'out'
+    typedef void (*decode_column_double_t)(const struct measurement_info_s* meas, const uint8_t* data,
+                                           size_t stride, size_t num, double* out);
+
+    typedef struct measurement_info_s {
         std::vector<location_info_t> locations; // locations of this measurement
-        size_t size;                            // size in bytes
+        size_t size;                            // size in bytes (of a single element for arrays)
         endianness_t endianness;
         measurement_type_t type;
         measurement_sign_t sign;
+
+        // arrays are 'count' elements of 'size' bytes back to back in a packet
+        // the last element is the newest sample
+        uint32_t count;       // number of elements, 1 if not an array
+        double sample_rate;   // samples per second of an array, 0 if not known
+
+        // bitfields are a range of bits of another integer measurement (the parent)
+        // they share the size, endianness and locations of their parent
+        // bit 0 is the least significant bit of the parent's value
+        uint8_t bit_offset;  // lowest bit of the field
+        uint8_t bit_width;   // number of bits in the field, 0 if not a bitfield
+        uint64_t bit_mask;   // mask of 'bit_width' low bits
+
+        // calibrated measurements are an engineering value computed from another numeric measurement (the input)
+        // they share the size, endianness and locations of their input and read as doubles
+        struct measurement_info_s* cal_input; // NULL if not calibrated
+        calibration_t* calibration;
+        std::vector<uint32_t> cal_index;      // index into the 'calibrated' list of the packet of each location
+
+        // set when the VCM is initialized, NULL if the measurement can't be read as that type
+        decode_uint32_t decode_uint32;
+        decode_int32_t decode_int32;
+        decode_uint64_t decode_uint64;
+        decode_int64_t decode_int64;
+        decode_float_t decode_float;
+        decode_double_t decode_double;
+        decode_double_t decode_value;   // any numeric measurement as a double
+
+        // same as above for every element of an array (also work on single measurements)
+        decode_array_uint32_t decode_array_uint32;
+        decode_array_int32_t decode_array_int32;
+        decode_array_uint64_t decode_array_uint64;
+        decode_array_int64_t decode_array_int64;
+        decode_array_float_t decode_array_float;
+        decode_array_double_t decode_array_value;
+
+        // any numeric measurement as a double out of many records at once (see lib/convert/columns.h)
+        decode_column_double_t decode_column_value;
     } measurement_info_t;
 
     class VCM {
@@ -86,8 +234,22 @@ namespace vcm {
         ~VCM();
 
         // initialize
+        // uses the compiled image of the config file if there is one that's up to date (see lib/vcm/image.h)
         RetType init();
 
+        // write a compiled image of the config file to 'image_file'
+        // the image replaces any old one atomically, processes that have the old one mapped keep it
+        // NOTE: must be initialized already!
+        RetType compile(std::string& image_file);
+
+        // true if this VCM was loaded from a compiled image
+        bool from_image();
+
+        // fingerprint of the raw layout of packet 'packet_index'
+        // two packets with the same fingerprint hold the same measurements at the same offsets in the same format
+        // bitfields and calibrated measurements aren't part of the layout, they're only a way of reading it
+        uint64_t packet_layout(uint32_t packet_index);
+
         // parse constants file
         // constants can be accessed with 'get_const'
         RetType parse_consts();
@@ -101,6 +263,11 @@ namespace vcm {
         measurement_info_t* get_info(std::string& measurement); // get the info of a measurement
         std::vector<std::string> measurements; // list of measurement names
 
+        // get the info of measurement 'id', the index of its name in 'measurements'
+        // generated vehicle headers have these as constants (see proc/tool/vcm)
+        // returns NULL if 'id' is out of range
+        measurement_info_t* get_info(uint32_t id);
+
         std::vector<packet_info_t*> packets; // list of packets
 
         // get network device info
@@ -108,6 +275,9 @@ namespace vcm {
         net_info_t* get_net(std::string& device_name);
         std::vector<std::string> net_devices; // list of network device names
 
+        // destinations to relay every received datagram to, 'relay [address] [port offset]' in the config file
+        std::vector<relay_info_t> relays;
+
         // get a network device in automatic set in port 'port'
         // returns NULL on error
         net_info_t* get_auto_net(uint16_t port);
@@ -122,15 +292,33 @@ namespace vcm {
         std::string config_file;
         std::string trigger_file;
         std::string const_file;
+        std::string history_file;
+        std::string schedule_file;
         std::string device;
 
         endianness_t sys_endianness; // endianness of the system GSW is running on
 
+        // header of frames on ports with framed packets
+        uint8_t frame_id_size;             // bytes, 1 by default
+        endianness_t frame_id_endianness;  // little endian by default
+
         uint32_t num_packets; // number of telemetry packets
         uint32_t num_net_devices; // number of network devices
     private:
+        // map 'image_file' and build everything from it
+        RetType load_image(std::string& image_file);
+
+        // give calibrated measurements their input's locations and add them to their packets
+        void link_calibrations(std::vector<measurement_info_t*>& calibrated);
+
         // local vars
         std::ifstream* f;
+
+        // mapped image, NULL if the config file was parsed
+        uint8_t* image;
+        size_t image_size;
+        std::vector<measurement_info_t*> meas_list; // measurement info in the same order as 'measurements'
+
         std::unordered_map<std::string, measurement_info_t*> addr_map;
         std::unordered_map<std::string, net_info_t*> net_map;
         std::unordered_map<uint16_t, net_info_t*> auto_port_map; // ports mapped to network devices in automatic configuration
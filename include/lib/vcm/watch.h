@@ -0,0 +1,72 @@
+/*******************************************************************************
+* Name: watch.h
+*
+* Purpose: Watches the files of a VCM config for changes
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef VCM_WATCH_H
+#define VCM_WATCH_H
+
+#include <stdint.h>
+#include <string>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* Uses inotify on the config directory, so files that are replaced (most
+* editors save to a temporary file and rename it) are still caught. Editors
+* usually touch a file more than once when saving, so after the first change
+* the watcher waits until the directory has been quiet for a short time before
+* reporting it.
+*/
+
+namespace vcm {
+
+    // which files changed, OR'd together
+    typedef enum {
+        CONFIG_CHANGED = 0x1,
+        TRIGGERS_CHANGED = 0x2,
+        CONSTANTS_CHANGED = 0x4,
+        HISTORY_CHANGED = 0x8
+    } config_change_t;
+
+    class ConfigWatcher {
+    public:
+        // constructor
+        ConfigWatcher();
+
+        // destructor
+        ~ConfigWatcher();
+
+        // start watching the config, trigger, constants and history files of 'vcm'
+        RetType init(VCM* vcm);
+
+        // check for changes without blocking
+        // 'changed' is set to the files that changed (see 'config_change_t')
+        // returns NOCHANGE if nothing changed
+        RetType poll(uint32_t* changed);
+
+        // block until something changes or 'timeout' milliseconds pass (0 waits forever)
+        // returns TIMEOUT if nothing changed in time
+        // returns INTERRUPTED if a signal was caught
+        RetType wait(uint32_t* changed, uint32_t timeout = 0);
+
+        // inotify file descriptor, can be used with poll/select
+        int fd;
+
+    private:
+        // read every queued event, OR'ing what changed into 'changed'
+        void drain(uint32_t* changed);
+
+        std::string config_dir;
+        std::string config_file;
+        std::string trigger_file;
+        std::string const_file;
+        std::string history_file;
+    };
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "lib/convert/calibrate.h"
+#include "lib/dls/dls.h"
+
+using namespace vcm;
+using namespace dls;
+using namespace convert;
+
+
+RetType CalibrationBatch::init(VCM* vcm, uint32_t packet_index) {
+    if(packet_index >= vcm->num_packets) {
+        MsgLogger logger("CalibrationBatch", "init");
+        logger.log_message("invalid packet index");
+        return FAILURE;
+    }
+
+    inputs.clear();
+    offsets.clear();
+    curves.clear();
+    groups.clear();
+    poly_coeffs.clear();
+    num_poly = 0;
+
+    // the VCM orders the list with polynomials first, grouped by degree
+    for(measurement_info_t* meas : vcm->packets[packet_index]->calibrated) {
+        size_t offset = 0;
+        for(location_info_t& loc : meas->locations) {
+            if(loc.packet_index == packet_index) {
+                offset = loc.offset;
+                break;
+            }
+        }
+
+        inputs.push_back(meas->cal_input);
+        offsets.push_back(offset);
+        curves.push_back(meas->calibration);
+
+        if(meas->calibration->kind != CAL_POLY) {
+            continue;
+        }
+
+        size_t deg = calibrate::degree(meas->calibration);
+        if(groups.size() == 0 || groups.back().degree != deg) {
+            poly_group_t group;
+            group.first = num_poly;
+            group.count = 0;
+            group.degree = deg;
+            groups.push_back(group);
+        }
+
+        groups.back().count++;
+        num_poly++;
+    }
+
+    // lay out the coefficients by order then channel
+    for(poly_group_t& group : groups) {
+        group.coeffs = poly_coeffs.size();
+        poly_coeffs.resize(poly_coeffs.size() + ((group.degree + 1) * group.count));
+
+        for(size_t ch = 0; ch < group.count; ch++) {
+            const std::vector<double>& c = curves[group.first + ch]->coeffs;
+
+            for(size_t order = 0; order <= group.degree; order++) {
+                poly_coeffs[group.coeffs + (order * group.count) + ch] = c[order];
+            }
+        }
+    }
+
+    raw.resize(inputs.size());
+
+    return SUCCESS;
+}
+
+size_t CalibrationBatch::size() {
+    return inputs.size();
+}
+
+void CalibrationBatch::evaluate(const uint8_t* packet, double* out) {
+    const size_t n = inputs.size();
+    double* x = raw.data();
+
+    // decode every input first
+    for(size_t i = 0; i < n; i++) {
+        x[i] = inputs[i]->decode_value(inputs[i], packet + offsets[i]);
+    }
+
+    // Horner's method across every channel of a group at once
+    for(const poly_group_t& group : groups) {
+        const size_t count = group.count;
+        const double* __restrict gx = x + group.first;
+        double* __restrict y = out + group.first;
+        const double* __restrict c = poly_coeffs.data() + group.coeffs;
+
+        const double* top = c + (group.degree * count);
+        for(size_t i = 0; i < count; i++) {
+            y[i] = top[i];
+        }
+
+        for(size_t order = group.degree; order > 0; order--) {
+            const double* co = c + ((order - 1) * count);
+
+            for(size_t i = 0; i < count; i++) {
+                y[i] = (y[i] * gx[i]) + co[i];
+            }
+        }
+    }
+
+    // piecewise curves and lookup tables
+    for(size_t i = num_poly; i < n; i++) {
+        out[i] = calibrate::evaluate(curves[i], x[i]);
+    }
+}
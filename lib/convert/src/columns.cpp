@@ -0,0 +1,115 @@
+#include <thread>
+#include "lib/convert/columns.h"
+#include "lib/dls/dls.h"
+
+using namespace vcm;
+using namespace dls;
+using namespace convert;
+
+// number of records a thread decodes at a time
+// small enough that a chunk of records fits in cache while every column is pulled out of it
+#define CHUNK_RECORDS 2048
+
+
+ColumnDecoder::ColumnDecoder() {
+    packet_size = 0;
+    num_threads = 1;
+}
+
+RetType ColumnDecoder::init(VCM* vcm, uint32_t packet_index, unsigned int threads) {
+    if(packet_index >= vcm->num_packets) {
+        MsgLogger logger("ColumnDecoder", "init");
+        logger.log_message("invalid packet index");
+        return FAILURE;
+    }
+
+    columns.clear();
+    packet_size = vcm->packets[packet_index]->size;
+
+    // columns are in the order of the VCM measurement list, same as every other tool
+    for(std::string& name : vcm->measurements) {
+        measurement_info_t* meas = vcm->get_info(name);
+
+        if(meas == NULL || meas->decode_column_value == NULL) {
+            // strings
+            continue;
+        }
+
+        for(location_info_t& loc : meas->locations) {
+            if(loc.packet_index != packet_index) {
+                continue;
+            }
+
+            for(uint32_t e = 0; e < meas->count; e++) {
+                column_t col;
+                col.meas = meas;
+                col.element = e;
+                col.offset = loc.offset + ((size_t)e * meas->size);
+                columns.push_back(col);
+            }
+        }
+    }
+
+    if(threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+
+    num_threads = (threads == 0) ? 1 : threads;
+
+    return SUCCESS;
+}
+
+void ColumnDecoder::decode_range(const uint8_t* records, size_t stride, size_t num,
+                                 size_t first, size_t last, double* out) {
+    const uint8_t* base = records + (first * stride);
+    size_t n = last - first;
+
+    for(size_t c = 0; c < columns.size(); c++) {
+        const column_t& col = columns[c];
+        col.meas->decode_column_value(col.meas, base + col.offset, stride, n, out + (c * num) + first);
+    }
+}
+
+RetType ColumnDecoder::decode(const uint8_t* records, size_t stride, size_t num, double* out) {
+    if(stride < packet_size) {
+        MsgLogger logger("ColumnDecoder", "decode");
+        logger.log_message("record stride is smaller than the packet");
+        return FAILURE;
+    }
+
+    size_t num_chunks = (num + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+    size_t threads = (num_threads < num_chunks) ? num_threads : num_chunks;
+
+    if(threads <= 1) {
+        decode_range(records, stride, num, 0, num, out);
+        return SUCCESS;
+    }
+
+    // each thread takes every 'threads'th chunk
+    auto worker = [=](size_t t) {
+        for(size_t chunk = t; chunk < num_chunks; chunk += threads) {
+            size_t first = chunk * CHUNK_RECORDS;
+            size_t last = (first + CHUNK_RECORDS < num) ? first + CHUNK_RECORDS : num;
+
+            decode_range(records, stride, num, first, last, out);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(size_t t = 1; t < threads; t++) {
+        workers.push_back(std::thread(worker, t));
+    }
+
+    // this thread does its share too
+    worker(0);
+
+    for(std::thread& w : workers) {
+        w.join();
+    }
+
+    return SUCCESS;
+}
+
+RetType ColumnDecoder::decode(const uint8_t* records, size_t num, double* out) {
+    return decode(records, packet_size, num, out);
+}
@@ -6,248 +6,193 @@
 using namespace vcm;
 using namespace dls;
 
-char result[MAX_CONVERSION_SIZE];
+// NOTE: decoding uses the decoders compiled into each measurement when the VCM
+//       was initialized (see lib/convert/decode.h), nothing is shared between
+//       calls so these are safe to call from any thread
+//       a logger is only created if the conversion fails
 
-// TODO maybe have a fancy function with va_args, idk
 
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, double* dst) {
+    if(measurement->decode_double == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be a float type the size of a double!");
+        return FAILURE;
+    }
 
-RetType convert::convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement, const uint8_t* data, double* dst) {
-    MsgLogger logger("CONVERT", "convert_to");
+    *dst = measurement->decode_double(measurement, data);
+    return SUCCESS;
+}
 
-    if(measurement->type != FLOAT_TYPE) {
-        logger.log_message("Measurement must be a float type!");
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, float* dst) {
+    if(measurement->decode_float == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be a float type the size of a float!");
         return FAILURE;
     }
 
-    if(measurement->size != sizeof(double)) {
-        logger.log_message("measurement is not the size of a double!");
+    *dst = measurement->decode_float(measurement, data);
+    return SUCCESS;
+}
+
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, uint32_t* dst) {
+    if(measurement->decode_uint32 == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be an unsigned integer no larger than 4 bytes!");
         return FAILURE;
     }
 
-    uint8_t val[sizeof(double)];
-    // size_t addr = (size_t)measurement->addr;
-    // const uint8_t* buff = (const uint8_t*)data;
+    *dst = measurement->decode_uint32(measurement, data);
+    return SUCCESS;
+}
 
-    if(measurement->endianness != vcm->sys_endianness) {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[measurement->size - i - 1] = data[i];
-        }
-    } else {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[i] = data[i];
-        }
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, int32_t* dst) {
+    if(measurement->decode_int32 == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be a signed integer no larger than 4 bytes!");
+        return FAILURE;
     }
 
-    *dst = *((double*)val);
+    *dst = measurement->decode_int32(measurement, data);
     return SUCCESS;
 }
 
-RetType convert::convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement, const uint8_t* data, float* dst) {
-    MsgLogger logger("CONVERT", "convert_to");
-
-    if(measurement->type != FLOAT_TYPE) {
-        logger.log_message("Measurement must be a float type!");
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, uint64_t* dst) {
+    if(measurement->decode_uint64 == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be an unsigned integer no larger than 8 bytes!");
         return FAILURE;
     }
 
-    if(measurement->size != sizeof(float)) {
-        logger.log_message("measurement is not the size of a float!");
+    *dst = measurement->decode_uint64(measurement, data);
+    return SUCCESS;
+}
+
+RetType convert::convert_to(vcm::VCM*, vcm::measurement_info_t* measurement, const uint8_t* data, int64_t* dst) {
+    if(measurement->decode_int64 == NULL) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("Measurement must be a signed integer no larger than 8 bytes!");
         return FAILURE;
     }
 
-    uint8_t val[sizeof(float)];
-    // size_t addr = (size_t)measurement->addr;
-    // const uint8_t* buff = (const uint8_t*)data;
+    *dst = measurement->decode_int64(measurement, data);
+    return SUCCESS;
+}
 
-    if(measurement->endianness != vcm->sys_endianness) {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[measurement->size - i - 1] = data[i];
-        }
-    } else {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[i] = data[i];
-        }
+RetType convert::convert_value(vcm::measurement_info_t* measurement, const uint8_t* data, double* dst) {
+    if(measurement->decode_value == NULL) {
+        MsgLogger logger("CONVERT", "convert_value");
+        logger.log_message("Measurement must be numeric!");
+        return FAILURE;
     }
 
-    *dst = *((float*)val);
+    *dst = measurement->decode_value(measurement, data);
     return SUCCESS;
 }
 
-RetType convert::convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement, const uint8_t* data, uint32_t* dst) {
-    MsgLogger logger("CONVERT", "convert_to");
 
-    if(measurement->type != INT_TYPE || measurement->sign != UNSIGNED_TYPE) {
-        logger.log_message("Measurement must be an unsigned integer!");
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, uint32_t* dst, size_t max) {
+    if(measurement->decode_array_uint32 == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be an unsigned integer no larger than 4 bytes with at most " + std::to_string(max) + " elements!");
         return FAILURE;
     }
 
-    if(measurement->size > sizeof(uint32_t)) {
-        logger.log_message("measurement too large to fit into integer");
+    measurement->decode_array_uint32(measurement, data, dst);
+    return SUCCESS;
+}
+
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, int32_t* dst, size_t max) {
+    if(measurement->decode_array_int32 == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be a signed integer no larger than 4 bytes with at most " + std::to_string(max) + " elements!");
         return FAILURE;
     }
 
-    uint8_t val[sizeof(uint32_t)];
-    memset(val, 0, sizeof(uint32_t));
-    // size_t addr = (size_t)measurement->addr;
-    // const uint8_t* buff = (const uint8_t*)data;
+    measurement->decode_array_int32(measurement, data, dst);
+    return SUCCESS;
+}
 
-    if(measurement->endianness != vcm->sys_endianness) {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[measurement->size - i - 1] = data[i];
-        }
-    } else {
-        for(size_t i = 0; i < measurement->size; i++) {
-            val[i] = data[i];
-        }
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, uint64_t* dst, size_t max) {
+    if(measurement->decode_array_uint64 == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be an unsigned integer no larger than 8 bytes with at most " + std::to_string(max) + " elements!");
+        return FAILURE;
     }
 
-    *dst = *((uint32_t*)val);
+    measurement->decode_array_uint64(measurement, data, dst);
     return SUCCESS;
 }
 
-RetType convert::convert_to(vcm::VCM* vcm, vcm::measurement_info_t* measurement, const uint8_t* data, int32_t* dst) {
-    MsgLogger logger("CONVERT", "convert_to");
-
-    if(measurement->type != INT_TYPE || measurement->sign != SIGNED_TYPE) {
-        logger.log_message("Measurement must be a signed integer!");
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, int64_t* dst, size_t max) {
+    if(measurement->decode_array_int64 == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be a signed integer no larger than 8 bytes with at most " + std::to_string(max) + " elements!");
         return FAILURE;
     }
 
-    if(measurement->size > sizeof(int32_t)) {
-        logger.log_message("measurement too large to fit into integer");
+    measurement->decode_array_int64(measurement, data, dst);
+    return SUCCESS;
+}
+
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, float* dst, size_t max) {
+    if(measurement->decode_array_float == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be a float type the size of a float with at most " + std::to_string(max) + " elements!");
         return FAILURE;
     }
 
-    uint8_t val[sizeof(int32_t)];
-    memset(val, 0, sizeof(int32_t));
-    // size_t addr = (size_t)measurement->addr;
-    // const uint8_t* buff = (const uint8_t*)data;
-
-    uint8_t sign_byte;
-    if(measurement->endianness == GSW_BIG_ENDIAN) {
-        // sign byte is first
-        sign_byte = data[0];
-    } else {
-        // sign byte is last
-        sign_byte = data[measurement->size - 1];
-    }
+    measurement->decode_array_float(measurement, data, dst);
+    return SUCCESS;
+}
 
-    if(sign_byte & (1 << 7)) {
-        // negative, 1 extend
-        sign_byte = 0xFF;
-    } else {
-        sign_byte = 0x00;
+RetType convert::convert_array(vcm::measurement_info_t* measurement, const uint8_t* data, double* dst, size_t max) {
+    if(measurement->decode_array_value == NULL || measurement->count > max) {
+        MsgLogger logger("CONVERT", "convert_array");
+        logger.log_message("Measurement must be numeric with at most " + std::to_string(max) + " elements!");
+        return FAILURE;
     }
 
-    if(measurement->endianness != vcm->sys_endianness) {
-        size_t i;
-        for(i = 0; i < measurement->size; i++) {
-            val[measurement->size - i - 1] = data[i];
-        }
+    measurement->decode_array_value(measurement, data, dst);
+    return SUCCESS;
+}
 
-        for(; i < sizeof(int32_t); i++) {
-            val[i] = sign_byte;
-        }
-    } else {
-        size_t i;
-        for(i = 0; i < measurement->size; i++) {
-            val[i] = data[i];
-        }
 
-        for(; i < sizeof(int32_t); i++) {
-            val[i] = sign_byte;
-        }
+RetType convert::convert_to(VCM*, measurement_info_t* measurement, const uint8_t* data, std::string* dst) {
+    if(measurement->type == STRING_TYPE) {
+        // stop at the first null terminator if there is one
+        dst->assign((const char*)data, strnlen((const char*)data, measurement->size));
+        return SUCCESS;
     }
 
-    *dst = *((int32_t*)val);
+    char result[MAX_CONVERSION_SIZE];
+    char* end;
 
+    if(format(measurement, data, result, result + MAX_CONVERSION_SIZE, &end) != SUCCESS) {
+        MsgLogger logger("CONVERT", "convert_to");
+        logger.log_message("unable to convert measurement to a string");
+        return FAILURE;
+    }
+
+    dst->assign(result, end - result);
     return SUCCESS;
 }
 
 
-// NOTE: may be a problem if unsigned and signed ints aren't the same length
-//       but that would be weird to have them not the same length
-// TODO this function could use some cleaning, uses malloc when it doesnt need to, some unnecessary code from it being refactored so many times
-// TODO now that other convert functions exist, maybe call them and then just convert to a string (sprintf)
-RetType convert::convert_to(VCM* vcm, measurement_info_t* measurement, const uint8_t* data, std::string* dst) {
-    MsgLogger logger("CONVERT", "convert_to");
-
-    switch(measurement->type) {
-        // all integer types, will try to put it a standard integer type of the same size or larger than the measurement size
-        // distinguishes between signed and unsigned
-        case INT_TYPE: {
-            if(measurement->sign == SIGNED_TYPE) { // signed
-                int32_t val;
-                RetType ret = convert_to(vcm, measurement, data, &val);
-
-                if(ret != SUCCESS) {
-                    return ret;
-                }
-
-                snprintf(result, MAX_CONVERSION_SIZE, "%i", val);
-            } else { // unsigned
-                uint32_t val;
-                RetType ret = convert_to(vcm, measurement, data, &val);
-
-                if(ret != SUCCESS) {
-                    return ret;
-                }
-
-                snprintf(result, MAX_CONVERSION_SIZE, "%u", val);
-            }
-
-            }
-            break;
-
-        // encompasses 4-byte floats and 8-byte doubles
-        case FLOAT_TYPE: {
-            if(measurement->size == sizeof(float)) {
-                float val;
-                RetType ret = convert_to(vcm, measurement, data, &val);
-
-                if(ret != SUCCESS) {
-                    return ret;
-                }
-
-                snprintf(result, MAX_CONVERSION_SIZE, "%f", val);
-            } else if(measurement->size == sizeof(double)) {
-                double val;
-                RetType ret = convert_to(vcm, measurement, data, &val);
-
-                if(ret != SUCCESS) {
-                    return ret;
-                }
-
-                snprintf(result, MAX_CONVERSION_SIZE, "%f", val);
-            } else {
-                logger.log_message("size of float type measurement does not match float or double");
-                return FAILURE;
-            }
-
-            }
-            break;
-
-        case STRING_TYPE: {
-            // -1 is for room for a null terminator
-            if(measurement->size > MAX_CONVERSION_SIZE - 1) {
-                logger.log_message("string too large to parse");
-                return FAILURE;
-            }
-            // size_t addr = (size_t)measurement->addr;
-            // const unsigned char* buff = (const unsigned char*)data;
-            memcpy(result, data, measurement->size);
-            result[measurement->size] = '\0'; // null terminate just in case
-
-            }
-            break;
-
-        default:
-            // TODO maybe display as hex?
-            return FAILURE;
-    }
-
-    *dst = result;
-    return SUCCESS;
+uint64_t convert::sample_time(vcm::measurement_info_t* measurement, uint64_t timestamp, uint64_t interval, uint32_t index) {
+    if(index + 1 >= measurement->count) {
+        return timestamp;
+    }
+
+    uint64_t back = measurement->count - 1 - index; // samples before the last one
+
+    uint64_t offset;
+    if(measurement->sample_rate > 0) {
+        offset = (uint64_t)((back * 1000000.0) / measurement->sample_rate);
+    } else {
+        offset = (back * interval) / measurement->count;
+    }
+
+    return (offset > timestamp) ? 0 : timestamp - offset;
 }
 
 
@@ -277,6 +222,16 @@ RetType convert::convert_from(vcm::VCM*, vcm::measurement_info_t* measurement, u
 RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, uint32_t val) {
     MsgLogger logger("CONVERT", "convert_from(uint32)");
 
+    if(measurement->bit_width) {
+        logger.log_message("can't convert to a bitfield");
+        return FAILURE;
+    }
+
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
     if(measurement->size < sizeof(uint32_t)) {
         logger.log_message("measurement too small to hold uint32");
         return FAILURE;
@@ -306,9 +261,103 @@ RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measuremen
     return SUCCESS;
 }
 
+RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, uint64_t val) {
+    MsgLogger logger("CONVERT", "convert_from(uint64)");
+
+    if(measurement->bit_width) {
+        logger.log_message("can't convert to a bitfield");
+        return FAILURE;
+    }
+
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
+    if(measurement->size < sizeof(uint64_t)) {
+        logger.log_message("measurement too small to hold uint64");
+        return FAILURE;
+    }
+
+    uint8_t* valb = (uint8_t*)&val;
+
+    if(vcm->sys_endianness != measurement->endianness) {
+        // pad the beginning with zeros
+        memset(output, 0, measurement->size - sizeof(uint64_t));
+
+        size_t i = 0;
+        for(; i < sizeof(uint64_t); i++) {
+            output[measurement->size - sizeof(uint64_t) + i] = valb[sizeof(uint64_t) - i - 1];
+        }
+
+    } else {
+        size_t i = 0;
+        for(; i < sizeof(uint64_t); i++) {
+            output[i] = valb[i];
+        }
+
+        // zero the rest of the output
+        memset(output + i, 0, measurement->size - sizeof(uint64_t));
+    }
+
+    return SUCCESS;
+}
+
+RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, int64_t val) {
+    MsgLogger logger("CONVERT", "convert_from(int64)");
+
+    if(measurement->bit_width) {
+        logger.log_message("can't convert to a bitfield");
+        return FAILURE;
+    }
+
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
+    if(measurement->size < sizeof(int64_t)) {
+        logger.log_message("measurement too small to hold int64");
+        return FAILURE;
+    }
+
+    uint8_t* valb = (uint8_t*)&val;
+
+    if(vcm->sys_endianness != measurement->endianness) {
+        // pad the beginning with zeros
+        memset(output, 0, measurement->size - sizeof(int64_t));
+
+        size_t i = 0;
+        for(; i < sizeof(int64_t); i++) {
+            output[measurement->size - sizeof(int64_t) + i] = valb[sizeof(int64_t) - i - 1];
+        }
+
+    } else {
+        size_t i = 0;
+        for(; i < sizeof(int64_t); i++) {
+            output[i] = valb[i];
+        }
+
+        // zero the rest of the output
+        memset(output + i, 0, measurement->size - sizeof(int64_t));
+    }
+
+    return SUCCESS;
+}
+
 RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, int32_t val) {
     MsgLogger logger("CONVERT", "convert_from(int32)");
 
+    if(measurement->bit_width) {
+        logger.log_message("can't convert to a bitfield");
+        return FAILURE;
+    }
+
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
     if(measurement->size < sizeof(int32_t)) {
         logger.log_message("measurement too small to hold int32");
         return FAILURE;
@@ -341,6 +390,11 @@ RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measuremen
 RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, float val) {
     MsgLogger logger("CONVERT", "convert_from(float)");
 
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
     if(measurement->size != sizeof(float)) {
         logger.log_message("measurement not the same size as float");
         return FAILURE;
@@ -367,6 +421,11 @@ RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measuremen
 RetType convert::convert_from(vcm::VCM* vcm, vcm::measurement_info_t* measurement, uint8_t* output, double& val) {
     MsgLogger logger("CONVERT", "convert_from(double)");
 
+    if(measurement->cal_input) {
+        logger.log_message("can't convert to a calibrated measurement");
+        return FAILURE;
+    }
+
     if(measurement->size != sizeof(double)) {
         logger.log_message("measurement not the same size as double");
         return FAILURE;
@@ -0,0 +1,81 @@
+#include "lib/convert/convert.h"
+#include "lib/dls/dls.h"
+#include <charconv>
+#include <string.h>
+
+using namespace vcm;
+using namespace dls;
+
+// NOTE: formatting uses std::to_chars, integers are written two digits at a
+//       time and floats use the shortest representation that round trips
+//       (Ryu), no locale, no format string parsing and no allocation
+//       this is an order of magnitude faster than snprintf("%f") into a string
+
+
+char* convert::format(uint64_t val, char* first, char* last) {
+    std::to_chars_result res = std::to_chars(first, last, val);
+    return (res.ec == std::errc()) ? res.ptr : NULL;
+}
+
+char* convert::format(int64_t val, char* first, char* last) {
+    std::to_chars_result res = std::to_chars(first, last, val);
+    return (res.ec == std::errc()) ? res.ptr : NULL;
+}
+
+char* convert::format(float val, char* first, char* last) {
+    std::to_chars_result res = std::to_chars(first, last, val);
+    return (res.ec == std::errc()) ? res.ptr : NULL;
+}
+
+char* convert::format(double val, char* first, char* last) {
+    std::to_chars_result res = std::to_chars(first, last, val);
+    return (res.ec == std::errc()) ? res.ptr : NULL;
+}
+
+RetType convert::format(measurement_info_t* measurement, const uint8_t* data,
+                        char* first, char* last, char** end) {
+    char* ptr = NULL;
+
+    switch(measurement->type) {
+        case INT_TYPE:
+            if(measurement->decode_int64 != NULL) {
+                ptr = format(measurement->decode_int64(measurement, data), first, last);
+            } else if(measurement->decode_uint64 != NULL) {
+                ptr = format(measurement->decode_uint64(measurement, data), first, last);
+            }
+            break;
+
+        // encompasses 4-byte floats and 8-byte doubles
+        case FLOAT_TYPE:
+            // calibrated measurements can be read as both, use the full precision
+            if(measurement->decode_double != NULL) {
+                ptr = format(measurement->decode_double(measurement, data), first, last);
+            } else if(measurement->decode_float != NULL) {
+                ptr = format(measurement->decode_float(measurement, data), first, last);
+            }
+            break;
+
+        case STRING_TYPE:
+            {
+                // stop at the first null terminator if there is one
+                size_t len = strnlen((const char*)data, measurement->size);
+                if(len <= (size_t)(last - first)) {
+                    memcpy(first, data, len);
+                    ptr = first + len;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if(ptr == NULL) {
+        MsgLogger logger("CONVERT", "format");
+        logger.log_message("unable to format measurement as text");
+        return FAILURE;
+    }
+
+    *end = ptr;
+    return SUCCESS;
+}
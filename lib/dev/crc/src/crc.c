@@ -0,0 +1,151 @@
+/*
+*   CRC32C (Castagnoli) checksums
+*
+*   Will Merges @ RIT Launch Initiative
+*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "lib/dev/crc/crc.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// reflected CRC32C polynomial
+#define POLY 0x82F63B78
+
+typedef uint32_t (*crc_fn_t)(uint32_t crc, const uint8_t* data, size_t len);
+
+// slicing by 8 tables, table[0] is the usual byte at a time table
+static uint32_t table[8][256];
+
+// picked when the library is loaded, before anything can call it from more than one thread
+static crc_fn_t crc_fn = NULL;
+static int hw = 0;
+
+static void make_table() {
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+        }
+        table[0][i] = c;
+    }
+
+    for(uint32_t i = 0; i < 256; i++) {
+        for(int t = 1; t < 8; t++) {
+            table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+        }
+    }
+}
+
+static uint32_t crc_table(uint32_t crc, const uint8_t* data, size_t len) {
+    while(len >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+
+        lo ^= crc;
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+              table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+              table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+
+        data += 8;
+        len -= 8;
+    }
+
+    while(len--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+    }
+
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc_hw(uint32_t crc, const uint8_t* data, size_t len) {
+    uint64_t c = crc;
+
+    while(len >= 8) {
+        uint64_t v;
+        memcpy(&v, data, 8);
+        c = _mm_crc32_u64(c, v);
+        data += 8;
+        len -= 8;
+    }
+
+    while(len--) {
+        c = _mm_crc32_u8(c, *data++);
+    }
+
+    return c;
+}
+
+static int has_hw() {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc_hw(uint32_t crc, const uint8_t* data, size_t len) {
+    while(len >= 8) {
+        uint64_t v;
+        memcpy(&v, data, 8);
+        crc = __crc32cd(crc, v);
+        data += 8;
+        len -= 8;
+    }
+
+    while(len--) {
+        crc = __crc32cb(crc, *data++);
+    }
+
+    return crc;
+}
+
+static int has_hw() {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif
+
+// the table is always made so crc32c_table works either way
+__attribute__((constructor))
+static void pick() {
+    make_table();
+    crc_fn = &crc_table;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+    if(has_hw()) {
+        hw = 1;
+        crc_fn = &crc_hw;
+    }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len) {
+    return ~crc_fn(~crc, data, len);
+}
+
+uint32_t crc32c_table(uint32_t crc, const uint8_t* data, size_t len) {
+    return ~crc_table(~crc, data, len);
+}
+
+uint32_t crc32c_packet(const uint8_t* packet, size_t size, size_t offset) {
+    uint32_t crc = crc32c(0, packet, offset);
+    return crc32c(crc, packet + offset + CRC32C_SIZE, size - offset - CRC32C_SIZE);
+}
+
+int crc32c_hw() {
+    return hw;
+}
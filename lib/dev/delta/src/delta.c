@@ -0,0 +1,233 @@
+/*
+*   Delta encoding of telemetry packets
+*
+*   Will Merges @ RIT Launch Initiative
+*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "lib/dev/delta/delta.h"
+
+// most bytes in one run
+#define MAX_RUN 128
+
+// run header bit for bytes that didn't change
+#define SKIP_RUN 0x80
+
+// deltas with counts more than this far ahead of the expected one are taken as old datagrams
+#define MAX_GAP 128
+
+void delta_encoder_init(delta_encoder_t* enc, uint8_t* last, size_t size, uint32_t keyframe_interval) {
+    enc->last = last;
+    enc->size = size;
+    enc->keyframe_interval = keyframe_interval;
+    enc->since_keyframe = 0;
+    enc->count = 0;
+    enc->keyframe = 1;
+
+    memset(last, 0, size);
+}
+
+void delta_force_keyframe(delta_encoder_t* enc) {
+    enc->keyframe = 1;
+}
+
+// write a delta of 'packet' against the last packet into 'out' after the header
+// returns the size of the datagram, or 0 if it wouldn't be smaller than a keyframe
+static size_t encode_xor(delta_encoder_t* enc, const uint8_t* packet, uint8_t* out) {
+    const uint8_t* last = enc->last;
+    size_t size = enc->size;
+
+    // anything as big as a keyframe is sent as one
+    size_t limit = DELTA_MAX_SIZE(size) - 1;
+    size_t pos = DELTA_HEADER_SIZE;
+
+    size_t i = 0;
+    while(i < size) {
+        size_t j = i;
+
+        if(packet[i] == last[i]) {
+            while(j < size && packet[j] == last[j]) {
+                j++;
+            }
+
+            // bytes after the last run didn't change, no need to send them
+            if(j == size) {
+                break;
+            }
+
+            while(i < j) {
+                size_t n = (j - i > MAX_RUN) ? MAX_RUN : j - i;
+
+                if(pos + 1 > limit) {
+                    return 0;
+                }
+
+                out[pos++] = SKIP_RUN | (n - 1);
+                i += n;
+            }
+
+            continue;
+        }
+
+        // a single unchanged byte costs the same inside the run as it does to skip, two or more end it
+        while(j < size && j - i < MAX_RUN) {
+            if(packet[j] == last[j] && (j + 1 >= size || packet[j + 1] == last[j + 1])) {
+                break;
+            }
+
+            j++;
+        }
+
+        size_t n = j - i;
+        if(pos + 1 + n > limit) {
+            return 0;
+        }
+
+        out[pos++] = n - 1;
+        for(; i < j; i++) {
+            out[pos++] = packet[i] ^ last[i];
+        }
+    }
+
+    return pos;
+}
+
+size_t delta_encode(delta_encoder_t* enc, const uint8_t* packet, uint8_t* out) {
+    size_t len = 0;
+
+    if(!enc->keyframe && enc->since_keyframe + 1 < enc->keyframe_interval) {
+        len = encode_xor(enc, packet, out);
+    }
+
+    if(len) {
+        out[0] = DELTA_XOR;
+        enc->since_keyframe++;
+    } else {
+        out[0] = DELTA_KEYFRAME;
+        memcpy(out + DELTA_HEADER_SIZE, packet, enc->size);
+        len = DELTA_MAX_SIZE(enc->size);
+
+        enc->since_keyframe = 0;
+        enc->keyframe = 0;
+    }
+
+    out[1] = enc->count++;
+    memcpy(enc->last, packet, enc->size);
+
+    return len;
+}
+
+void delta_decoder_init(delta_decoder_t* dec, uint8_t* packet, size_t size) {
+    dec->packet = packet;
+    dec->size = size;
+    dec->next = 0;
+    dec->started = 0;
+    dec->synced = 0;
+
+    memset(packet, 0, size);
+}
+
+// true if the runs of a delta 'len' bytes long fit in the packet
+static int check_xor(delta_decoder_t* dec, const uint8_t* data, size_t len) {
+    size_t pos = DELTA_HEADER_SIZE;
+    size_t i = 0;
+
+    while(pos < len) {
+        uint8_t run = data[pos++];
+        size_t n = (run & ~SKIP_RUN) + 1;
+
+        if(!(run & SKIP_RUN)) {
+            if(pos + n > len) {
+                return 0;
+            }
+
+            pos += n;
+        }
+
+        i += n;
+        if(i > dec->size) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void apply_xor(delta_decoder_t* dec, const uint8_t* data, size_t len) {
+    size_t pos = DELTA_HEADER_SIZE;
+    size_t i = 0;
+
+    while(pos < len) {
+        uint8_t run = data[pos++];
+        size_t n = (run & ~SKIP_RUN) + 1;
+
+        if(run & SKIP_RUN) {
+            i += n;
+            continue;
+        }
+
+        for(size_t end = i + n; i < end; i++) {
+            dec->packet[i] ^= data[pos++];
+        }
+    }
+}
+
+delta_ret_t delta_decode(delta_decoder_t* dec, const uint8_t* data, size_t len, uint32_t* missed) {
+    *missed = 0;
+
+    if(len < DELTA_HEADER_SIZE) {
+        dec->synced = 0;
+        return DELTA_ERR;
+    }
+
+    uint8_t kind = data[0];
+    uint8_t count = data[1];
+
+    if(dec->started) {
+        uint8_t gap = count - dec->next;
+
+        // a keyframe is taken whatever its count, the encoder may have restarted from 0
+        if(gap >= MAX_GAP) {
+            if(kind != DELTA_KEYFRAME) {
+                return DELTA_OLD;
+            }
+
+            gap = 0;
+        }
+
+        *missed = gap;
+    }
+
+    dec->started = 1;
+    dec->next = count + 1;
+
+    if(kind == DELTA_KEYFRAME) {
+        if(len != DELTA_MAX_SIZE(dec->size)) {
+            dec->synced = 0;
+            return DELTA_ERR;
+        }
+
+        memcpy(dec->packet, data + DELTA_HEADER_SIZE, dec->size);
+        dec->synced = 1;
+        return DELTA_OK;
+    }
+
+    if(kind != DELTA_XOR || !check_xor(dec, data, len)) {
+        dec->synced = 0;
+        return DELTA_ERR;
+    }
+
+    // the delta is against a packet we never got
+    if(!dec->synced || *missed) {
+        dec->synced = 0;
+        return DELTA_WAITING;
+    }
+
+    apply_xor(dec, data, len);
+    return DELTA_OK;
+}
+
+void delta_desync(delta_decoder_t* dec) {
+    dec->synced = 0;
+}
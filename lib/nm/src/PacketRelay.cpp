@@ -0,0 +1,134 @@
+#include "lib/nm/PacketRelay.h"
+#include "lib/dls/dls.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+using namespace nm;
+using namespace dls;
+
+// room for a few batches from every socket before the kernel has sent any (bytes)
+#define SEND_BUFFER_SIZE (4 * 1024 * 1024)
+
+
+PacketRelay::PacketRelay() {
+    sockfd = -1;
+    num_queued = 0;
+    max_queued = 0;
+}
+
+PacketRelay::~PacketRelay() {
+    if(sockfd != -1) {
+        close(sockfd);
+    }
+}
+
+RetType PacketRelay::init(const std::vector<vcm::relay_info_t>& relays, size_t max) {
+    MsgLogger logger("PacketRelay", "init");
+
+    if(relays.size() == 0 || max == 0) {
+        logger.log_message("nothing to relay to");
+        return FAILURE;
+    }
+
+    sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(sockfd == -1) {
+        logger.log_message("failed to open socket");
+        return FAILURE;
+    }
+
+    // the kernel caps this at net.core.wmem_max, whatever we get is fine
+    int size = SEND_BUFFER_SIZE;
+    if(setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == -1) {
+        logger.log_message("failed to set send buffer size, using the default");
+    }
+
+    for(const vcm::relay_info_t& relay : relays) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = relay.addr;
+
+        destinations.push_back(addr);
+        port_offsets.push_back(relay.port_offset);
+    }
+
+    relay_count_t zero;
+    memset(&zero, 0, sizeof(zero));
+    counts.assign(relays.size(), zero);
+
+    max_queued = max;
+    num_queued = 0;
+    msgs.resize(max_queued);
+    iovs.resize(max_queued);
+    addrs.resize(max_queued);
+    dest_index.resize(max_queued);
+
+    // each message only ever points at its own iovec and address
+    for(size_t i = 0; i < max_queued; i++) {
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    return SUCCESS;
+}
+
+void PacketRelay::queue(uint16_t port, const uint8_t* data, size_t size) {
+    for(uint32_t d = 0; d < destinations.size(); d++) {
+        if(num_queued == max_queued) {
+            flush();
+        }
+
+        addrs[num_queued] = destinations[d];
+        addrs[num_queued].sin_port = htons((uint16_t)(port + port_offsets[d]));
+        iovs[num_queued].iov_base = (void*)data;
+        iovs[num_queued].iov_len = size;
+        dest_index[num_queued] = d;
+        num_queued++;
+    }
+}
+
+void PacketRelay::flush() {
+    size_t done = 0;
+
+    while(done < num_queued) {
+        int n = sendmmsg(sockfd, &msgs[done], num_queued - done, 0);
+
+        if(n > 0) {
+            for(size_t i = done; i < done + n; i++) {
+                relay_count_t* count = &counts[dest_index[i]];
+                count->sent++;
+                count->bytes += iovs[i].iov_len;
+            }
+
+            done += n;
+            continue;
+        }
+
+        if(n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        // out of room, nothing after this will fit either
+        if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            for(; done < num_queued; done++) {
+                counts[dest_index[done]].dropped++;
+            }
+            break;
+        }
+
+        // this one failed (e.g. the destination is unreachable), the rest may still go
+        counts[dest_index[done]].dropped++;
+        done++;
+    }
+
+    num_queued = 0;
+}
+
+void PacketRelay::clear_counts() {
+    memset(counts.data(), 0, counts.size() * sizeof(relay_count_t));
+}
@@ -0,0 +1,289 @@
+#include "lib/nm/PacketRing.h"
+#include "lib/dls/dls.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+using namespace nm;
+using namespace dls;
+
+// TPACKET_V3 packs frames of any size into blocks, this just has to be a valid frame size
+#define FRAME_SIZE 2048
+
+// offsets into a frame
+#define ETH_TYPE_OFFSET 12
+#define IP_OFFSET ETH_HLEN
+#define IP_PROTO_OFFSET (IP_OFFSET + 9)
+#define IP_FRAG_OFFSET (IP_OFFSET + 6)
+#define IP_SRC_OFFSET 12
+#define UDP_HLEN 8
+
+// classic BPF jumps are 8 bits, every port needs to reach the end of the program
+#define MAX_FILTER_PORTS 240
+
+
+PacketRing::PacketRing() {
+    sockfd = -1;
+    ifindex = 0;
+    ring = (uint8_t*)MAP_FAILED;
+    ring_size = 0;
+    block_size = 0;
+    num_blocks = 0;
+    block = 0;
+    current = NULL;
+    frame = NULL;
+    frames_left = 0;
+}
+
+PacketRing::~PacketRing() {
+    if(ring != MAP_FAILED) {
+        munmap(ring, ring_size);
+    }
+
+    if(sockfd != -1) {
+        close(sockfd);
+    }
+}
+
+RetType PacketRing::attach_filter(std::vector<uint16_t>& ports) {
+    MsgLogger logger("PacketRing", "attach_filter");
+
+    std::vector<uint16_t> unique = ports;
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    if(unique.size() == 0 || unique.size() > MAX_FILTER_PORTS) {
+        logger.log_message("can filter 1 to " + std::to_string(MAX_FILTER_PORTS) + " ports, not " +
+                           std::to_string(unique.size()));
+        return FAILURE;
+    }
+
+    // port checks start after the header checks, the last two instructions drop and accept
+    const uint8_t first_port = 8;
+    const uint8_t drop = first_port + unique.size();
+    const uint8_t accept = drop + 1;
+
+    std::vector<struct sock_filter> prog;
+
+    // IPv4
+    prog.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ETH_TYPE_OFFSET));
+    prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, (uint8_t)(drop - 2)));
+
+    // UDP
+    prog.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, IP_PROTO_OFFSET));
+    prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, (uint8_t)(drop - 4)));
+
+    // not a fragment, more fragments flag and fragment offset are clear
+    prog.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, IP_FRAG_OFFSET));
+    prog.push_back(BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3FFF, (uint8_t)(drop - 6), 0));
+
+    // X = IP header length, load the UDP destination port
+    prog.push_back(BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, IP_OFFSET));
+    prog.push_back(BPF_STMT(BPF_LD | BPF_H | BPF_IND, IP_OFFSET + 2));
+
+    for(size_t i = 0; i < unique.size(); i++) {
+        uint8_t at = first_port + i;
+        prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, unique[i], (uint8_t)(accept - (at + 1)), 0));
+    }
+
+    prog.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+    prog.push_back(BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF));
+
+    struct sock_fprog fprog;
+    fprog.len = prog.size();
+    fprog.filter = prog.data();
+
+    if(setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == -1) {
+        logger.log_message("failed to attach filter: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType PacketRing::init(std::string& interface, std::vector<uint16_t>& ports, size_t block_size,
+                         size_t num_blocks, uint32_t block_timeout) {
+    MsgLogger logger("PacketRing", "init");
+
+    if(sockfd != -1) {
+        logger.log_message("already initialized");
+        return FAILURE;
+    }
+
+    if(block_size == 0 || block_size % getpagesize() != 0 || num_blocks == 0) {
+        logger.log_message("block size must be a multiple of the page size");
+        return FAILURE;
+    }
+
+    this->block_size = block_size;
+    this->num_blocks = num_blocks;
+
+    // no protocol until the filter is on and the ring is set up, so nothing else gets in first
+    sockfd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if(sockfd == -1) {
+        logger.log_message("failed to create packet socket: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    ifindex = if_nametoindex(interface.c_str());
+    if(ifindex == 0) {
+        logger.log_message("no interface: " + interface);
+        return FAILURE;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+    if(ioctl(sockfd, SIOCGIFHWADDR, &ifr) == -1) {
+        logger.log_message("failed to get hardware type of interface: " + interface);
+        return FAILURE;
+    }
+
+    if(ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER && ifr.ifr_hwaddr.sa_family != ARPHRD_LOOPBACK) {
+        logger.log_message("not an ethernet interface: " + interface);
+        return FAILURE;
+    }
+
+    if(attach_filter(ports) != SUCCESS) {
+        return FAILURE;
+    }
+
+    int version = TPACKET_V3;
+    if(setsockopt(sockfd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+        logger.log_message("TPACKET_V3 not supported");
+        return FAILURE;
+    }
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_block_nr = num_blocks;
+    req.tp_frame_size = FRAME_SIZE;
+    req.tp_frame_nr = (block_size * num_blocks) / FRAME_SIZE;
+    req.tp_retire_blk_tov = block_timeout;
+
+    if(setsockopt(sockfd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1) {
+        logger.log_message("failed to create receive ring: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    ring_size = block_size * num_blocks;
+    ring = (uint8_t*)mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sockfd, 0);
+    if(ring == MAP_FAILED) {
+        logger.log_message("failed to map receive ring");
+        return FAILURE;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_IP);
+    addr.sll_ifindex = ifindex;
+
+    if(bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        logger.log_message("failed to bind to interface: " + interface);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+int PacketRing::get_socket() {
+    return sockfd;
+}
+
+RetType PacketRing::next_block() {
+    struct tpacket_block_desc* desc = (struct tpacket_block_desc*)(ring + (block * block_size));
+
+    if(!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+        return NOCHANGE;
+    }
+
+    current = desc;
+    frames_left = desc->hdr.bh1.num_pkts;
+    frame = (struct tpacket3_hdr*)((uint8_t*)desc + desc->hdr.bh1.offset_to_first_pkt);
+
+    return SUCCESS;
+}
+
+bool PacketRing::next(ring_datagram_t* datagram) {
+    while(frames_left > 0) {
+        struct tpacket3_hdr* hdr = frame;
+        frame = (struct tpacket3_hdr*)((uint8_t*)frame + hdr->tp_next_offset);
+        frames_left--;
+
+        // loopback shows us what we send too
+        struct sockaddr_ll* sll = (struct sockaddr_ll*)((uint8_t*)hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+        if(sll->sll_pkttype == PACKET_OUTGOING) {
+            continue;
+        }
+
+        // the filter only lets through IPv4 UDP, but the frame could be cut off
+        uint8_t* mac = (uint8_t*)hdr + hdr->tp_mac;
+        size_t captured = hdr->tp_snaplen;
+
+        if(captured < IP_OFFSET + 1) {
+            continue;
+        }
+
+        uint8_t* ip = mac + IP_OFFSET;
+        size_t ip_len = (ip[0] & 0x0F) * 4;
+        if(captured < IP_OFFSET + ip_len + UDP_HLEN) {
+            continue;
+        }
+
+        uint8_t* udp = ip + ip_len;
+        size_t udp_len = ((size_t)udp[4] << 8) | udp[5];
+
+        datagram->port = ((uint16_t)udp[2] << 8) | udp[3];
+
+        datagram->src.sin_family = AF_INET;
+        memcpy(&datagram->src.sin_addr.s_addr, ip + IP_SRC_OFFSET, sizeof(datagram->src.sin_addr.s_addr));
+        memcpy(&datagram->src.sin_port, udp, sizeof(datagram->src.sin_port));
+
+        datagram->data = udp + UDP_HLEN;
+        datagram->size = (udp_len > UDP_HLEN) ? udp_len - UDP_HLEN : 0;
+        datagram->length = std::min(datagram->size, captured - (IP_OFFSET + ip_len + UDP_HLEN));
+
+        return true;
+    }
+
+    return false;
+}
+
+void PacketRing::release_block() {
+    if(current == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&current->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+    current = NULL;
+    frames_left = 0;
+    block = (block + 1) % num_blocks;
+}
+
+RetType PacketRing::stats(uint32_t* packets, uint32_t* drops) {
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+
+    if(getsockopt(sockfd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == -1) {
+        MsgLogger logger("PacketRing", "stats");
+        logger.log_message("failed to get statistics");
+        return FAILURE;
+    }
+
+    *packets = st.tp_packets;
+    *drops = st.tp_drops;
+
+    return SUCCESS;
+}
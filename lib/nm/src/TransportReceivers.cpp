@@ -0,0 +1,460 @@
+#include "lib/nm/TransportReceivers.h"
+#include "lib/dls/dls.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+using namespace nm;
+using namespace dls;
+
+// records are at most this big, the size in front of each is 2 bytes
+#define RECORD_HEADER_SIZE 2
+#define MAX_RECORD_SIZE 65535
+
+
+// size of the record at 'record', not counting its header
+static inline size_t record_size(const uint8_t* record) {
+    return ((size_t)record[0] << 8) | record[1];
+}
+
+// receives time out after 'rx_timeout' milliseconds, or block if it's 0
+static RetType set_timeout(int fd, size_t rx_timeout) {
+    if(rx_timeout == 0) {
+        return SUCCESS;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = rx_timeout / 1000;
+    tv.tv_usec = (rx_timeout % 1000) * 1000;
+
+    if(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+
+TcpReceiver::TcpReceiver() {
+    listen_fd = -1;
+    conn_fd = -1;
+    pending_fd = -1;
+    pending = false;
+    timeout = -1;
+    stream = NULL;
+    stream_size = 0;
+    stream_start = 0;
+    stream_used = 0;
+}
+
+TcpReceiver::~TcpReceiver() {
+    if(conn_fd != -1) {
+        close(conn_fd);
+    }
+
+    if(listen_fd != -1) {
+        close(listen_fd);
+    }
+
+    if(pending_fd != -1) {
+        close(pending_fd);
+    }
+
+    if(stream) {
+        delete[] stream;
+    }
+}
+
+RetType TcpReceiver::init(uint16_t port, size_t rx_timeout, size_t buffer_size, size_t batch_size) {
+    MsgLogger logger("TcpReceiver", "init");
+
+    if(batch_size == 0) {
+        logger.log_message("batch size must be at least 1");
+        return FAILURE;
+    }
+
+    timeout = (rx_timeout > 0) ? rx_timeout : -1;
+
+    sockfd = epoll_create1(EPOLL_CLOEXEC);
+    if(sockfd == -1) {
+        logger.log_message("failed to create epoll instance");
+        return FAILURE;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listen_fd == -1) {
+        logger.log_message("socket creation failed");
+        return FAILURE;
+    }
+
+    int on = 1;
+    if(setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+        logger.log_message("failed to set socket reuseaddr option");
+        return FAILURE;
+    }
+
+    struct sockaddr_in myaddr;
+    memset(&myaddr, 0, sizeof(myaddr));
+    myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    myaddr.sin_family = AF_INET;
+    myaddr.sin_port = htons(port);
+    if(bind(listen_fd, (struct sockaddr*)&myaddr, sizeof(myaddr)) || listen(listen_fd, 1)) {
+        logger.log_message("socket bind failed");
+        return FAILURE;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    if(epoll_ctl(sockfd, EPOLL_CTL_ADD, listen_fd, &event) == -1) {
+        logger.log_message("failed to add socket to epoll set");
+        return FAILURE;
+    }
+
+    pending_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(pending_fd == -1) {
+        logger.log_message("failed to create eventfd");
+        return FAILURE;
+    }
+
+    event.data.fd = pending_fd;
+    if(epoll_ctl(sockfd, EPOLL_CTL_ADD, pending_fd, &event) == -1) {
+        logger.log_message("failed to add eventfd to epoll set");
+        return FAILURE;
+    }
+
+    alloc_batch(buffer_size, batch_size);
+
+    // always room for the biggest record after whatever is left of the last read
+    stream_size = 2 * (RECORD_HEADER_SIZE + MAX_RECORD_SIZE);
+    stream = new uint8_t[stream_size];
+
+    return SUCCESS;
+}
+
+RetType TcpReceiver::set_nonblocking() {
+    timeout = 0;
+    return SUCCESS;
+}
+
+void TcpReceiver::drop_connection() {
+    epoll_ctl(sockfd, EPOLL_CTL_DEL, conn_fd, NULL);
+    close(conn_fd);
+
+    conn_fd = -1;
+
+    // whole records already read can still be taken, a partial one at the end never will be
+    size_t whole = 0;
+    while(stream_used - whole >= RECORD_HEADER_SIZE &&
+          stream_used - whole - RECORD_HEADER_SIZE >= record_size(stream + stream_start + whole)) {
+        whole += RECORD_HEADER_SIZE + record_size(stream + stream_start + whole);
+    }
+    stream_used = whole;
+}
+
+void TcpReceiver::accept_connection() {
+    MsgLogger logger("TcpReceiver", "accept_connection");
+
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = accept4(listen_fd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd == -1) {
+        return;
+    }
+
+    // the sender reconnected, anything it was in the middle of sending on the old connection is gone
+    if(conn_fd != -1) {
+        logger.log_message("replacing connection");
+        drop_connection();
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(epoll_ctl(sockfd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        logger.log_message("failed to add connection to epoll set");
+        close(fd);
+        return;
+    }
+
+    conn_fd = fd;
+    remote_addr = addr;
+
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    logger.log_message("connection from " + std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port)));
+}
+
+void TcpReceiver::read_stream() {
+    // leftovers go to the front, there's only ever part of one record left
+    if(stream_start > 0) {
+        memmove(stream, stream + stream_start, stream_used);
+        stream_start = 0;
+    }
+
+    ssize_t n = recv(conn_fd, stream + stream_used, stream_size - stream_used, 0);
+
+    if(n > 0) {
+        stream_used += n;
+        return;
+    }
+
+    if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+
+    MsgLogger logger("TcpReceiver", "read_stream");
+    logger.log_message(n == 0 ? "connection closed" : "connection failed");
+    drop_connection();
+}
+
+int TcpReceiver::take_records(size_t max) {
+    size_t taken = 0;
+    int n = 0;
+
+    while((size_t)n < max && stream_used - taken >= RECORD_HEADER_SIZE) {
+        const uint8_t* record = stream + stream_start + taken;
+        size_t size = record_size(record);
+
+        if(stream_used - taken - RECORD_HEADER_SIZE < size) {
+            break;
+        }
+
+        memcpy(batch_buffers[n], record + RECORD_HEADER_SIZE, std::min(size, buffer_size));
+        batch_lengths[n] = size;
+        n++;
+
+        taken += RECORD_HEADER_SIZE + size;
+    }
+
+    queued = stream_used;
+
+    stream_start += taken;
+    stream_used -= taken;
+    if(stream_used == 0) {
+        stream_start = 0;
+    }
+
+    return n;
+}
+
+void TcpReceiver::update_pending() {
+    bool left = false;
+    if(stream_used >= RECORD_HEADER_SIZE) {
+        const uint8_t* record = stream + stream_start;
+        left = stream_used - RECORD_HEADER_SIZE >= record_size(record);
+    }
+
+    uint64_t value = 1;
+    if(left && !pending) {
+        pending = (write(pending_fd, &value, sizeof(value)) == sizeof(value));
+    } else if(!left && pending) {
+        pending = (read(pending_fd, &value, sizeof(value)) != sizeof(value));
+    }
+}
+
+int TcpReceiver::receive(size_t max) {
+    // records left from the last read don't need to wait
+    int n = take_records(max);
+    if(n > 0) {
+        update_pending();
+        return n;
+    }
+
+    struct epoll_event events[3];
+    int num = epoll_wait(sockfd, events, 3, timeout);
+    if(num <= 0) {
+        if(num == 0) {
+            errno = EAGAIN;
+        }
+        return -1;
+    }
+
+    for(int i = 0; i < num; i++) {
+        if(events[i].data.fd == listen_fd) {
+            accept_connection();
+        } else if(events[i].data.fd == conn_fd) {
+            read_stream();
+        }
+    }
+
+    n = take_records(max);
+    update_pending();
+
+    if(n == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return n;
+}
+
+ssize_t TcpReceiver::rx() {
+    // the first batch buffer is 'rx_buffer'
+    if(receive(1) <= 0) {
+        return -1;
+    }
+
+    return batch_lengths[0];
+}
+
+int TcpReceiver::rx_batch() {
+    return receive(batch_size);
+}
+
+
+RetType UnixReceiver::init(std::string& path, size_t rx_timeout, size_t buffer_size, size_t batch_size) {
+    MsgLogger logger("UnixReceiver", "init");
+
+    if(batch_size == 0) {
+        logger.log_message("batch size must be at least 1");
+        return FAILURE;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(path.size() == 0 || path.size() >= sizeof(addr.sun_path)) {
+        logger.log_message("Unix socket path must be 1 to " + std::to_string(sizeof(addr.sun_path) - 1) +
+                           " characters: " + path);
+        return FAILURE;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    sockfd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(sockfd == -1) {
+        logger.log_message("socket creation failed");
+        return FAILURE;
+    }
+
+    if(set_timeout(sockfd, rx_timeout) != SUCCESS) {
+        logger.log_message("failed to set timeout on socket");
+        return FAILURE;
+    }
+
+    // a socket left by the last decom, anything else at the path is left alone and the bind fails
+    struct stat st;
+    if(lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    if(bind(sockfd, (struct sockaddr*)&addr, sizeof(addr))) {
+        logger.log_message("socket bind failed: " + path);
+        return FAILURE;
+    }
+
+    alloc_batch(buffer_size, batch_size);
+
+    return SUCCESS;
+}
+
+
+RetType CanReceiver::init(std::string& interface, uint32_t can_id, size_t rx_timeout, size_t batch_size) {
+    MsgLogger logger("CanReceiver", "init");
+
+    if(batch_size == 0) {
+        logger.log_message("batch size must be at least 1");
+        return FAILURE;
+    }
+
+    unsigned int ifindex = if_nametoindex(interface.c_str());
+    if(ifindex == 0) {
+        logger.log_message("no CAN interface " + interface);
+        return FAILURE;
+    }
+
+    sockfd = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if(sockfd == -1) {
+        logger.log_message("socket creation failed");
+        return FAILURE;
+    }
+
+    // only frames with our id, extended ids are told apart by their flag
+    struct can_filter filter;
+    if(can_id > CAN_SFF_MASK) {
+        filter.can_id = can_id | CAN_EFF_FLAG;
+        filter.can_mask = CAN_EFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    } else {
+        filter.can_id = can_id;
+        filter.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+
+    if(setsockopt(sockfd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0) {
+        logger.log_message("failed to set CAN filter");
+        return FAILURE;
+    }
+
+    // classic frames still arrive, CAN_MTU bytes long
+    int on = 1;
+    if(setsockopt(sockfd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0) {
+        logger.log_message("failed to enable CAN FD frames");
+        return FAILURE;
+    }
+
+    on = 1;
+    if(setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+        logger.log_message("failed to set socket drop count option");
+        return FAILURE;
+    }
+
+    if(set_timeout(sockfd, rx_timeout) != SUCCESS) {
+        logger.log_message("failed to set timeout on socket");
+        return FAILURE;
+    }
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifindex;
+    if(bind(sockfd, (struct sockaddr*)&addr, sizeof(addr))) {
+        logger.log_message("socket bind failed: " + interface);
+        return FAILURE;
+    }
+
+    // every buffer holds a whole frame until it's unpacked
+    alloc_batch(CANFD_MTU, batch_size);
+
+    return SUCCESS;
+}
+
+size_t CanReceiver::unpack(uint8_t* buffer, size_t size) {
+    if(size != CAN_MTU && size != CANFD_MTU) {
+        return 0;
+    }
+
+    struct canfd_frame* frame = (struct canfd_frame*)buffer;
+    size_t len = std::min((size_t)frame->len, (size_t)CANFD_MAX_DLEN);
+
+    memmove(buffer, frame->data, len);
+    return len;
+}
+
+ssize_t CanReceiver::rx() {
+    ssize_t n = NetworkReceiver::rx();
+    if(n <= 0) {
+        return n;
+    }
+
+    return unpack(rx_buffer, n);
+}
+
+int CanReceiver::rx_batch() {
+    int n = NetworkReceiver::rx_batch();
+
+    for(int i = 0; i < n; i++) {
+        batch_lengths[i] = unpack(batch_buffers[i], batch_lengths[i]);
+    }
+
+    return n;
+}
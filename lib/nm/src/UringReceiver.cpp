@@ -0,0 +1,490 @@
+#include "lib/nm/UringReceiver.h"
+#include "lib/dls/dls.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace nm;
+using namespace dls;
+
+// each buffer holds the recvmsg header, the source address, the drop count control message, then the packet
+#define CONTROL_OFFSET (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in))
+#define CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+#define HEADER_SIZE (CONTROL_OFFSET + CONTROL_SIZE)
+
+// how long 'add' waits for the submission thread to take a request (milliseconds)
+#define SQPOLL_WAIT 100
+
+struct UringReceiver::socket_s {
+    // NULL for a watched file descriptor
+    NetworkReceiver* net;
+    int fd;
+    void* tag;
+
+    // recvmsg only reads the name and control lengths from this
+    struct msghdr msg;
+
+    // provided buffer ring, entries point into 'buffers'
+    struct io_uring_buf_ring* ring;
+    size_t ring_size;
+    uint16_t tail;
+
+    uint8_t* buffers;
+    size_t stride;
+};
+
+// the ring's entries, the tail is overlaid on the first one
+// NOTE: not 'io_uring_buf_ring::bufs', in C++ the empty struct the kernel header puts before it takes up space
+static inline struct io_uring_buf* ring_bufs(struct io_uring_buf_ring* ring) {
+    return (struct io_uring_buf*)ring;
+}
+
+// there's no glibc wrapper for these
+static int io_uring_setup(uint32_t entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int io_uring_register(int fd, uint32_t opcode, void* arg, uint32_t nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+UringReceiver::UringReceiver() {
+    ring_fd = -1;
+    sqpoll = false;
+    sq_ring = MAP_FAILED;
+    sqes = (struct io_uring_sqe*)MAP_FAILED;
+    to_submit = 0;
+    sockets = NULL;
+    max_sockets = 0;
+    num_sockets = 0;
+    num_buffers = 0;
+}
+
+UringReceiver::~UringReceiver() {
+    // closing the ring cancels every request
+    if(ring_fd != -1) {
+        close(ring_fd);
+    }
+
+    if(sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+
+    if(sqes != MAP_FAILED) {
+        munmap(sqes, sqes_size);
+    }
+
+    if(sockets) {
+        for(uint32_t i = 0; i < num_sockets; i++) {
+            if(sockets[i].ring) {
+                munmap(sockets[i].ring, sockets[i].ring_size);
+            }
+
+            if(sockets[i].buffers) {
+                delete[] sockets[i].buffers;
+            }
+        }
+
+        delete[] sockets;
+    }
+}
+
+RetType UringReceiver::init(uint32_t max_sockets, uint32_t num_buffers, bool sqpoll) {
+    MsgLogger logger("UringReceiver", "init");
+
+    if(ring_fd != -1) {
+        logger.log_message("already initialized");
+        return FAILURE;
+    }
+
+    if(num_buffers == 0 || num_buffers > 32768 || (num_buffers & (num_buffers - 1)) != 0) {
+        logger.log_message("number of buffers must be a power of 2 no more than 32768");
+        return FAILURE;
+    }
+
+    this->max_sockets = max_sockets;
+    this->num_buffers = num_buffers;
+    this->sqpoll = sqpoll;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // every buffer can be holding a completion at once, plus one for each request ending
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = (max_sockets * num_buffers) + max_sockets;
+
+    if(sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = 1000;
+    }
+
+    // room to re-arm every socket at once
+    ring_fd = io_uring_setup(2 * max_sockets, &params);
+    if(ring_fd == -1) {
+        logger.log_message("io_uring unavailable: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        logger.log_message("kernel io_uring is too old");
+        return FAILURE;
+    }
+
+    // both queues are in one mapping
+    sq_ring_size = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+    cq_ring_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    if(cq_ring_size > sq_ring_size) {
+        sq_ring_size = cq_ring_size;
+    }
+
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if(sq_ring == MAP_FAILED) {
+        logger.log_message("failed to map io_uring queues");
+        return FAILURE;
+    }
+
+    uint8_t* ring = (uint8_t*)sq_ring;
+    sq_head = (uint32_t*)(ring + params.sq_off.head);
+    sq_tail = (uint32_t*)(ring + params.sq_off.tail);
+    sq_flags = (uint32_t*)(ring + params.sq_off.flags);
+    sq_mask = *(uint32_t*)(ring + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_array = (uint32_t*)(ring + params.sq_off.array);
+
+    cq_ring = sq_ring;
+    cq_head = (uint32_t*)(ring + params.cq_off.head);
+    cq_tail = (uint32_t*)(ring + params.cq_off.tail);
+    cq_mask = *(uint32_t*)(ring + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe*)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      ring_fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        logger.log_message("failed to map io_uring submission entries");
+        return FAILURE;
+    }
+
+    sockets = new socket_s[max_sockets];
+    memset(sockets, 0, max_sockets * sizeof(socket_s));
+
+    return SUCCESS;
+}
+
+RetType UringReceiver::queue(const struct io_uring_sqe* entry) {
+    uint32_t tail = *sq_tail;
+
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        // full, get the kernel to take what's there
+        if(enter(0, 0) == -1 || tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+            return FAILURE;
+        }
+    }
+
+    uint32_t index = tail & sq_mask;
+    sqes[index] = *entry;
+    sq_array[index] = index;
+
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    to_submit++;
+
+    return SUCCESS;
+}
+
+int UringReceiver::enter(uint32_t min_complete, uint32_t timeout) {
+    uint32_t flags = 0;
+    uint32_t submit = to_submit;
+
+    if(sqpoll) {
+        // the kernel thread takes submissions, it only needs waking if it went idle
+        submit = 0;
+        if(to_submit > 0 && (__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        to_submit = 0;
+
+        if(flags == 0 && min_complete == 0) {
+            return 0;
+        }
+    } else if(submit == 0 && min_complete == 0) {
+        return 0;
+    }
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    void* argp = NULL;
+    size_t argsz = 0;
+
+    if(min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+
+        if(timeout > 0) {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = (uint64_t)&ts;
+
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+
+    int ret = io_uring_enter(ring_fd, submit, min_complete, flags, argp, argsz);
+    if(ret > 0 && !sqpoll) {
+        to_submit -= ret;
+    }
+
+    return ret;
+}
+
+RetType UringReceiver::arm(uint32_t socket) {
+    socket_s* s = &sockets[socket];
+
+    struct io_uring_sqe entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.fd = s->fd;
+    entry.user_data = socket;
+
+    if(s->net) {
+        // receive into a buffer from the socket's ring until something goes wrong
+        entry.opcode = IORING_OP_RECVMSG;
+        entry.addr = (uint64_t)&s->msg;
+        entry.len = 1;
+        entry.ioprio = IORING_RECV_MULTISHOT;
+        entry.flags = IOSQE_BUFFER_SELECT;
+        entry.buf_group = (uint16_t)socket;
+    } else {
+        entry.opcode = IORING_OP_POLL_ADD;
+        entry.poll32_events = POLLIN;
+        entry.len = IORING_POLL_ADD_MULTI;
+    }
+
+    return queue(&entry);
+}
+
+RetType UringReceiver::add(NetworkReceiver* net, size_t buffer_size, void* tag) {
+    MsgLogger logger("UringReceiver", "add");
+
+    if(num_sockets == max_sockets) {
+        logger.log_message("no room for another socket");
+        return FAILURE;
+    }
+
+    uint32_t index = num_sockets;
+    socket_s* s = &sockets[index];
+
+    s->net = net;
+    s->fd = net->get_socket();
+    s->tag = tag;
+    s->msg.msg_namelen = sizeof(struct sockaddr_in);
+    s->msg.msg_controllen = CONTROL_SIZE;
+
+    // keep the packets aligned
+    s->stride = (HEADER_SIZE + buffer_size + 63) & ~((size_t)63);
+    s->buffers = new uint8_t[s->stride * num_buffers];
+
+    // the ring has to be page aligned
+    s->ring_size = num_buffers * sizeof(struct io_uring_buf);
+    s->ring = (struct io_uring_buf_ring*)mmap(NULL, s->ring_size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(s->ring == MAP_FAILED) {
+        s->ring = NULL;
+        logger.log_message("failed to allocate buffer ring");
+        return FAILURE;
+    }
+
+    num_sockets++;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)s->ring;
+    reg.ring_entries = num_buffers;
+    reg.bgid = (uint16_t)index;
+
+    if(io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        logger.log_message("failed to register buffer ring: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    for(uint32_t i = 0; i < num_buffers; i++) {
+        struct io_uring_buf* buf = &ring_bufs(s->ring)[i];
+        buf->addr = (uint64_t)(s->buffers + (i * s->stride));
+        buf->len = s->stride;
+        buf->bid = i;
+    }
+
+    s->tail = num_buffers;
+    __atomic_store_n(&s->ring->tail, s->tail, __ATOMIC_RELEASE);
+
+    if(arm(index) != SUCCESS || enter(0, 0) == -1) {
+        logger.log_message("failed to submit receive");
+        return FAILURE;
+    }
+
+    // an unsupported request fails as soon as the kernel takes it
+    if(sqpoll) {
+        for(int i = 0; i < SQPOLL_WAIT; i++) {
+            if(__atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == *sq_tail) {
+                break;
+            }
+
+            usleep(1000);
+        }
+    }
+
+    uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for(uint32_t head = *cq_head; head != tail; head++) {
+        struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+
+        if(cqe->user_data == index && cqe->res < 0 && cqe->res != -ENOBUFS) {
+            logger.log_message("multishot receive not supported: " + std::string(strerror(-cqe->res)));
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+RetType UringReceiver::watch(int fd, void* tag) {
+    MsgLogger logger("UringReceiver", "watch");
+
+    if(num_sockets == max_sockets) {
+        logger.log_message("no room for another file descriptor");
+        return FAILURE;
+    }
+
+    uint32_t index = num_sockets++;
+    socket_s* s = &sockets[index];
+
+    s->net = NULL;
+    s->fd = fd;
+    s->tag = tag;
+
+    if(arm(index) != SUCCESS || enter(0, 0) == -1) {
+        logger.log_message("failed to submit poll");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+int UringReceiver::wait(uring_packet_t* packets, uint32_t max, uint32_t timeout) {
+    uint32_t head = *cq_head;
+    uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    if(head == tail) {
+        // nothing ready, submit anything queued and sleep until something is
+        if(enter(1, timeout) == -1) {
+            if(errno == ETIME || errno == EINTR) {
+                return 0;
+            }
+
+            MsgLogger logger("UringReceiver", "wait");
+            logger.log_message("io_uring_enter failed: " + std::string(strerror(errno)));
+            return -1;
+        }
+
+        tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    } else if(enter(0, 0) == -1) { // re-arms from last time
+        MsgLogger logger("UringReceiver", "wait");
+        logger.log_message("io_uring_enter failed: " + std::string(strerror(errno)));
+        return -1;
+    }
+
+    int n = 0;
+    while(head != tail && (uint32_t)n < max) {
+        struct io_uring_cqe* cqe = &cqes[head & cq_mask];
+        head++;
+
+        uint32_t index = (uint32_t)cqe->user_data;
+        socket_s* s = &sockets[index];
+
+        // the request ended (out of buffers, or an error), start it again
+        if(!(cqe->flags & IORING_CQE_F_MORE)) {
+            if(arm(index) != SUCCESS) {
+                MsgLogger logger("UringReceiver", "wait");
+                logger.log_message("failed to re-arm request");
+            }
+        }
+
+        if(s->net == NULL) {
+            uring_packet_t* packet = &packets[n++];
+            packet->tag = s->tag;
+            packet->data = NULL;
+            packet->size = 0;
+            packet->length = 0;
+            packet->addr = NULL;
+            packet->socket = index;
+            continue;
+        }
+
+        if(cqe->res < 0) {
+            // out of buffers just means we're behind, the packet stays in the socket
+            if(cqe->res != -ENOBUFS) {
+                MsgLogger logger("UringReceiver", "wait");
+                logger.log_message("receive failed: " + std::string(strerror(-cqe->res)));
+            }
+
+            continue;
+        }
+
+        if(!(cqe->flags & IORING_CQE_F_BUFFER) || (size_t)cqe->res < HEADER_SIZE) {
+            continue;
+        }
+
+        uint16_t buffer = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        uint8_t* buf = s->buffers + (buffer * s->stride);
+        struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)buf;
+
+        uring_packet_t* packet = &packets[n++];
+        packet->tag = s->tag;
+        packet->data = buf + HEADER_SIZE;
+        packet->size = out->payloadlen;
+        packet->length = cqe->res - HEADER_SIZE;
+        packet->addr = (struct sockaddr_in*)(buf + sizeof(struct io_uring_recvmsg_out));
+        packet->socket = index;
+        packet->buffer = buffer;
+
+        s->net->received_from(packet->addr);
+
+        // only there once something has been dropped (see NetworkReceiver::kernel_drops)
+        struct cmsghdr* cmsg = (struct cmsghdr*)(buf + CONTROL_OFFSET);
+        if(out->controllen >= sizeof(struct cmsghdr) && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&s->net->kernel_drops, CMSG_DATA(cmsg), sizeof(s->net->kernel_drops));
+        }
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+void UringReceiver::release(uring_packet_t* packets, int num) {
+    for(int i = 0; i < num; i++) {
+        if(packets[i].data == NULL) {
+            continue;
+        }
+
+        socket_s* s = &sockets[packets[i].socket];
+
+        struct io_uring_buf* buf = &ring_bufs(s->ring)[s->tail & (num_buffers - 1)];
+        buf->addr = (uint64_t)(s->buffers + (packets[i].buffer * s->stride));
+        buf->len = s->stride;
+        buf->bid = packets[i].buffer;
+
+        s->tail++;
+        __atomic_store_n(&s->ring->tail, s->tail, __ATOMIC_RELEASE);
+    }
+}
@@ -6,6 +6,10 @@
 #include <string.h>
 #include <exception>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <linux/sock_diag.h>
+#include <linux/filter.h>
 #include "lib/nm/nm.h"
 #include "lib/dls/dls.h"
 #include "lib/shm/shm.h"
@@ -16,10 +20,22 @@ using namespace dls;
 using namespace shm;
 using namespace vcm;
 
+// control message space for the drop count that comes with each packet
+#define CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+
 
 NetworkReceiver::NetworkReceiver() {
     sockfd = -1;
     inited = false;
+    rx_buffer = NULL;
+    batch_buffers = NULL;
+    batch_lengths = NULL;
+    batch_addrs = NULL;
+    msgs = NULL;
+    iovs = NULL;
+    controls = NULL;
+    kernel_drops = 0;
+    queued = 0;
 }
 
 NetworkReceiver::~NetworkReceiver() {
@@ -34,9 +50,19 @@ NetworkReceiver::~NetworkReceiver() {
     if(rx_buffer) {
         delete[] rx_buffer;
     }
+
+    if(batch_buffers) {
+        delete[] batch_buffers;
+        delete[] batch_lengths;
+        delete[] batch_addrs;
+        delete[] msgs;
+        delete[] iovs;
+        delete[] controls;
+    }
 }
 
-RetType NetworkReceiver::init(uint16_t port, uint32_t multicast_addr, size_t rx_timeout, size_t buffer_size) {
+RetType NetworkReceiver::init(uint16_t port, uint32_t multicast_addr, size_t rx_timeout, size_t buffer_size,
+                              size_t batch_size) {
     MsgLogger logger("NetworkReceiver", "init");
 
     if(inited) {
@@ -44,7 +70,13 @@ RetType NetworkReceiver::init(uint16_t port, uint32_t multicast_addr, size_t rx_
         return FAILURE;
     }
 
+    if(batch_size == 0) {
+        logger.log_message("batch size must be at least 1");
+        return FAILURE;
+    }
+
     this->buffer_size = buffer_size;
+    this->batch_size = batch_size;
 
     // set up the socket
     // if(rx_timeout >= 0) { // blocking mode
@@ -78,6 +110,13 @@ RetType NetworkReceiver::init(uint16_t port, uint32_t multicast_addr, size_t rx_
         return FAILURE;
     }
 
+    // have the kernel tell us how many packets it dropped with each packet we get
+    on = 1;
+    if(setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+        logger.log_message("failed to set socket drop count option");
+        return FAILURE;
+    }
+
     // set the timeout if there is one, -1 means no timeout
     if(rx_timeout > 0) {
         struct timeval tv;
@@ -114,12 +153,42 @@ RetType NetworkReceiver::init(uint16_t port, uint32_t multicast_addr, size_t rx_
         }
     }
 
-    // allocate memory for receive buffer
-    rx_buffer = new uint8_t[buffer_size];
+    alloc_batch(buffer_size, batch_size);
 
     return SUCCESS;
 }
 
+void NetworkReceiver::alloc_batch(size_t buffer_size, size_t batch_size) {
+    this->buffer_size = buffer_size;
+    this->batch_size = batch_size;
+
+    // allocate memory for receive buffers, one block for the whole batch
+    rx_buffer = new uint8_t[buffer_size * batch_size];
+
+    batch_buffers = new uint8_t*[batch_size];
+    batch_lengths = new size_t[batch_size];
+    batch_addrs = new struct sockaddr_in[batch_size];
+    msgs = new struct mmsghdr[batch_size];
+    iovs = new struct iovec[batch_size];
+    controls = new uint8_t[batch_size * CONTROL_SIZE];
+
+    memset(msgs, 0, batch_size * sizeof(struct mmsghdr));
+
+    for(size_t i = 0; i < batch_size; i++) {
+        batch_buffers[i] = rx_buffer + (i * buffer_size);
+
+        iovs[i].iov_base = batch_buffers[i];
+        iovs[i].iov_len = buffer_size;
+
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &batch_addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_control = controls + (i * CONTROL_SIZE);
+        msgs[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+    }
+}
+
 ssize_t NetworkReceiver::rx() {
     socklen_t addr_len = sizeof(struct sockaddr_in);
 
@@ -127,6 +196,93 @@ ssize_t NetworkReceiver::rx() {
                     (struct sockaddr*)&remote_addr, &addr_len);
 }
 
+int NetworkReceiver::rx_batch() {
+    // MSG_WAITFORONE only blocks for the first packet
+    // MSG_TRUNC makes each length the real size of the packet, same as 'rx'
+    int n = recvmmsg(sockfd, msgs, batch_size, MSG_WAITFORONE | MSG_TRUNC, NULL);
+
+    queued = 0;
+    for(int i = 0; i < n; i++) {
+        batch_lengths[i] = msgs[i].msg_len;
+        queued += msgs[i].msg_len;
+
+        // only there once something has been dropped
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+        if(cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&kernel_drops, CMSG_DATA(cmsg), sizeof(kernel_drops));
+        }
+
+        // the kernel overwrites these with the size of what it wrote
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+    }
+
+    // there could be more behind a full batch
+    if(n > 0 && (size_t)n == batch_size) {
+        uint32_t meminfo[SK_MEMINFO_VARS];
+        socklen_t len = sizeof(meminfo);
+
+        if(getsockopt(sockfd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0) {
+            queued += meminfo[SK_MEMINFO_RMEM_ALLOC];
+        }
+    }
+
+    return n;
+}
+
+void NetworkReceiver::received_from(struct sockaddr_in* addr) {
+    remote_addr = *addr;
+}
+
+int NetworkReceiver::get_socket() {
+    return sockfd;
+}
+
+RetType NetworkReceiver::set_nonblocking() {
+    MsgLogger logger("NetworkReceiver", "set_nonblocking");
+
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    if(flags == -1 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        logger.log_message("failed to make socket nonblocking");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType NetworkReceiver::steer_by_source(uint32_t workers) {
+    MsgLogger logger("NetworkReceiver", "steer_by_source");
+
+    if(workers == 0) {
+        logger.log_message("need at least one worker");
+        return FAILURE;
+    }
+
+    // classic BPF run by the kernel to pick a socket out of the reuseport group, returns its index
+    // packet data starts at the UDP payload, the IP header is reached with SKF_NET_OFF
+    // if a worker isn't there (the index is past the end of the group) the kernel falls back to its own hash
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, (uint32_t)SKF_NET_OFF),     // X = IP header length
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, (uint32_t)SKF_NET_OFF),      // A = UDP source port, right after the IP header
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),                                // X = A
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)SKF_NET_OFF + 12), // A = IP source address
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),                         // A += X
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers),                   // A %= workers
+        BPF_STMT(BPF_RET | BPF_A, 0)                                    // return A
+    };
+
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    if(setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        logger.log_message("failed to attach reuseport steering program: " + std::string(strerror(errno)));
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
 
 AutoNetworkReceiver::AutoNetworkReceiver() {
     shm = NULL;
@@ -145,7 +301,8 @@ AutoNetworkReceiver::~AutoNetworkReceiver() {
     }
 }
 
-RetType AutoNetworkReceiver::init(VCM* vcm, uint16_t port, uint32_t multicast_addr, size_t rx_timeout, size_t buffer_size) {
+RetType AutoNetworkReceiver::init(VCM* vcm, uint16_t port, uint32_t multicast_addr, size_t rx_timeout,
+                                  size_t buffer_size, size_t batch_size) {
     MsgLogger logger("AutoNetworkReceiver", "init");
 
     if(inited) {
@@ -177,7 +334,7 @@ RetType AutoNetworkReceiver::init(VCM* vcm, uint16_t port, uint32_t multicast_ad
 
     inited = true;
 
-    return NetworkReceiver::init(port, multicast_addr, rx_timeout, buffer_size);
+    return NetworkReceiver::init(port, multicast_addr, rx_timeout, buffer_size, batch_size);
 }
 
 ssize_t AutoNetworkReceiver::rx() {
@@ -202,6 +359,31 @@ ssize_t AutoNetworkReceiver::rx() {
     return read;
 }
 
+int AutoNetworkReceiver::rx_batch() {
+    int n = NetworkReceiver::rx_batch();
+
+    if(n <= 0) {
+        return n;
+    }
+
+    // only the latest address matters
+    if(FAILURE == shm->update_addr(device_id, &batch_addrs[n - 1])) {
+        MsgLogger logger("AutoNetworkReceiver", "rx_batch");
+        logger.log_message("failed to update shared memory");
+    }
+
+    return n;
+}
+
+void AutoNetworkReceiver::received_from(struct sockaddr_in* addr) {
+    remote_addr = *addr;
+
+    if(FAILURE == shm->update_addr(device_id, &remote_addr)) {
+        MsgLogger logger("AutoNetworkReceiver", "received_from");
+        logger.log_message("failed to update shared memory");
+    }
+}
+
 NetworkTransmitter::NetworkTransmitter() {
     mq = (mqd_t)-1;
     sockfd = -1;
@@ -0,0 +1,263 @@
+/*******************************************************************************
+* Name: sched.cpp
+*
+* Purpose: Real-time scheduling, CPU affinity and memory locking profiles for
+*          GSW processes
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "lib/sched/sched.h"
+#include "lib/dls/dls.h"
+
+using namespace dls;
+using namespace sched;
+
+// parse a CPU list like '1', '1,3' or '0-2,5' into 'cpus'
+static RetType parse_cpus(const std::string& list, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+
+    std::istringstream ss(list);
+    for(std::string range; std::getline(ss, range, ','); ) {
+        size_t dash = range.find('-');
+
+        int low;
+        int high;
+        try {
+            low = std::stoi(range.substr(0, dash), NULL, 10);
+            high = (dash == std::string::npos) ? low : std::stoi(range.substr(dash + 1), NULL, 10);
+        } catch(std::invalid_argument& ia) {
+            return FAILURE;
+        }
+
+        if(low < 0 || high < low || high >= CPU_SETSIZE) {
+            return FAILURE;
+        }
+
+        for(int cpu = low; cpu <= high; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+    }
+
+    return (CPU_COUNT(cpus) > 0) ? SUCCESS : FAILURE;
+}
+
+RetType sched::parse_schedule_file(vcm::VCM* vcm, std::vector<profile_t>* profiles) {
+    MsgLogger logger("SCHED", "parse_schedule_file");
+
+    if(vcm->schedule_file == "") {
+        return FILENOTFOUND;
+    }
+
+    std::ifstream f(vcm->schedule_file.c_str());
+    if(!f.is_open()) {
+        logger.log_message("failed to open schedule file: " + vcm->schedule_file);
+        return FILENOTFOUND;
+    }
+
+    for(std::string line; std::getline(f, line); ) {
+        if(line == "" || !line.rfind("#", 0)) { // blank or comment '#'
+            continue;
+        }
+
+        std::istringstream ss(line);
+
+        profile_t profile;
+        profile.priority = 0;
+        profile.pinned = false;
+        CPU_ZERO(&profile.cpus);
+        profile.mlock = LOCK_NONE;
+
+        if(!(ss >> profile.process)) {
+            continue; // only whitespace
+        }
+
+        std::string option;
+        std::string value;
+        while(ss >> option) {
+            if(!(ss >> value)) {
+                logger.log_message("missing value for option '" + option + "': " + line);
+                return FAILURE;
+            }
+
+            if(option == "priority") {
+                try {
+                    profile.priority = std::stoi(value, NULL, 10);
+                } catch(std::invalid_argument& ia) {
+                    profile.priority = 0;
+                }
+
+                if(profile.priority < sched_get_priority_min(SCHED_FIFO) ||
+                   profile.priority > sched_get_priority_max(SCHED_FIFO)) {
+                    logger.log_message("invalid real-time priority: " + line);
+                    return FAILURE;
+                }
+            } else if(option == "cpus") {
+                if(SUCCESS != parse_cpus(value, &profile.cpus)) {
+                    logger.log_message("invalid CPU list: " + line);
+                    return FAILURE;
+                }
+
+                profile.pinned = true;
+            } else if(option == "mlock") {
+                if(value == "current") {
+                    profile.mlock = LOCK_CURRENT;
+                } else if(value == "all") {
+                    profile.mlock = LOCK_ALL;
+                } else if(value == "onfault") {
+                    profile.mlock = LOCK_ONFAULT;
+                } else {
+                    logger.log_message("invalid memory lock policy: " + line);
+                    return FAILURE;
+                }
+            } else {
+                logger.log_message("invalid option '" + option + "': " + line);
+                return FAILURE;
+            }
+        }
+
+        for(profile_t& p : *profiles) {
+            if(p.process == profile.process) {
+                logger.log_message("process has more than one profile: " + profile.process);
+                return FAILURE;
+            }
+        }
+
+        profiles->push_back(profile);
+    }
+
+    f.close();
+
+    return SUCCESS;
+}
+
+RetType sched::apply_profile(profile_t* profile) {
+    MsgLogger logger("SCHED", "apply_profile");
+
+    RetType ret = SUCCESS;
+
+    // lock memory before going real-time so we don't page fault at a high priority later
+    int flags = 0;
+    switch(profile->mlock) {
+        case LOCK_NONE:
+            break;
+        case LOCK_CURRENT:
+            flags = MCL_CURRENT;
+            break;
+        case LOCK_ALL:
+            flags = MCL_CURRENT | MCL_FUTURE;
+            break;
+        case LOCK_ONFAULT:
+            flags = MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT;
+            break;
+    }
+
+    if(flags && mlockall(flags) == -1) {
+        logger.log_message("failed to lock memory of " + profile->process + ": " + std::string(strerror(errno)));
+        ret = FAILURE;
+    }
+
+    if(profile->pinned && sched_setaffinity(0, sizeof(cpu_set_t), &profile->cpus) == -1) {
+        logger.log_message("failed to set CPU affinity of " + profile->process + ": " + std::string(strerror(errno)));
+        ret = FAILURE;
+    }
+
+    if(profile->priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = profile->priority;
+
+        if(sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+            logger.log_message("failed to set real-time priority of " + profile->process + ": " +
+                               std::string(strerror(errno)));
+            ret = FAILURE;
+        }
+    }
+
+    return ret;
+}
+
+RetType sched::apply(vcm::VCM* vcm, const std::string& process) {
+    std::vector<profile_t> profiles;
+
+    RetType ret = parse_schedule_file(vcm, &profiles);
+    if(FILENOTFOUND == ret) {
+        return SUCCESS;
+    } else if(SUCCESS != ret) {
+        return FAILURE;
+    }
+
+    for(profile_t& profile : profiles) {
+        if(profile.process == process) {
+            return apply_profile(&profile);
+        }
+    }
+
+    return SUCCESS;
+}
+
+RetType sched::measure_latency(uint32_t period, uint32_t duration, latency_t* latency) {
+    if(period == 0 || duration == 0) {
+        MsgLogger logger("SCHED", "measure_latency");
+        logger.log_message("period and duration must be non-zero");
+        return FAILURE;
+    }
+
+    size_t num = ((uint64_t)duration * 1000) / period;
+    if(num == 0) {
+        num = 1;
+    }
+
+    // allocated and touched up front so nothing faults while measuring
+    std::vector<double> samples(num, 0.0);
+
+    struct timespec next;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for(size_t i = 0; i < num; i++) {
+        next.tv_nsec += (long)period * 1000;
+        while(next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {}
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        samples[i] = (((double)(now.tv_sec - next.tv_sec) * 1e9) + (now.tv_nsec - next.tv_nsec)) / 1000.0;
+    }
+
+    latency->samples = num;
+    latency->histogram.assign(NUM_LATENCY_BUCKETS, 0);
+
+    double sum = 0;
+    for(double sample : samples) {
+        sum += sample;
+
+        size_t bucket = 0;
+        while(bucket + 1 < NUM_LATENCY_BUCKETS && sample >= LATENCY_BUCKETS[bucket + 1]) {
+            bucket++;
+        }
+        latency->histogram[bucket]++;
+    }
+    latency->mean = sum / num;
+
+    std::sort(samples.begin(), samples.end());
+    latency->min = samples[0];
+    latency->p50 = samples[(num * 50) / 100];
+    latency->p99 = samples[(num * 99) / 100];
+    latency->p999 = samples[(num * 999) / 1000];
+    latency->max = samples[num - 1];
+
+    return SUCCESS;
+}
@@ -123,6 +123,9 @@ RetType Shm::destroy() {
         return FAILURE;
     }
 
+    // the block goes away once everyone detaches, including us
+    shmdt(data);
+
     shmid = -1;
     data = NULL;
 
@@ -0,0 +1,310 @@
+/*******************************************************************************
+* Name: EnvelopeShm.cpp
+*
+* Purpose: Downsampled min/max/mean envelopes of telemetry measurements
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include <string.h>
+#include <algorithm>
+#include "lib/telemetry/EnvelopeShm.h"
+#include "lib/dls/dls.h"
+
+using namespace dls;
+
+// times a reader retries a bucket the writer is changing before skipping it
+#define MAX_READ_RETRIES 16
+
+
+EnvelopeShm::EnvelopeShm() {
+    shm = NULL;
+    rings_offset = 0;
+    buckets_offset = 0;
+    total_size = 0;
+}
+
+EnvelopeShm::~EnvelopeShm() {
+    if(shm) {
+        delete shm;
+    }
+}
+
+RetType EnvelopeShm::init(VCM* vcm) {
+    MsgLogger logger("EnvelopeShm", "init");
+
+    history_config_t config;
+
+    RetType ret = parse_history_file(vcm, &config);
+    if(SUCCESS != ret) {
+        return ret;
+    }
+
+    if(config.tiers.size() == 0) {
+        logger.log_message("no envelope tiers specified");
+        return FAILURE;
+    }
+
+    measurements = config.measurements;
+    tiers = config.tiers;
+
+    for(size_t i = 0; i < measurements.size(); i++) {
+        index[measurements[i]] = i;
+    }
+
+    // figure out the layout
+    size_t num_rings = measurements.size() * tiers.size();
+
+    rings_offset = sizeof(envelope_header_t);
+    buckets_offset = rings_offset + (num_rings * sizeof(ring_t));
+    total_size = buckets_offset + (num_rings * ENVELOPE_NUM_BUCKETS * sizeof(bucket_t));
+
+    // keyed on the config directory like history shared memory, the history file gets a new inode when edited
+    key_filename = vcm->config_dir;
+    shm = new Shm(key_filename.c_str(), shm_key_id, total_size);
+
+    return SUCCESS;
+}
+
+RetType EnvelopeShm::open() {
+    return shm->attach();
+}
+
+RetType EnvelopeShm::close() {
+    return shm->detach();
+}
+
+// NOTE: does not attach!
+RetType EnvelopeShm::create() {
+    MsgLogger logger("EnvelopeShm", "create");
+
+    if(SUCCESS != shm->create()) {
+        logger.log_message("failed to create envelope shared memory");
+        return FAILURE;
+    }
+
+    if(SUCCESS != shm->attach()) {
+        logger.log_message("failed to attach to envelope shared memory");
+        return FAILURE;
+    }
+
+    memset(shm->data, 0, total_size);
+
+    envelope_header_t* header = (envelope_header_t*)shm->data;
+    header->num_series = measurements.size();
+    header->num_tiers = tiers.size();
+    header->num_buckets = ENVELOPE_NUM_BUCKETS;
+
+    if(SUCCESS != shm->detach()) {
+        logger.log_message("failed to detach from envelope shared memory");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType EnvelopeShm::destroy() {
+    // the history file may have changed the envelopes kept since shared memory was made, attach whatever size
+    Shm old(key_filename.c_str(), shm_key_id, 0);
+    if(SUCCESS != old.attach() || SUCCESS != old.destroy()) {
+        return FAILURE;
+    }
+
+    if(shm->data != NULL) {
+        shm->detach();
+    }
+
+    return SUCCESS;
+}
+
+bool EnvelopeShm::tracked(measurement_info_t* meas) {
+    return index.count(meas) > 0;
+}
+
+EnvelopeShm::ring_t* EnvelopeShm::get_ring(uint32_t series, uint32_t tier) {
+    return ((ring_t*)(shm->data + rings_offset)) + ((series * tiers.size()) + tier);
+}
+
+EnvelopeShm::bucket_t* EnvelopeShm::get_bucket(uint32_t series, uint32_t tier, uint32_t bucket) {
+    size_t ring = (series * tiers.size()) + tier;
+    return ((bucket_t*)(shm->data + buckets_offset)) + ((ring * ENVELOPE_NUM_BUCKETS) + bucket);
+}
+
+RetType EnvelopeShm::append(measurement_info_t* meas, uint64_t timestamp, double value) {
+    if(!index.count(meas) || shm->data == NULL) {
+        MsgLogger logger("EnvelopeShm", "append");
+        logger.log_message("no envelopes kept for measurement");
+        return FAILURE;
+    }
+
+    uint32_t series = index[meas];
+    RetType ret = SUCCESS;
+
+    for(uint32_t t = 0; t < tiers.size(); t++) {
+        uint64_t period = (uint64_t)tiers[t] * 1000;
+        uint64_t start = timestamp - (timestamp % period);
+
+        ring_t* ring = get_ring(series, t);
+        bucket_t* bucket = get_bucket(series, t, ring->head);
+
+        if(ring->used > 0 && start == bucket->start) {
+            // still in the current bucket
+            __atomic_store_n(&bucket->seq, bucket->seq + 1, __ATOMIC_RELEASE);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+
+            if(value < bucket->min) {
+                bucket->min = value;
+            }
+            if(value > bucket->max) {
+                bucket->max = value;
+            }
+            bucket->sum += value;
+            bucket->count++;
+
+            __atomic_store_n(&bucket->seq, bucket->seq + 1, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        if(ring->used > 0 && start < bucket->start) {
+            // out of order, drop it
+            ret = FAILURE;
+            continue;
+        }
+
+        // start a new bucket, recycling the oldest if the ring is full
+        uint32_t head = ring->head;
+        uint32_t used = ring->used;
+
+        if(used == 0) {
+            head = 0;
+            used = 1;
+        } else {
+            head = (head + 1) % ENVELOPE_NUM_BUCKETS;
+            if(used < ENVELOPE_NUM_BUCKETS) {
+                used++;
+            }
+        }
+
+        bucket = get_bucket(series, t, head);
+
+        __atomic_store_n(&bucket->seq, bucket->seq + 1, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        bucket->start = start;
+        bucket->min = value;
+        bucket->max = value;
+        bucket->sum = value;
+        bucket->count = 1;
+
+        __atomic_store_n(&bucket->seq, bucket->seq + 1, __ATOMIC_RELEASE);
+
+        __atomic_store_n(&ring->used, used, __ATOMIC_RELEASE);
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+
+    return ret;
+}
+
+RetType EnvelopeShm::read(measurement_info_t* meas, uint32_t period, uint64_t t0, uint64_t t1,
+                          std::vector<envelope_t>* out) {
+    MsgLogger logger("EnvelopeShm", "read");
+
+    if(!index.count(meas) || shm->data == NULL) {
+        logger.log_message("no envelopes kept for measurement");
+        return FAILURE;
+    }
+
+    // pick the coarsest tier that is still fine enough, one that fits evenly into 'period' if there is one
+    int tier = -1;
+    for(uint32_t t = 0; t < tiers.size(); t++) {
+        if(tiers[t] > period) {
+            continue;
+        }
+
+        if(tier == -1) {
+            tier = t;
+            continue;
+        }
+
+        bool even = (period % tiers[t] == 0);
+        bool best_even = (period % tiers[tier] == 0);
+        if((even && !best_even) || (even == best_even && tiers[t] > tiers[tier])) {
+            tier = t;
+        }
+    }
+
+    if(tier == -1) {
+        logger.log_message("no envelope tier of " + std::to_string(period) + " ms or less");
+        return FAILURE;
+    }
+
+    uint32_t series = index[meas];
+    uint64_t out_period = (uint64_t)period * 1000;
+
+    ring_t* ring = get_ring(series, tier);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t used = __atomic_load_n(&ring->used, __ATOMIC_ACQUIRE);
+
+    uint32_t first = (head + ENVELOPE_NUM_BUCKETS + 1 - used) % ENVELOPE_NUM_BUCKETS;
+    size_t base = out->size();
+
+    for(uint32_t i = 0; i < used; i++) {
+        bucket_t* bucket = get_bucket(series, tier, (first + i) % ENVELOPE_NUM_BUCKETS);
+        bucket_t copy;
+
+        bool valid = false;
+        for(int retries = 0; retries < MAX_READ_RETRIES; retries++) {
+            uint32_t seq = __atomic_load_n(&bucket->seq, __ATOMIC_ACQUIRE);
+            if(seq & 1) {
+                // being written
+                continue;
+            }
+
+            memcpy(&copy, bucket, sizeof(bucket_t));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if(seq == __atomic_load_n(&bucket->seq, __ATOMIC_ACQUIRE)) {
+                valid = true;
+                break;
+            }
+        }
+
+        if(!valid || copy.count == 0) {
+            continue;
+        }
+
+        // buckets of 'period' start on a multiple of it, like the tiers do
+        uint64_t start = copy.start - (copy.start % out_period);
+        if(start + out_period <= t0 || start > t1) {
+            continue;
+        }
+
+        // merge into the bucket of 'period' it falls in
+        if(out->size() > base && out->back().start == start) {
+            envelope_t* env = &out->back();
+            env->mean = ((env->mean * env->count) + copy.sum) / (env->count + copy.count);
+            env->count += copy.count;
+            env->min = std::min(env->min, copy.min);
+            env->max = std::max(env->max, copy.max);
+            continue;
+        }
+
+        // a recycled bucket can be newer than the ones after it, keep things in order
+        if(out->size() > base && out->back().start > start) {
+            continue;
+        }
+
+        envelope_t env;
+        env.start = start;
+        env.period = period;
+        env.count = copy.count;
+        env.min = copy.min;
+        env.max = copy.max;
+        env.mean = copy.sum / copy.count;
+
+        out->push_back(env);
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,576 @@
+/*******************************************************************************
+* Name: HistoryShm.cpp
+*
+* Purpose: Compressed in-memory time-series history of telemetry measurements
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include "lib/telemetry/HistoryShm.h"
+#include "lib/dls/dls.h"
+
+using namespace dls;
+
+// most bits a single sample can take up
+// timestamp: 4 bit prefix + 64 bit delta-of-delta
+// value: 2 bit prefix + 5 bit leading zeros + 6 bit length + 64 bits
+#define MAX_SAMPLE_BITS (4 + 64 + 2 + 5 + 6 + 64)
+
+// marks that the last XOR window is not set yet
+#define NO_WINDOW 0xFF
+
+// write the low 'n' bits of 'val' to 'data' starting at bit 'pos', most significant bit first
+// NOTE: relies on the data being zeroed before it's written
+static inline void put_bits(uint8_t* data, uint32_t* pos, uint64_t val, unsigned int n) {
+    while(n > 0) {
+        uint32_t byte = *pos >> 3;
+        unsigned int used = *pos & 0x7;
+        unsigned int room = 8 - used;
+        unsigned int take = (n < room) ? n : room;
+
+        uint8_t bits = (uint8_t)((val >> (n - take)) & ((1u << take) - 1));
+        data[byte] |= (uint8_t)(bits << (room - take));
+
+        *pos += take;
+        n -= take;
+    }
+}
+
+// read 'n' bits from 'data' starting at bit 'pos', most significant bit first
+static inline uint64_t get_bits(const uint8_t* data, uint32_t* pos, unsigned int n) {
+    uint64_t val = 0;
+
+    while(n > 0) {
+        uint32_t byte = *pos >> 3;
+        unsigned int used = *pos & 0x7;
+        unsigned int room = 8 - used;
+        unsigned int take = (n < room) ? n : room;
+
+        uint8_t bits = (data[byte] >> (room - take)) & ((1u << take) - 1);
+        val = (val << take) | bits;
+
+        *pos += take;
+        n -= take;
+    }
+
+    return val;
+}
+
+// sign extend the low 'n' bits of 'val'
+static inline int64_t sign_extend(uint64_t val, unsigned int n) {
+    if(n == 64) {
+        return (int64_t)val;
+    }
+
+    uint64_t sign = 1ULL << (n - 1);
+    return (int64_t)((val ^ sign) - sign);
+}
+
+// true if 'val' fits in an 'n' bit two's complement integer
+static inline bool fits(int64_t val, unsigned int n) {
+    return val >= -(1LL << (n - 1)) && val < (1LL << (n - 1));
+}
+
+static inline uint64_t double_bits(double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+static inline double bits_double(uint64_t bits) {
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+
+HistoryShm::HistoryShm() {
+    shm = NULL;
+    total_size = 0;
+}
+
+HistoryShm::~HistoryShm() {
+    if(shm) {
+        delete shm;
+    }
+}
+
+// default envelope tiers, 100 ms, 1 s and 10 s
+static const uint32_t default_tiers[] = {100, 1000, 10000};
+
+RetType parse_history_file(VCM* vcm, history_config_t* config) {
+    MsgLogger logger("HistoryShm", "parse_history_file");
+
+    if(vcm->history_file == "") {
+        logger.log_message("no history file specified");
+        return FILENOTFOUND;
+    }
+
+    std::ifstream f(vcm->history_file.c_str());
+    if(!f.is_open()) {
+        logger.log_message("failed to open history file: " + vcm->history_file);
+        return FILENOTFOUND;
+    }
+
+    // index into the config for each measurement already added
+    std::unordered_map<measurement_info_t*, size_t> added;
+    bool tiers_set = false;
+
+    for(std::string line; std::getline(f, line); ) {
+        if(line == "" || !line.rfind("#", 0)) { // blank or comment '#'
+            continue;
+        }
+
+        std::istringstream ss(line);
+        std::string fst;
+        ss >> fst;
+
+        if(fst == "tiers") {
+            // list of envelope periods in milliseconds
+            config->tiers.clear();
+            tiers_set = true;
+
+            for(std::string tok; ss >> tok; ) {
+                uint32_t period;
+                try {
+                    period = std::stoi(tok, NULL, 10);
+                } catch(std::invalid_argument& ia) {
+                    logger.log_message("invalid tier period: " + line);
+                    return FAILURE;
+                }
+
+                if(period == 0) {
+                    logger.log_message("tier period must be non-zero: " + line);
+                    return FAILURE;
+                }
+
+                config->tiers.push_back(period);
+            }
+
+            continue;
+        }
+
+        std::string snd;
+        ss >> snd;
+
+        uint32_t blocks = HISTORY_DEFAULT_BLOCKS;
+        if(snd != "") {
+            try {
+                blocks = std::stoi(snd, NULL, 10);
+            } catch(std::invalid_argument& ia) {
+                logger.log_message("invalid number of blocks: " + line);
+                return FAILURE;
+            }
+
+            if(blocks == 0) {
+                logger.log_message("must keep at least one block: " + line);
+                return FAILURE;
+            }
+        }
+
+        std::vector<measurement_info_t*> add;
+
+        if(fst == "all") {
+            // every numeric measurement
+            for(std::string& name : vcm->measurements) {
+                measurement_info_t* meas = vcm->get_info(name);
+
+                if(meas->type == INT_TYPE || meas->type == FLOAT_TYPE) {
+                    add.push_back(meas);
+                }
+            }
+        } else {
+            measurement_info_t* meas = vcm->get_info(fst);
+
+            if(meas == NULL) {
+                logger.log_message("no such measurement: " + fst);
+                return FAILURE;
+            }
+
+            if(meas->type != INT_TYPE && meas->type != FLOAT_TYPE) {
+                logger.log_message("history can only be kept for numeric measurements: " + fst);
+                return FAILURE;
+            }
+
+            add.push_back(meas);
+        }
+
+        for(measurement_info_t* meas : add) {
+            if(added.count(meas)) {
+                // the last line listing a measurement decides its size
+                config->num_blocks[added[meas]] = blocks;
+            } else {
+                added[meas] = config->measurements.size();
+                config->measurements.push_back(meas);
+                config->num_blocks.push_back(blocks);
+            }
+        }
+    }
+
+    f.close();
+
+    if(!tiers_set) {
+        for(uint32_t period : default_tiers) {
+            config->tiers.push_back(period);
+        }
+    }
+
+    return SUCCESS;
+}
+
+RetType HistoryShm::init(VCM* vcm) {
+    history_config_t config;
+
+    RetType ret = parse_history_file(vcm, &config);
+    if(SUCCESS != ret) {
+        return ret;
+    }
+
+    measurements = config.measurements;
+    num_blocks = config.num_blocks;
+
+    for(size_t i = 0; i < measurements.size(); i++) {
+        index[measurements[i]] = i;
+    }
+
+    // figure out the layout
+    total_size = sizeof(history_header_t) + (measurements.size() * sizeof(series_t));
+    for(uint32_t blocks : num_blocks) {
+        total_size += (size_t)blocks * HISTORY_BLOCK_SIZE;
+    }
+
+    // keyed on the config directory like telemetry shared memory, an editor saving the history file gives it a
+    // new inode and shared memory made from it could no longer be found to destroy
+    key_filename = vcm->config_dir;
+    shm = new Shm(key_filename.c_str(), shm_key_id, total_size);
+
+    return SUCCESS;
+}
+
+RetType HistoryShm::open() {
+    return shm->attach();
+}
+
+RetType HistoryShm::close() {
+    return shm->detach();
+}
+
+// NOTE: does not attach!
+RetType HistoryShm::create() {
+    MsgLogger logger("HistoryShm", "create");
+
+    if(SUCCESS != shm->create()) {
+        logger.log_message("failed to create history shared memory");
+        return FAILURE;
+    }
+
+    if(SUCCESS != shm->attach()) {
+        logger.log_message("failed to attach to history shared memory");
+        return FAILURE;
+    }
+
+    memset(shm->data, 0, total_size);
+
+    history_header_t* header = (history_header_t*)shm->data;
+    header->num_series = measurements.size();
+    header->block_size = HISTORY_BLOCK_SIZE;
+
+    series_t* table = (series_t*)(shm->data + sizeof(history_header_t));
+    uint64_t offset = sizeof(history_header_t) + (measurements.size() * sizeof(series_t));
+
+    for(size_t i = 0; i < measurements.size(); i++) {
+        table[i].num_blocks = num_blocks[i];
+        table[i].head = 0;
+        table[i].used = 0;
+        table[i].offset = offset;
+
+        offset += (uint64_t)num_blocks[i] * HISTORY_BLOCK_SIZE;
+    }
+
+    if(SUCCESS != shm->detach()) {
+        logger.log_message("failed to detach from history shared memory");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType HistoryShm::destroy() {
+    // the history file may have changed since shared memory was made, attach to it whatever size it is
+    Shm old(key_filename.c_str(), shm_key_id, 0);
+    if(SUCCESS != old.attach() || SUCCESS != old.destroy()) {
+        return FAILURE;
+    }
+
+    // the block goes away once everyone detaches, including us
+    if(shm->data != NULL) {
+        shm->detach();
+    }
+
+    return SUCCESS;
+}
+
+bool HistoryShm::tracked(measurement_info_t* meas) {
+    return index.count(meas) > 0;
+}
+
+HistoryShm::block_header_t* HistoryShm::next_block(series_t* series) {
+    uint32_t head = series->head;
+    uint32_t used = series->used;
+
+    if(used == 0) {
+        head = 0;
+        used = 1;
+    } else if(used < series->num_blocks) {
+        head++;
+        used++;
+    } else {
+        // recycle the oldest block
+        head = (head + 1) % series->num_blocks;
+    }
+
+    block_header_t* block = (block_header_t*)(shm->data + series->offset + ((uint64_t)head * HISTORY_BLOCK_SIZE));
+
+    // odd generation tells readers the block is being recycled
+    __atomic_store_n(&block->gen, block->gen + 1, __ATOMIC_RELEASE);
+
+    block->count = 0;
+    block->t_first = 0;
+    block->t_last = 0;
+    block->bits = 0;
+    block->last_delta = 0;
+    block->last_value = 0;
+    block->last_leading = NO_WINDOW;
+    block->last_trailing = 0;
+    memset((uint8_t*)block + sizeof(block_header_t), 0, HISTORY_BLOCK_SIZE - sizeof(block_header_t));
+
+    __atomic_store_n(&block->gen, block->gen + 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&series->used, used, __ATOMIC_RELEASE);
+    __atomic_store_n(&series->head, head, __ATOMIC_RELEASE);
+
+    return block;
+}
+
+RetType HistoryShm::append(measurement_info_t* meas, uint64_t timestamp, double value) {
+    if(!index.count(meas) || shm->data == NULL) {
+        MsgLogger logger("HistoryShm", "append");
+        logger.log_message("no history kept for measurement");
+        return FAILURE;
+    }
+
+    series_t* series = ((series_t*)(shm->data + sizeof(history_header_t))) + index[meas];
+
+    block_header_t* block;
+    if(series->used == 0) {
+        block = next_block(series);
+    } else {
+        block = (block_header_t*)(shm->data + series->offset + ((uint64_t)series->head * HISTORY_BLOCK_SIZE));
+
+        if(block->count > 0 && timestamp < block->t_last) {
+            // out of order, drop it
+            return FAILURE;
+        }
+
+        if(block->bits + MAX_SAMPLE_BITS > (HISTORY_BLOCK_SIZE - sizeof(block_header_t)) * 8) {
+            // no room left in this block
+            block = next_block(series);
+        }
+    }
+
+    uint8_t* data = (uint8_t*)block + sizeof(block_header_t);
+    uint32_t pos = block->bits;
+    uint64_t bits = double_bits(value);
+
+    if(block->count == 0) {
+        // first sample in the block is stored raw
+        block->t_first = timestamp;
+        put_bits(data, &pos, bits, 64);
+        block->last_delta = 0;
+    } else {
+        // delta-of-delta encode the timestamp
+        int64_t delta = (int64_t)(timestamp - block->t_last);
+        int64_t dod = delta - block->last_delta;
+
+        if(dod == 0) {
+            put_bits(data, &pos, 0x0, 1);
+        } else if(fits(dod, 7)) {
+            put_bits(data, &pos, 0x2, 2);
+            put_bits(data, &pos, (uint64_t)dod, 7);
+        } else if(fits(dod, 14)) {
+            put_bits(data, &pos, 0x6, 3);
+            put_bits(data, &pos, (uint64_t)dod, 14);
+        } else if(fits(dod, 20)) {
+            put_bits(data, &pos, 0xE, 4);
+            put_bits(data, &pos, (uint64_t)dod, 20);
+        } else {
+            put_bits(data, &pos, 0xF, 4);
+            put_bits(data, &pos, (uint64_t)dod, 64);
+        }
+
+        block->last_delta = delta;
+
+        // XOR encode the value
+        uint64_t x = bits ^ block->last_value;
+
+        if(x == 0) {
+            put_bits(data, &pos, 0x0, 1);
+        } else {
+            uint8_t leading = __builtin_clzll(x);
+            uint8_t trailing = __builtin_ctzll(x);
+
+            // only 5 bits to store leading zeros
+            if(leading > 31) {
+                leading = 31;
+            }
+
+            if(block->last_leading != NO_WINDOW && leading >= block->last_leading
+                                                && trailing >= block->last_trailing) {
+                // fits in the last window
+                unsigned int len = 64 - block->last_leading - block->last_trailing;
+                put_bits(data, &pos, 0x2, 2);
+                put_bits(data, &pos, x >> block->last_trailing, len);
+            } else {
+                unsigned int len = 64 - leading - trailing;
+                put_bits(data, &pos, 0x3, 2);
+                put_bits(data, &pos, leading, 5);
+                put_bits(data, &pos, len & 0x3F, 6); // length of 64 is stored as 0
+                put_bits(data, &pos, x >> trailing, len);
+
+                block->last_leading = leading;
+                block->last_trailing = trailing;
+            }
+        }
+    }
+
+    block->last_value = bits;
+    block->bits = pos;
+    block->t_last = timestamp;
+
+    // publish the sample, readers load the count before reading any bits
+    __atomic_store_n(&block->count, block->count + 1, __ATOMIC_RELEASE);
+
+    return SUCCESS;
+}
+
+void HistoryShm::decode(const uint8_t* block, uint64_t t0, uint64_t t1,
+                        std::vector<uint64_t>* times, std::vector<double>* values) {
+    const block_header_t* header = (const block_header_t*)block;
+    const uint8_t* data = block + sizeof(block_header_t);
+
+    uint32_t pos = 0;
+    uint64_t t = header->t_first;
+    int64_t delta = 0;
+    uint64_t bits = get_bits(data, &pos, 64);
+    uint8_t leading = 0;
+    uint8_t trailing = 0;
+
+    for(uint32_t i = 0; i < header->count; i++) {
+        if(i > 0) {
+            // decode the timestamp
+            int64_t dod;
+            if(get_bits(data, &pos, 1) == 0) {
+                dod = 0;
+            } else if(get_bits(data, &pos, 1) == 0) {
+                dod = sign_extend(get_bits(data, &pos, 7), 7);
+            } else if(get_bits(data, &pos, 1) == 0) {
+                dod = sign_extend(get_bits(data, &pos, 14), 14);
+            } else if(get_bits(data, &pos, 1) == 0) {
+                dod = sign_extend(get_bits(data, &pos, 20), 20);
+            } else {
+                dod = (int64_t)get_bits(data, &pos, 64);
+            }
+
+            delta += dod;
+            t += delta;
+
+            // decode the value
+            if(get_bits(data, &pos, 1) == 1) {
+                if(get_bits(data, &pos, 1) == 1) {
+                    leading = get_bits(data, &pos, 5);
+                    unsigned int len = get_bits(data, &pos, 6);
+                    if(len == 0) {
+                        len = 64;
+                    }
+                    trailing = 64 - leading - len;
+                }
+
+                unsigned int len = 64 - leading - trailing;
+                bits ^= get_bits(data, &pos, len) << trailing;
+            }
+        }
+
+        if(t > t1) {
+            // timestamps only go up from here
+            return;
+        }
+
+        if(t >= t0) {
+            times->push_back(t);
+            values->push_back(bits_double(bits));
+        }
+    }
+}
+
+RetType HistoryShm::read(measurement_info_t* meas, uint64_t t0, uint64_t t1,
+                         std::vector<uint64_t>* times, std::vector<double>* values) {
+    if(!index.count(meas) || shm->data == NULL) {
+        MsgLogger logger("HistoryShm", "read");
+        logger.log_message("no history kept for measurement");
+        return FAILURE;
+    }
+
+    series_t* series = ((series_t*)(shm->data + sizeof(history_header_t))) + index[meas];
+
+    uint32_t head = __atomic_load_n(&series->head, __ATOMIC_ACQUIRE);
+    uint32_t used = __atomic_load_n(&series->used, __ATOMIC_ACQUIRE);
+
+    // local copy of a block, decoding is done on the copy
+    uint8_t copy[HISTORY_BLOCK_SIZE];
+    block_header_t* copy_header = (block_header_t*)copy;
+
+    // start at the oldest block
+    uint32_t start = 0;
+    if(used == series->num_blocks) {
+        start = (head + 1) % series->num_blocks;
+    }
+
+    for(uint32_t i = 0; i < used; i++) {
+        uint32_t b = (start + i) % series->num_blocks;
+        block_header_t* block = (block_header_t*)(shm->data + series->offset + ((uint64_t)b * HISTORY_BLOCK_SIZE));
+
+        uint32_t gen = __atomic_load_n(&block->gen, __ATOMIC_ACQUIRE);
+        if(gen & 1) {
+            // being recycled
+            continue;
+        }
+
+        // load the count first, every bit for these samples is written
+        uint32_t count = __atomic_load_n(&block->count, __ATOMIC_ACQUIRE);
+        if(count == 0) {
+            continue;
+        }
+
+        if(block->t_first > t1 || block->t_last < t0) {
+            // nothing we want in this block
+            continue;
+        }
+
+        memcpy(copy, (uint8_t*)block, HISTORY_BLOCK_SIZE);
+        copy_header->count = count;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&block->gen, __ATOMIC_RELAXED) != gen) {
+            // recycled while we were copying, that data is gone
+            continue;
+        }
+
+        decode(copy, t0, t1, times, values);
+    }
+
+    return SUCCESS;
+}
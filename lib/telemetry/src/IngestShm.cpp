@@ -0,0 +1,408 @@
+/*******************************************************************************
+* Name: IngestShm.cpp
+*
+* Purpose: Counters of how each telemetry packet is arriving over the network
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include <string.h>
+#include "lib/telemetry/IngestShm.h"
+#include "lib/dls/dls.h"
+
+using namespace dls;
+
+// how often rates are updated (nanoseconds)
+#define RATE_WINDOW 1000000000
+
+
+// a port's workers all write the same counters, nothing else is ordered by them so relaxed is enough
+static inline void add(uint64_t* counter, uint64_t value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline void set_max(uint64_t* counter, uint64_t value) {
+    uint64_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    while(value > current &&
+          !__atomic_compare_exchange_n(counter, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+static inline void set(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t get(uint64_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+
+IngestShm::IngestShm() {
+    shm = NULL;
+    num_packets = 0;
+    num_links = 0;
+    num_relays = 0;
+    total_size = 0;
+    window.tv_sec = 0;
+    window.tv_nsec = 0;
+}
+
+IngestShm::~IngestShm() {
+    if(shm) {
+        delete shm;
+    }
+}
+
+RetType IngestShm::init(VCM* vcm) {
+    num_packets = vcm->num_packets;
+    packets = vcm->packets;
+
+    writer_t writer;
+    memset(&writer, 0, sizeof(writer));
+    writers.assign(num_packets, writer);
+
+    // only packets that arrive over more than one link have link counters
+    num_links = 0;
+    first_link.assign(num_packets, -1);
+    for(uint32_t i = 0; i < num_packets; i++) {
+        if(packets[i]->ports.size() > 1) {
+            first_link[i] = num_links;
+            num_links += packets[i]->ports.size();
+        }
+    }
+
+    num_relays = vcm->relays.size();
+
+    clock_gettime(CLOCK_MONOTONIC, &window);
+
+    total_size = sizeof(ingest_header_t) + (num_packets * sizeof(ingest_stats_t)) + (num_links * sizeof(ingest_link_t)) +
+                 (num_relays * sizeof(ingest_relay_t));
+
+    // keyed on the config directory like telemetry shared memory, an editor saving the config file gives it a
+    // new inode and a reload would no longer find the old shared memory
+    key_filename = vcm->config_dir;
+    shm = new Shm(key_filename.c_str(), shm_key_id, total_size);
+
+    return SUCCESS;
+}
+
+RetType IngestShm::open() {
+    return shm->attach();
+}
+
+RetType IngestShm::close() {
+    return shm->detach();
+}
+
+// NOTE: does not attach!
+RetType IngestShm::create() {
+    MsgLogger logger("IngestShm", "create");
+
+    if(SUCCESS != shm->create()) {
+        logger.log_message("failed to create ingest shared memory");
+        return FAILURE;
+    }
+
+    if(SUCCESS != shm->attach()) {
+        logger.log_message("failed to attach to ingest shared memory");
+        return FAILURE;
+    }
+
+    memset(shm->data, 0, total_size);
+
+    ingest_header_t* header = (ingest_header_t*)shm->data;
+    header->num_packets = num_packets;
+    header->num_links = num_links;
+    header->num_relays = num_relays;
+
+    if(SUCCESS != shm->detach()) {
+        logger.log_message("failed to detach from ingest shared memory");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+// NOTE: must be attached already!
+RetType IngestShm::destroy() {
+    return shm->destroy();
+}
+
+RetType IngestShm::reload() {
+    // the old config may have had a different number of packets, attach to it whatever size it is
+    Shm old(key_filename.c_str(), shm_key_id, 0);
+    if(SUCCESS == old.attach() && SUCCESS != old.destroy()) {
+        MsgLogger logger("IngestShm", "reload");
+        logger.log_message("failed to destroy old ingest shared memory");
+        return FAILURE;
+    }
+
+    return create();
+}
+
+ingest_stats_t* IngestShm::get_stats(uint32_t packet_id) {
+    return ((ingest_stats_t*)(shm->data + sizeof(ingest_header_t))) + packet_id;
+}
+
+ingest_link_t* IngestShm::get_link(uint32_t packet_id, uint32_t link) {
+    if(shm->data == NULL || packet_id >= num_packets || first_link[packet_id] < 0 ||
+       link >= packets[packet_id]->ports.size()) {
+        return NULL;
+    }
+
+    ingest_link_t* links = (ingest_link_t*)(shm->data + sizeof(ingest_header_t) + (num_packets * sizeof(ingest_stats_t)));
+    return links + first_link[packet_id] + link;
+}
+
+ingest_relay_t* IngestShm::get_relay(uint32_t relay) {
+    if(shm->data == NULL || relay >= num_relays) {
+        return NULL;
+    }
+
+    ingest_relay_t* relays = (ingest_relay_t*)(shm->data + sizeof(ingest_header_t) + (num_packets * sizeof(ingest_stats_t)) +
+                                               (num_links * sizeof(ingest_link_t)));
+    return relays + relay;
+}
+
+void IngestShm::received(uint32_t packet_id, uint64_t num, uint64_t bytes, uint64_t mismatched) {
+    if(shm->data == NULL || packet_id >= num_packets) {
+        return;
+    }
+
+    ingest_stats_t* stats = get_stats(packet_id);
+    writer_t* writer = &writers[packet_id];
+
+    // rates start from whatever was counted before we started
+    if(!writer->active) {
+        writer->active = true;
+        writer->packets = get(&stats->packets);
+        writer->bytes = get(&stats->bytes);
+    }
+
+    add(&stats->packets, num);
+    add(&stats->bytes, bytes);
+
+    if(mismatched) {
+        add(&stats->size_mismatches, mismatched);
+    }
+}
+
+void IngestShm::sequence(uint32_t packet_id, const uint8_t* data) {
+    if(shm->data == NULL || packet_id >= num_packets || packets[packet_id]->sequence == NULL) {
+        return;
+    }
+
+    measurement_info_t* meas = packets[packet_id]->sequence;
+    uint64_t seq = meas->decode_uint64(meas, data + packets[packet_id]->sequence_offset);
+
+    ingest_stats_t* stats = get_stats(packet_id);
+    writer_t* writer = &writers[packet_id];
+
+    // sequence numbers wrap around at the size of the measurement
+    uint64_t mask = (meas->size >= sizeof(uint64_t)) ? ~(uint64_t)0 : ((uint64_t)1 << (8 * meas->size)) - 1;
+
+    uint64_t last = __atomic_exchange_n(&stats->sequence, seq, __ATOMIC_RELAXED);
+
+    if(writer->have_sequence) {
+        uint64_t skipped = (seq - (last + 1)) & mask;
+
+        // more than half way around is taken as going backwards
+        if(skipped > (mask >> 1)) {
+            add(&stats->sequence_errors, 1);
+        } else if(skipped) {
+            add(&stats->sequence_gaps, skipped);
+        }
+    }
+
+    writer->have_sequence = true;
+}
+
+void IngestShm::socket(uint32_t packet_id, uint32_t drops, size_t queued, uint32_t link) {
+    if(shm->data == NULL || packet_id >= num_packets || link >= MAX_PACKET_PORTS) {
+        return;
+    }
+
+    ingest_stats_t* stats = get_stats(packet_id);
+    writer_t* writer = &writers[packet_id];
+
+    // the kernel's count is 32 bits and wraps, only the difference matters
+    if(drops != writer->drops[link]) {
+        add(&stats->kernel_drops, (uint32_t)(drops - writer->drops[link]));
+        writer->drops[link] = drops;
+    }
+
+    set_max(&stats->queued_max, queued);
+}
+
+void IngestShm::link_copy(uint32_t packet_id, uint32_t link, bool first) {
+    ingest_link_t* stats = get_link(packet_id, link);
+    if(stats == NULL) {
+        return;
+    }
+
+    add(&stats->packets, 1);
+    add(first ? &stats->first : &stats->behind, 1);
+}
+
+void IngestShm::link_lag(uint32_t packet_id, uint32_t link, uint64_t lag) {
+    ingest_link_t* stats = get_link(packet_id, link);
+    if(stats == NULL) {
+        return;
+    }
+
+    add(&stats->lag_total, lag);
+    set_max(&stats->lag_max, lag);
+}
+
+void IngestShm::link_lost(uint32_t packet_id, uint32_t link, uint64_t num) {
+    ingest_link_t* stats = get_link(packet_id, link);
+    if(stats == NULL) {
+        return;
+    }
+
+    add(&stats->lost, num);
+}
+
+void IngestShm::delta(uint32_t packet_id, uint32_t lost, bool dropped) {
+    if(shm->data == NULL || packet_id >= num_packets) {
+        return;
+    }
+
+    ingest_stats_t* stats = get_stats(packet_id);
+
+    if(lost) {
+        add(&stats->delta_lost, lost);
+    }
+
+    if(dropped) {
+        add(&stats->delta_dropped, 1);
+    }
+}
+
+void IngestShm::bad_crc(uint32_t packet_id) {
+    if(shm->data == NULL || packet_id >= num_packets) {
+        return;
+    }
+
+    add(&get_stats(packet_id)->crc_errors, 1);
+}
+
+void IngestShm::replicated(uint32_t packet_id, uint64_t lag) {
+    if(shm->data == NULL || packet_id >= num_packets) {
+        return;
+    }
+
+    ingest_stats_t* stats = get_stats(packet_id);
+    set(&stats->replica_lag, lag);
+    set_max(&stats->replica_lag_max, lag);
+}
+
+void IngestShm::relayed(uint32_t relay, uint64_t sent, uint64_t bytes, uint64_t dropped) {
+    ingest_relay_t* stats = get_relay(relay);
+    if(stats == NULL) {
+        return;
+    }
+
+    if(sent) {
+        add(&stats->sent, sent);
+        add(&stats->bytes, bytes);
+    }
+
+    if(dropped) {
+        add(&stats->dropped, dropped);
+    }
+}
+
+void IngestShm::tick() {
+    if(shm->data == NULL) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t elapsed = ((now.tv_sec - window.tv_sec) * 1000000000ULL) + now.tv_nsec - window.tv_nsec;
+    if(elapsed < RATE_WINDOW) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < num_packets; i++) {
+        writer_t* writer = &writers[i];
+        if(!writer->active) {
+            continue;
+        }
+
+        ingest_stats_t* stats = get_stats(i);
+        uint64_t packets = get(&stats->packets);
+        uint64_t bytes = get(&stats->bytes);
+
+        set(&stats->packet_rate, (uint64_t)(((double)(packets - writer->packets) * RATE_WINDOW) / elapsed));
+        set(&stats->byte_rate, (uint64_t)(((double)(bytes - writer->bytes) * RATE_WINDOW) / elapsed));
+
+        writer->packets = packets;
+        writer->bytes = bytes;
+    }
+
+    window = now;
+}
+
+RetType IngestShm::read(uint32_t packet_id, ingest_stats_t* stats) {
+    if(shm->data == NULL || packet_id >= num_packets) {
+        MsgLogger logger("IngestShm", "read");
+        logger.log_message("not attached or no such packet");
+        return FAILURE;
+    }
+
+    ingest_stats_t* src = get_stats(packet_id);
+
+    stats->packets = get(&src->packets);
+    stats->bytes = get(&src->bytes);
+    stats->packet_rate = get(&src->packet_rate);
+    stats->byte_rate = get(&src->byte_rate);
+    stats->size_mismatches = get(&src->size_mismatches);
+    stats->kernel_drops = get(&src->kernel_drops);
+    stats->queued_max = get(&src->queued_max);
+    stats->sequence_gaps = get(&src->sequence_gaps);
+    stats->sequence_errors = get(&src->sequence_errors);
+    stats->sequence = get(&src->sequence);
+    stats->delta_lost = get(&src->delta_lost);
+    stats->delta_dropped = get(&src->delta_dropped);
+    stats->crc_errors = get(&src->crc_errors);
+    stats->replica_lag = get(&src->replica_lag);
+    stats->replica_lag_max = get(&src->replica_lag_max);
+
+    return SUCCESS;
+}
+
+RetType IngestShm::read_link(uint32_t packet_id, uint32_t link, ingest_link_t* stats) {
+    ingest_link_t* src = get_link(packet_id, link);
+    if(src == NULL) {
+        MsgLogger logger("IngestShm", "read_link");
+        logger.log_message("not attached or no such link");
+        return FAILURE;
+    }
+
+    stats->packets = get(&src->packets);
+    stats->first = get(&src->first);
+    stats->behind = get(&src->behind);
+    stats->lag_total = get(&src->lag_total);
+    stats->lag_max = get(&src->lag_max);
+    stats->lost = get(&src->lost);
+
+    return SUCCESS;
+}
+
+RetType IngestShm::read_relay(uint32_t relay, ingest_relay_t* stats) {
+    ingest_relay_t* src = get_relay(relay);
+    if(src == NULL) {
+        MsgLogger logger("IngestShm", "read_relay");
+        logger.log_message("not attached or no such relay");
+        return FAILURE;
+    }
+
+    stats->sent = get(&src->sent);
+    stats->bytes = get(&src->bytes);
+    stats->dropped = get(&src->dropped);
+
+    return SUCCESS;
+}
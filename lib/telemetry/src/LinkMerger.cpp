@@ -0,0 +1,163 @@
+/*******************************************************************************
+* Name: LinkMerger.cpp
+*
+* Purpose: Merges copies of a telemetry packet that arrive over redundant links
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include <time.h>
+#include <algorithm>
+#include "lib/telemetry/LinkMerger.h"
+#include "lib/dls/dls.h"
+
+using namespace dls;
+
+
+// FNV-1a, for packets without a sequence number
+static inline uint64_t hash_packet(const uint8_t* data, size_t size) {
+    uint64_t h = 14695981039346656037ULL;
+
+    for(size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+LinkMerger::LinkMerger() {
+    packet = NULL;
+    packet_id = 0;
+    ingest = NULL;
+    mask = 0;
+    next = 0;
+    last = 0;
+    have_last = false;
+    late_run = 0;
+}
+
+RetType LinkMerger::init(VCM* vcm, uint32_t packet_id, IngestShm* ingest) {
+    if(packet_id >= vcm->num_packets) {
+        MsgLogger logger("LinkMerger", "init");
+        logger.log_message("no such packet");
+        return FAILURE;
+    }
+
+    this->packet_id = packet_id;
+    this->ingest = ingest;
+    packet = vcm->packets[packet_id];
+
+    slot_t empty;
+    empty.key = 0;
+    empty.time = 0;
+    empty.first = 0;
+    empty.seen = 0;
+    empty.used = false;
+    slots.assign(MERGE_SLOTS, empty);
+    next = 0;
+
+    if(packet->sequence) {
+        size_t size = packet->sequence->size;
+        mask = (size >= sizeof(uint64_t)) ? ~(uint64_t)0 : ((uint64_t)1 << (8 * size)) - 1;
+    }
+
+    return SUCCESS;
+}
+
+void LinkMerger::evict(slot_t* slot) {
+    for(uint32_t link = 0; link < packet->ports.size(); link++) {
+        if(!(slot->seen & (1 << link))) {
+            ingest->link_lost(packet_id, link, 1);
+        }
+    }
+}
+
+LinkMerger::slot_t* LinkMerger::find(uint64_t key, uint64_t now) {
+    for(size_t n = 1; n <= MERGE_SLOTS; n++) {
+        slot_t* slot = &slots[(next + MERGE_SLOTS - n) % MERGE_SLOTS];
+
+        // everything further back arrived earlier
+        if(!slot->used || now - slot->time >= MERGE_WINDOW) {
+            return NULL;
+        }
+
+        if(slot->key == key) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+LinkMerger::merge_t LinkMerger::merge(uint32_t link, const uint8_t* data) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+    uint64_t key;
+    if(packet->sequence) {
+        key = packet->sequence->decode_uint64(packet->sequence, data + packet->sequence_offset);
+    } else {
+        key = hash_packet(data, packet->size);
+    }
+
+    uint8_t bit = 1 << link;
+    slot_t* slot;
+    if(packet->sequence) {
+        slot = &slots[key % MERGE_SLOTS];
+    } else {
+        slot = find(key, now);
+    }
+
+    if(slot && slot->used && slot->key == key && now - slot->time < MERGE_WINDOW) {
+        if(!(slot->seen & bit)) {
+            // another link got here first
+            slot->seen |= bit;
+            ingest->link_copy(packet_id, link, false);
+            ingest->link_lag(packet_id, link, now - slot->time);
+            return MERGE_DUPLICATE;
+        }
+
+        // the link repeated a sequence number
+        if(packet->sequence) {
+            ingest->link_copy(packet_id, link, false);
+            return MERGE_DUPLICATE;
+        }
+
+        // the same contents again on the same link, a new packet
+    }
+
+    if(!packet->sequence) {
+        slot = &slots[next];
+        next = (next + 1) % MERGE_SLOTS;
+    }
+
+    if(slot->used) {
+        evict(slot);
+    }
+
+    slot->key = key;
+    slot->time = now;
+    slot->first = link;
+    slot->seen = bit;
+    slot->used = true;
+
+    ingest->link_copy(packet_id, link, true);
+
+    if(packet->sequence) {
+        uint64_t window = std::min((uint64_t)MERGE_SLOTS, mask >> 2);
+
+        // shared memory already has a newer one, unless the vehicle started over before getting past it
+        if(have_last && ((last - key) & mask) <= window && ++late_run < MERGE_RESTART) {
+            return MERGE_LATE;
+        }
+
+        last = key;
+        have_last = true;
+        late_run = 0;
+    }
+
+    return MERGE_NEW;
+}
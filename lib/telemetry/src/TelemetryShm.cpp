@@ -72,8 +72,13 @@ TelemetryShm::TelemetryShm() {
     packet_blocks = NULL;
     info_blocks = NULL;
     master_block = NULL;
+    write_locks = NULL;
+    locked_packets = NULL;
     num_packets = 0;
     last_nonces = NULL;
+    layouts = NULL;
+    generation = 0;
+    woken_generation = 0;
     last_nonce = 1; // NOTE: cannot be 0, 0 indicates a signal was received
     read_mode = STANDARD_READ;
     read_locked = false;
@@ -130,6 +135,10 @@ TelemetryShm::~TelemetryShm() {
         free(last_nonces);
     }
 
+    if(layouts) {
+        delete[] layouts;
+    }
+
     if(updated) {
         free(updated);
     }
@@ -149,14 +158,17 @@ RetType TelemetryShm::init(VCM* vcm) {
     updated = (bool*)malloc(num_packets * sizeof(bool));
     memset(updated, 0, num_packets * sizeof(bool));
 
+    key_filename = vcm->config_dir;
+
     // create master Shm object
     // use an id guaranteed unused so we can use the same file name for all blocks
-    master_block = new Shm(vcm->config_file.c_str(), 0, sizeof(shm_info_t));
+    master_block = new Shm(key_filename.c_str(), 0, sizeof(shm_info_t));
 
     // create Shm objects for each telemetry packet
     packet_blocks = new Shm*[num_packets];
     info_blocks = new Shm*[num_packets];
     write_locks = new Shm*[num_packets];
+    layouts = new uint64_t[num_packets];
 
     // store which packets we currently have locked
     locked_packets = new bool[num_packets];
@@ -168,9 +180,10 @@ RetType TelemetryShm::init(VCM* vcm) {
         // for shmem id use (i+1)*2 for packets (always even) and (2*i)+1 for info blocks (always odd)
         // virtual locks use a shmid of -(i+1)*2 (always even and negative)
         // guarantees all blocks can use the same file but different ids to make a key
-        packet_blocks[i] = new Shm(vcm->config_file.c_str(), 2*(i+1), packet->size);
-        info_blocks[i] = new Shm(vcm->config_file.c_str(), (2*i)+1, sizeof(uint32_t)); // holds one nonce
-        write_locks[i] = new Shm(vcm->config_file.c_str(), -2*(i+1), sizeof(sem_t)); // holds a single semaphore
+        packet_blocks[i] = new Shm(key_filename.c_str(), 2*(i+1), packet->size);
+        info_blocks[i] = new Shm(key_filename.c_str(), (2*i)+1, sizeof(packet_shm_info_t));
+        write_locks[i] = new Shm(key_filename.c_str(), -2*(i+1), sizeof(sem_t)); // holds a single semaphore
+        layouts[i] = vcm->packet_layout(i);
 
         // we currently hold no locks
         locked_packets[i] = false;
@@ -200,6 +213,22 @@ RetType TelemetryShm::open() {
         return FAILURE;
     }
 
+    shm_info_t* info = (shm_info_t*)master_block->data;
+    generation = info->generation;
+    woken_generation = generation;
+
+    // make sure shared memory was made from the same config we were
+    bool match = (info->num_packets == num_packets);
+    for(size_t i = 0; match && i < num_packets; i++) {
+        match = (((packet_shm_info_t*)info_blocks[i]->data)->layout == layouts[i]);
+    }
+
+    if(!match) {
+        MsgLogger logger("TelemetryShm", "open");
+        logger.log_message("shared memory layout doesn't match the config, was the config changed?");
+        return FAILURE;
+    }
+
     return SUCCESS;
 }
 
@@ -227,44 +256,7 @@ RetType TelemetryShm::create() {
     MsgLogger logger("TelemetryShm", "create");
 
     for(size_t i = 0; i < num_packets; i++) {
-        if(SUCCESS != packet_blocks[i]->create()) {
-            logger.log_message("failed to create packet block");
-            return FAILURE;
-        }
-        else if(SUCCESS != info_blocks[i]->create()) {
-            logger.log_message("failed to create info block");
-            return FAILURE;
-        } else if(SUCCESS != write_locks[i]->create()) {
-            logger.log_message("failed to create write lock");
-            return FAILURE;
-        }
-
-        // attach first
-        if(SUCCESS != info_blocks[i]->attach()) {
-            logger.log_message("failed to attach to shared memory block");
-            return FAILURE;
-        }
-
-        // 'info blocks' are single nonces now, initialize them to 1
-        *((uint32_t*)info_blocks[i]->data) = 1;
-
-        // we should unatach after setting the default
-        // although we technically still could stay attached and be okay
-        if(SUCCESS != info_blocks[i]->detach()) {
-            logger.log_message("failed to detach from shared memory block");
-            return FAILURE;
-        }
-
-        // now set the write lock for this packet
-        if(SUCCESS != write_locks[i]->attach()) {
-            logger.log_message("failed to attach to write lock shared memory block");
-            return FAILURE;
-        }
-
-        INIT(*((sem_t*)(write_locks[i]->data)), 1);
-
-        if(SUCCESS != write_locks[i]->detach()) {
-            logger.log_message("failed to detach from write lock shared memory block");
+        if(SUCCESS != create_packet(i, 1)) {
             return FAILURE;
         }
     }
@@ -295,6 +287,9 @@ RetType TelemetryShm::create() {
     // start the master nonce at 1, 0 indicates a signal
     info->nonce = 1;
 
+    info->generation = 0;
+    info->num_packets = num_packets;
+
     // we should detach to be later attached
     // if this fails it's not the end of the world? but its still bad and shouldn't fail
     if(SUCCESS != master_block->detach()) {
@@ -305,20 +300,20 @@ RetType TelemetryShm::create() {
     return SUCCESS;
 }
 
-// NOTE: must be attached already!
+// NOTE: destroys whatever packets are in shared memory, they may be from an older config
 RetType TelemetryShm::destroy() {
     MsgLogger logger("TelemetryShm", "destroy");
 
-    for(size_t i = 0; i < num_packets; i++) {
-        if(SUCCESS != packet_blocks[i]->destroy()) {
-            logger.log_message("failed to destroy packet block");
-            return FAILURE;
-        }
-        else if(SUCCESS != info_blocks[i]->destroy()) {
-            logger.log_message("failed to destroy info block");
-            return FAILURE;
-        } else if(SUCCESS != write_locks[i]->destroy()) {
-            logger.log_message("failed to destroy write lock block");
+    if(master_block->data == NULL && SUCCESS != master_block->attach()) {
+        logger.log_message("failed to attach to master block");
+        return FAILURE;
+    }
+
+    size_t old_num = ((shm_info_t*)master_block->data)->num_packets;
+
+    for(size_t i = 0; i < old_num; i++) {
+        if(SUCCESS != destroy_old_packet(i)) {
+            logger.log_message("failed to destroy blocks of packet " + std::to_string(i));
             return FAILURE;
         }
     }
@@ -331,6 +326,157 @@ RetType TelemetryShm::destroy() {
     return SUCCESS;
 }
 
+RetType TelemetryShm::create_packet(size_t i, uint32_t nonce) {
+    MsgLogger logger("TelemetryShm", "create_packet");
+
+    if(SUCCESS != packet_blocks[i]->create()) {
+        logger.log_message("failed to create packet block");
+        return FAILURE;
+    }
+    else if(SUCCESS != info_blocks[i]->create()) {
+        logger.log_message("failed to create info block");
+        return FAILURE;
+    } else if(SUCCESS != write_locks[i]->create()) {
+        logger.log_message("failed to create write lock");
+        return FAILURE;
+    }
+
+    // attach first
+    if(SUCCESS != info_blocks[i]->attach()) {
+        logger.log_message("failed to attach to shared memory block");
+        return FAILURE;
+    }
+
+    packet_shm_info_t* packet_info = (packet_shm_info_t*)info_blocks[i]->data;
+    packet_info->nonce = nonce;
+    packet_info->written = 0;
+    packet_info->layout = layouts[i];
+
+    // we should unatach after setting the default
+    // although we technically still could stay attached and be okay
+    if(SUCCESS != info_blocks[i]->detach()) {
+        logger.log_message("failed to detach from shared memory block");
+        return FAILURE;
+    }
+
+    // now set the write lock for this packet
+    if(SUCCESS != write_locks[i]->attach()) {
+        logger.log_message("failed to attach to write lock shared memory block");
+        return FAILURE;
+    }
+
+    INIT(*((sem_t*)(write_locks[i]->data)), 1);
+
+    if(SUCCESS != write_locks[i]->detach()) {
+        logger.log_message("failed to detach from write lock shared memory block");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryShm::destroy_old_packet(size_t i) {
+    // size zero attaches to a block of any size
+    Shm blocks[] = {
+        Shm(key_filename.c_str(), 2*(i+1), 0),
+        Shm(key_filename.c_str(), (2*i)+1, 0),
+        Shm(key_filename.c_str(), -2*(i+1), 0)
+    };
+
+    RetType ret = SUCCESS;
+    for(Shm& block : blocks) {
+        // anyone still attached keeps the block until they detach
+        if(SUCCESS != block.attach() || SUCCESS != block.destroy()) {
+            ret = FAILURE;
+        }
+    }
+
+    return ret;
+}
+
+RetType TelemetryShm::reload() {
+    MsgLogger logger("TelemetryShm", "reload");
+
+    if(SUCCESS != master_block->attach()) {
+        logger.log_message("failed to attach to master block");
+        return FAILURE;
+    }
+
+    shm_info_t* info = (shm_info_t*)master_block->data;
+
+    // enter as a writer, nobody reads or writes while packets are swapped out
+    P(info->wmutex);
+    info->writers++;
+    if(info->writers == 1) {
+        P(info->readTry);
+    }
+    V(info->wmutex);
+
+    P(info->resource);
+
+    RetType ret = SUCCESS;
+    size_t old_num = info->num_packets;
+    size_t max_num = (old_num > num_packets) ? old_num : num_packets;
+    size_t kept = 0;
+
+    for(size_t i = 0; i < max_num; i++) {
+        if(i < old_num && i < num_packets && SUCCESS == info_blocks[i]->attach()) {
+            bool same = (((packet_shm_info_t*)info_blocks[i]->data)->layout == layouts[i]);
+            info_blocks[i]->detach();
+
+            if(same) {
+                kept++;
+                continue;
+            }
+        }
+
+        if(i < old_num && SUCCESS != destroy_old_packet(i)) {
+            logger.log_message("failed to destroy old blocks of packet " + std::to_string(i));
+            ret = FAILURE;
+        }
+
+        if(i < num_packets && SUCCESS != create_packet(i, info->nonce + 1)) {
+            logger.log_message("failed to create blocks of packet " + std::to_string(i));
+            ret = FAILURE;
+        }
+    }
+
+    info->num_packets = num_packets;
+    info->generation++;
+    info->nonce++;
+
+    logger.log_message("reloaded to generation " + std::to_string(info->generation) + ", kept " +
+                       std::to_string(kept) + " of " + std::to_string(num_packets) + " packets");
+
+    // wake up every reader
+    syscall(SYS_futex, &(info->nonce), FUTEX_WAKE_BITSET, INT_MAX, NULL, NULL, 0xFFFFFFFF);
+
+    // exit as a writer
+    V(info->resource);
+
+    P(info->wmutex);
+    info->writers--;
+    if(info->writers == 0) {
+        V(info->readTry);
+    }
+    V(info->wmutex);
+
+    if(SUCCESS != master_block->detach()) {
+        logger.log_message("failed to detach from master block");
+        return FAILURE;
+    }
+
+    return ret;
+}
+
+bool TelemetryShm::reloaded() {
+    if(master_block == NULL || master_block->data == NULL) {
+        return false;
+    }
+
+    return __atomic_load_n(&((shm_info_t*)master_block->data)->generation, __ATOMIC_RELAXED) != generation;
+}
+
 RetType TelemetryShm::write(uint32_t packet_id, uint8_t* data) {
     MsgLogger logger("TelemetryShm", "write");
 
@@ -370,6 +516,7 @@ RetType TelemetryShm::write(uint32_t packet_id, uint8_t* data) {
     info->nonce++; // update the master nonce
 
     (*packet_nonce) = info->nonce; // update the packet nonce to equal the new master nonce
+    ((packet_shm_info_t*)packet_nonce)->written = 1;
 
     // update our last nonces
     // we do this so if we read after a write we know we updated our packet
@@ -398,6 +545,74 @@ RetType TelemetryShm::write(uint32_t packet_id, uint8_t* data) {
     return SUCCESS;
 }
 
+RetType TelemetryShm::write(uint32_t* packet_ids, uint8_t** data, size_t num) {
+    if(packet_blocks == NULL || info_blocks == NULL || master_block == NULL) {
+        // not open
+        MsgLogger logger("TelemetryShm", "write(multiple)");
+        logger.log_message("object not open");
+        return FAILURE;
+    }
+
+    shm_info_t* info = (shm_info_t*)master_block->data;
+
+    if(info == NULL) {
+        MsgLogger logger("TelemetryShm", "write(multiple)");
+        logger.log_message("shared memory block is null");
+        return FAILURE;
+    }
+
+    for(size_t i = 0; i < num; i++) {
+        if(packet_ids[i] >= num_packets) {
+            MsgLogger logger("TelemetryShm", "write(multiple)");
+            logger.log_message("invalid packet id");
+            return FAILURE;
+        }
+    }
+
+    // enter as a writer
+    P(info->wmutex);
+    info->writers++;
+    if(info->writers == 1) {
+        P(info->readTry);
+    }
+    V(info->wmutex);
+
+    P(info->resource);
+
+    uint32_t bitset = 0;
+    for(size_t i = 0; i < num; i++) {
+        uint32_t packet_id = packet_ids[i];
+        Shm* packet = packet_blocks[packet_id];
+
+        memcpy((unsigned char*)packet->data, data[i], packet->size);
+        info->nonce++; // update the master nonce
+
+        // update the packet nonce to equal the new master nonce
+        packet_shm_info_t* packet_info = (packet_shm_info_t*)info_blocks[packet_id]->data;
+        packet_info->nonce = info->nonce;
+        packet_info->written = 1;
+
+        bitset |= 1 << (packet_id % 32);
+    }
+
+    // wakeup anyone blocked on any of the packets
+    if(bitset) {
+        syscall(SYS_futex, &(info->nonce), FUTEX_WAKE_BITSET, INT_MAX, NULL, NULL, bitset);
+    }
+
+    // exit as a writer
+    V(info->resource);
+
+    P(info->wmutex);
+    info->writers--;
+    if(info->writers == 0) {
+        V(info->readTry);
+    }
+    V(info->wmutex);
+
+    return SUCCESS;
+}
+
 RetType TelemetryShm::clear(uint32_t packet_id, uint8_t val) {
     MsgLogger logger("TelemetryShm", "clear");
 
@@ -543,10 +758,11 @@ RetType TelemetryShm::read_lock(unsigned int* packet_ids, size_t num, uint32_t t
         unsigned int id;
         bool block = true; // whether or not we block
         for(size_t i = 0; i < num; i++) {
-            bitset |= (1 << i);
-
             id = packet_ids[i];
 
+            // writers wake the bit of the packet id, not where it is in our list
+            bitset |= (1 << (id % 32));
+
             nonce = (uint32_t*)(info_blocks[id]->data);
             if(*nonce != last_nonces[id]) {
                 // we found a nonce that changed!
@@ -557,6 +773,13 @@ RetType TelemetryShm::read_lock(unsigned int* packet_ids, size_t num, uint32_t t
             }
         }
 
+        // the config was reloaded, return once so the caller can notice (see 'reloaded')
+        // readers that don't check go back to blocking next time instead of spinning
+        if(info->generation != woken_generation) {
+            woken_generation = info->generation;
+            block = false;
+        }
+
         // in standard read mode we don't care if the packet updated
         if(!block || (read_mode == STANDARD_READ)) {
             read_locked = true;
@@ -890,6 +1113,30 @@ RetType TelemetryShm::packet_updated(uint32_t packet_id, bool* updated) {
     return SUCCESS;
 }
 
+RetType TelemetryShm::packet_nonce(uint32_t packet_id, uint32_t* nonce) {
+    // called for every packet sent by the replication daemon, only log on errors
+    if(!read_locked || packet_id >= num_packets) {
+        MsgLogger logger("TelemetryShm", "packet_nonce");
+        logger.log_message(read_locked ? "invalid packet id" : "not read locked");
+        return FAILURE;
+    }
+
+    *nonce = last_nonces[packet_id];
+
+    return SUCCESS;
+}
+
+bool TelemetryShm::written(uint32_t packet_id) {
+    // called for every packet decom writes, only log on errors
+    if(packet_id >= num_packets || info_blocks == NULL || info_blocks[packet_id]->data == NULL) {
+        MsgLogger logger("TelemetryShm", "written");
+        logger.log_message("invalid packet id or not open");
+        return false;
+    }
+
+    return ((packet_shm_info_t*)info_blocks[packet_id]->data)->written != 0;
+}
+
 
 RetType TelemetryShm::update_value(uint32_t packet_id, uint32_t* value) {
     MsgLogger logger("TelemetryShm", "update_value");
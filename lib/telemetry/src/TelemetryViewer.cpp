@@ -9,6 +9,7 @@
 *******************************************************************************/
 #include <string.h>
 #include <limits.h>
+#include <sys/time.h>
 
 #include "lib/telemetry/TelemetryViewer.h"
 #include "lib/dls/dls.h"
@@ -25,6 +26,10 @@ TelemetryViewer::TelemetryViewer() {
     vcm = NULL;
     packet_sizes = NULL;
     packet_buffers = NULL;
+    calibrations = NULL;
+    calibrated = NULL;
+    history = NULL;
+    envelope = NULL;
 }
 
 TelemetryViewer::~TelemetryViewer() {
@@ -52,6 +57,26 @@ TelemetryViewer::~TelemetryViewer() {
         delete[] packet_sizes;
     }
 
+    if(calibrations != NULL) {
+        for(size_t i = 0; i < vcm->num_packets; i++) {
+            if(calibrations[i] != NULL) {
+                delete calibrations[i];
+                delete[] calibrated[i];
+            }
+        }
+
+        delete[] calibrations;
+        delete[] calibrated;
+    }
+
+    if(history != NULL) {
+        delete history;
+    }
+
+    if(envelope != NULL) {
+        delete envelope;
+    }
+
     if(vcm && rm_vcm) {
         delete vcm;
     }
@@ -98,6 +123,11 @@ RetType TelemetryViewer::init(VCM* vcm, TelemetryShm* shm) {
     packet_buffers = new uint8_t*[vcm->num_packets];
     memset(packet_buffers, 0, sizeof(uint8_t*) * vcm->num_packets);
 
+    calibrations = new CalibrationBatch*[vcm->num_packets];
+    memset(calibrations, 0, sizeof(CalibrationBatch*) * vcm->num_packets);
+    calibrated = new double*[vcm->num_packets];
+    memset(calibrated, 0, sizeof(double*) * vcm->num_packets);
+
     return SUCCESS;
 }
 
@@ -160,6 +190,18 @@ RetType TelemetryViewer::add(uint32_t packet_id) {
         memset(packet_buffers[packet_id], 0, packet_sizes[packet_id]); // zero buffer
         num_packets++;
 
+        if(vcm->packets[packet_id]->calibrated.size() && calibrations[packet_id] == NULL) {
+            calibrations[packet_id] = new CalibrationBatch;
+            if(SUCCESS != calibrations[packet_id]->init(vcm, packet_id)) {
+                MsgLogger logger("TelemetryViewer", "add");
+                logger.log_message("failed to set up calibrations for packet");
+                return FAILURE;
+            }
+
+            calibrated[packet_id] = new double[calibrations[packet_id]->size()];
+            calibrations[packet_id]->evaluate(packet_buffers[packet_id], calibrated[packet_id]);
+        }
+
         return SUCCESS;
     }
 
@@ -218,6 +260,14 @@ RetType TelemetryViewer::update(uint32_t timeout) {
         return FAILURE;
     }
 
+    // evaluate the calibrations of every packet that updated, one pass per packet
+    for(size_t i = 0; i < num_packets; i++) {
+        id = packet_ids[i];
+        if(shm->updated[id] && calibrations[id] != NULL) {
+            calibrations[id]->evaluate(packet_buffers[id], calibrated[id]);
+        }
+    }
+
     return SUCCESS;
 }
 
@@ -225,33 +275,44 @@ void TelemetryViewer::sighandler() {
     shm->sighandler();
 }
 
-RetType TelemetryViewer::latest_data(measurement_info_t* meas, uint8_t** data) {
-    MsgLogger logger("TelemetryViewer", "latest_data");
-
-    std::vector<location_info_t> locs = meas->locations;
+RetType TelemetryViewer::latest_location(measurement_info_t* meas, size_t* index) {
+    std::vector<location_info_t>& locs = meas->locations;
 
     if(locs.size() <= 0) {
+        MsgLogger logger("TelemetryViewer", "latest_data");
         logger.log_message("measurement does not exist anywhere");
         return FAILURE;
     }
 
-    location_info_t* best_loc;
+    size_t best_loc = 0;
     long int best = INT_MAX;
     uint32_t curr;
     for(size_t i = 0; i < locs.size(); i++) {
         if(shm->update_value(locs[i].packet_index, &curr) == FAILURE) {
+            MsgLogger logger("TelemetryViewer", "latest_data");
             logger.log_message("unable to retrieve update value for packet");
             return FAILURE;
         }
 
         if(curr < best) {
             best = curr;
-            best_loc = &(locs[i]);
+            best_loc = i;
         }
     }
 
-    // guaranteed loc is not NULL since we found some location
-    *data = packet_buffers[best_loc->packet_index] + best_loc->offset;
+    *index = best_loc;
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::latest_data(measurement_info_t* meas, uint8_t** data) {
+    size_t index;
+    if(latest_location(meas, &index) != SUCCESS) {
+        return FAILURE;
+    }
+
+    location_info_t* loc = &(meas->locations[index]);
+    *data = packet_buffers[loc->packet_index] + loc->offset;
 
     return SUCCESS;
 }
@@ -275,15 +336,15 @@ bool TelemetryViewer::updated(measurement_info_t* meas) {
 }
 
 RetType TelemetryViewer::get_str(measurement_info_t* meas, std::string* val) {
-    MsgLogger logger("TelemetryViewer", "get");
-
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to locate latest data for measurement");
         return FAILURE;
     }
 
     if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to convert measurement to string");
         return FAILURE;
     }
@@ -291,16 +352,33 @@ RetType TelemetryViewer::get_str(measurement_info_t* meas, std::string* val) {
     return SUCCESS;
 }
 
-RetType TelemetryViewer::get_float(measurement_info_t* meas, float* val) {
-    MsgLogger logger("TelemetryViewer", "get");
+RetType TelemetryViewer::get_str(measurement_info_t* meas, char* first, char* last, char** end) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(format(meas, data, first, last, end) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to format measurement as text");
+        return FAILURE;
+    }
 
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_float(measurement_info_t* meas, float* val) {
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to locate latest data for measurement");
         return FAILURE;
     }
 
     if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to convert measurement to float");
         return FAILURE;
     }
@@ -309,15 +387,28 @@ RetType TelemetryViewer::get_float(measurement_info_t* meas, float* val) {
 }
 
 RetType TelemetryViewer::get_double(measurement_info_t* meas, double* val) {
-    MsgLogger logger("TelemetryViewer", "get");
+    if(meas->cal_input) {
+        // already evaluated when the packet updated
+        size_t index;
+        if(latest_location(meas, &index) == SUCCESS) {
+            uint32_t packet = meas->locations[index].packet_index;
+
+            if(calibrated[packet] != NULL) {
+                *val = calibrated[packet][meas->cal_index[index]];
+                return SUCCESS;
+            }
+        }
+    }
 
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to locate latest data for measurement");
         return FAILURE;
     }
 
     if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to convert measurement to double");
         return FAILURE;
     }
@@ -326,15 +417,15 @@ RetType TelemetryViewer::get_double(measurement_info_t* meas, double* val) {
 }
 
 RetType TelemetryViewer::get_int(measurement_info_t* meas, int* val) {
-    MsgLogger logger("TelemetryViewer", "get");
-
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to locate latest data for measurement");
         return FAILURE;
     }
 
     if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to convert measurement to int");
         return FAILURE;
     }
@@ -343,15 +434,15 @@ RetType TelemetryViewer::get_int(measurement_info_t* meas, int* val) {
 }
 
 RetType TelemetryViewer::get_uint(measurement_info_t* meas, unsigned int* val) {
-    MsgLogger logger("TelemetryViewer", "get");
-
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to locate latest data for measurement");
         return FAILURE;
     }
 
     if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
         logger.log_message("failed to convert measurement to uint");
         return FAILURE;
     }
@@ -359,6 +450,172 @@ RetType TelemetryViewer::get_uint(measurement_info_t* meas, unsigned int* val) {
     return SUCCESS;
 }
 
+RetType TelemetryViewer::get_int64(measurement_info_t* meas, int64_t* val) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to convert measurement to int64");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_uint64(measurement_info_t* meas, uint64_t* val) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_to(vcm, meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to convert measurement to uint64");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, uint32_t* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, int32_t* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, uint64_t* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, int64_t* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, float* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_array(measurement_info_t* meas, double* val, size_t max) {
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_array(meas, data, val, max) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get_array");
+        logger.log_message("failed to convert array measurement");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_value(measurement_info_t* meas, double* val) {
+    if(meas->cal_input) {
+        // already evaluated when the packet updated
+        size_t index;
+        if(latest_location(meas, &index) == SUCCESS) {
+            uint32_t packet = meas->locations[index].packet_index;
+
+            if(calibrated[packet] != NULL) {
+                *val = calibrated[packet][meas->cal_index[index]];
+                return SUCCESS;
+            }
+        }
+    }
+
+    uint8_t* data;
+    if(latest_data(meas, &data) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to locate latest data for measurement");
+        return FAILURE;
+    }
+
+    if(convert_value(meas, data, val) == FAILURE) {
+        MsgLogger logger("TelemetryViewer", "get");
+        logger.log_message("failed to convert measurement to value");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
 RetType TelemetryViewer::get_raw(measurement_info_t* meas, uint8_t* buffer) {
     uint8_t* data;
     if(latest_data(meas, &data) == FAILURE) {
@@ -445,6 +702,42 @@ RetType TelemetryViewer::get_uint(std::string& meas, unsigned int* val) {
     return get_uint(m_info, val);
 }
 
+RetType TelemetryViewer::get_int64(std::string& meas, int64_t* val) {
+    MsgLogger logger("TelemetryViewer", "get");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_int64(m_info, val);
+}
+
+RetType TelemetryViewer::get_uint64(std::string& meas, uint64_t* val) {
+    MsgLogger logger("TelemetryViewer", "get");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_uint64(m_info, val);
+}
+
+RetType TelemetryViewer::get_value(std::string& meas, double* val) {
+    MsgLogger logger("TelemetryViewer", "get");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_value(m_info, val);
+}
+
 RetType TelemetryViewer::get_raw(std::string& meas, uint8_t* buffer) {
     MsgLogger logger("TelemetryViewer", "get_raw");
 
@@ -456,3 +749,147 @@ RetType TelemetryViewer::get_raw(std::string& meas, uint8_t* buffer) {
 
     return get_raw(m_info, buffer);
 }
+
+RetType TelemetryViewer::open_history() {
+    MsgLogger logger("TelemetryViewer", "open_history");
+
+    if(history != NULL) {
+        return SUCCESS;
+    }
+
+    HistoryShm* h = new HistoryShm();
+
+    if(SUCCESS != h->init(vcm)) {
+        logger.log_message("failed to initialize history shared memory");
+        delete h;
+        return FAILURE;
+    }
+
+    if(SUCCESS != h->open()) {
+        logger.log_message("failed to attach to history shared memory");
+        delete h;
+        return FAILURE;
+    }
+
+    history = h;
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_history_range(measurement_info_t* meas, uint64_t t0, uint64_t t1,
+                                           std::vector<uint64_t>* times, std::vector<double>* values) {
+    if(SUCCESS != open_history()) {
+        return FAILURE;
+    }
+
+    return history->read(meas, t0, t1, times, values);
+}
+
+RetType TelemetryViewer::get_history_last(measurement_info_t* meas, double seconds,
+                                          std::vector<uint64_t>* times, std::vector<double>* values) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t t1 = ((uint64_t)now.tv_sec * 1000000) + now.tv_usec;
+    uint64_t span = (uint64_t)(seconds * 1000000.0);
+    uint64_t t0 = (span > t1) ? 0 : t1 - span;
+
+    return get_history_range(meas, t0, t1, times, values);
+}
+
+RetType TelemetryViewer::get_history_range(std::string& meas, uint64_t t0, uint64_t t1,
+                                           std::vector<uint64_t>* times, std::vector<double>* values) {
+    MsgLogger logger("TelemetryViewer", "get_history_range");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_history_range(m_info, t0, t1, times, values);
+}
+
+RetType TelemetryViewer::get_history_last(std::string& meas, double seconds,
+                                          std::vector<uint64_t>* times, std::vector<double>* values) {
+    MsgLogger logger("TelemetryViewer", "get_history_last");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_history_last(m_info, seconds, times, values);
+}
+
+RetType TelemetryViewer::open_envelope() {
+    MsgLogger logger("TelemetryViewer", "open_envelope");
+
+    if(envelope != NULL) {
+        return SUCCESS;
+    }
+
+    EnvelopeShm* e = new EnvelopeShm();
+
+    if(SUCCESS != e->init(vcm)) {
+        logger.log_message("failed to initialize envelope shared memory");
+        delete e;
+        return FAILURE;
+    }
+
+    if(SUCCESS != e->open()) {
+        logger.log_message("failed to attach to envelope shared memory");
+        delete e;
+        return FAILURE;
+    }
+
+    envelope = e;
+    return SUCCESS;
+}
+
+RetType TelemetryViewer::get_envelope_range(measurement_info_t* meas, uint32_t period, uint64_t t0, uint64_t t1,
+                                            std::vector<envelope_t>* out) {
+    if(SUCCESS != open_envelope()) {
+        return FAILURE;
+    }
+
+    return envelope->read(meas, period, t0, t1, out);
+}
+
+RetType TelemetryViewer::get_envelope_last(measurement_info_t* meas, uint32_t period, double seconds,
+                                           std::vector<envelope_t>* out) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t t1 = ((uint64_t)now.tv_sec * 1000000) + now.tv_usec;
+    uint64_t span = (uint64_t)(seconds * 1000000.0);
+    uint64_t t0 = (span > t1) ? 0 : t1 - span;
+
+    return get_envelope_range(meas, period, t0, t1, out);
+}
+
+RetType TelemetryViewer::get_envelope_range(std::string& meas, uint32_t period, uint64_t t0, uint64_t t1,
+                                            std::vector<envelope_t>* out) {
+    MsgLogger logger("TelemetryViewer", "get_envelope_range");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_envelope_range(m_info, period, t0, t1, out);
+}
+
+RetType TelemetryViewer::get_envelope_last(std::string& meas, uint32_t period, double seconds,
+                                           std::vector<envelope_t>* out) {
+    MsgLogger logger("TelemetryViewer", "get_envelope_last");
+
+    measurement_info_t* m_info = vcm->get_info(meas);
+    if(m_info == NULL) {
+        logger.log_message("Measurement not found: " + meas);
+        return FAILURE;
+    }
+
+    return get_envelope_last(m_info, period, seconds, out);
+}
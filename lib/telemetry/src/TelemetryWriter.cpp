@@ -130,9 +130,11 @@ RetType TelemetryWriter::init(VCM* vcm, TelemetryShm* shm) {
 // basically memcpy with endianness checking
 void TelemetryWriter::telemetry_copy(measurement_info_t* meas, uint8_t* dst, const uint8_t* src, size_t len) {
     if(vcm->sys_endianness != meas->endianness) {
-        // copy backwards
-        for(size_t i = 0; i < len; i++) {
-            dst[len - i - 1] = src[i];
+        // copy each element backwards
+        for(size_t e = 0; e < len; e += meas->size) {
+            for(size_t i = 0; i < meas->size; i++) {
+                dst[e + meas->size - i - 1] = src[e + i];
+            }
         }
     } else {
         for(size_t i = 0; i < len; i++) {
@@ -142,9 +144,23 @@ void TelemetryWriter::telemetry_copy(measurement_info_t* meas, uint8_t* dst, con
 }
 
 RetType TelemetryWriter::write(measurement_info_t* meas, uint8_t* data, size_t len) {
-    if(len != meas->size) {
+    if(meas->bit_width) {
+        MsgLogger logger("TelemetryWriter", "write");
+        logger.log_message("can't write a bitfield, write its parent");
+
+        return FAILURE;
+    }
+
+    if(meas->cal_input) {
+        MsgLogger logger("TelemetryWriter", "write");
+        logger.log_message("can't write a calibrated measurement, write its input");
+
+        return FAILURE;
+    }
+
+    if(len != meas->size * meas->count) {
         MsgLogger logger("TelemetryWriter", "write");
-        logger.log_message("must write size of measurement");
+        logger.log_message("must write size of measurement (every element of arrays)");
 
         return FAILURE;
     }
@@ -178,7 +194,21 @@ RetType TelemetryWriter::write(std::string& meas, uint8_t* data, size_t len) {
 }
 
 RetType TelemetryWriter::write_raw(measurement_info_t* meas, uint8_t* data, size_t len) {
-    if(len > meas->size) {
+    if(meas->bit_width) {
+        MsgLogger logger("TelemetryWriter", "write_raw");
+        logger.log_message("can't write a bitfield, write its parent");
+
+        return FAILURE;
+    }
+
+    if(meas->cal_input) {
+        MsgLogger logger("TelemetryWriter", "write_raw");
+        logger.log_message("can't write a calibrated measurement, write its input");
+
+        return FAILURE;
+    }
+
+    if(len > meas->size * meas->count) {
         MsgLogger logger("TelemetryWriter", "write_raw");
         logger.log_message("must write less than size of measurement");
 
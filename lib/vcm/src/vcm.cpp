@@ -1,4 +1,8 @@
 #include "lib/vcm/vcm.h"
+#include "lib/vcm/image.h"
+#include "lib/convert/decode.h"
+#include "lib/convert/calibrate.h"
+#include "lib/dev/crc/crc.h"
 #include "lib/dls/dls.h"
 #include "common/types.h"
 #include <string>
@@ -7,8 +11,14 @@
 #include <exception>
 #include <unordered_map>
 #include <unordered_set>
+#include <algorithm>
 #include <endian.h>
 #include <arpa/inet.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace dls;
 using namespace vcm;
@@ -20,11 +30,18 @@ VCM::VCM() {
     port = 0; // treat zero as an invalid port
     protocol = PROTOCOL_NOT_SET;
     multicast_addr = 0; // treat address of zero as invalid
+    frame_id_size = 1;
+    frame_id_endianness = GSW_LITTLE_ENDIAN;
     num_packets = 0;
     device = "";
     trigger_file = "";
     const_file = "";
+    history_file = "";
+    schedule_file = "";
     num_net_devices = 0;
+    f = NULL;
+    image = NULL;
+    image_size = 0;
 
     if(__BYTE_ORDER == __BIG_ENDIAN) {
         sys_endianness = GSW_BIG_ENDIAN;
@@ -52,14 +69,30 @@ VCM::VCM(std::string config_file) {
 
     this->config_file = config_file;
 
+    // files referenced by the config file are relative to its directory
+    size_t slash = config_file.rfind('/');
+    if(slash == std::string::npos) {
+        config_dir = ".";
+    } else {
+        config_dir = config_file.substr(0, slash);
+    }
+
     // default values
     port = 0; // treat zero as an invalid port
     protocol = PROTOCOL_NOT_SET;
     multicast_addr = 0; // treat address of zero as invalid
+    frame_id_size = 1;
+    frame_id_endianness = GSW_LITTLE_ENDIAN;
     num_packets = 0;
     device = "";
     trigger_file = "";
     const_file = "";
+    history_file = "";
+    schedule_file = "";
+    num_net_devices = 0;
+    f = NULL;
+    image = NULL;
+    image_size = 0;
 
     if(__BYTE_ORDER == __BIG_ENDIAN) {
         sys_endianness = GSW_BIG_ENDIAN;
@@ -72,9 +105,13 @@ VCM::VCM(std::string config_file) {
 }
 
 VCM::~VCM() {
-    // free all pointers in addr_map
-    for(auto i : addr_map) {
-        delete i.second;
+    // free all measurements, parsed or loaded from an image
+    for(measurement_info_t* meas : meas_list) {
+        if(meas->calibration) {
+            delete meas->calibration;
+        }
+
+        delete meas;
     }
 
     // free all pointers in packets
@@ -111,9 +148,47 @@ VCM::~VCM() {
 
         delete f;
     }
+
+    if(image) {
+        munmap(image, image_size);
+    }
+}
+
+measurement_info_t* VCM::get_info(uint32_t id) {
+    if(id >= meas_list.size()) {
+        return NULL;
+    }
+
+    return meas_list[id];
 }
 
 measurement_info_t* VCM::get_info(std::string& measurement) {
+    if(image) {
+        // look it up in the image's index
+        const image::header_t* header = (const image::header_t*)image;
+        const char* strings = (const char*)(image + header->strings.offset);
+        const image::measurement_t* table = (const image::measurement_t*)(image + header->measurements.offset);
+        const uint32_t* index = (const uint32_t*)(image + header->index.offset);
+        const uint32_t mask = header->index.count - 1;
+
+        uint32_t slot = image::hash(measurement.c_str(), measurement.size()) & mask;
+        for(uint32_t probe = 0; probe < header->index.count; probe++) {
+            uint32_t entry = index[slot];
+
+            if(entry == 0) {
+                break;
+            }
+
+            if(!strcmp(strings + table[entry - 1].name, measurement.c_str())) {
+                return meas_list[entry - 1];
+            }
+
+            slot = (slot + 1) & mask;
+        }
+
+        return NULL;
+    }
+
     if(addr_map.count(measurement)) {
         return addr_map.at(measurement);
     } else {
@@ -137,9 +212,63 @@ net_info_t* VCM::get_auto_net(uint16_t port) {
     }
 }
 
+// parse the rest of 'ss' as a list of numbers into 'out'
+// returns FAILURE if any token isn't a number
+static RetType parse_numbers(std::istringstream& ss, std::vector<double>* out) {
+    for(std::string tok; ss >> tok; ) {
+        try {
+            size_t end;
+            out->push_back(std::stod(tok, &end));
+
+            if(end != tok.size()) {
+                return FAILURE;
+            }
+        } catch(std::exception& e) {
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+// true if 'line' starts a packet received over something other than UDP
+// 'tcp [port] {', 'unix [path] {' or 'can [interface] [id] {'
+static bool transport_packet(const std::string& fst, const std::string& snd, const std::string& line) {
+    if(fst != "tcp" && fst != "unix" && fst != "can") {
+        return false;
+    }
+
+    // a measurement that happens to have one of those names
+    if(snd == "cal" || snd == "bits") {
+        return false;
+    }
+
+    size_t end = line.find_last_not_of(" \t\r");
+    return end != std::string::npos && line[end] == '{';
+}
+
 RetType VCM::init() {
     MsgLogger logger("VCM", "init");
 
+    // use the compiled image if it's at least as new as the config file
+    std::string image_file = config_file + image::VCM_IMAGE_SUFFIX;
+    struct stat config_stat;
+    struct stat image_stat;
+
+    if(stat(config_file.c_str(), &config_stat) == 0 && stat(image_file.c_str(), &image_stat) == 0) {
+        bool stale = (image_stat.st_mtim.tv_sec < config_stat.st_mtim.tv_sec) ||
+                     (image_stat.st_mtim.tv_sec == config_stat.st_mtim.tv_sec &&
+                      image_stat.st_mtim.tv_nsec < config_stat.st_mtim.tv_nsec);
+
+        if(stale) {
+            logger.log_message("Compiled image is older than config file, parsing config file: " + config_file);
+        } else if(SUCCESS == load_image(image_file)) {
+            return SUCCESS;
+        } else {
+            logger.log_message("Failed to load compiled image, parsing config file: " + config_file);
+        }
+    }
+
     f = new std::ifstream(config_file.c_str());
     if(!f) {
         logger.log_message("Failed to open config file: " + config_file);
@@ -154,9 +283,28 @@ RetType VCM::init() {
     // hash set to check uniqueness of telemetry packet ports
     std::unordered_set<uint16_t> port_set;
 
+    // ports with framed packets, and the frame ids used on each (port in the high bits)
+    std::unordered_set<uint16_t> framed_port_set;
+    std::unordered_set<uint64_t> frame_id_set;
+
+    // every port framed packets arrive on, by the first port they list
+    std::unordered_map<uint16_t, std::vector<uint16_t>> framed_links;
+
+    // Unix socket paths and CAN interface ids ('[interface] [id]') packets are received on
+    std::unordered_set<std::string> endpoint_set;
+
     // unique_id for net devices
     uint32_t net_id = 0;
 
+    // number of workers for each port, packets get theirs once every packet is parsed
+    std::unordered_map<uint16_t, uint32_t> workers;
+
+    // bitfields and their parents, bitfields get their parent's locations once every packet is parsed
+    std::vector<std::pair<measurement_info_t*, measurement_info_t*>> bitfields;
+
+    // calibrated measurements, in the order they were declared
+    std::vector<measurement_info_t*> calibrated;
+
     // read the config file
     for(std::string line; std::getline(*f, line); ) {
         if(line == "" || !line.rfind("#", 0)) { // blank or comment '#'
@@ -174,7 +322,64 @@ RetType VCM::init() {
         std::string third;
         ss >> third;
 
-        if(fst == "net") {
+        if(fst == "workers") {
+            // workers [port] [number]
+            uint16_t worker_port;
+            uint32_t num;
+            try {
+                worker_port = std::stoi(snd, NULL, 10);
+                num = std::stoi(third, NULL, 10);
+            } catch(std::invalid_argument& ia) {
+                logger.log_message("Invalid workers line: " + line);
+                return FAILURE;
+            }
+
+            if(num == 0 || num > MAX_PORT_WORKERS) {
+                logger.log_message("Ports can have 1 to " + std::to_string(MAX_PORT_WORKERS) + " workers: " + line);
+                return FAILURE;
+            }
+
+            workers[worker_port] = num;
+        } else if(fst == "relay") {
+            // relay [address] [optional port offset]
+            relay_info_t relay;
+            relay.port_offset = 0;
+
+            if(inet_pton(AF_INET, snd.c_str(), &relay.addr) != 1) {
+                logger.log_message("Invalid relay address: " + line);
+                return FAILURE;
+            }
+
+            if(third != "") {
+                int offset;
+                try {
+                    offset = std::stoi(third, NULL, 10);
+                } catch(std::exception& e) {
+                    logger.log_message("Invalid relay port offset: " + line);
+                    return FAILURE;
+                }
+
+                if(offset < 0 || offset > 65535) {
+                    logger.log_message("Relay port offsets are 0 to 65535: " + line);
+                    return FAILURE;
+                }
+
+                relay.port_offset = offset;
+            }
+
+            // we'd receive everything we relay
+            if((ntohl(relay.addr) >> 24) == 127 && relay.port_offset == 0) {
+                logger.log_message("Relaying to this machine needs a port offset: " + line);
+                return FAILURE;
+            }
+
+            if(relays.size() >= MAX_RELAYS) {
+                logger.log_message("No more than " + std::to_string(MAX_RELAYS) + " relays: " + line);
+                return FAILURE;
+            }
+
+            relays.push_back(relay);
+        } else if(fst == "net") {
             // new net device
             std::string fourth;
             ss >> fourth;
@@ -270,46 +475,249 @@ RetType VCM::init() {
                     logger.log_message("Unrecogonized protocol on line: " + line);
                     return FAILURE;
                 }
+            } else if(fst == "frame_id") {
+                // frame_id = [size in bytes] [optional endianness, big or little (default)]
+                std::string fourth;
+                ss >> fourth;
+
+                if(third == "1" || third == "2" || third == "4") {
+                    frame_id_size = std::stoi(third, NULL, 10);
+                } else {
+                    logger.log_message("Frame ids must be 1, 2 or 4 bytes: " + line);
+                    return FAILURE;
+                }
+
+                if(fourth == "big") {
+                    frame_id_endianness = GSW_BIG_ENDIAN;
+                } else if(fourth == "little" || fourth == "") {
+                    frame_id_endianness = GSW_LITTLE_ENDIAN;
+                } else {
+                    logger.log_message("Invalid frame id endianness: " + line);
+                    return FAILURE;
+                }
             } else if(fst == "name") {
                 device = third;
             } else if(fst == "triggers") {
                 trigger_file = config_dir + "/" + third;
             } else if(fst == "constants") {
                 const_file = config_dir + "/" + third;
+            } else if(fst == "history") {
+                history_file = config_dir + "/" + third;
+            } else if(fst == "schedule") {
+                schedule_file = config_dir + "/" + third;
             } else {
                 logger.log_message("Invalid line: " + line);
                 return FAILURE;
             }
-        } else if(snd == "{") { // start of a telemetry packet
+        } else if(snd == "{" || snd == "frame" || snd == "delta" || transport_packet(fst, snd, line)) {
+            // start of a telemetry packet
+            // [port] {
+            // [port] frame [id] {
+            // [port] delta {
+            // tcp [port] {
+            // unix [path] {
+            // can [interface] [id] {
+            // virtual {
             packet_info_t* packet = new packet_info_t;
             packet->size = 0;
+            packet->framed = false;
+            packet->frame_id = 0;
+            packet->delta = false;
+            packet->sequence = NULL;
+            packet->sequence_offset = 0;
+            packet->crc = NULL;
+            packet->crc_offset = 0;
+            packet->workers = 1;
+            packet->transport = TRANSPORT_UDP;
+            packet->can_id = 0;
+
+            if(snd == "frame") {
+                std::string fourth;
+                ss >> fourth;
+
+                if(fst == "virtual" || fourth != "{") {
+                    logger.log_message("Invalid framed packet: " + line);
+                    return FAILURE;
+                }
+
+                try {
+                    packet->frame_id = std::stoul(third, NULL, 10);
+                } catch(std::invalid_argument& ia) {
+                    logger.log_message("Invalid frame id in line: " + line);
+                    return FAILURE;
+                }
+
+                packet->framed = true;
+            } else if(snd == "delta") {
+                // a delta is against the last packet from the same link, the links couldn't be merged
+                if(fst == "virtual" || third != "{" || fst.find(',') != std::string::npos) {
+                    logger.log_message("Invalid delta encoded packet: " + line);
+                    return FAILURE;
+                }
+
+                packet->delta = true;
+            }
 
-            if(fst == "virtual") {
+            if(transport_packet(fst, snd, line)) {
+                packet->port = 0;
+                packet->is_virtual = false;
+
+                if(fst == "tcp") {
+                    if(third != "{") {
+                        logger.log_message("Invalid TCP packet: " + line);
+                        return FAILURE;
+                    }
+
+                    try {
+                        packet->port = std::stoi(snd, NULL, 10);
+                    } catch(std::exception& e) {
+                        logger.log_message("Invalid port in line: " + line);
+                        return FAILURE;
+                    }
+
+                    // TCP and UDP ports are separate, but everything else goes by port number
+                    if(port_set.count(packet->port) || framed_port_set.count(packet->port)) {
+                        logger.log_message("Telemetry packets must have unique port numbers");
+                        return FAILURE;
+                    }
+
+                    port_set.insert(packet->port);
+                    packet->ports.push_back(packet->port);
+                    packet->transport = TRANSPORT_TCP;
+                } else if(fst == "unix") {
+                    if(third != "{") {
+                        logger.log_message("Invalid Unix socket packet: " + line);
+                        return FAILURE;
+                    }
+
+                    packet->endpoint = snd;
+                    packet->transport = TRANSPORT_UNIX;
+                } else {
+                    std::string fourth;
+                    ss >> fourth;
+
+                    if(fourth != "{") {
+                        logger.log_message("Invalid CAN packet: " + line);
+                        return FAILURE;
+                    }
+
+                    unsigned long id;
+                    try {
+                        id = std::stoul(third, NULL, 0); // hex with '0x'
+                    } catch(std::exception& e) {
+                        logger.log_message("Invalid CAN id in line: " + line);
+                        return FAILURE;
+                    }
+
+                    if(id > MAX_CAN_ID) {
+                        logger.log_message("CAN ids are 0 to " + std::to_string(MAX_CAN_ID) + ": " + line);
+                        return FAILURE;
+                    }
+
+                    packet->endpoint = snd;
+                    packet->can_id = id;
+                    packet->transport = TRANSPORT_CAN;
+                }
+
+                std::string key = packet->endpoint;
+                if(packet->transport == TRANSPORT_CAN) {
+                    key += " " + std::to_string(packet->can_id);
+                }
+
+                if(packet->transport != TRANSPORT_TCP) {
+                    if(endpoint_set.count(key)) {
+                        logger.log_message("Another packet is already received on " + key);
+                        return FAILURE;
+                    }
+
+                    endpoint_set.insert(key);
+                }
+            } else if(fst == "virtual") {
                 packet->port = 0;
                 packet->is_virtual = true;
             } else {
                 packet->is_virtual = false;
 
-                // get the network port for this packet
-                // this is the port the packet is sent TO
-                try {
-                    packet->port = std::stoi(fst, NULL, 10);
-                } catch(std::invalid_argument& ia) {
-                    logger.log_message("Invalid port in line: " + line);
-                    return FAILURE;
+                // get the network ports for this packet, one for each link it's sent over (comma separated)
+                // these are the ports the packet is sent TO, the first is the packet's 'port'
+                std::istringstream ports(fst);
+                for(std::string p; std::getline(ports, p, ','); ) {
+                    uint16_t link_port;
+                    try {
+                        link_port = std::stoi(p, NULL, 10);
+                    } catch(std::invalid_argument& ia) {
+                        logger.log_message("Invalid port in line: " + line);
+                        return FAILURE;
+                    }
+
+                    if(std::find(packet->ports.begin(), packet->ports.end(), link_port) != packet->ports.end()) {
+                        logger.log_message("Packet lists a port more than once: " + line);
+                        return FAILURE;
+                    }
+
+                    packet->ports.push_back(link_port);
                 }
 
-                if(port_set.find(packet->port) != port_set.end()) {
-                    logger.log_message("Telemetry packets must have unique port numbers");
+                if(packet->ports.size() == 0 || packet->ports.size() > MAX_PACKET_PORTS) {
+                    logger.log_message("Packets can have 1 to " + std::to_string(MAX_PACKET_PORTS) + " ports: " + line);
                     return FAILURE;
                 }
 
-                port_set.insert(packet->port);
+                packet->port = packet->ports[0];
+
+                for(uint16_t link_port : packet->ports) {
+                    if(port_set.find(link_port) != port_set.end()) {
+                        logger.log_message("Telemetry packets must have unique port numbers");
+                        return FAILURE;
+                    }
+                }
+
+                if(packet->framed) {
+                    // any number of framed packets can share a port, as long as their ids are different
+                    // NOTE: frame ids are checked against 'frame_id_size' once the whole file is read
+                    uint64_t key = ((uint64_t)packet->port << 32) | packet->frame_id;
+
+                    if(frame_id_set.count(key)) {
+                        logger.log_message("Framed packets on the same port must have unique frame ids: " + line);
+                        return FAILURE;
+                    }
+
+                    // every framed packet on a port arrives over the same links
+                    auto it = framed_links.find(packet->port);
+                    if(it != framed_links.end()) {
+                        if(it->second != packet->ports) {
+                            logger.log_message("Framed packets on the same port must list the same ports: " + line);
+                            return FAILURE;
+                        }
+                    } else {
+                        for(uint16_t link_port : packet->ports) {
+                            if(framed_port_set.count(link_port)) {
+                                logger.log_message("Port is already used by other framed packets: " + line);
+                                return FAILURE;
+                            }
+
+                            framed_port_set.insert(link_port);
+                        }
+
+                        framed_links[packet->port] = packet->ports;
+                    }
+
+                    frame_id_set.insert(key);
+                } else {
+                    for(uint16_t link_port : packet->ports) {
+                        if(framed_port_set.count(link_port)) {
+                            logger.log_message("Framed and unframed packets can't share a port: " + line);
+                            return FAILURE;
+                        }
+
+                        port_set.insert(link_port);
+                    }
+                }
             }
 
             bool done = false;
             // we don't allow comments or empty lines after starting a packet
-            // BUT we don't check for anything following a measurement name, we only look at the first token
+            // BUT we don't check for anything following a measurement name, other than 'sequence' or 'crc'
             for(std::string line; std::getline(*f,line); ) {
                 if(line == "" || !line.rfind("#",0)) { // blank or comment '#'
                     continue;
@@ -331,14 +739,66 @@ RetType VCM::init() {
                         return FAILURE;
                     }
 
+                    if(meas->bit_width) {
+                        logger.log_message("Bitfield " + token + " can't be placed in a packet, place its parent instead");
+                        return FAILURE;
+                    }
+
+                    if(meas->cal_input) {
+                        logger.log_message("Calibrated measurement " + token + " can't be placed in a packet, place its input instead");
+                        return FAILURE;
+                    }
+
+                    // [measurement] sequence
+                    // marks the packet's sequence number, an unsigned integer counting up by one each packet
+                    std::string mark;
+                    ss >> mark;
+                    if(mark == "sequence") {
+                        if(packet->sequence) {
+                            logger.log_message("Packet already has a sequence number: " + line);
+                            return FAILURE;
+                        }
+
+                        if(meas->type != INT_TYPE || meas->sign != UNSIGNED_TYPE || meas->count != 1 || meas->size > sizeof(uint64_t)) {
+                            logger.log_message("Sequence number " + token + " must be a single unsigned integer");
+                            return FAILURE;
+                        }
+
+                        packet->sequence = meas;
+                        packet->sequence_offset = packet->size;
+                    }
+
+                    // [measurement] crc
+                    // marks the packet's CRC32C, a 4 byte unsigned integer over every other byte in the packet
+                    if(mark == "crc") {
+                        if(packet->crc) {
+                            logger.log_message("Packet already has a CRC: " + line);
+                            return FAILURE;
+                        }
+
+                        if(meas->type != INT_TYPE || meas->sign != UNSIGNED_TYPE || meas->count != 1 || meas->size != CRC32C_SIZE) {
+                            logger.log_message("CRC " + token + " must be a single 4 byte unsigned integer");
+                            return FAILURE;
+                        }
+
+                        packet->crc = meas;
+                        packet->crc_offset = packet->size;
+                    }
+
                     location_info_t loc;
                     loc.offset = packet->size;
                     loc.packet_index = num_packets;
                     meas->locations.push_back(loc); // copy struct in, less memory to track and it's small
-                    packet->size += meas->size;
+                    packet->size += meas->size * meas->count;
                 }
             }
 
+            if(done && packet->transport == TRANSPORT_CAN && packet->size > MAX_CAN_PACKET_SIZE) {
+                logger.log_message("CAN packets can't be bigger than " + std::to_string(MAX_CAN_PACKET_SIZE) +
+                                   " bytes, a CAN FD frame: " + line);
+                return FAILURE;
+            }
+
             if(done) {
                 packets.push_back(packet);
                 num_packets++;
@@ -346,19 +806,277 @@ RetType VCM::init() {
                 logger.log_message("Reached end of file before end of packet");
                 return FAILURE;
             }
+        } else if(snd == "bits") { // bitfield of another measurement
+            // [name] bits [low]..[high] of [parent] [optional signed or unsigned, default is unsigned]
+            std::string fourth;
+            ss >> fourth;
+            std::string fifth;
+            ss >> fifth;
+            std::string sixth;
+            ss >> sixth;
+
+            size_t dots = third.find("..");
+            if(fst == "" || dots == std::string::npos || fourth != "of" || fifth == "") {
+                logger.log_message("Invalid bitfield: " + line);
+                return FAILURE;
+            }
+
+            int low;
+            int high;
+            try {
+                low = std::stoi(third.substr(0, dots), NULL, 10);
+                high = std::stoi(third.substr(dots + 2), NULL, 10);
+            } catch(std::invalid_argument& ia) {
+                logger.log_message("Invalid bit range: " + line);
+                return FAILURE;
+            }
+
+            if(!addr_map.count(fifth)) {
+                logger.log_message("Bitfield parent " + fifth + " does not exist");
+                return FAILURE;
+            }
+
+            measurement_info_t* parent = addr_map.at(fifth);
+            if(parent->type != INT_TYPE || parent->bit_width || parent->size > sizeof(uint64_t) || parent->count != 1) {
+                logger.log_message("Bitfield parent must be an integer no larger than 8 bytes: " + line);
+                return FAILURE;
+            }
+
+            if(low < 0 || high < low || (size_t)high >= parent->size * 8) {
+                logger.log_message("Bit range out of bounds of parent: " + line);
+                return FAILURE;
+            }
+
+            measurement_info_t* entry = new measurement_info_t;
+            entry->size = parent->size;
+            entry->endianness = parent->endianness;
+            entry->type = INT_TYPE;
+            entry->count = 1;
+            entry->sample_rate = 0;
+            entry->bit_offset = low;
+            entry->bit_width = high - low + 1;
+            entry->bit_mask = (entry->bit_width == 64) ? ~0ULL : ((1ULL << entry->bit_width) - 1);
+
+            if(sixth == "signed") {
+                entry->sign = SIGNED_TYPE;
+            } else if(sixth == "unsigned" || sixth == "") {
+                // default is unsigned, most bitfields are flags
+                entry->sign = UNSIGNED_TYPE;
+            } else {
+                logger.log_message("Invalid token: " + sixth);
+                return FAILURE;
+            }
+
+            entry->cal_input = NULL;
+            entry->calibration = NULL;
+
+            convert::compile_decoders(entry);
+
+            bitfields.push_back(std::make_pair(entry, parent));
+
+            addr_map[fst] = entry;
+            measurements.push_back(fst);
+            meas_list.push_back(entry);
+        } else if(snd == "cal") { // calibrated value of another measurement
+            // [name] cal [input] linear [scale] [offset]
+            // [name] cal [input] poly [c0] [c1] ... [cN]
+            // [name] cal [input] piecewise {
+            // [low] [high] [c0] [c1] ... [cN]
+            // }
+            // [name] cal [input] table {
+            // [x] [y]
+            // }
+            std::string fourth;
+            ss >> fourth;
+
+            if(fst == "" || third == "" || fourth == "") {
+                logger.log_message("Invalid calibration: " + line);
+                return FAILURE;
+            }
+
+            if(!addr_map.count(third)) {
+                logger.log_message("Calibration input " + third + " does not exist");
+                return FAILURE;
+            }
+
+            measurement_info_t* input = addr_map.at(third);
+            if(input->decode_value == NULL || input->count != 1) {
+                logger.log_message("Calibration input must be a single numeric measurement: " + line);
+                return FAILURE;
+            }
+
+            calibration_t* cal = new calibration_t;
+
+            if(fourth == "linear" || fourth == "poly") {
+                cal->kind = CAL_POLY;
+
+                std::vector<double> nums;
+                if(SUCCESS != parse_numbers(ss, &nums) || nums.size() == 0) {
+                    logger.log_message("Invalid calibration coefficients: " + line);
+                    return FAILURE;
+                }
+
+                if(fourth == "linear") {
+                    // scale and offset, stored as a first order polynomial
+                    if(nums.size() != 2) {
+                        logger.log_message("Linear calibrations need a scale and an offset: " + line);
+                        return FAILURE;
+                    }
+
+                    cal->coeffs.push_back(nums[1]);
+                    cal->coeffs.push_back(nums[0]);
+                } else {
+                    cal->coeffs = nums;
+                }
+            } else if(fourth == "piecewise" || fourth == "table") {
+                std::string brace;
+                ss >> brace;
+
+                if(brace != "{") {
+                    logger.log_message("Expected '{' after calibration type: " + line);
+                    return FAILURE;
+                }
+
+                cal->kind = (fourth == "piecewise") ? CAL_PIECEWISE : CAL_TABLE;
+
+                bool done = false;
+                for(std::string row; std::getline(*f, row); ) {
+                    if(row == "" || !row.rfind("#", 0)) { // blank or comment '#'
+                        continue;
+                    }
+
+                    std::istringstream rs(row);
+                    std::string first;
+                    rs >> first;
+
+                    if(first == "}") {
+                        done = true;
+                        break;
+                    }
+
+                    std::istringstream ns(row);
+                    std::vector<double> nums;
+                    if(SUCCESS != parse_numbers(ns, &nums)) {
+                        logger.log_message("Invalid calibration row: " + row);
+                        return FAILURE;
+                    }
+
+                    if(cal->kind == CAL_PIECEWISE) {
+                        if(nums.size() < 3 || nums[1] < nums[0]) {
+                            logger.log_message("Piecewise rows need a low, a high and coefficients: " + row);
+                            return FAILURE;
+                        }
+
+                        calibration_range_t range;
+                        range.low = nums[0];
+                        range.high = nums[1];
+                        range.coeffs.assign(nums.begin() + 2, nums.end());
+                        cal->ranges.push_back(range);
+                    } else {
+                        if(nums.size() != 2 || (cal->x.size() && nums[0] <= cal->x.back())) {
+                            logger.log_message("Table rows need an x and a y, with x ascending: " + row);
+                            return FAILURE;
+                        }
+
+                        cal->x.push_back(nums[0]);
+                        cal->y.push_back(nums[1]);
+                    }
+                }
+
+                if(!done) {
+                    logger.log_message("Reached end of file before end of calibration");
+                    return FAILURE;
+                }
+
+                if(cal->ranges.size() == 0 && cal->x.size() == 0) {
+                    logger.log_message("Empty calibration: " + line);
+                    return FAILURE;
+                }
+            } else {
+                logger.log_message("Invalid calibration type: " + fourth);
+                return FAILURE;
+            }
+
+            measurement_info_t* entry = new measurement_info_t;
+            entry->size = input->size;
+            entry->endianness = input->endianness;
+            entry->type = FLOAT_TYPE;
+            entry->sign = SIGNED_TYPE;
+            entry->count = 1;
+            entry->sample_rate = 0;
+            entry->bit_offset = 0;
+            entry->bit_width = 0;
+            entry->bit_mask = 0;
+            entry->cal_input = input;
+            entry->calibration = cal;
+
+            convert::compile_calibration(entry);
+
+            calibrated.push_back(entry);
+
+            addr_map[fst] = entry;
+            measurements.push_back(fst);
+            meas_list.push_back(entry);
         } else { // measurement definition
             std::string fourth;
             ss >> fourth;
             std::string fifth;
             ss >> fifth;
+            std::string sixth;
+            ss >> sixth;
 
             if(fst == "" || snd == "") {
                 logger.log_message("Missing information: " + line);
                 return FAILURE;
             }
 
+            // arrays end with '[count]' or '[count@sample rate in Hz]'
+            std::string array_tok = "";
+            if(!third.rfind("[", 0)) {
+                array_tok = third;
+                third = "";
+            } else if(!fourth.rfind("[", 0)) {
+                array_tok = fourth;
+                fourth = "";
+            } else if(!fifth.rfind("[", 0)) {
+                array_tok = fifth;
+                fifth = "";
+            } else if(!sixth.rfind("[", 0)) {
+                array_tok = sixth;
+            }
+
             measurement_info_t* entry = new measurement_info_t;
 
+            entry->count = 1;
+            entry->sample_rate = 0;
+
+            if(array_tok != "") {
+                size_t end = array_tok.find(']');
+                size_t at = array_tok.find('@');
+
+                if(end == std::string::npos) {
+                    logger.log_message("Invalid array: " + line);
+                    return FAILURE;
+                }
+
+                try {
+                    if(at == std::string::npos) {
+                        entry->count = std::stoi(array_tok.substr(1, end - 1), NULL, 10);
+                    } else {
+                        entry->count = std::stoi(array_tok.substr(1, at - 1), NULL, 10);
+                        entry->sample_rate = std::stod(array_tok.substr(at + 1, end - at - 1));
+                    }
+                } catch(std::invalid_argument& ia) {
+                    logger.log_message("Invalid array: " + line);
+                    return FAILURE;
+                }
+
+                if(entry->count == 0 || entry->sample_rate < 0) {
+                    logger.log_message("Invalid array: " + line);
+                    return FAILURE;
+                }
+            }
+
             try {
                 entry->size = (size_t)(std::stoi(snd, NULL, 10));
             } catch(std::invalid_argument& ia) {
@@ -366,9 +1084,25 @@ RetType VCM::init() {
                 return FAILURE;
             }
 
+            entry->bit_offset = 0;
+            entry->bit_width = 0;
+            entry->bit_mask = 0;
+
+            // 64 bit integer types also set the sign
+            bool sign_set = false;
+
             // check for type (optional, default is undefined)
             if(third == "int") {
                 entry->type = INT_TYPE;
+            } else if(third == "int64" || third == "uint64") {
+                if(entry->size != sizeof(uint64_t)) {
+                    logger.log_message("64 bit integer measurements must be 8 bytes: " + line);
+                    return FAILURE;
+                }
+
+                entry->type = INT_TYPE;
+                entry->sign = (third == "int64") ? SIGNED_TYPE : UNSIGNED_TYPE;
+                sign_set = true;
             } else if(third == "float") {
                 entry->type = FLOAT_TYPE;
             } else if(third == "string") {
@@ -412,25 +1146,44 @@ RetType VCM::init() {
                 tok = fourth;
             }
 
-            if(tok == "unsigned") {
+            if(sign_set && ((tok == "unsigned" && entry->sign != UNSIGNED_TYPE) ||
+                            (tok == "signed" && entry->sign != SIGNED_TYPE))) {
+                logger.log_message("Sign does not match type: " + line);
+                return FAILURE;
+            } else if(tok == "unsigned") {
                 entry->sign = UNSIGNED_TYPE;
             } else if(tok == "signed") {
                 entry->sign = SIGNED_TYPE;
             } else if(tok == "") {
                 // default is signed
-                entry->sign = SIGNED_TYPE;
+                if(!sign_set) {
+                    entry->sign = SIGNED_TYPE;
+                }
             } else {
                 logger.log_message("Invalid token: " + tok);
                 return FAILURE;
             }
 
+            entry->cal_input = NULL;
+            entry->calibration = NULL;
+
+            convert::compile_decoders(entry);
+
             addr_map[fst] = entry;
             measurements.push_back(fst);
+            meas_list.push_back(entry);
         }
     }
 
     f->close();
 
+    // bitfields live wherever their parent does
+    for(auto& field : bitfields) {
+        field.first->locations = field.second->locations;
+    }
+
+    link_calibrations(calibrated);
+
     // check for unset mandatory configuration items
     if(protocol == PROTOCOL_NOT_SET) {
         logger.log_message("Config file missing protocol: " + config_file);
@@ -443,6 +1196,45 @@ RetType VCM::init() {
     //     return FAILURE;
     // }
 
+    for(auto& w : workers) {
+        bool found = false;
+
+        for(packet_info_t* packet : packets) {
+            if(std::find(packet->ports.begin(), packet->ports.end(), w.first) == packet->ports.end()) {
+                continue;
+            }
+
+            // each worker has its own socket in the port's reuseport group
+            if(packet->transport != TRANSPORT_UDP && w.second > 1) {
+                logger.log_message("Only UDP ports can have workers, port " + std::to_string(w.first));
+                return FAILURE;
+            }
+
+            // copies from each link have to meet in one process to be merged
+            if(packet->ports.size() > 1 && w.second > 1) {
+                logger.log_message("Packets on more than one port can't have workers, port " + std::to_string(w.first));
+                return FAILURE;
+            }
+
+            packet->workers = w.second;
+            found = true;
+        }
+
+        if(!found) {
+            logger.log_message("No telemetry packet on port " + std::to_string(w.first) + " to give workers");
+            return FAILURE;
+        }
+    }
+
+    // frame ids have to fit in the frame header
+    for(packet_info_t* packet : packets) {
+        if(packet->framed && frame_id_size < sizeof(uint32_t) && (packet->frame_id >> (8 * frame_id_size)) != 0) {
+            logger.log_message("Frame id " + std::to_string(packet->frame_id) + " doesn't fit in " +
+                               std::to_string(frame_id_size) + " byte frame ids");
+            return FAILURE;
+        }
+    }
+
     return SUCCESS;
 }
 
@@ -494,3 +1286,652 @@ std::string* VCM::get_const(std::string& name) {
         return NULL;
     }
 }
+
+bool VCM::from_image() {
+    return image != NULL;
+}
+
+void VCM::link_calibrations(std::vector<measurement_info_t*>& calibrated) {
+    // calibrated measurements live wherever their input does
+    // inputs are declared first, so inputs that are bitfields or calibrated already have their locations
+    for(measurement_info_t* meas : calibrated) {
+        meas->locations = meas->cal_input->locations;
+
+        for(location_info_t& loc : meas->locations) {
+            packets[loc.packet_index]->calibrated.push_back(meas);
+        }
+    }
+
+    // order each packet's calibrations so polynomials of the same degree are next to each other
+    for(packet_info_t* packet : packets) {
+        std::stable_sort(packet->calibrated.begin(), packet->calibrated.end(),
+            [](measurement_info_t* a, measurement_info_t* b) {
+                if(a->calibration->kind != b->calibration->kind) {
+                    return a->calibration->kind < b->calibration->kind;
+                }
+
+                return convert::calibrate::degree(a->calibration) < convert::calibrate::degree(b->calibration);
+            });
+    }
+
+    for(measurement_info_t* meas : calibrated) {
+        meas->cal_index.clear();
+
+        for(location_info_t& loc : meas->locations) {
+            std::vector<measurement_info_t*>& list = packets[loc.packet_index]->calibrated;
+            meas->cal_index.push_back(std::find(list.begin(), list.end(), meas) - list.begin());
+        }
+    }
+}
+
+// add 'str' to the string table 'strings', returns its offset
+static uint32_t add_string(std::vector<char>& strings, const std::string& str) {
+    uint32_t offset = strings.size();
+    strings.insert(strings.end(), str.begin(), str.end());
+    strings.push_back('\0');
+    return offset;
+}
+
+// 'file' relative to 'dir' (the way it's written in the config file)
+static std::string relative_to(const std::string& file, const std::string& dir) {
+    std::string prefix = dir + "/";
+
+    if(!file.rfind(prefix, 0)) {
+        return file.substr(prefix.size());
+    }
+
+    return file;
+}
+
+// append the raw bytes of 'table' to 'out', aligned to 8 bytes
+template<typename T>
+static image::table_t append_table(std::vector<uint8_t>& out, const T* data, size_t count, size_t bytes) {
+    out.resize((out.size() + 7) & ~(size_t)7, 0);
+
+    image::table_t table;
+    table.offset = out.size();
+    table.count = count;
+    table.pad = 0;
+
+    const uint8_t* raw = (const uint8_t*)data;
+    out.insert(out.end(), raw, raw + bytes);
+
+    return table;
+}
+
+RetType VCM::compile(std::string& image_file) {
+    MsgLogger logger("VCM", "compile");
+
+    std::vector<char> strings;
+    std::vector<image::measurement_t> meas_table;
+    std::vector<image::location_t> loc_table;
+    std::vector<image::packet_t> packet_table;
+    std::vector<uint16_t> port_table;
+    std::vector<image::net_t> net_table;
+    std::vector<image::relay_t> relay_table;
+    std::vector<image::calibration_t> cal_table;
+    std::vector<image::range_t> range_table;
+    std::vector<double> numbers;
+
+    // offset zero is the empty string, used for anything that isn't set
+    strings.push_back('\0');
+
+    std::unordered_map<measurement_info_t*, uint32_t> meas_index;
+    for(size_t i = 0; i < measurements.size(); i++) {
+        meas_index[get_info(measurements[i])] = i;
+    }
+
+    for(std::string& name : measurements) {
+        measurement_info_t* meas = get_info(name);
+
+        image::measurement_t m;
+        memset(&m, 0, sizeof(m));
+
+        m.name = add_string(strings, name);
+        m.size = meas->size;
+        m.count = meas->count;
+        m.endianness = meas->endianness;
+        m.type = meas->type;
+        m.sign = meas->sign;
+        m.bit_offset = meas->bit_offset;
+        m.bit_width = meas->bit_width;
+        m.bit_mask = meas->bit_mask;
+        m.sample_rate = meas->sample_rate;
+
+        m.first_location = loc_table.size();
+        m.num_locations = meas->locations.size();
+        for(location_info_t& loc : meas->locations) {
+            image::location_t l;
+            l.offset = loc.offset;
+            l.packet_index = loc.packet_index;
+            l.pad = 0;
+            loc_table.push_back(l);
+        }
+
+        if(meas->cal_input) {
+            calibration_t* cal = meas->calibration;
+
+            m.cal_input = meas_index[meas->cal_input] + 1;
+            m.calibration = cal_table.size();
+
+            image::calibration_t c;
+            c.kind = cal->kind;
+            c.first = numbers.size();
+            c.pad = 0;
+
+            switch(cal->kind) {
+                case CAL_POLY:
+                    c.num = cal->coeffs.size();
+                    numbers.insert(numbers.end(), cal->coeffs.begin(), cal->coeffs.end());
+                    break;
+                case CAL_PIECEWISE:
+                    c.first = range_table.size();
+                    c.num = cal->ranges.size();
+                    for(calibration_range_t& range : cal->ranges) {
+                        image::range_t r;
+                        r.low = range.low;
+                        r.high = range.high;
+                        r.first = numbers.size();
+                        r.num = range.coeffs.size();
+                        numbers.insert(numbers.end(), range.coeffs.begin(), range.coeffs.end());
+                        range_table.push_back(r);
+                    }
+                    break;
+                case CAL_TABLE:
+                    c.num = cal->x.size();
+                    numbers.insert(numbers.end(), cal->x.begin(), cal->x.end());
+                    numbers.insert(numbers.end(), cal->y.begin(), cal->y.end());
+                    break;
+            }
+
+            cal_table.push_back(c);
+        }
+
+        meas_table.push_back(m);
+    }
+
+    for(packet_info_t* packet : packets) {
+        image::packet_t p;
+        memset(&p, 0, sizeof(p));
+        p.size = packet->size;
+        p.timeout = packet->timeout;
+        p.port = packet->port;
+        p.is_virtual = packet->is_virtual;
+        p.framed = packet->framed;
+        p.frame_id = packet->frame_id;
+        p.delta = packet->delta;
+        p.transport = packet->transport;
+        p.can_id = packet->can_id;
+        if(packet->endpoint != "") {
+            p.endpoint = add_string(strings, packet->endpoint);
+        }
+        if(packet->sequence) {
+            p.sequence = meas_index[packet->sequence] + 1;
+        }
+        if(packet->crc) {
+            p.crc = meas_index[packet->crc] + 1;
+        }
+        p.workers = packet->workers;
+        p.first_port = port_table.size();
+        p.num_ports = packet->ports.size();
+        port_table.insert(port_table.end(), packet->ports.begin(), packet->ports.end());
+        packet_table.push_back(p);
+    }
+
+    for(std::string& name : net_devices) {
+        net_info_t* info = get_net(name);
+
+        if(info->mode != ADDR_AUTO) {
+            logger.log_message("only automatic network devices can be compiled: " + name);
+            return FAILURE;
+        }
+
+        image::net_t n;
+        n.name = add_string(strings, name);
+        n.port = *((uint16_t*)info->addr_info);
+        n.pad = 0;
+        net_table.push_back(n);
+    }
+
+    for(relay_info_t& relay : relays) {
+        image::relay_t r;
+        r.addr = relay.addr;
+        r.port_offset = relay.port_offset;
+        r.pad = 0;
+        relay_table.push_back(r);
+    }
+
+    // index with at least twice as many slots as measurements
+    uint32_t slots = 16;
+    while(slots < 2 * measurements.size()) {
+        slots <<= 1;
+    }
+
+    std::vector<uint32_t> index(slots, 0);
+    for(size_t i = 0; i < measurements.size(); i++) {
+        uint32_t slot = image::hash(measurements[i].c_str(), measurements[i].size()) & (slots - 1);
+
+        while(index[slot]) {
+            slot = (slot + 1) & (slots - 1);
+        }
+
+        index[slot] = i + 1;
+    }
+
+    image::header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = image::VCM_IMAGE_MAGIC;
+    header.version = image::VCM_IMAGE_VERSION;
+    header.multicast_addr = multicast_addr;
+    header.port = port;
+    header.protocol = protocol;
+    header.frame_id_size = frame_id_size;
+    header.frame_id_endianness = frame_id_endianness;
+
+    if(device != "") {
+        header.device = add_string(strings, device);
+    }
+    if(trigger_file != "") {
+        header.trigger_file = add_string(strings, relative_to(trigger_file, config_dir));
+    }
+    if(const_file != "") {
+        header.const_file = add_string(strings, relative_to(const_file, config_dir));
+    }
+    if(history_file != "") {
+        header.history_file = add_string(strings, relative_to(history_file, config_dir));
+    }
+    if(schedule_file != "") {
+        header.schedule_file = add_string(strings, relative_to(schedule_file, config_dir));
+    }
+
+    // lay it out
+    std::vector<uint8_t> out(sizeof(header), 0);
+
+    header.strings = append_table(out, strings.data(), strings.size(), strings.size());
+    header.measurements = append_table(out, meas_table.data(), meas_table.size(), meas_table.size() * sizeof(image::measurement_t));
+    header.locations = append_table(out, loc_table.data(), loc_table.size(), loc_table.size() * sizeof(image::location_t));
+    header.packets = append_table(out, packet_table.data(), packet_table.size(), packet_table.size() * sizeof(image::packet_t));
+    header.ports = append_table(out, port_table.data(), port_table.size(), port_table.size() * sizeof(uint16_t));
+    header.nets = append_table(out, net_table.data(), net_table.size(), net_table.size() * sizeof(image::net_t));
+    header.relays = append_table(out, relay_table.data(), relay_table.size(), relay_table.size() * sizeof(image::relay_t));
+    header.calibrations = append_table(out, cal_table.data(), cal_table.size(), cal_table.size() * sizeof(image::calibration_t));
+    header.ranges = append_table(out, range_table.data(), range_table.size(), range_table.size() * sizeof(image::range_t));
+    header.numbers = append_table(out, numbers.data(), numbers.size(), numbers.size() * sizeof(double));
+    header.index = append_table(out, index.data(), index.size(), index.size() * sizeof(uint32_t));
+
+    header.size = out.size();
+    memcpy(out.data(), &header, sizeof(header));
+
+    // write to a temporary file and move it into place so nobody ever maps half an image
+    std::string tmp_file = image_file + ".tmp";
+
+    std::ofstream of(tmp_file.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if(!of.is_open()) {
+        logger.log_message("failed to open image file: " + tmp_file);
+        return FAILURE;
+    }
+
+    of.write((const char*)out.data(), out.size());
+    of.close();
+
+    if(!of) {
+        logger.log_message("failed to write image file: " + tmp_file);
+        unlink(tmp_file.c_str());
+        return FAILURE;
+    }
+
+    if(rename(tmp_file.c_str(), image_file.c_str()) != 0) {
+        logger.log_message("failed to move image into place: " + image_file);
+        unlink(tmp_file.c_str());
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+RetType VCM::load_image(std::string& image_file) {
+    MsgLogger logger("VCM", "load_image");
+
+    int fd = open(image_file.c_str(), O_RDONLY);
+    if(fd == -1) {
+        logger.log_message("failed to open image: " + image_file);
+        return FAILURE;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(image::header_t)) {
+        logger.log_message("image too small: " + image_file);
+        close(fd);
+        return FAILURE;
+    }
+
+    size_t size = st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED) {
+        logger.log_message("failed to map image: " + image_file);
+        return FAILURE;
+    }
+
+    const uint8_t* base = (const uint8_t*)map;
+    const image::header_t* header = (const image::header_t*)base;
+
+    // check everything before building anything
+    auto table_ok = [&](const image::table_t& t, size_t entry_size) {
+        return t.offset <= size && (t.offset % 8) == 0 && (size - t.offset) / entry_size >= t.count;
+    };
+
+    bool valid = header->magic == image::VCM_IMAGE_MAGIC &&
+                 header->version == image::VCM_IMAGE_VERSION &&
+                 header->size == size &&
+                 table_ok(header->strings, 1) && header->strings.count > 0 &&
+                 table_ok(header->measurements, sizeof(image::measurement_t)) &&
+                 table_ok(header->locations, sizeof(image::location_t)) &&
+                 table_ok(header->packets, sizeof(image::packet_t)) &&
+                 table_ok(header->ports, sizeof(uint16_t)) &&
+                 table_ok(header->nets, sizeof(image::net_t)) &&
+                 table_ok(header->relays, sizeof(image::relay_t)) && header->relays.count <= MAX_RELAYS &&
+                 table_ok(header->calibrations, sizeof(image::calibration_t)) &&
+                 table_ok(header->ranges, sizeof(image::range_t)) &&
+                 table_ok(header->numbers, sizeof(double)) &&
+                 table_ok(header->index, sizeof(uint32_t)) &&
+                 header->index.count > 0 && (header->index.count & (header->index.count - 1)) == 0;
+
+    const char* strings = (const char*)(base + header->strings.offset);
+    const image::measurement_t* meas_table = (const image::measurement_t*)(base + header->measurements.offset);
+    const image::location_t* loc_table = (const image::location_t*)(base + header->locations.offset);
+    const image::packet_t* packet_table = (const image::packet_t*)(base + header->packets.offset);
+    const uint16_t* port_table = (const uint16_t*)(base + header->ports.offset);
+    const image::net_t* net_table = (const image::net_t*)(base + header->nets.offset);
+    const image::relay_t* relay_table = (const image::relay_t*)(base + header->relays.offset);
+    const image::calibration_t* cal_table = (const image::calibration_t*)(base + header->calibrations.offset);
+    const image::range_t* range_table = (const image::range_t*)(base + header->ranges.offset);
+    const double* numbers = (const double*)(base + header->numbers.offset);
+    const uint32_t* index = (const uint32_t*)(base + header->index.offset);
+
+    const uint32_t num_strings = header->strings.count;
+    const uint32_t num_meas = header->measurements.count;
+    const uint32_t num_numbers = header->numbers.count;
+
+    auto numbers_ok = [&](uint32_t first, uint32_t num) {
+        return first <= num_numbers && num <= num_numbers - first;
+    };
+
+    // the string table ends with a NUL, so every offset into it is a terminated string
+    valid = valid && strings[num_strings - 1] == '\0' &&
+            header->device < num_strings && header->trigger_file < num_strings &&
+            header->const_file < num_strings && header->history_file < num_strings &&
+            header->schedule_file < num_strings;
+
+    for(uint32_t i = 0; valid && i < num_meas; i++) {
+        const image::measurement_t& m = meas_table[i];
+
+        valid = m.name < num_strings &&
+                m.first_location <= header->locations.count &&
+                m.num_locations <= header->locations.count - m.first_location &&
+                m.cal_input <= i; // inputs are declared first
+
+        for(uint32_t l = 0; valid && l < m.num_locations; l++) {
+            valid = loc_table[m.first_location + l].packet_index < header->packets.count;
+        }
+
+        if(valid && m.cal_input) {
+            valid = m.calibration < header->calibrations.count;
+
+            if(valid) {
+                const image::calibration_t& c = cal_table[m.calibration];
+
+                switch(c.kind) {
+                    case CAL_POLY:
+                        valid = numbers_ok(c.first, c.num);
+                        break;
+                    case CAL_PIECEWISE:
+                        valid = c.first <= header->ranges.count && c.num <= header->ranges.count - c.first;
+                        for(uint32_t r = 0; valid && r < c.num; r++) {
+                            valid = numbers_ok(range_table[c.first + r].first, range_table[c.first + r].num);
+                        }
+                        break;
+                    case CAL_TABLE:
+                        valid = c.num > 0 && numbers_ok(c.first, 2 * c.num);
+                        break;
+                    default:
+                        valid = false;
+                }
+            }
+        }
+    }
+
+    for(uint32_t i = 0; valid && i < header->packets.count; i++) {
+        valid = packet_table[i].workers >= 1 && packet_table[i].workers <= MAX_PORT_WORKERS &&
+                packet_table[i].num_ports <= MAX_PACKET_PORTS &&
+                packet_table[i].first_port <= header->ports.count &&
+                packet_table[i].num_ports <= header->ports.count - packet_table[i].first_port &&
+                packet_table[i].sequence <= num_meas && packet_table[i].crc <= num_meas &&
+                packet_table[i].transport <= TRANSPORT_CAN && packet_table[i].endpoint < num_strings;
+    }
+
+    for(uint32_t i = 0; valid && i < header->nets.count; i++) {
+        valid = net_table[i].name < num_strings;
+    }
+
+    for(uint32_t i = 0; valid && i < header->index.count; i++) {
+        valid = index[i] <= num_meas;
+    }
+
+    if(!valid) {
+        logger.log_message("invalid or incompatible image: " + image_file);
+        munmap(map, size);
+        return FAILURE;
+    }
+
+    // build everything out of the image
+    image = (uint8_t*)map;
+    image_size = size;
+
+    multicast_addr = header->multicast_addr;
+    port = header->port;
+    protocol = (protocol_t)header->protocol;
+    frame_id_size = header->frame_id_size;
+    frame_id_endianness = (endianness_t)header->frame_id_endianness;
+    device = strings + header->device;
+
+    if(header->trigger_file) {
+        trigger_file = config_dir + "/" + (strings + header->trigger_file);
+    }
+    if(header->const_file) {
+        const_file = config_dir + "/" + (strings + header->const_file);
+    }
+    if(header->history_file) {
+        history_file = config_dir + "/" + (strings + header->history_file);
+    }
+    if(header->schedule_file) {
+        schedule_file = config_dir + "/" + (strings + header->schedule_file);
+    }
+
+    for(uint32_t i = 0; i < header->packets.count; i++) {
+        packet_info_t* packet = new packet_info_t;
+        packet->size = packet_table[i].size;
+        packet->timeout = packet_table[i].timeout;
+        packet->port = packet_table[i].port;
+        packet->is_virtual = packet_table[i].is_virtual;
+        packet->framed = packet_table[i].framed;
+        packet->frame_id = packet_table[i].frame_id;
+        packet->delta = packet_table[i].delta;
+        packet->transport = (transport_t)packet_table[i].transport;
+        if(packet->transport == TRANSPORT_UNIX || packet->transport == TRANSPORT_CAN) {
+            packet->endpoint = strings + packet_table[i].endpoint;
+        }
+        packet->can_id = packet_table[i].can_id;
+        packet->sequence = NULL;
+        packet->sequence_offset = 0;
+        packet->crc = NULL;
+        packet->crc_offset = 0;
+        packet->workers = packet_table[i].workers;
+        packet->ports.assign(port_table + packet_table[i].first_port,
+                             port_table + packet_table[i].first_port + packet_table[i].num_ports);
+        packets.push_back(packet);
+    }
+    num_packets = packets.size();
+
+    std::vector<measurement_info_t*> calibrated;
+
+    for(uint32_t i = 0; i < num_meas; i++) {
+        const image::measurement_t& m = meas_table[i];
+
+        measurement_info_t* entry = new measurement_info_t;
+        entry->size = m.size;
+        entry->endianness = (endianness_t)m.endianness;
+        entry->type = (measurement_type_t)m.type;
+        entry->sign = (measurement_sign_t)m.sign;
+        entry->count = m.count;
+        entry->sample_rate = m.sample_rate;
+        entry->bit_offset = m.bit_offset;
+        entry->bit_width = m.bit_width;
+        entry->bit_mask = m.bit_mask;
+        entry->cal_input = NULL;
+        entry->calibration = NULL;
+
+        for(uint32_t l = 0; l < m.num_locations; l++) {
+            location_info_t loc;
+            loc.offset = loc_table[m.first_location + l].offset;
+            loc.packet_index = loc_table[m.first_location + l].packet_index;
+            entry->locations.push_back(loc);
+        }
+
+        if(m.cal_input) {
+            const image::calibration_t& c = cal_table[m.calibration];
+            calibration_t* cal = new calibration_t;
+            cal->kind = (calibration_kind_t)c.kind;
+
+            switch(cal->kind) {
+                case CAL_POLY:
+                    cal->coeffs.assign(numbers + c.first, numbers + c.first + c.num);
+                    break;
+                case CAL_PIECEWISE:
+                    for(uint32_t r = 0; r < c.num; r++) {
+                        const image::range_t& ir = range_table[c.first + r];
+
+                        calibration_range_t range;
+                        range.low = ir.low;
+                        range.high = ir.high;
+                        range.coeffs.assign(numbers + ir.first, numbers + ir.first + ir.num);
+                        cal->ranges.push_back(range);
+                    }
+                    break;
+                case CAL_TABLE:
+                    cal->x.assign(numbers + c.first, numbers + c.first + c.num);
+                    cal->y.assign(numbers + c.first + c.num, numbers + c.first + (2 * c.num));
+                    break;
+            }
+
+            entry->cal_input = meas_list[m.cal_input - 1];
+            entry->calibration = cal;
+
+            convert::compile_calibration(entry);
+            calibrated.push_back(entry);
+        } else {
+            convert::compile_decoders(entry);
+        }
+
+        meas_list.push_back(entry);
+        measurements.push_back(strings + m.name);
+    }
+
+    link_calibrations(calibrated);
+
+    // sequence numbers and CRCs are found by their location in the packet
+    for(uint32_t i = 0; i < header->packets.count; i++) {
+        if(packet_table[i].sequence) {
+            measurement_info_t* meas = meas_list[packet_table[i].sequence - 1];
+            for(location_info_t& loc : meas->locations) {
+                if(loc.packet_index == i) {
+                    packets[i]->sequence = meas;
+                    packets[i]->sequence_offset = loc.offset;
+                    break;
+                }
+            }
+        }
+
+        if(packet_table[i].crc) {
+            measurement_info_t* meas = meas_list[packet_table[i].crc - 1];
+            for(location_info_t& loc : meas->locations) {
+                if(loc.packet_index == i) {
+                    packets[i]->crc = meas;
+                    packets[i]->crc_offset = loc.offset;
+                    break;
+                }
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < header->nets.count; i++) {
+        net_info_t* info = new net_info_t;
+        info->mode = ADDR_AUTO;
+        info->unique_id = i;
+        info->addr_info = (void*)(new uint16_t(net_table[i].port));
+
+        std::string name = strings + net_table[i].name;
+        auto_port_map[net_table[i].port] = info;
+        net_map[name] = info;
+        net_devices.push_back(name);
+    }
+    num_net_devices = net_devices.size();
+
+    for(uint32_t i = 0; i < header->relays.count; i++) {
+        relay_info_t relay;
+        relay.addr = relay_table[i].addr;
+        relay.port_offset = relay_table[i].port_offset;
+        relays.push_back(relay);
+    }
+
+    return SUCCESS;
+}
+
+// FNV-1a over 'size' bytes of 'data'
+static void hash_bytes(uint64_t* h, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for(size_t i = 0; i < size; i++) {
+        *h ^= bytes[i];
+        *h *= 1099511628211ULL;
+    }
+}
+
+uint64_t VCM::packet_layout(uint32_t packet_index) {
+    uint64_t h = 14695981039346656037ULL;
+
+    if(packet_index >= num_packets) {
+        return 0;
+    }
+
+    packet_info_t* packet = packets[packet_index];
+
+    uint64_t size = packet->size;
+    uint8_t is_virtual = packet->is_virtual;
+    hash_bytes(&h, &size, sizeof(size));
+    hash_bytes(&h, &packet->port, sizeof(packet->port));
+    hash_bytes(&h, &is_virtual, sizeof(is_virtual));
+
+    for(std::string& name : measurements) {
+        measurement_info_t* meas = get_info(name);
+
+        if(meas->bit_width || meas->cal_input) {
+            continue;
+        }
+
+        for(location_info_t& loc : meas->locations) {
+            if(loc.packet_index != packet_index) {
+                continue;
+            }
+
+            uint64_t fields[] = {loc.offset, meas->size, meas->count, (uint64_t)meas->type,
+                                 (uint64_t)meas->sign, (uint64_t)meas->endianness};
+
+            hash_bytes(&h, name.c_str(), name.size() + 1);
+            hash_bytes(&h, fields, sizeof(fields));
+        }
+    }
+
+    return h;
+}
@@ -0,0 +1,129 @@
+#include "lib/vcm/watch.h"
+#include "lib/dls/dls.h"
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+using namespace dls;
+using namespace vcm;
+
+// time the config directory has to be quiet before a change is reported (milliseconds)
+#define SETTLE_TIME 100
+
+
+ConfigWatcher::ConfigWatcher() {
+    fd = -1;
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    if(fd != -1) {
+        close(fd);
+    }
+}
+
+RetType ConfigWatcher::init(VCM* vcm) {
+    MsgLogger logger("ConfigWatcher", "init");
+
+    config_dir = vcm->config_dir;
+    config_file = vcm->config_file;
+    trigger_file = vcm->trigger_file;
+    const_file = vcm->const_file;
+    history_file = vcm->history_file;
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd == -1) {
+        logger.log_message("failed to initialize inotify");
+        return FAILURE;
+    }
+
+    if(inotify_add_watch(fd, config_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        logger.log_message("failed to watch config directory: " + config_dir);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+void ConfigWatcher::drain(uint32_t* changed) {
+    // big enough for several events with names
+    alignas(struct inotify_event) char buff[4096];
+
+    while(1) {
+        ssize_t n = read(fd, buff, sizeof(buff));
+        if(n <= 0) {
+            // EAGAIN, nothing left
+            return;
+        }
+
+        for(char* ptr = buff; ptr < buff + n; ) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if(event->len == 0) {
+                continue;
+            }
+
+            std::string path = config_dir + "/" + event->name;
+
+            if(path == config_file) {
+                *changed |= CONFIG_CHANGED;
+            } else if(path == trigger_file) {
+                *changed |= TRIGGERS_CHANGED;
+            } else if(path == const_file) {
+                *changed |= CONSTANTS_CHANGED;
+            } else if(path == history_file) {
+                *changed |= HISTORY_CHANGED;
+            }
+        }
+    }
+}
+
+RetType ConfigWatcher::poll(uint32_t* changed) {
+    *changed = 0;
+    drain(changed);
+
+    if(*changed == 0) {
+        return NOCHANGE;
+    }
+
+    // let the editor finish
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while(::poll(&pfd, 1, SETTLE_TIME) > 0) {
+        drain(changed);
+    }
+
+    return SUCCESS;
+}
+
+RetType ConfigWatcher::wait(uint32_t* changed, uint32_t timeout) {
+    *changed = 0;
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while(1) {
+        int ret = ::poll(&pfd, 1, (timeout == 0) ? -1 : (int)timeout);
+
+        if(ret == -1) {
+            if(errno == EINTR) {
+                return INTERRUPTED;
+            }
+
+            MsgLogger logger("ConfigWatcher", "wait");
+            logger.log_message("poll failed");
+            return FAILURE;
+        } else if(ret == 0) {
+            return TIMEOUT;
+        }
+
+        // something in the directory changed, but maybe not one of our files
+        if(SUCCESS == poll(changed)) {
+            return SUCCESS;
+        }
+    }
+}
@@ -1,15 +1,34 @@
 #include <stdio.h>
 #include "lib/nm/nm.h"
+#include "lib/nm/UringReceiver.h"
+#include "lib/nm/PacketRing.h"
+#include "lib/nm/PacketRelay.h"
+#include "lib/nm/TransportReceivers.h"
 #include "lib/shm/shm.h"
 #include "lib/dls/dls.h"
 #include "lib/vcm/vcm.h"
 #include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/IngestShm.h"
+#include "lib/telemetry/LinkMerger.h"
+#include "lib/sched/sched.h"
+#include "lib/dev/delta/delta.h"
+#include "lib/dev/crc/crc.h"
 #include "common/types.h"
 #include <csignal>
 #include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <poll.h>
 
 /*
 *   This executable runs the "decom master process"
@@ -18,11 +37,69 @@
 *   listens to the specified port of the telemetry packet and if it writes each
 *   packet it receives to that telemetry packet's block in shared memory.
 *
+*   Framed packets (declared as '[port] frame [id] {' in the VCM file) share a port,
+*   a single child process receives all of them and splits each datagram into its
+*   frames, writing every frame in the datagram to shared memory at once.
+*
+*   Sockets are read in batches (recvmmsg), taking every datagram that's queued
+*   up with one system call. Every packet in a batch is logged, but only the
+*   latest copy of each packet needs to be written to shared memory.
+*
+*   A busy port can be split between several child processes, its workers
+*   ('workers [port] [number]' in the VCM file). Each worker has its own socket
+*   on the port, and a steering program attached to the port's sockets sends
+*   every packet from a source to the same worker so each source stays in order.
+*   Workers of a port lock its packets to write them, a packet with a sequence
+*   number is only written over an older one, so shared memory never goes back
+*   to an older packet that another worker got to late. A run of late packets
+*   means the vehicle started its sequence over, and they're written again.
+*
+*   A packet sent over redundant links arrives on more than one port ('[port],[port] {'
+*   in the VCM file). Its child receives on every one of them and merges the copies,
+*   the first copy of each packet to arrive is logged and written, the copies from
+*   the other links are dropped (see lib/telemetry/LinkMerger.h).
+*
+*   A packet can also be sent over TCP ('tcp [port] {'), to a Unix domain socket
+*   ('unix [path] {') or over CAN ('can [interface] [id] {'), see
+*   lib/nm/TransportReceivers.h. These have a receiver of their own but are
+*   otherwise received like any other packet. Only UDP datagrams are relayed,
+*   and the io_uring and capture modes fall back to epoll if there are any.
+*
+*   Delta encoded packets ('[port] delta {' in the VCM file) arrive as keyframes
+*   and deltas against the last packet (see lib/dev/delta/delta.h). Each one is
+*   put back together before it's logged and written, if a datagram is lost the
+*   deltas after it are dropped until the next keyframe.
+*
 *   When the decom master process is killed, it kills each child process as well.
 *   If a child process dies unexpectedly, either due to error or being manually
 *   sent a kill signal, the master process will report it through the message log.
 *
-*   Run as: ./decom [config file path]
+*   When the config is reloaded (shmctl -reload) each child exits on its own, once
+*   they're all gone the master reads the new config and spawns a new set of children.
+*
+*   With '-single' there are no children, one process receives on every socket
+*   with epoll and writes whatever arrived in one pass to shared memory at once.
+*   This keeps the process count and memory the same however many packets the
+*   config has. On a config reload it re-executes itself with the new config.
+*
+*   '-uring' is the single process decom receiving through io_uring instead of
+*   epoll. Every socket has a receive request that stays armed and the kernel
+*   writes packets into buffers we gave it ahead of time, so receiving takes no
+*   system calls while packets keep coming. '-sqpoll' adds a kernel thread to take
+*   our submissions as well. On kernels without support (multishot receive needs
+*   6.0) it falls back to epoll.
+*
+*   '-capture [interface]' is the single process decom capturing straight off a
+*   network interface with a packet ring (AF_PACKET, TPACKET_V3) and a filter
+*   for the ports in the VCM file, skipping the socket layer. The sockets are
+*   still opened but never read. This needs CAP_NET_RAW, without it (or if the
+*   interface can't be captured from) it falls back to epoll.
+*
+*   Every mode keeps counters of how each packet is arriving (rates, size
+*   mismatches, kernel drops, queued bytes and sequence number gaps) in ingest
+*   shared memory, see lib/telemetry/IngestShm.h and app/ingest_view.
+*
+*   Run as: ./decom [-single | -uring | -sqpoll | -capture [interface]] [config file path]
 *   If no VCM config file path is specified, the default location is used
 */
 
@@ -35,17 +112,74 @@ using namespace shm;
 
 VCM* veh = NULL;
 
-NetworkReceiver* net = NULL;
+// a receiver for each port (link) of the packet a child receives
+std::vector<NetworkReceiver*> nets;
+IngestShm ingest;
+
+// merges the copies of packets that arrive over more than one link, NULL for packets with one port
+std::vector<LinkMerger*> mergers;
+
+// packets in a row of each packet this process didn't write because shared memory had a newer one
+std::vector<uint32_t> late_runs;
+
+// puts delta encoded packets back together, NULL for packets that aren't
+std::vector<delta_decoder_t*> decoders;
+
+// copies of the packets decoded from the current batch of datagrams, each decoder only has one packet
+// so anything taken from it has to be copied before the next datagram is decoded
+// the copies are reused from batch to batch, only the first 'num_decoded' are in use
+std::deque<std::vector<uint8_t>> decoded;
+size_t num_decoded = 0;
+
+// forwards every datagram received to the relay destinations in the config, NULL if there aren't any
+PacketRelay* relay = NULL;
 std::string decom_id = "DECOM[master]"; // id for each decom proc spawned
 
 bool child_proc = false;
 std::vector<pid_t> pids;
 
 bool ignore_kill = false;
+bool reloading = false;
 
 bool killed = false;
 int received_sig = 0;
 
+// exit status of a child that stopped because the config was reloaded
+#define RELOAD_EXIT 64
+
+// largest UDP datagram, the receive buffer size for framed packets
+#define MAX_DATAGRAM_SIZE 65536
+
+// most sockets (or io_uring completions) handled in one pass of the single process decom
+#define MAX_EVENTS 64
+
+// most packets received from a socket with one system call
+#define RX_BATCH 32
+
+// most datagrams (to any destination) queued to be relayed before they're sent
+#define RELAY_QUEUE 256
+
+// buffers the kernel can fill for each socket before the single process decom gets to them with io_uring
+#define URING_BUFFERS 64
+
+// packet ring used by the single process decom when capturing from an interface, 8MB
+#define RING_BLOCK_SIZE (1 << 18)
+#define RING_BLOCKS 32
+
+// longest a captured packet waits in a partly filled block of the packet ring (milliseconds)
+#define RING_BLOCK_TIMEOUT 2
+
+// how often the single process decom checks for a config reload if nothing is received (milliseconds)
+#define RELOAD_CHECK_TIME 1000
+
+// furthest behind shared memory a worker's packet can be and still be taken as late rather than the vehicle
+// starting its sequence over (capped at a quarter of the sequence number's range)
+#define REORDER_WINDOW 1024
+
+// late packets in a row after which the vehicle is taken to have started its sequence over, e.g. it restarted
+// before its sequence number got past the one in shared memory
+#define RESTART_RUN 16
+
 
 void sighandler(int signum) {
     MsgLogger logger(decom_id.c_str(), "sighandler");
@@ -81,87 +215,528 @@ void sighandler(int signum) {
     }
 }
 
-// clean up memory of a child
-void child_cleanup() {
-    MsgLogger logger(decom_id.c_str(), "child_cleanup");
+// free the link mergers and decoders
+void close_packets() {
+    for(LinkMerger* merger : mergers) {
+        if(merger) {
+            delete merger;
+        }
+    }
+    mergers.clear();
+    late_runs.clear();
 
-    logger.log_message("killed, cleaning up resources");
-    if(net) { // it's possible we get killed before we can create our network manager
+    for(delta_decoder_t* decoder : decoders) {
+        if(decoder) {
+            delete[] decoder->packet;
+            delete decoder;
+        }
+    }
+    decoders.clear();
+}
+
+// stop relaying
+void close_relay() {
+    if(relay) {
+        delete relay;
+        relay = NULL;
+    }
+}
+
+// close the receivers of a child and free the link mergers and decoders
+void close_links() {
+    for(NetworkReceiver* net : nets) {
         delete net; // this also calls close
     }
+    nets.clear();
+
+    close_packets();
+    close_relay();
 }
 
-// main logic for each sub process to run
-// only exit if something bad happens
-void execute(size_t packet_id, packet_info_t* packet) {
-    decom_id = "DECOM[" + std::to_string(packet_id) + "]";
+// clean up memory of a child
+void child_cleanup() {
+    MsgLogger logger(decom_id.c_str(), "child_cleanup");
 
-    // create message logger
-    MsgLogger logger(decom_id.c_str(), "execute");
+    logger.log_message("killed, cleaning up resources");
+    close_links(); // it's possible we get killed before we can create our receivers
+}
 
-    // set packet name to use for logging messages and network manager name
-    std::string packet_name = veh->device + "(" + std::to_string(packet_id) + ")";
+// create/init the network receiver for 'port' with 'batch_size' buffers of 'buffer_size' bytes
+// receives time out after 'rx_timeout' milliseconds, or block if it's 0
+// if the port has more than one worker, packets are steered between them by source
+// returns NULL on failure
+NetworkReceiver* open_receiver(uint16_t port, size_t buffer_size, size_t rx_timeout, size_t batch_size,
+                               uint32_t workers = 1) {
+    MsgLogger logger(decom_id.c_str(), "open_receiver");
 
-    // create/init the network receiver
     // NOTE: on linux kernel 4.15 (tested on) if in a recvfrom call (like in rx() function) the default action is SA_RESTART
     // this means if we catch signal while blocked in recvfrom, we'll never wake up
     // we can either use sigaction instead of signal, or just set a timeout so we wake up once in a while to check if we got a signal
-    // for now we just use a timeout, 1s is reasonable and doesn't kill our performance (hence the 1000ms timeout in NetworkReceiver init function)
-    if(veh->get_auto_net(packet->port)) {
-        AutoNetworkReceiver* n = new AutoNetworkReceiver();
+    // for now we just use a timeout, 1s is reasonable and doesn't kill our performance (hence the 1000ms timeout the children use)
+    // the single process decom doesn't block in recvfrom at all
+    NetworkReceiver* n;
+    if(veh->get_auto_net(port)) {
+        AutoNetworkReceiver* a = new AutoNetworkReceiver();
 
-        if(SUCCESS != n->init(veh, packet->port, veh->multicast_addr, 1000, packet->size)) {
+        if(SUCCESS != a->init(veh, port, veh->multicast_addr, rx_timeout, buffer_size, batch_size)) {
             logger.log_message("failed to initialize auto network receiver");
-            delete n;
-            return;
+            delete a;
+            return NULL;
         }
 
-        net = n;
+        n = a;
     } else {
-        net = new NetworkReceiver();
+        n = new NetworkReceiver();
 
-        if(SUCCESS != net->init(packet->port, veh->multicast_addr, 1000, packet->size)) {
+        if(SUCCESS != n->init(port, veh->multicast_addr, rx_timeout, buffer_size, batch_size)) {
             logger.log_message("failed to initialized network receiver");
-            delete net;
-            return;
+            delete n;
+            return NULL;
+        }
+    }
+
+    // without the steering program the kernel still keeps each source on one socket (by hashing its address
+    // and port), but which one changes as workers come and go
+    if(workers > 1 && SUCCESS != n->steer_by_source(workers)) {
+        logger.log_message("failed to steer packets between workers on port " + std::to_string(port) +
+                           ", leaving it to the kernel");
+    }
+
+    return n;
+}
+
+// links 'packet' arrives over, a Unix or CAN packet has one with no port
+size_t num_links(packet_info_t* packet) {
+    return packet->ports.size() > 0 ? packet->ports.size() : 1;
+}
+
+// create/init the receiver for 'link' of 'packet' over the packet's transport
+// 'buffer_size', 'rx_timeout', 'batch_size' and 'workers' are the same as for 'open_receiver'
+// returns NULL on failure
+NetworkReceiver* open_link(packet_info_t* packet, uint32_t link, size_t buffer_size, size_t rx_timeout,
+                           size_t batch_size, uint32_t workers = 1) {
+    MsgLogger logger(decom_id.c_str(), "open_link");
+
+    if(packet->transport == TRANSPORT_TCP) {
+        TcpReceiver* t = new TcpReceiver();
+        if(SUCCESS != t->init(packet->ports[link], rx_timeout, buffer_size, batch_size)) {
+            logger.log_message("failed to initialize TCP receiver on port " + std::to_string(packet->ports[link]));
+            delete t;
+            return NULL;
+        }
+
+        return t;
+    } else if(packet->transport == TRANSPORT_UNIX) {
+        UnixReceiver* u = new UnixReceiver();
+        if(SUCCESS != u->init(packet->endpoint, rx_timeout, buffer_size, batch_size)) {
+            logger.log_message("failed to initialize Unix socket receiver at " + packet->endpoint);
+            delete u;
+            return NULL;
+        }
+
+        return u;
+    } else if(packet->transport == TRANSPORT_CAN) {
+        // frames are always CAN FD sized, the packet is never bigger
+        CanReceiver* c = new CanReceiver();
+        if(SUCCESS != c->init(packet->endpoint, packet->can_id, rx_timeout, batch_size)) {
+            logger.log_message("failed to initialize CAN receiver on " + packet->endpoint);
+            delete c;
+            return NULL;
+        }
+
+        return c;
+    }
+
+    return open_receiver(packet->ports[link], buffer_size, rx_timeout, batch_size, workers);
+}
+
+// attach to the ingest counters, decom runs without them if they aren't there
+void open_ingest() {
+    if(ingest.init(veh) != SUCCESS || ingest.open() != SUCCESS) {
+        MsgLogger logger(decom_id.c_str(), "open_ingest");
+        logger.log_message("failed to attach to ingest shared memory, not keeping ingest counters");
+    }
+}
+
+// relay datagrams to the destinations in the config, decom runs without relaying if it can't
+void open_relay() {
+    if(veh->relays.size() == 0) {
+        return;
+    }
+
+    relay = new PacketRelay();
+    if(relay->init(veh->relays, RELAY_QUEUE) != SUCCESS) {
+        MsgLogger logger(decom_id.c_str(), "open_relay");
+        logger.log_message("failed to open relay socket, not relaying datagrams");
+        close_relay();
+    }
+}
+
+// queue an 'n' byte datagram at 'data' that arrived on 'port' to be relayed
+// only UDP datagrams are relayed, anything else has port 0
+static inline void relay_datagram(uint16_t port, const uint8_t* data, size_t n) {
+    if(relay && port != 0) {
+        relay->queue(port, data, n);
+    }
+}
+
+// send every queued datagram and count them, before the buffers they're in are used again
+void flush_relay() {
+    if(relay == NULL) {
+        return;
+    }
+
+    relay->flush();
+
+    for(uint32_t i = 0; i < relay->counts.size(); i++) {
+        relay_count_t* count = &relay->counts[i];
+        ingest.relayed(i, count->sent, count->bytes, count->dropped);
+    }
+    relay->clear_counts();
+}
+
+// make a link merger for every packet that arrives over more than one link and a decoder for every delta
+// encoded packet
+RetType open_packets() {
+    mergers.resize(veh->num_packets, NULL);
+    decoders.resize(veh->num_packets, NULL);
+    late_runs.assign(veh->num_packets, 0);
+
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        packet_info_t* packet = veh->packets[i];
+
+        if(packet->delta) {
+            decoders[i] = new delta_decoder_t;
+            delta_decoder_init(decoders[i], new uint8_t[packet->size], packet->size);
+        }
+
+        if(packet->ports.size() <= 1) {
+            continue;
+        }
+
+        mergers[i] = new LinkMerger();
+        if(mergers[i]->init(veh, i, &ingest) != SUCCESS) {
+            MsgLogger logger(decom_id.c_str(), "open_packets");
+            logger.log_message("failed to merge the links of packet " + std::to_string(i));
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+// size of the receive buffer for one datagram of 'packet'
+size_t datagram_size(packet_info_t* packet) {
+    return packet->delta ? DELTA_MAX_SIZE(packet->size) : packet->size;
+}
+
+// decode an 'n' byte datagram of delta encoded 'packet_id' at 'data'
+// returns a copy of the whole packet that lasts until the next batch (see 'decoded'), or NULL if the datagram
+// had to be dropped
+uint8_t* decode_packet(uint32_t packet_id, const uint8_t* data, size_t n) {
+    uint32_t missed;
+    delta_decoder_t* decoder = decoders[packet_id];
+    delta_ret_t ret = delta_decode(decoder, data, n, &missed);
+
+    ingest.delta(packet_id, missed, ret == DELTA_WAITING || ret == DELTA_OLD);
+
+    if(ret == DELTA_OK) {
+        if(num_decoded == decoded.size()) {
+            decoded.emplace_back();
+        }
+
+        std::vector<uint8_t>& copy = decoded[num_decoded++];
+        copy.assign(decoder->packet, decoder->packet + decoder->size);
+        return copy.data();
+    }
+
+    if(ret == DELTA_ERR) {
+        MsgLogger logger(decom_id.c_str(), "decode_packet");
+        logger.log_message("bad delta encoded datagram of packet " + std::to_string(packet_id) +
+                           ", waiting for a keyframe");
+        ingest.received(packet_id, 0, 0, 1);
+    } else if(ret == DELTA_WAITING && missed) { // only the first delta that can't be applied
+        MsgLogger logger(decom_id.c_str(), "decode_packet");
+        logger.log_message("lost " + std::to_string(missed) + " delta encoded datagrams of packet " +
+                           std::to_string(packet_id) + ", waiting for a keyframe");
+    }
+
+    return NULL;
+}
+
+// true if 'packet' at 'data' has no CRC or its CRC is correct
+bool check_crc(packet_info_t* packet, const uint8_t* data) {
+    if(packet->crc == NULL) {
+        return true;
+    }
+
+    uint32_t crc = packet->crc->decode_uint64(packet->crc, data + packet->crc_offset);
+    return crc == crc32c_packet(data, packet->size, packet->crc_offset);
+}
+
+// a correctly sized copy of 'packet_id' at 'data' arrived on 'link'
+// a copy that failed its CRC or already arrived on another link is dropped, anything else is logged and has its
+// sequence number counted, returns true if it should be written to shared memory
+bool take_copy(uint32_t packet_id, uint32_t link, uint8_t* data, PacketLogger* plogger) {
+    packet_info_t* packet = veh->packets[packet_id];
+
+    // checked before merging, so a corrupted copy doesn't drop a good one from another link
+    if(!check_crc(packet, data)) {
+        MsgLogger logger(decom_id.c_str(), "take_copy");
+        logger.log_message("CRC mismatch on packet " + std::to_string(packet_id) + " from link " +
+                           std::to_string(link));
+        ingest.bad_crc(packet_id);
+
+        // a delta applied to a bad packet is bad too
+        if(decoders[packet_id]) {
+            delta_desync(decoders[packet_id]);
+        }
+
+        // log the packet either way
+        plogger->log_packet((unsigned char*)data, packet->size);
+        return false;
+    }
+
+    LinkMerger::merge_t merged = LinkMerger::MERGE_NEW;
+    if(mergers[packet_id]) {
+        merged = mergers[packet_id]->merge(link, data);
+    }
+
+    if(merged == LinkMerger::MERGE_DUPLICATE) {
+        return false;
+    }
+
+    plogger->log_packet((unsigned char*)data, packet->size);
+    ingest.sequence(packet_id, data);
+
+    return merged == LinkMerger::MERGE_NEW;
+}
+
+// open a receiver for each link of 'packet' into 'nets'
+// with one it blocks for up to a second at a time, with more they're nonblocking and waited on together
+RetType open_links(packet_info_t* packet, size_t buffer_size, uint32_t workers) {
+    size_t links = num_links(packet);
+
+    for(uint32_t link = 0; link < links; link++) {
+        NetworkReceiver* net = open_link(packet, link, buffer_size, 1000, RX_BATCH, workers);
+        if(net == NULL) {
+            return FAILURE;
+        }
+
+        nets.push_back(net);
+
+        if(links > 1 && net->set_nonblocking() == FAILURE) {
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+// wait up to a second for any of 'nets' to have datagrams, setting 'ready' for each one that does
+// a single receiver waits in its own receive instead, so it's always ready
+void wait_links(std::vector<struct pollfd>& fds, std::vector<bool>& ready) {
+    if(nets.size() == 1) {
+        ready[0] = true;
+        return;
+    }
+
+    if(fds.size() != nets.size()) {
+        fds.resize(nets.size());
+        for(size_t i = 0; i < nets.size(); i++) {
+            fds[i].fd = nets[i]->get_socket();
+            fds[i].events = POLLIN;
         }
     }
 
+    if(poll(fds.data(), fds.size(), 1000) <= 0) { // interrupted by a kill signal or timed out
+        std::fill(ready.begin(), ready.end(), false);
+        return;
+    }
+
+    for(size_t i = 0; i < fds.size(); i++) {
+        ready[i] = (fds[i].revents & POLLIN);
+    }
+}
+
+// true if the sequence number of a copy of 'packet' at 'data' is newer than the one at 'current'
+// the same number, or one up to REORDER_WINDOW behind, was received late by another worker
+// anything further behind is taken as the vehicle starting over
+static bool newer_sequence(packet_info_t* packet, const uint8_t* data, const uint8_t* current) {
+    measurement_info_t* meas = packet->sequence;
+
+    // sequence numbers wrap around at the size of the measurement
+    uint64_t mask = (meas->size >= sizeof(uint64_t)) ? ~(uint64_t)0 : ((uint64_t)1 << (8 * meas->size)) - 1;
+    uint64_t window = std::min((uint64_t)REORDER_WINDOW, mask >> 2);
+
+    uint64_t seq = meas->decode_uint64(meas, data + packet->sequence_offset);
+    uint64_t last = meas->decode_uint64(meas, current + packet->sequence_offset);
+
+    uint64_t behind = (last - seq) & mask;
+    return behind > window;
+}
+
+// write 'data' to 'packet_id' in shared memory
+// a packet received by more than one worker is locked while it's written, and if it has a sequence number
+// it's only written over an older one, or over nothing, or after RESTART_RUN late ones in a row
+RetType write_packet(TelemetryShm* shmem, uint32_t packet_id, uint8_t* data) {
+    packet_info_t* packet = veh->packets[packet_id];
+
+    // no need to lock the packet for writing here, with one worker it's the only writer
+    if(packet->workers <= 1) {
+        return shmem->write(packet_id, data);
+    }
+
+    if(shmem->write_lock(packet_id) == FAILURE) {
+        return FAILURE;
+    }
+
+    // the zeros in shared memory that was never written aren't a sequence number
+    bool write = packet->sequence == NULL || !shmem->written(packet_id) ||
+                 newer_sequence(packet, data, shmem->get_buffer(packet_id));
+
+    if(!write && ++late_runs[packet_id] >= RESTART_RUN) {
+        MsgLogger logger(decom_id.c_str(), "write_packet");
+        logger.log_message("sequence number of packet " + std::to_string(packet_id) + " went back, vehicle restarted");
+        write = true;
+    }
+
+    RetType ret = SUCCESS;
+    if(write) {
+        late_runs[packet_id] = 0;
+        ret = shmem->write(packet_id, data);
+    }
+
+    if(shmem->write_unlock(packet_id) == FAILURE) {
+        ret = FAILURE;
+    }
+
+    return ret;
+}
+
+// id of a child receiving on a port with 'workers' workers for logging
+std::string child_id(const std::string& id, uint32_t worker, uint32_t workers) {
+    if(workers <= 1) {
+        return "DECOM[" + id + "]";
+    }
+
+    return "DECOM[" + id + ":" + std::to_string(worker) + "]";
+}
+
+// main logic for each sub process to run, 'worker' of the packet's workers
+// only exit if something bad happens
+void execute(size_t packet_id, packet_info_t* packet, uint32_t worker) {
+    decom_id = child_id(std::to_string(packet_id), worker, packet->workers);
+
+    // create message logger
+    MsgLogger logger(decom_id.c_str(), "execute");
+
+    // set packet name to use for logging messages and network manager name
+    std::string packet_name = veh->device + "(" + std::to_string(packet_id) + ")";
+
+    // create/init a network receiver for each link
+    if(open_links(packet, datagram_size(packet), packet->workers) != SUCCESS) {
+        close_links();
+        return;
+    }
+
     // open shared memory
     TelemetryShm shmem;
     if(shmem.init(veh) == FAILURE) {
         logger.log_message("failed to init telemetry shared memory");
-        delete net;
+        close_links();
         return;
     }
 
     // attach to shared memory
     if(shmem.open() == FAILURE) {
         logger.log_message("failed to attach to telemetry shared memory");
-        delete net;
+        close_links();
+        return;
+    }
+
+    open_ingest();
+    open_relay();
+
+    if(open_packets() != SUCCESS) {
+        close_links();
         return;
     }
 
     // create packet logger
     PacketLogger plogger(packet_name);
 
+    std::vector<struct pollfd> fds;
+    std::vector<bool> ready(nets.size(), false);
+
+    // links that are ready at once are read starting from a different one each time, so none always comes first
+    size_t turn = 0;
+
     // main loop
-    ssize_t n = 0;
+    int n = 0;
     while(!killed) {
-        // read any incoming message and write it to shared memory
-        if((n = net->rx()) > 0) {
-            if(n != (ssize_t)packet->size) {
-                logger.log_message("Packet size mismatch, " + std::to_string(packet->size) +
-                                   " != " + std::to_string(n) + " (received)");
-            } else { // only write the packet to shared mem if it's the correct size
-                // no need to lock the packet for writing here, telemetry (non-virtual) packets should only have one writer
-                if(shmem.write(packet_id, net->rx_buffer) == FAILURE) {
-                    logger.log_message("failed to write packet to shared memory");
-                    // ignore and continue
+        // the config changed, the master will start a child for the new one
+        if(shmem.reloaded()) {
+            logger.log_message("config reloaded, exiting");
+            close_links();
+            exit(RELOAD_EXIT);
+        }
+
+        ingest.tick();
+
+        wait_links(fds, ready);
+
+        // read any incoming messages, all of them are logged but only the latest is written to shared memory
+        uint8_t* latest = NULL;
+        num_decoded = 0;
+        for(size_t l = 0; l < nets.size(); l++) {
+            uint32_t link = (turn + l) % nets.size();
+            NetworkReceiver* net = nets[link];
+
+            if(!ready[link] || (n = net->rx_batch()) <= 0) {
+                continue;
+            }
+
+            // what arrives over other transports isn't relayed
+            uint16_t relay_port = (packet->transport == TRANSPORT_UDP) ? packet->ports[link] : 0;
+
+            uint64_t bytes = 0;
+            uint64_t mismatched = 0;
+            for(int i = 0; i < n; i++) {
+                bytes += net->batch_lengths[i];
+                relay_datagram(relay_port, net->batch_buffers[i],
+                               std::min(net->batch_lengths[i], datagram_size(packet)));
+
+                if(packet->delta) {
+                    uint8_t* decoded = decode_packet(packet_id, net->batch_buffers[i],
+                                                     std::min(net->batch_lengths[i], datagram_size(packet)));
+                    if(decoded && take_copy(packet_id, link, decoded, &plogger)) {
+                        latest = decoded;
+                    }
+                } else if(net->batch_lengths[i] != packet->size) {
+                    logger.log_message("Packet size mismatch, " + std::to_string(packet->size) +
+                                       " != " + std::to_string(net->batch_lengths[i]) + " (received)");
+                    mismatched++;
+
+                    // log the packet either way, anything bigger than the buffer was cut off
+                    plogger.log_packet((unsigned char*)net->batch_buffers[i],
+                                       std::min(net->batch_lengths[i], (size_t)packet->size));
+                } else if(take_copy(packet_id, link, net->batch_buffers[i], &plogger)) {
+                    // only write the packet to shared mem if it's the correct size
+                    latest = net->batch_buffers[i];
                 }
             }
 
-            plogger.log_packet((unsigned char*)net->rx_buffer, n); // log the packet either way
+            ingest.received(packet_id, n, bytes, mismatched);
+            ingest.socket(packet_id, net->kernel_drops, net->queued, link);
+        }
+        turn++;
+
+        flush_relay();
+
+        if(latest && write_packet(&shmem, packet_id, latest) == FAILURE) {
+            logger.log_message("failed to write packet to shared memory");
+            // ignore and continue
         }
     }
 
@@ -170,84 +745,1060 @@ void execute(size_t packet_id, packet_info_t* packet) {
     exit(received_sig);
 }
 
-int main(int argc, char** argv) {
-    MsgLogger logger(decom_id.c_str(), "main");
-    logger.log_message("starting decom master process");
+// read a frame id of 'size' bytes
+static inline uint32_t read_frame_id(const uint8_t* data, uint8_t size, bool big) {
+    uint32_t id = 0;
 
-    // interpret the 1st argument as a config_file location if available
-    std::string config_file = "";
-    if(argc > 1) {
-        config_file = argv[1];
+    for(uint8_t i = 0; i < size; i++) {
+        if(big) {
+            id = (id << 8) | data[i];
+        } else {
+            id |= (uint32_t)data[i] << (8 * i);
+        }
     }
 
-    // can't catch sigkill or sigstop though
-    signal(SIGINT, sighandler);
-    signal(SIGTERM, sighandler);
-    signal(SIGSEGV, sighandler);
-    signal(SIGFPE, sighandler);
-    signal(SIGABRT, sighandler);
+    return id;
+}
 
-    if(config_file == "") {
-        veh = new VCM(); // use default config file
-    } else {
-        veh = new VCM(config_file); // use specified config file
-    }
+// packets framed on a port, looked up by frame id
+typedef struct {
+    uint16_t port;
 
-    // init VCM
-    if(veh->init() == FAILURE) {
-        logger.log_message("failed to initialize VCM");
-        return -1;
-    }
+    // every packet on the port
+    std::vector<uint32_t> packets;
 
-    logger.log_message("starting decom sub-processes");
+    // ids up to 2 bytes index a table directly, larger ones use a map
+    std::vector<int32_t> table;
+    std::unordered_map<uint32_t, uint32_t> map;
+} framing_t;
 
-    // according to packets in vcm, spawn a bunch of processes
-    // we don't want to killed in the process of making these children so we ignore kill signals
-    ignore_kill = true;
+// find the framed packets on 'port', creating a packet logger in 'ploggers' for each one
+void init_framing(framing_t* framing, uint16_t port, std::vector<PacketLogger*>& ploggers) {
+    framing->port = port;
 
-    pid_t pid;
-    size_t i = 0;
-    for(packet_info_t* packet : veh->packets) {
-        if(packet->is_virtual) {
-            // this is a virtual telemetry packet, so it has no network input
-            i++;
+    if(veh->frame_id_size <= 2) {
+        framing->table.resize(1 << (8 * veh->frame_id_size), -1);
+    }
+
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        packet_info_t* packet = veh->packets[i];
+
+        if(!packet->framed || packet->port != port) {
             continue;
         }
 
-        pid = fork();
-        if(pid == -1) {
-            logger.log_message("failed to start decom sub-process " + std::to_string(i));
-        } else if(pid == 0) { // we are the child
-            // if we allowed killing during this step, the child process could be killed before it's able to set the 'child_proc' boolean
-            // which would make it try and clean up other children on kill, and we dont want multiple processes trying to kill each other
-            child_proc = true;
-            ignore_kill = false;
-            execute(i, packet);
-
-            return -1; // if a child returns, something bad happened to it and it should exit
+        if(veh->frame_id_size <= 2) {
+            framing->table[packet->frame_id] = i;
+        } else {
+            framing->map[packet->frame_id] = i;
         }
+        framing->packets.push_back(i);
 
-        // otherwise we're the parent, keep going
-        logger.log_message("started decom sub-process [" + std::to_string(i) +
-                                            "] with PID: " + std::to_string(pid));
-        i++;
-        pids.push_back(pid);
+        // log each frame as its own packet so logs read the same as unframed packets
+        ploggers[i] = new PacketLogger(veh->device + "(" + std::to_string(i) + ")");
     }
+}
 
-    ignore_kill = false;
+// split an 'n' byte datagram that arrived on 'link' into frames, a frame id followed by the packet with that id
+// the packet id and start of each frame to write are appended to 'ids' and 'frames', and each frame is counted
+// and logged (unless it's a copy of one that already arrived on another link)
+// the frame size comes from the packet, so nothing after a bad frame can be found and the rest is dropped
+void split_frames(framing_t* framing, uint32_t link, uint8_t* data, size_t n, std::vector<uint32_t>& ids,
+                  std::vector<uint8_t*>& frames, std::vector<PacketLogger*>& ploggers) {
+    const uint8_t id_size = veh->frame_id_size;
+    const bool id_big = (veh->frame_id_endianness == GSW_BIG_ENDIAN);
 
-    // monitor children processes in case they die
-    while(1) {
-        pid = wait(NULL);
-        if(pid == -1) { // error
-            if(errno == ECHILD) { // no more children left to wait for
-                logger.log_message("all decom sub-process children have died, exiting unexpectedly");
-                return -1;
+    size_t offset = 0;
+    while(offset + id_size <= n) {
+        uint32_t frame_id = read_frame_id(data + offset, id_size, id_big);
+        offset += id_size;
+
+        int64_t packet_id = -1;
+        if(id_size <= 2) {
+            packet_id = framing->table[frame_id];
+        } else {
+            auto it = framing->map.find(frame_id);
+            if(it != framing->map.end()) {
+                packet_id = it->second;
             }
         }
 
-        logger.log_message("decom sub-process child with PID: " + std::to_string(pid) + " died unexpectedly");
-        // continue and keep monitoring other children
+        if(packet_id < 0) {
+            MsgLogger logger(decom_id.c_str(), "split_frames");
+            logger.log_message("unknown frame id " + std::to_string(frame_id) + " on port " +
+                               std::to_string(framing->port) + ", dropping the rest of the datagram");
+            ingest.received(framing->packets[0], 0, 0, 1);
+            return;
+        }
+
+        size_t size = veh->packets[packet_id]->size;
+        if(offset + size > n) {
+            MsgLogger logger(decom_id.c_str(), "split_frames");
+            logger.log_message("frame " + std::to_string(frame_id) + " on port " + std::to_string(framing->port) +
+                               " is cut off, " + std::to_string(n - offset) + " < " + std::to_string(size));
+            ingest.received(framing->packets[0], 0, 0, 1);
+            return;
+        }
+
+        ingest.received(packet_id, 1, size, 0);
+        if(take_copy(packet_id, link, data + offset, ploggers[packet_id])) {
+            ids.push_back(packet_id);
+            frames.push_back(data + offset);
+        }
+
+        offset += size;
+    }
+}
+
+// every framed packet on a port shares the socket counters of 'net', the socket of 'link'
+void count_framed_socket(framing_t* framing, NetworkReceiver* net, uint32_t link) {
+    for(uint32_t packet_id : framing->packets) {
+        ingest.socket(packet_id, net->kernel_drops, net->queued, link);
+    }
+}
+
+// main logic for a sub process receiving framed packets on 'port', 'worker' of the port's 'workers'
+// only exit if something bad happens
+void execute_framed(uint16_t port, uint32_t worker, uint32_t workers) {
+    decom_id = child_id(std::to_string(port), worker, workers);
+
+    // create message logger
+    MsgLogger logger(decom_id.c_str(), "execute_framed");
+
+    framing_t framing;
+    std::vector<PacketLogger*> ploggers(veh->num_packets, NULL);
+    init_framing(&framing, port, ploggers);
+
+    // largest UDP datagram, every framed packet on the port lists the same links
+    if(open_links(veh->packets[framing.packets[0]], MAX_DATAGRAM_SIZE, workers) != SUCCESS) {
+        close_links();
+        return;
+    }
+
+    // open shared memory
+    TelemetryShm shmem;
+    if(shmem.init(veh) == FAILURE) {
+        logger.log_message("failed to init telemetry shared memory");
+        close_links();
+        return;
+    }
+
+    // attach to shared memory
+    if(shmem.open() == FAILURE) {
+        logger.log_message("failed to attach to telemetry shared memory");
+        close_links();
+        return;
+    }
+
+    open_ingest();
+    open_relay();
+
+    if(open_packets() != SUCCESS) {
+        close_links();
+        return;
+    }
+
+    // frames of the current batch of datagrams
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t*> frames;
+
+    std::vector<struct pollfd> fds;
+    std::vector<bool> ready(nets.size(), false);
+    size_t turn = 0;
+
+    // main loop
+    int n = 0;
+    while(!killed) {
+        // the config changed, the master will start a child for the new one
+        if(shmem.reloaded()) {
+            logger.log_message("config reloaded, exiting");
+            close_links();
+            exit(RELOAD_EXIT);
+        }
+
+        ingest.tick();
+
+        wait_links(fds, ready);
+
+        ids.clear();
+        frames.clear();
+        for(size_t l = 0; l < nets.size(); l++) {
+            uint32_t link = (turn + l) % nets.size();
+            NetworkReceiver* net = nets[link];
+
+            if(!ready[link] || (n = net->rx_batch()) <= 0) {
+                continue;
+            }
+
+            uint16_t link_port = veh->packets[framing.packets[0]]->ports[link];
+            for(int i = 0; i < n; i++) {
+                size_t length = std::min(net->batch_lengths[i], (size_t)MAX_DATAGRAM_SIZE);
+                relay_datagram(link_port, net->batch_buffers[i], length);
+                split_frames(&framing, link, net->batch_buffers[i], length, ids, frames, ploggers);
+            }
+            count_framed_socket(&framing, net, link);
+        }
+        turn++;
+
+        flush_relay();
+
+        if(ids.size() == 0) {
+            continue;
+        }
+
+        // the whole batch goes into shared memory at once
+        // no need to lock the packets for writing here, with one worker it's the only writer
+        if(workers <= 1) {
+            if(shmem.write(ids.data(), frames.data(), ids.size()) == FAILURE) {
+                logger.log_message("failed to write frames to shared memory");
+                // ignore and continue
+            }
+
+            continue;
+        }
+
+        // other workers write the same packets, each frame is written on its own
+        for(size_t i = 0; i < ids.size(); i++) {
+            if(write_packet(&shmem, ids[i], frames[i]) == FAILURE) {
+                logger.log_message("failed to write frame to shared memory");
+                // ignore and continue
+            }
+        }
+    }
+
+    // we got killed and got a signal, making net->rx fail
+    child_cleanup();
+    exit(received_sig);
+}
+
+// a socket of the single process decom
+typedef struct {
+    NetworkReceiver* net;
+
+    // index of the socket's port in the ports of its packet(s), and the port
+    uint32_t link;
+    uint16_t port;
+
+    // unframed packet received on the socket
+    uint32_t packet_id;
+    size_t size;
+
+    // framed packets received on the socket, NULL if unframed
+    framing_t* framing;
+} source_t;
+
+// state of the single process decom
+int sig_fd = -1;
+std::vector<source_t> sources;
+std::vector<framing_t> framings;
+std::vector<PacketLogger*> ploggers;
+UringReceiver* ring = NULL;
+PacketRing* capture = NULL;
+
+// clean up memory of the single process decom
+void single_cleanup() {
+    // cancels the receives into the sockets before they're closed
+    if(ring) {
+        delete ring;
+        ring = NULL;
+    }
+
+    if(capture) {
+        delete capture;
+        capture = NULL;
+    }
+
+    for(source_t& source : sources) {
+        delete source.net;
+    }
+    sources.clear();
+
+    close_packets();
+    close_relay();
+
+    for(PacketLogger* plogger : ploggers) {
+        if(plogger) {
+            delete plogger;
+        }
+    }
+    ploggers.clear();
+}
+
+// the signalfd is readable, we got a kill signal
+void single_killed() {
+    MsgLogger logger(decom_id.c_str(), "single_killed");
+
+    struct signalfd_siginfo info;
+    if(read(sig_fd, &info, sizeof(info)) != sizeof(info)) {
+        return;
+    }
+
+    logger.log_message("received kill signal, cleaning up resources");
+    single_cleanup();
+    close(sig_fd);
+    exit(info.ssi_signo);
+}
+
+// start over as a new process with the new config
+void single_restart(char** argv) {
+    MsgLogger logger(decom_id.c_str(), "single_restart");
+    logger.log_message("config reloaded, restarting");
+
+    single_cleanup();
+
+    // exec the binary /proc/self/exe points to, exec'ing the link itself would rename the process 'exe'
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if(len > 0) {
+        path[len] = '\0';
+        execv(path, argv);
+    }
+
+    logger.log_message("failed to restart");
+    exit(-1);
+}
+
+// open a nonblocking socket for every port of each unframed packet and every port of framed packets
+// each socket can receive 'batch_size' datagrams at once
+RetType open_sources(size_t batch_size) {
+    std::unordered_set<uint16_t> framed_ports;
+
+    size_t num_sources = 0;
+    size_t num_framed = 0;
+    for(packet_info_t* packet : veh->packets) {
+        if(packet->framed && framed_ports.count(packet->port)) {
+            continue;
+        }
+
+        if(packet->framed) {
+            framed_ports.insert(packet->port);
+            num_framed++;
+        }
+        num_sources += num_links(packet);
+    }
+    framed_ports.clear();
+
+    // sized up front, epoll/io_uring hold pointers to the sources
+    sources.reserve(num_sources);
+    framings.reserve(num_framed);
+    ploggers.resize(veh->num_packets, NULL);
+
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        packet_info_t* packet = veh->packets[i];
+
+        if(packet->is_virtual) {
+            // this is a virtual telemetry packet, so it has no network input
+            continue;
+        }
+
+        source_t source;
+        source.packet_id = i;
+        source.size = packet->size;
+        source.framing = NULL;
+
+        if(packet->framed && framed_ports.count(packet->port)) {
+            continue;
+        }
+
+        if(packet->workers > 1) {
+            MsgLogger logger(decom_id.c_str(), "open_sources");
+            logger.log_message("the single process decom has one socket per port, ignoring the workers of port " +
+                               std::to_string(packet->port));
+        }
+
+        size_t buffer_size = datagram_size(packet);
+        if(packet->framed) {
+            framed_ports.insert(packet->port);
+            framings.emplace_back();
+            source.framing = &framings.back();
+            init_framing(source.framing, packet->port, ploggers);
+
+            // largest UDP datagram
+            buffer_size = MAX_DATAGRAM_SIZE;
+        } else {
+            ploggers[i] = new PacketLogger(veh->device + "(" + std::to_string(i) + ")");
+        }
+
+        // a socket for each link the packet(s) arrive over, only UDP datagrams are relayed
+        for(uint32_t link = 0; link < num_links(packet); link++) {
+            source.link = link;
+            source.port = (packet->transport == TRANSPORT_UDP) ? packet->ports[link] : 0;
+            source.net = open_link(packet, link, buffer_size, 0, batch_size);
+
+            if(source.net == NULL) {
+                return FAILURE;
+            }
+
+            sources.push_back(source);
+
+            if(source.net->set_nonblocking() == FAILURE) {
+                return FAILURE;
+            }
+        }
+    }
+
+    return open_packets();
+}
+
+// receive with every socket in one epoll set, the signalfd is in the same set
+// only returns if something bad happens
+void run_epoll(TelemetryShm* shmem, char** argv) {
+    MsgLogger logger(decom_id.c_str(), "run_epoll");
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd == -1) {
+        logger.log_message("failed to create epoll instance");
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL; // the signalfd is the only event without a source
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sig_fd, &event) == -1) {
+        logger.log_message("failed to add signalfd to epoll set");
+        return;
+    }
+
+    // level triggered, a socket with more queued just shows up again on the next wait
+    for(source_t& source : sources) {
+        event.events = EPOLLIN;
+        event.data.ptr = &source;
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source.net->get_socket(), &event) == -1) {
+            logger.log_message("failed to add socket to epoll set");
+            return;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+
+    // packets received in one pass over the ready sockets
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t*> frames;
+
+    // main loop
+    while(1) {
+        int num = epoll_wait(epoll_fd, events, MAX_EVENTS, RELOAD_CHECK_TIME);
+
+        if(num == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            logger.log_message("epoll_wait failed");
+            close(epoll_fd);
+            return;
+        }
+
+        if(shmem->reloaded()) {
+            close(epoll_fd);
+            single_restart(argv);
+        }
+
+        ingest.tick();
+
+        ids.clear();
+        frames.clear();
+        num_decoded = 0;
+
+        // a batch of datagrams from each ready socket, each has its own receive buffers
+        for(int i = 0; i < num; i++) {
+            source_t* source = (source_t*)events[i].data.ptr;
+
+            if(source == NULL) {
+                close(epoll_fd);
+                single_killed();
+                continue;
+            }
+
+            NetworkReceiver* net = source->net;
+            int n = net->rx_batch();
+            if(n <= 0) {
+                continue;
+            }
+
+            if(source->framing) {
+                for(int j = 0; j < n; j++) {
+                    size_t length = std::min(net->batch_lengths[j], (size_t)MAX_DATAGRAM_SIZE);
+                    relay_datagram(source->port, net->batch_buffers[j], length);
+                    split_frames(source->framing, source->link, net->batch_buffers[j], length, ids, frames, ploggers);
+                }
+                count_framed_socket(source->framing, net, source->link);
+                continue;
+            }
+
+            // only the latest packet is written to shared memory
+            uint8_t* latest = NULL;
+            uint64_t bytes = 0;
+            uint64_t mismatched = 0;
+            for(int j = 0; j < n; j++) {
+                bytes += net->batch_lengths[j];
+                relay_datagram(source->port, net->batch_buffers[j],
+                               std::min(net->batch_lengths[j], datagram_size(veh->packets[source->packet_id])));
+
+                if(decoders[source->packet_id]) {
+                    uint8_t* decoded = decode_packet(source->packet_id, net->batch_buffers[j],
+                                                     std::min(net->batch_lengths[j], DELTA_MAX_SIZE(source->size)));
+                    if(decoded && take_copy(source->packet_id, source->link, decoded, ploggers[source->packet_id])) {
+                        latest = decoded;
+                    }
+                } else if(net->batch_lengths[j] != source->size) {
+                    logger.log_message("Packet size mismatch, " + std::to_string(source->size) +
+                                       " != " + std::to_string(net->batch_lengths[j]) + " (received)");
+                    mismatched++;
+
+                    // log the packet either way, anything bigger than the buffer was cut off
+                    ploggers[source->packet_id]->log_packet((unsigned char*)net->batch_buffers[j],
+                                                            std::min(net->batch_lengths[j], source->size));
+                } else if(take_copy(source->packet_id, source->link, net->batch_buffers[j],
+                                    ploggers[source->packet_id])) {
+                    // only write the packet to shared mem if it's the correct size
+                    latest = net->batch_buffers[j];
+                }
+            }
+
+            ingest.received(source->packet_id, n, bytes, mismatched);
+            ingest.socket(source->packet_id, net->kernel_drops, net->queued, source->link);
+
+            if(latest) {
+                ids.push_back(source->packet_id);
+                frames.push_back(latest);
+            }
+        }
+
+        flush_relay();
+
+        // everything received this pass goes into shared memory at once
+        // no need to lock the packets for writing here, telemetry (non-virtual) packets should only have one writer
+        if(ids.size() > 0 && shmem->write(ids.data(), frames.data(), ids.size()) == FAILURE) {
+            logger.log_message("failed to write packets to shared memory");
+            // ignore and continue
+        }
+    }
+}
+
+// receive every socket through 'ring', the signalfd is watched by the ring too
+// only returns if something bad happens
+void run_uring(TelemetryShm* shmem, char** argv) {
+    MsgLogger logger(decom_id.c_str(), "run_uring");
+
+    uring_packet_t packets[MAX_EVENTS];
+
+    // packets received in one pass over the completions
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t*> frames;
+
+    // main loop
+    while(1) {
+        int num = ring->wait(packets, MAX_EVENTS, RELOAD_CHECK_TIME);
+
+        if(num == -1) {
+            logger.log_message("failed to wait for packets");
+            return;
+        }
+
+        if(shmem->reloaded()) {
+            single_restart(argv);
+        }
+
+        ingest.tick();
+
+        ids.clear();
+        frames.clear();
+        num_decoded = 0;
+
+        for(int i = 0; i < num; i++) {
+            uring_packet_t* packet = &packets[i];
+            source_t* source = (source_t*)packet->tag;
+
+            if(source == NULL) {
+                single_killed();
+                continue;
+            }
+
+            relay_datagram(source->port, packet->data, packet->length);
+
+            // packets are taken out of the socket as they come in, nothing is ever counted as queued
+            if(source->framing) {
+                split_frames(source->framing, source->link, packet->data, packet->length, ids, frames, ploggers);
+                count_framed_socket(source->framing, source->net, source->link);
+                continue;
+            }
+
+            bool delta = (decoders[source->packet_id] != NULL);
+            ingest.received(source->packet_id, 1, packet->size, !delta && packet->size != source->size);
+            ingest.socket(source->packet_id, source->net->kernel_drops, 0, source->link);
+
+            if(delta) {
+                uint8_t* decoded = decode_packet(source->packet_id, packet->data, packet->length);
+                if(decoded && take_copy(source->packet_id, source->link, decoded, ploggers[source->packet_id])) {
+                    ids.push_back(source->packet_id);
+                    frames.push_back(decoded);
+                }
+            } else if(packet->size != source->size) {
+                logger.log_message("Packet size mismatch, " + std::to_string(source->size) +
+                                   " != " + std::to_string(packet->size) + " (received)");
+                ploggers[source->packet_id]->log_packet((unsigned char*)packet->data, packet->length); // log the packet either way
+            } else if(take_copy(source->packet_id, source->link, packet->data, ploggers[source->packet_id])) {
+                // only write the packet to shared mem if it's the correct size
+                ids.push_back(source->packet_id);
+                frames.push_back(packet->data);
+            }
+        }
+
+        // everything received this pass goes into shared memory at once
+        // no need to lock the packets for writing here, telemetry (non-virtual) packets should only have one writer
+        if(ids.size() > 0 && shmem->write(ids.data(), frames.data(), ids.size()) == FAILURE) {
+            logger.log_message("failed to write packets to shared memory");
+            // ignore and continue
+        }
+
+        // done with the buffers the packets are in
+        flush_relay();
+        ring->release(packets, num);
+    }
+}
+
+// receive every packet from 'capture' instead of the sockets, the signalfd is polled with it
+// only returns if something bad happens
+void run_capture(TelemetryShm* shmem, char** argv) {
+    MsgLogger logger(decom_id.c_str(), "run_capture");
+
+    // sources by destination port
+    std::vector<source_t*> by_port(1 << 16, NULL);
+
+    // network devices with an auto configuration by port, the source address of their packets goes to shared memory
+    std::unordered_map<uint16_t, uint32_t> auto_devices;
+    NmShm nmshm;
+
+    for(source_t& source : sources) {
+        uint16_t port = veh->packets[source.packet_id]->ports[source.link];
+        by_port[port] = &source;
+
+        net_info_t* net = veh->get_auto_net(port);
+        if(net) {
+            auto_devices[port] = net->unique_id;
+        }
+    }
+
+    if(auto_devices.size() > 0 && (nmshm.init(veh->num_net_devices) != SUCCESS || nmshm.attach() != SUCCESS)) {
+        logger.log_message("failed to attach to network manager shared memory");
+        return;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = capture->get_socket();
+    fds[0].events = POLLIN;
+    fds[1].fd = sig_fd;
+    fds[1].events = POLLIN;
+
+    // packets in a block of the ring
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t*> frames;
+    ring_datagram_t datagram;
+
+    // main loop
+    while(1) {
+        if(poll(fds, 2, RELOAD_CHECK_TIME) == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            logger.log_message("poll failed");
+            return;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            single_killed();
+        }
+
+        if(shmem->reloaded()) {
+            single_restart(argv);
+        }
+
+        ingest.tick();
+
+        // parse each block where it is in the ring, then copy its packets into shared memory at once
+        while(capture->next_block() == SUCCESS) {
+            ids.clear();
+            frames.clear();
+            num_decoded = 0;
+
+            while(capture->next(&datagram)) {
+                source_t* source = by_port[datagram.port];
+                if(source == NULL) {
+                    continue;
+                }
+
+                if(auto_devices.size() > 0) {
+                    auto it = auto_devices.find(datagram.port);
+                    if(it != auto_devices.end() && nmshm.update_addr(it->second, &datagram.src) == FAILURE) {
+                        logger.log_message("failed to update network manager shared memory");
+                    }
+                }
+
+                relay_datagram(datagram.port, datagram.data, datagram.length);
+
+                if(source->framing) {
+                    split_frames(source->framing, source->link, datagram.data, datagram.length, ids, frames, ploggers);
+                    continue;
+                }
+
+                // there's no socket queue to count, the ring's drops aren't for any one port
+                bool delta = (decoders[source->packet_id] != NULL);
+                bool mismatched = ((!delta && datagram.size != source->size) || datagram.length != datagram.size);
+                ingest.received(source->packet_id, 1, datagram.size, mismatched);
+
+                if(!mismatched && delta) {
+                    uint8_t* decoded = decode_packet(source->packet_id, datagram.data, datagram.length);
+                    if(decoded && take_copy(source->packet_id, source->link, decoded, ploggers[source->packet_id])) {
+                        ids.push_back(source->packet_id);
+                        frames.push_back(decoded);
+                    }
+                } else if(mismatched) {
+                    logger.log_message("Packet size mismatch, " + std::to_string(source->size) +
+                                       " != " + std::to_string(datagram.size) + " (received)");
+                    ploggers[source->packet_id]->log_packet((unsigned char*)datagram.data, datagram.length); // log the packet either way
+                } else if(take_copy(source->packet_id, source->link, datagram.data, ploggers[source->packet_id])) {
+                    // only write the packet to shared mem if it's the correct size
+                    ids.push_back(source->packet_id);
+                    frames.push_back(datagram.data);
+                }
+            }
+
+            // no need to lock the packets for writing here, telemetry (non-virtual) packets should only have one writer
+            if(ids.size() > 0 && shmem->write(ids.data(), frames.data(), ids.size()) == FAILURE) {
+                logger.log_message("failed to write packets to shared memory");
+                // ignore and continue
+            }
+
+            flush_relay();
+            capture->release_block();
+        }
+    }
+}
+
+// main logic of the single process decom
+// kill signals come through a signalfd waited on with the sockets, so there's no receive timeout to wait out on shutdown
+// if 'interface' isn't empty packets are captured from it with a packet ring,
+// if 'uring' is set the sockets are received through io_uring ('sqpoll' to use a submission thread),
+// otherwise (or if either isn't supported) with epoll
+// only exit if something bad happens
+void execute_single(char** argv, bool uring, bool sqpoll, std::string& interface) {
+    decom_id = "DECOM[single]";
+
+    // create message logger
+    MsgLogger logger(decom_id.c_str(), "execute_single");
+
+    // signals are read from the signalfd instead of interrupting us
+    // NOTE: a blocked signal stays blocked across execv, the reloaded process picks up any that are pending
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    if(sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        logger.log_message("failed to block kill signals");
+        return;
+    }
+
+    sig_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if(sig_fd == -1) {
+        logger.log_message("failed to create signalfd");
+        return;
+    }
+
+    // open shared memory
+    TelemetryShm shmem;
+    if(shmem.init(veh) == FAILURE) {
+        logger.log_message("failed to init telemetry shared memory");
+        return;
+    }
+
+    // attach to shared memory
+    if(shmem.open() == FAILURE) {
+        logger.log_message("failed to attach to telemetry shared memory");
+        return;
+    }
+
+    open_ingest();
+    open_relay();
+
+    // the rings only see UDP datagrams, every other transport has its own receiver
+    bool udp_only = true;
+    for(packet_info_t* packet : veh->packets) {
+        if(!packet->is_virtual && packet->transport != TRANSPORT_UDP) {
+            udp_only = false;
+        }
+    }
+
+    if(!udp_only && (interface != "" || uring)) {
+        logger.log_message("some packets aren't sent over UDP, falling back to epoll");
+        interface = "";
+        uring = false;
+    }
+
+    if(interface != "") {
+        std::vector<uint16_t> ports;
+        for(packet_info_t* packet : veh->packets) {
+            if(!packet->is_virtual) {
+                ports.insert(ports.end(), packet->ports.begin(), packet->ports.end());
+            }
+        }
+
+        capture = new PacketRing();
+        if(capture->init(interface, ports, RING_BLOCK_SIZE, RING_BLOCKS, RING_BLOCK_TIMEOUT) != SUCCESS) {
+            logger.log_message("failed to capture from " + interface + ", falling back to epoll");
+            delete capture;
+            capture = NULL;
+        }
+    } else if(uring) {
+        ring = new UringReceiver();
+
+        // a socket for at most every port of every packet, and the signalfd
+        size_t num_ports = 0;
+        for(packet_info_t* packet : veh->packets) {
+            num_ports += packet->ports.size();
+        }
+
+        if(ring->init(num_ports + 1, URING_BUFFERS, sqpoll) != SUCCESS) {
+            logger.log_message("io_uring not supported, falling back to epoll");
+            delete ring;
+            ring = NULL;
+        }
+    }
+
+    // the rings have their own buffers, so the sockets don't need batches
+    // when capturing the sockets are never read, they're only open so the kernel has somewhere to put the datagrams
+    if(open_sources((ring || capture) ? 1 : RX_BATCH) != SUCCESS) {
+        single_cleanup();
+        return;
+    }
+
+    if(ring) {
+        RetType ret = ring->watch(sig_fd, NULL);
+
+        for(source_t& source : sources) {
+            if(ret != SUCCESS) {
+                break;
+            }
+
+            ret = ring->add(source.net, source.framing ? MAX_DATAGRAM_SIZE : datagram_size(veh->packets[source.packet_id]),
+                            &source);
+        }
+
+        if(ret != SUCCESS) {
+            logger.log_message("io_uring receive not supported, falling back to epoll");
+            delete ring;
+            ring = NULL;
+        }
+    }
+
+    if(capture) {
+        logger.log_message("capturing " + std::to_string(sources.size()) + " ports from " + interface);
+        run_capture(&shmem, argv);
+    } else if(ring) {
+        logger.log_message("receiving on " + std::to_string(sources.size()) + " sockets with io_uring");
+        run_uring(&shmem, argv);
+    } else {
+        logger.log_message("receiving on " + std::to_string(sources.size()) + " sockets with epoll");
+        run_epoll(&shmem, argv);
+    }
+
+    single_cleanup();
+}
+
+// according to packets in vcm, spawn a bunch of processes
+// returns FAILURE in a child process that had to stop
+RetType spawn_children() {
+    MsgLogger logger(decom_id.c_str(), "spawn_children");
+    logger.log_message("starting decom sub-processes");
+
+    // we don't want to killed in the process of making these children so we ignore kill signals
+    ignore_kill = true;
+
+    // ports of framed packets that already have a child
+    std::unordered_set<uint16_t> framed_ports;
+
+    pid_t pid;
+    size_t i = 0;
+    for(packet_info_t* packet : veh->packets) {
+        if(packet->is_virtual) {
+            // this is a virtual telemetry packet, so it has no network input
+            i++;
+            continue;
+        }
+
+        // one child receives every framed packet on a port
+        if(packet->framed && framed_ports.count(packet->port)) {
+            i++;
+            continue;
+        }
+
+        if(packet->framed) {
+            framed_ports.insert(packet->port);
+        }
+
+        // a busy port can have more than one child, each with its own socket
+        for(uint32_t worker = 0; worker < packet->workers; worker++) {
+            pid = fork();
+            if(pid == -1) {
+                logger.log_message("failed to start decom sub-process " + std::to_string(i));
+                continue;
+            } else if(pid == 0) { // we are the child
+                // if we allowed killing during this step, the child process could be killed before it's able to set the 'child_proc' boolean
+                // which would make it try and clean up other children on kill, and we dont want multiple processes trying to kill each other
+                child_proc = true;
+                ignore_kill = false;
+
+                // memory locks aren't inherited, and the profile may have changed on a reload
+                if(SUCCESS != sched::apply(veh, "decom")) {
+                    logger.log_message("failed to apply scheduling profile, running without it");
+                }
+
+                if(packet->framed) {
+                    execute_framed(packet->port, worker, packet->workers);
+                } else {
+                    execute(i, packet, worker);
+                }
+
+                return FAILURE; // if a child returns, something bad happened to it and it should exit
+            }
+
+            // otherwise we're the parent, keep going
+            std::string worker_name = (packet->workers > 1) ? " worker " + std::to_string(worker) : "";
+            if(packet->framed) {
+                logger.log_message("started decom sub-process for framed packets on port " +
+                                   std::to_string(packet->port) + worker_name + " with PID: " + std::to_string(pid));
+            } else {
+                logger.log_message("started decom sub-process [" + std::to_string(i) + "]" + worker_name +
+                                   " with PID: " + std::to_string(pid));
+            }
+            pids.push_back(pid);
+        }
+        i++;
+    }
+
+    ignore_kill = false;
+
+    return SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    MsgLogger logger(decom_id.c_str(), "main");
+    logger.log_message("starting decom master process");
+
+    // interpret the 1st argument that isn't an option as a config_file location if available
+    std::string config_file = "";
+    bool single = false;
+    bool uring = false;
+    bool sqpoll = false;
+    std::string interface = "";
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if(arg == "-single") {
+            single = true;
+        } else if(arg == "-uring") {
+            single = true;
+            uring = true;
+        } else if(arg == "-sqpoll") {
+            single = true;
+            uring = true;
+            sqpoll = true;
+        } else if(arg == "-capture" && i + 1 < argc) {
+            single = true;
+            interface = argv[++i];
+        } else {
+            config_file = argv[i];
+        }
+    }
+
+    // can't catch sigkill or sigstop though
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    signal(SIGSEGV, sighandler);
+    signal(SIGFPE, sighandler);
+    signal(SIGABRT, sighandler);
+
+    if(config_file == "") {
+        veh = new VCM(); // use default config file
+    } else {
+        veh = new VCM(config_file); // use specified config file
+    }
+
+    // init VCM
+    if(veh->init() == FAILURE) {
+        logger.log_message("failed to initialize VCM");
+        return -1;
+    }
+
+    if(SUCCESS != sched::apply(veh, "decom")) {
+        logger.log_message("failed to apply scheduling profile, running without it");
+    }
+
+    if(single) {
+        execute_single(argv, uring, sqpoll, interface);
+        return -1; // only returns if something bad happened
+    }
+
+    // monitor children processes in case they die
+    pid_t pid;
+    while(1) {
+        if(pids.size() == 0) {
+            // start children for the current config
+            if(reloading) {
+                logger.log_message("config reloaded, restarting decom sub-processes");
+
+                delete veh;
+                if(config_file == "") {
+                    veh = new VCM();
+                } else {
+                    veh = new VCM(config_file);
+                }
+
+                if(veh->init() == FAILURE) {
+                    logger.log_message("failed to initialize reloaded VCM");
+                    return -1;
+                }
+
+                reloading = false;
+            }
+
+            if(spawn_children() != SUCCESS) {
+                return -1; // we're a child that returned
+            }
+        }
+
+        int status;
+        pid = wait(&status);
+        if(pid == -1) { // error
+            if(errno == ECHILD) { // no more children left to wait for
+                logger.log_message("all decom sub-process children have died, exiting unexpectedly");
+                return -1;
+            }
+
+            continue;
+        }
+
+        for(size_t j = 0; j < pids.size(); j++) {
+            if(pids[j] == pid) {
+                pids.erase(pids.begin() + j);
+                break;
+            }
+        }
+
+        if(WIFEXITED(status) && WEXITSTATUS(status) == RELOAD_EXIT) {
+            reloading = true;
+            continue;
+        }
+
+        logger.log_message("decom sub-process child with PID: " + std::to_string(pid) + " died unexpectedly");
+        // continue and keep monitoring other children
+
+        if(pids.size() == 0 && !reloading) {
+            logger.log_message("all decom sub-process children have died, exiting unexpectedly");
+            return -1;
+        }
     }
 
     // should never get here
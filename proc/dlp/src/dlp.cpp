@@ -1,4 +1,6 @@
 #include "lib/dls/dls.h"
+#include "lib/vcm/vcm.h"
+#include "lib/sched/sched.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -248,6 +250,13 @@ int main(int argc, char* argv[]) {
         gsw_home.assign(env, size);
     }
 
+    // the data logger isn't tied to a vehicle, take its scheduling profile from the default config
+    // before starting the reader threads so they inherit it
+    vcm::VCM veh;
+    if(SUCCESS != veh.init() || SUCCESS != sched::apply(&veh, "dlp")) {
+        printf("failed to apply scheduling profile, running without it\n");
+    }
+
     std::string msg_file = gsw_home + "/log/system.log";
     std::string tel_file = gsw_home + "/log/telemetry.log";
 
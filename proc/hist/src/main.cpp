@@ -0,0 +1,195 @@
+/********************************************************************
+*  Name: main.cpp
+*
+*  Purpose: History process, waits for updates to measurements and
+*           records them into compressed history shared memory and
+*           downsampled envelope shared memory
+*           Array measurements record every sample with its own timestamp
+*
+*  Usage: ./hist [config file path]
+*         If no VCM config file path is specified, the default location is used
+*
+*  Author: Will Merges
+*
+*  RIT Launch Initiative
+*********************************************************************/
+#include "lib/telemetry/TelemetryViewer.h"
+#include "lib/telemetry/HistoryShm.h"
+#include "lib/telemetry/EnvelopeShm.h"
+#include "lib/dls/dls.h"
+#include "lib/vcm/vcm.h"
+#include "lib/sched/sched.h"
+#include "lib/convert/convert.h"
+
+#include <stdint.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <vector>
+
+using namespace dls;
+using namespace vcm;
+
+VCM* veh;
+TelemetryShm tshm;
+TelemetryViewer tv;
+HistoryShm hshm;
+EnvelopeShm eshm;
+
+bool killed = false;
+
+void sighandler(int) {
+    tv.sighandler();
+    killed = true;
+}
+
+int main(int argc, char** argv) {
+    MsgLogger logger("HIST", "main");
+    logger.log_message("starting history process");
+
+    // interpret the 1st argument as a config_file location if available
+    std::string config_file = "";
+    if(argc > 1) {
+        config_file = argv[1];
+    }
+
+    if(config_file == "") {
+        veh = new VCM(); // use default config file
+    } else {
+        veh = new VCM(config_file); // use specified config file
+    }
+
+    // init VCM
+    if(veh->init() != SUCCESS) {
+        logger.log_message("failed to initialize VCM");
+        return -1;
+    }
+
+    if(SUCCESS != sched::apply(veh, "hist")) {
+        logger.log_message("failed to apply scheduling profile, running without it");
+    }
+
+    if(veh->history_file == "") {
+        logger.log_message("no history file specified");
+        return 1;
+    }
+
+    // setup history shm
+    if(hshm.init(veh) != SUCCESS) {
+        logger.log_message("failed to init history shm");
+        return -1;
+    }
+
+    if(hshm.open() != SUCCESS) {
+        logger.log_message("failed to open history shm");
+        return -1;
+    }
+
+    // setup envelope shm
+    if(eshm.init(veh) != SUCCESS) {
+        logger.log_message("failed to init envelope shm");
+        return -1;
+    }
+
+    if(eshm.open() != SUCCESS) {
+        logger.log_message("failed to open envelope shm");
+        return -1;
+    }
+
+    // setup telemetry shm
+    if(tshm.init(veh) != SUCCESS) {
+        logger.log_message("failed to init telemetry shm");
+        return -1;
+    }
+
+    if(tshm.open() != SUCCESS) {
+        logger.log_message("failed to open telemetry shm");
+        return -1;
+    }
+
+    // setup telemetry viewer
+    if(tv.init(veh, &tshm)) {
+        logger.log_message("failed to init telemetry viewer");
+        return -1;
+    }
+
+    // only watch packets that hold a measurement we keep history for
+    for(measurement_info_t* meas : hshm.measurements) {
+        if(SUCCESS != tv.add(meas)) {
+            logger.log_message("failed to add measurement to telemetry viewer");
+            return -1;
+        }
+    }
+
+    tv.set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
+
+    logger.log_message("recording history for " + std::to_string(hshm.measurements.size()) + " measurements");
+
+    // add signal handlers
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    signal(SIGSEGV, sighandler);
+    signal(SIGFPE, sighandler);
+    signal(SIGABRT, sighandler);
+
+    struct timeval now;
+    uint64_t timestamp;
+    double val;
+
+    // buffer for decoding arrays, big enough for the longest one
+    size_t max_count = 1;
+    for(measurement_info_t* meas : hshm.measurements) {
+        if(meas->count > max_count) {
+            max_count = meas->count;
+        }
+    }
+    std::vector<double> samples(max_count);
+
+    // time each measurement was last updated, used to spread array samples out
+    std::vector<uint64_t> last_time(hshm.measurements.size(), 0);
+
+    // main logic
+    while(!killed) {
+        if(SUCCESS != tv.update()) {
+            // move on
+            continue;
+        }
+
+        gettimeofday(&now, NULL);
+        timestamp = ((uint64_t)now.tv_sec * 1000000) + now.tv_usec;
+
+        for(size_t i = 0; i < hshm.measurements.size(); i++) {
+            measurement_info_t* meas = hshm.measurements[i];
+
+            if(!tv.updated(meas)) {
+                continue;
+            }
+
+            uint64_t interval = (last_time[i] == 0) ? 0 : timestamp - last_time[i];
+            last_time[i] = timestamp;
+
+            if(meas->count > 1) {
+                if(SUCCESS != tv.get_array(meas, samples.data(), samples.size())) {
+                    continue;
+                }
+
+                for(uint32_t j = 0; j < meas->count; j++) {
+                    uint64_t t = convert::sample_time(meas, timestamp, interval, j);
+                    hshm.append(meas, t, samples[j]);
+                    eshm.append(meas, t, samples[j]);
+                }
+
+                continue;
+            }
+
+            if(SUCCESS != tv.get_value(meas, &val)) {
+                continue;
+            }
+
+            // fails if the clock went backwards, the sample is just dropped
+            hshm.append(meas, timestamp, val);
+            eshm.append(meas, timestamp, val);
+        }
+    }
+
+    return 1;
+}
@@ -3,6 +3,8 @@
 *
 *  Purpose: Measurement Monitor process, waits for updates the measurements
 *           and executes trigger function if available
+*           picks up changes to the trigger file and reloads of the config
+*           (shmctl -reload) without restarting
 *
 *  Usage:
 *
@@ -15,6 +17,8 @@
 #include "lib/telemetry/TelemetryWriter.h"
 #include "lib/dls/dls.h"
 #include "lib/vcm/vcm.h"
+#include "lib/vcm/watch.h"
+#include "lib/sched/sched.h"
 
 #include <stdint.h>
 #include <signal.h>
@@ -25,15 +29,20 @@ using namespace dls;
 using namespace vcm;
 using namespace trigger;
 
-VCM* veh;
-TelemetryShm tshm;
-TelemetryViewer tv;
-TelemetryWriter tw;
+std::string config_file = "";
+
+// everything below is rebuilt when the config is reloaded
+VCM* veh = NULL;
+TelemetryShm* tshm = NULL;
+TelemetryViewer* tv = NULL;
+TelemetryWriter* tw = NULL;
 
 bool killed = false;
 
 void sighandler(int) {
-    tv.sighandler();
+    if(tv) {
+        tv->sighandler();
+    }
     killed = true;
 }
 
@@ -46,16 +55,78 @@ namespace std {
     };
 }
 
-int main(int argc, char** argv) {
-    MsgLogger logger("MMON", "main");
-    logger.log_message("starting mmon process");
+// packets that cause a trigger to be executed
+std::unordered_set<uint32_t> trigger_packets;
 
-    // interpret the 1st argument as a config_file location if available
-    std::string config_file = "";
-    if(argc > 1) {
-        config_file = argv[1];
+// maps packet id to list of triggers to execute
+std::vector<std::unordered_set<trigger_t>> packet_map;
+
+// parse the trigger file and map triggers to the packets that cause them
+// keeps the current triggers if the file fails to parse
+RetType load_triggers() {
+    MsgLogger logger("MMON", "load_triggers");
+
+    std::vector<trigger_t> triggers;
+    if(SUCCESS != parse_trigger_file(veh, &triggers)) {
+        logger.log_message("failed to parse trigger file");
+        return FAILURE;
+    }
+
+    logger.log_message("successfully parsed trigger file");
+
+    trigger_packets.clear();
+    packet_map.clear();
+
+    for(size_t i = 0; i < veh->num_packets; i++) {
+        std::unordered_set<trigger_t> l;
+        packet_map.push_back(l);
+    }
+
+    for(trigger_t t : triggers) {
+        // tv.add(t.meas);
+        for(location_info_t loc : t.meas->locations) {
+            trigger_packets.insert(loc.packet_index);
+            packet_map[loc.packet_index].insert(t);
+        }
+    }
+
+    return SUCCESS;
+}
+
+// free the VCM and telemetry objects
+void teardown() {
+    // don't let a signal use the viewer while it's freed
+    sigset_t mask, old_mask;
+    sigfillset(&mask);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+    if(tv) {
+        delete tv;
+        tv = NULL;
+    }
+
+    if(tw) {
+        delete tw;
+        tw = NULL;
     }
 
+    if(tshm) {
+        delete tshm;
+        tshm = NULL;
+    }
+
+    if(veh) {
+        delete veh;
+        veh = NULL;
+    }
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+// read the config and attach to telemetry shared memory
+int setup() {
+    MsgLogger logger("MMON", "setup");
+
     if(config_file == "") {
         veh = new VCM(); // use default config file
     } else {
@@ -68,99 +139,131 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    if(SUCCESS != sched::apply(veh, "mmon")) {
+        logger.log_message("failed to apply scheduling profile, running without it");
+    }
+
     if(veh->trigger_file == "") {
         logger.log_message("no trigger file specified");
         return 1;
     }
 
     // setup telemetry shm
-    if(tshm.init(veh) != SUCCESS) {
+    tshm = new TelemetryShm();
+    if(tshm->init(veh) != SUCCESS) {
         logger.log_message("failed to init telemetry shm");
         return -1;
     }
 
-    if(tshm.open() != SUCCESS) {
+    if(tshm->open() != SUCCESS) {
         logger.log_message("failed to open telemetry shm");
         return -1;
     }
 
     // setup telemetry viewer
-    if(tv.init(veh, &tshm)) {
+    TelemetryViewer* viewer = new TelemetryViewer();
+    if(viewer->init(veh, tshm)) {
         logger.log_message("failed to init telemetry viewer");
+        delete viewer;
         return -1;
     }
 
-    // setup telemetry viewer
-    if(tw.init(veh, &tshm)) {
-        logger.log_message("failed to init telemetry viewer");
+    // setup telemetry writer
+    tw = new TelemetryWriter();
+    if(tw->init(veh, tshm)) {
+        logger.log_message("failed to init telemetry writer");
+        delete viewer;
         return -1;
     }
 
-    tv.set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
+    viewer->set_update_mode(TelemetryViewer::BLOCKING_UPDATE);
 
-    // parse the trigger file
-    std::vector<trigger_t> triggers;
-    if(SUCCESS != parse_trigger_file(veh, &triggers)) {
-        logger.log_message("failed to parse trigger file");
+    // TODO add measurement that are triggers AND are arguments (we need to read them presumably)
+    // TODO or should this be all so each function has access to every measurement?
+    viewer->add_all();
+
+    // only visible to the signal handler once it's ready
+    tv = viewer;
+
+    if(SUCCESS != load_triggers()) {
         return -1;
     }
 
-    logger.log_message("successfully parsed trigger file");
-
-    // add signal handlers
-    signal(SIGINT, sighandler);
-    signal(SIGTERM, sighandler);
-    signal(SIGSEGV, sighandler);
-    signal(SIGFPE, sighandler);
-    signal(SIGABRT, sighandler);
+    return 0;
+}
 
-    // packets that cause a trigger to be executed
-    std::unordered_set<uint32_t> trigger_packets;
+int main(int argc, char** argv) {
+    MsgLogger logger("MMON", "main");
+    logger.log_message("starting mmon process");
 
-    // maps packet id to list of triggers to execute
-    std::vector<std::unordered_set<trigger_t>> packet_map;
+    // interpret the 1st argument as a config_file location if available
+    if(argc > 1) {
+        config_file = argv[1];
+    }
 
-    for(size_t i = 0; i < veh->num_packets; i++) {
-        std::unordered_set<trigger_t> l;
-        packet_map.push_back(l);
+    int ret = setup();
+    if(ret != 0) {
+        return ret;
     }
 
-    for(trigger_t t : triggers) {
-        // tv.add(t.meas);
-        for(location_info_t loc : t.meas->locations) {
-            trigger_packets.insert(loc.packet_index);
-            packet_map[loc.packet_index].insert(t);
-        }
+    // watch for changes to the trigger file
+    ConfigWatcher watcher;
+    if(SUCCESS != watcher.init(veh)) {
+        logger.log_message("failed to watch trigger file, changes to it require a restart");
     }
 
-    // TODO add measurement that are triggers AND are arguments (we need to read them presumably)
-    // TODO or should this be all so each function has access to every measurement?
-    tv.add_all();
+    // add signal handlers
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    signal(SIGSEGV, sighandler);
+    signal(SIGFPE, sighandler);
+    signal(SIGABRT, sighandler);
 
     // whether we should flush to shared memory
     uint8_t flush = 0;
 
+    uint32_t changed;
+
     // main logic
     while(!killed) {
-        if(SUCCESS != tv.update()) {
+        if(SUCCESS != tv->update()) {
             // move on
             continue;
         }
 
+        // the config was reloaded, start over with the new one
+        // a reload wakes us up so this is checked right away
+        if(tshm->reloaded()) {
+            logger.log_message("config reloaded, restarting");
+
+            teardown();
+            ret = setup();
+            if(ret != 0) {
+                return ret;
+            }
+
+            continue;
+        }
+
+        if(watcher.fd != -1 && SUCCESS == watcher.poll(&changed) && (changed & TRIGGERS_CHANGED)) {
+            logger.log_message("trigger file changed, reloading triggers");
+            load_triggers();
+        }
+
         // lock packets for writing
         // don't want anyone writing to our virtual packets at the same time
-        if(SUCCESS != tw.lock(false)) {
+        if(SUCCESS != tw->lock(false)) {
             continue;
         }
 
         // TODO can we parallelize some of this?
         // is the overhead worth it?
         for(uint32_t packet_id : trigger_packets) {
-            if(tshm.updated[packet_id]) {
+            if(tshm->updated[packet_id]) {
                 // this packet updated, process it's triggers
 
                 for(trigger_t t : packet_map[packet_id]) {
-                    if(SUCCESS == t.func(&tv, &tw, &(t.args))) {
+                    if(SUCCESS == t.func(tv, tw, &(t.args))) {
                         flush = 1;
                     }
                 }
@@ -169,14 +272,14 @@ int main(int argc, char** argv) {
 
         // flush any updates
         if(flush) {
-            tw.flush();
+            tw->flush();
             flush = 0;
         }
 
         // unlock packets so others waiting can write to virtual packets
         // don't check return, continues anyways
         // TODO something bad probably happens if this errors, since we increment semaphore again
-        tw.unlock();
+        tw->unlock();
     }
 
     return 1;
@@ -0,0 +1,158 @@
+/********************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Replication daemon, copies telemetry shared memory from the
+*           ground station receiving the vehicle (the primary) to other
+*           machines (replicas), so every app can run on a replica the
+*           same as it does on the primary, reading its own telemetry
+*           shared memory
+*
+*           The primary sends every packet that's written to its shared
+*           memory, with the packet's nonce and when it was written, to each
+*           replica connected over TCP and/or to a multicast group. A replica
+*           writes them into its own shared memory, which has to be made
+*           from the same config (shmctl -on). Packets whose layout differs
+*           from the primary's aren't replicated.
+*
+*           A replica that falls behind is sent the latest copy of each
+*           packet rather than every copy, one that reconnects is sent
+*           everything the primary has before anything new. Replicas keep
+*           ingest counters for what they receive, including how long each
+*           packet took to get from the primary (see app/ingest_view).
+*           See replicate.h for the messages.
+*
+*  Usage: ./replicate -primary [-tcp port] [-multicast group:port] [-rate bytes per second] [config file path]
+*         ./replicate -replica (-tcp primary:port | -multicast group:port) [config file path]
+*         The primary listens on TCP port 8300 if neither is given, '-rate' limits what's sent to
+*         each replica (and the group)
+*         If no VCM config file path is specified, the default location is used
+*
+*  Author: Will Merges
+*
+*  RIT Launch Initiative
+*********************************************************************/
+#include "replicate.h"
+#include "lib/dls/dls.h"
+#include "lib/vcm/vcm.h"
+#include "lib/sched/sched.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <arpa/inet.h>
+
+using namespace dls;
+using namespace vcm;
+
+static void usage() {
+    printf("usage: ./replicate -primary [-tcp port] [-multicast group:port] [-rate bytes per second] [config file]\n");
+    printf("       ./replicate -replica (-tcp primary:port | -multicast group:port) [config file]\n");
+}
+
+int main(int argc, char** argv) {
+    MsgLogger logger("REPLICATE", "main");
+
+    bool primary = false;
+    bool replica = false;
+    std::string tcp = "";
+    std::string multicast = "";
+    uint64_t rate = 0;
+    std::string config_file = "";
+
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if(arg == "-primary") {
+            primary = true;
+        } else if(arg == "-replica") {
+            replica = true;
+        } else if(arg == "-tcp" && i + 1 < argc) {
+            tcp = argv[++i];
+        } else if(arg == "-multicast" && i + 1 < argc) {
+            multicast = argv[++i];
+        } else if(arg == "-rate" && i + 1 < argc) {
+            try {
+                rate = std::stoull(argv[++i], NULL, 10);
+            } catch(std::exception& e) {
+                usage();
+                return -1;
+            }
+        } else if(arg[0] != '-' && config_file == "") {
+            config_file = arg;
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    if(primary == replica) {
+        usage();
+        return -1;
+    }
+
+    struct sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    if(multicast != "" && (SUCCESS != parse_addr(multicast, &group) || !IN_MULTICAST(ntohl(group.sin_addr.s_addr)))) {
+        printf("invalid multicast group: %s\n", multicast.c_str());
+        return -1;
+    }
+
+    uint16_t tcp_port = 0;
+    struct sockaddr_in remote;
+    memset(&remote, 0, sizeof(remote));
+
+    if(primary) {
+        if(tcp != "") {
+            try {
+                tcp_port = std::stoi(tcp, NULL, 10);
+            } catch(std::exception& e) {
+                tcp_port = 0;
+            }
+
+            if(tcp_port == 0) {
+                printf("invalid TCP port: %s\n", tcp.c_str());
+                return -1;
+            }
+        } else if(multicast == "") {
+            tcp_port = REPL_DEFAULT_PORT;
+        }
+    } else {
+        if((tcp == "") == (multicast == "")) {
+            usage();
+            return -1;
+        }
+
+        if(multicast != "") {
+            remote = group;
+        } else if(SUCCESS != parse_addr(tcp, &remote)) {
+            printf("invalid primary address: %s\n", tcp.c_str());
+            return -1;
+        }
+    }
+
+    VCM* veh;
+    if(config_file == "") {
+        veh = new VCM(); // use default config file
+    } else {
+        veh = new VCM(config_file); // use specified config file
+    }
+
+    if(veh->init() != SUCCESS) {
+        logger.log_message("failed to initialize VCM");
+        return -1;
+    }
+
+    if(SUCCESS != sched::apply(veh, "replicate")) {
+        logger.log_message("failed to apply scheduling profile, running without it");
+    }
+
+    if(primary) {
+        logger.log_message("starting replication primary");
+        run_primary(veh, tcp_port, &group, rate, argv);
+    } else {
+        logger.log_message("starting replica");
+        run_replica(veh, &remote, argv);
+    }
+
+    delete veh;
+    return 1;
+}
@@ -0,0 +1,674 @@
+#include "replicate.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/dls/dls.h"
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+
+/*
+*   The primary has two threads. One blocks on telemetry shared memory and
+*   pokes an eventfd whenever anything is written, the other does everything
+*   else from an epoll loop: it locks shared memory, marks every packet that
+*   changed as waiting to be sent to each replica, and copies waiting packets
+*   into each replica's queue while there's room.
+*
+*   This is the flow control. A replica's queue only takes more packets once
+*   the socket has taken most of what's in it, and a packet that changes again
+*   before it's sent is only sent once, with whatever it holds by then. So a
+*   slow replica (or link) gets fewer copies of each packet, always ending up
+*   on the latest, without holding up anyone else or growing the queue.
+*/
+
+using namespace dls;
+using namespace vcm;
+
+// a replica's queue takes more packets when it has less than this many bytes in it
+#define QUEUE_LOW 65536
+
+// most passes over the replicas for one wakeup, so one that drains fast can't keep us from the others
+#define MAX_PASSES 16
+
+// milliseconds epoll waits at most, how often the timers are checked
+#define TICK 100
+
+// a replica over TCP, or the multicast group
+typedef struct {
+    int fd;
+    bool multicast;
+    struct sockaddr_in addr; // peer or group
+    std::string name;
+
+    // packets waiting to be sent, they're sent with whatever is in shared memory when there's room
+    std::vector<bool> waiting;
+    size_t num_waiting;
+    uint32_t next; // packet to look at first, so they take turns when there isn't room for all of them
+
+    // messages waiting for room in the socket, from 'queue_start'
+    std::vector<uint8_t> queue;
+    size_t queue_start;
+    bool want_out; // EPOLLOUT is set
+
+    uint64_t seq;
+    uint64_t budget; // bytes it can be sent before the budget is topped up, if there's a rate limit
+
+    // since the stats were last logged
+    uint64_t sent;
+    uint64_t bytes;
+    uint64_t conflated; // copies that were never sent since a newer one replaced them
+} replica_t;
+
+// what the waker thread needs
+typedef struct {
+    VCM* veh;
+    int event_fd;
+} waker_args_t;
+
+static TelemetryShm* waker_shm = NULL;
+
+// interrupts the waker blocking in 'read_lock'
+static void waker_sighandler(int) {
+    if(waker_shm) {
+        waker_shm->sighandler();
+    }
+}
+
+// blocks on telemetry shared memory and pokes the eventfd every time something is written
+static void* waker(void* arg) {
+    waker_args_t* args = (waker_args_t*)arg;
+    MsgLogger logger("REPLICATE[primary]", "waker");
+
+    waker_shm = new TelemetryShm();
+    if(waker_shm->init(args->veh) != SUCCESS || waker_shm->open() != SUCCESS) {
+        logger.log_message("failed to attach to telemetry shared memory");
+        return NULL;
+    }
+
+    waker_shm->set_read_mode(TelemetryShm::BLOCKING_READ);
+
+    uint64_t one = 1;
+    while(1) {
+        RetType ret = waker_shm->read_lock();
+
+        if(ret == SUCCESS) {
+            waker_shm->read_unlock();
+
+            if(write(args->event_fd, &one, sizeof(one)) != sizeof(one)) {
+                logger.log_message("failed to wake up the sender");
+            }
+        } else {
+            // interrupted to stop, or something bad
+            break;
+        }
+
+        // the sender restarts, there's nothing more to wait for
+        if(waker_shm->reloaded()) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// everything the sender keeps
+typedef struct {
+    VCM* veh;
+    TelemetryShm shm;
+    int epoll_fd;
+    uint32_t session;
+    uint64_t rate;
+    uint64_t burst; // most budget a replica can save up, always enough for the biggest message
+
+    // latest nonce of each packet and when we saw it, packets we've never seen written aren't sent
+    std::vector<uint32_t> nonces;
+    std::vector<uint64_t> seen;
+    std::vector<bool> have;
+
+    std::vector<replica_t*> replicas;
+} primary_t;
+
+// start a message of 'type' with 'size' bytes after the header at the end of the queue of 'r'
+static uint8_t* queue_message(primary_t* p, replica_t* r, uint8_t type, size_t size) {
+    // whatever was sent is only moved out of the way once there's something new to go after it
+    if(r->queue_start > 0 && r->queue_start == r->queue.size()) {
+        r->queue.clear();
+        r->queue_start = 0;
+    }
+
+    size_t start = r->queue.size();
+    r->queue.resize(start + sizeof(repl_header_t) + size);
+
+    repl_header_t* header = (repl_header_t*)&r->queue[start];
+    header->magic = REPL_MAGIC;
+    header->version = REPL_VERSION;
+    header->type = type;
+    header->pad = 0;
+    header->size = size;
+    header->session = p->session;
+    header->seq = r->seq++;
+    header->time = realtime_ns();
+
+    return &r->queue[start + sizeof(repl_header_t)];
+}
+
+static void queue_config(primary_t* p, replica_t* r) {
+    uint8_t* body = queue_message(p, r, REPL_CONFIG, sizeof(repl_config_t) + p->veh->num_packets * sizeof(uint64_t));
+
+    repl_config_t* config = (repl_config_t*)body;
+    config->num_packets = p->veh->num_packets;
+    config->pad = 0;
+
+    uint8_t* layouts = body + sizeof(repl_config_t);
+    for(uint32_t i = 0; i < p->veh->num_packets; i++) {
+        uint64_t layout = p->veh->packet_layout(i);
+        memcpy(layouts + (i * sizeof(uint64_t)), &layout, sizeof(uint64_t));
+    }
+}
+
+// everything we have is waiting to be sent to 'r', after the config
+static void send_everything(primary_t* p, replica_t* r) {
+    queue_config(p, r);
+
+    for(uint32_t i = 0; i < p->veh->num_packets; i++) {
+        if(p->have[i] && !r->waiting[i]) {
+            r->waiting[i] = true;
+            r->num_waiting++;
+        }
+    }
+}
+
+static size_t queued(replica_t* r) {
+    return r->queue.size() - r->queue_start;
+}
+
+// copy waiting packets into the queue of 'r' until it's full (or out of budget)
+// NOTE: shared memory must be read locked
+static void fill(primary_t* p, replica_t* r) {
+    uint32_t num_packets = p->veh->num_packets;
+    uint32_t first = r->next;
+
+    for(uint32_t n = 0; n < num_packets && r->num_waiting > 0 && queued(r) < QUEUE_LOW; n++) {
+        uint32_t id = (first + n) % num_packets;
+        if(!r->waiting[id]) {
+            continue;
+        }
+
+        size_t size = p->veh->packets[id]->size;
+        size_t message_size = sizeof(repl_header_t) + sizeof(repl_packet_t) + size;
+        if(p->rate && r->budget < message_size) {
+            r->next = id;
+            return;
+        }
+
+        uint8_t* buffer = p->shm.get_buffer(id);
+        if(buffer == NULL) {
+            continue;
+        }
+
+        uint8_t* body = queue_message(p, r, REPL_PACKET, sizeof(repl_packet_t) + size);
+        repl_packet_t* packet = (repl_packet_t*)body;
+        packet->packet_id = id;
+        packet->nonce = p->nonces[id];
+        packet->seen = p->seen[id];
+        memcpy(body + sizeof(repl_packet_t), buffer, size);
+
+        r->waiting[id] = false;
+        r->num_waiting--;
+        r->next = (id + 1) % num_packets;
+
+        if(p->rate) {
+            r->budget -= message_size;
+        }
+    }
+}
+
+// watch for room in the socket of 'r' only while something is waiting for it
+static void want_out(primary_t* p, replica_t* r, bool want) {
+    if(r->want_out == want) {
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = r;
+    epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, r->fd, &event);
+
+    r->want_out = want;
+}
+
+// send as much of the queue of 'r' as the socket takes, returns FAILURE if the replica is gone
+static RetType flush(primary_t* p, replica_t* r) {
+    while(queued(r) > 0) {
+        ssize_t n;
+        size_t size = queued(r);
+
+        if(r->multicast) {
+            // one message per datagram
+            repl_header_t* header = (repl_header_t*)&r->queue[r->queue_start];
+            size = sizeof(repl_header_t) + header->size;
+            n = sendto(r->fd, &r->queue[r->queue_start], size, MSG_DONTWAIT, (struct sockaddr*)&r->addr,
+                       sizeof(r->addr));
+        } else {
+            n = send(r->fd, &r->queue[r->queue_start], size, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+
+        if(n > 0) {
+            r->queue_start += n;
+            r->bytes += n;
+            continue;
+        }
+
+        if(n == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            want_out(p, r, true);
+            return SUCCESS;
+        }
+
+        // a multicast datagram that can't be sent is dropped, the next refresh covers it
+        if(r->multicast) {
+            repl_header_t* header = (repl_header_t*)&r->queue[r->queue_start];
+            r->queue_start += sizeof(repl_header_t) + header->size;
+            continue;
+        }
+
+        return FAILURE;
+    }
+
+    want_out(p, r, false);
+    return SUCCESS;
+}
+
+static void drop_replica(primary_t* p, replica_t* r) {
+    MsgLogger logger("REPLICATE[primary]", "drop_replica");
+    logger.log_message("replica " + r->name + " disconnected");
+
+    epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, r->fd, NULL);
+    close(r->fd);
+
+    for(size_t i = 0; i < p->replicas.size(); i++) {
+        if(p->replicas[i] == r) {
+            p->replicas.erase(p->replicas.begin() + i);
+            break;
+        }
+    }
+
+    delete r;
+}
+
+static replica_t* add_replica(primary_t* p, int fd, struct sockaddr_in* addr, bool multicast) {
+    replica_t* r = new replica_t;
+    r->fd = fd;
+    r->multicast = multicast;
+    r->addr = *addr;
+
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+    r->name = std::string(ip) + ":" + std::to_string(ntohs(addr->sin_port));
+
+    r->waiting.assign(p->veh->num_packets, false);
+    r->num_waiting = 0;
+    r->next = 0;
+    r->queue_start = 0;
+    r->want_out = false;
+    r->seq = 0;
+    r->budget = p->burst;
+    r->sent = 0;
+    r->bytes = 0;
+    r->conflated = 0;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = r;
+    if(epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        MsgLogger logger("REPLICATE[primary]", "add_replica");
+        logger.log_message("failed to add socket to epoll set");
+        close(fd);
+        delete r;
+        return NULL;
+    }
+
+    p->replicas.push_back(r);
+    send_everything(p, r);
+
+    return r;
+}
+
+// take in whatever was written to shared memory, queue waiting packets for every replica and send them
+static void pump(primary_t* p) {
+    for(int pass = 0; pass < MAX_PASSES; pass++) {
+        if(p->shm.read_lock() != SUCCESS) {
+            return;
+        }
+
+        uint64_t now = realtime_ns();
+        for(uint32_t i = 0; i < p->veh->num_packets; i++) {
+            if(!p->shm.updated[i]) {
+                continue;
+            }
+
+            p->shm.packet_nonce(i, &p->nonces[i]);
+            p->seen[i] = now;
+            p->have[i] = true;
+
+            for(replica_t* r : p->replicas) {
+                if(r->waiting[i]) {
+                    r->conflated++;
+                } else {
+                    r->waiting[i] = true;
+                    r->num_waiting++;
+                }
+            }
+        }
+
+        for(replica_t* r : p->replicas) {
+            size_t before = r->num_waiting;
+            fill(p, r);
+            r->sent += before - r->num_waiting;
+        }
+
+        p->shm.read_unlock();
+
+        // another pass only if a replica emptied its queue and still has packets waiting
+        bool again = false;
+        std::vector<replica_t*> gone;
+        for(replica_t* r : p->replicas) {
+            if(flush(p, r) != SUCCESS) {
+                gone.push_back(r);
+            } else if(queued(r) == 0 && r->num_waiting > 0 && !p->rate) {
+                again = true;
+            }
+        }
+
+        for(replica_t* r : gone) {
+            drop_replica(p, r);
+        }
+
+        if(!again) {
+            return;
+        }
+    }
+}
+
+static int open_listener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, 8)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void accept_replica(primary_t* p, int listen_fd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    int fd = accept4(listen_fd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd == -1) {
+        return;
+    }
+
+    // packets are small and should go out as soon as they're queued
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    replica_t* r = add_replica(p, fd, &addr, false);
+    if(r) {
+        MsgLogger logger("REPLICATE[primary]", "accept_replica");
+        logger.log_message("replica " + r->name + " connected, sending " + std::to_string(r->num_waiting) +
+                           " packets to catch up");
+    }
+}
+
+static void log_stats(primary_t* p) {
+    MsgLogger logger("REPLICATE[primary]", "stats");
+
+    for(replica_t* r : p->replicas) {
+        logger.log_message("replica " + r->name + ": sent " + std::to_string(r->sent) + " packets, " +
+                           std::to_string(r->bytes) + " bytes, " + std::to_string(r->conflated) +
+                           " replaced before they were sent, " + std::to_string(queued(r)) + " bytes queued");
+        r->sent = 0;
+        r->bytes = 0;
+        r->conflated = 0;
+    }
+}
+
+static void clean_up(primary_t* p, pthread_t thread, int event_fd, int sig_fd, int listen_fd) {
+    // the waker may be blocked in shared memory, it has to let go before we do
+    pthread_kill(thread, SIGUSR1);
+    pthread_join(thread, NULL);
+
+    if(waker_shm) {
+        delete waker_shm;
+        waker_shm = NULL;
+    }
+
+    while(p->replicas.size() > 0) {
+        replica_t* r = p->replicas.back();
+        p->replicas.pop_back();
+        close(r->fd);
+        delete r;
+    }
+
+    close(p->epoll_fd);
+    close(event_fd);
+    close(sig_fd);
+
+    if(listen_fd != -1) {
+        close(listen_fd);
+    }
+}
+
+void run_primary(VCM* veh, uint16_t tcp_port, struct sockaddr_in* group, uint64_t rate, char** argv) {
+    MsgLogger logger("REPLICATE[primary]", "run_primary");
+
+    // a message is only sent once the budget covers all of it, so the rate has to allow at least one a second
+    if(rate && rate < max_message_size(veh)) {
+        logger.log_message("rate of " + std::to_string(rate) + " bytes per second is too low, biggest message is " +
+                           std::to_string(max_message_size(veh)) + " bytes");
+        return;
+    }
+
+    primary_t p;
+    p.veh = veh;
+    p.rate = rate;
+    p.burst = std::max(rate / 10, (uint64_t)max_message_size(veh));
+    p.nonces.assign(veh->num_packets, 0);
+    p.seen.assign(veh->num_packets, 0);
+    p.have.assign(veh->num_packets, false);
+
+    // a new session every start, replicas take everything from it even if the nonces went backwards
+    srand(realtime_ns() ^ getpid());
+    p.session = (uint32_t)rand();
+
+    if(p.shm.init(veh) != SUCCESS || p.shm.open() != SUCCESS) {
+        logger.log_message("failed to attach to telemetry shared memory");
+        return;
+    }
+
+    // we read whatever is there, the waker is the one that blocks
+    p.shm.set_read_mode(TelemetryShm::STANDARD_READ);
+
+    // kill signals are read from a signalfd, SIGUSR1 only ever goes to the waker
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if(sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        logger.log_message("failed to block kill signals");
+        return;
+    }
+
+    int sig_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    p.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(sig_fd == -1 || event_fd == -1 || p.epoll_fd == -1) {
+        logger.log_message("failed to create signalfd, eventfd or epoll instance");
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &sig_fd;
+    epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, sig_fd, &event);
+    event.data.ptr = &event_fd;
+    epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, event_fd, &event);
+
+    int listen_fd = -1;
+    if(tcp_port) {
+        listen_fd = open_listener(tcp_port);
+        if(listen_fd == -1) {
+            logger.log_message("failed to listen on TCP port " + std::to_string(tcp_port));
+            return;
+        }
+
+        event.data.ptr = &listen_fd;
+        epoll_ctl(p.epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+        logger.log_message("listening for replicas on TCP port " + std::to_string(tcp_port));
+    }
+
+    // whatever is already in shared memory, before any replica asks for it
+    if(p.shm.read_lock() == SUCCESS) {
+        for(uint32_t i = 0; i < veh->num_packets; i++) {
+            if(p.shm.updated[i]) {
+                p.shm.packet_nonce(i, &p.nonces[i]);
+                p.seen[i] = realtime_ns();
+                p.have[i] = true;
+            }
+        }
+        p.shm.read_unlock();
+    }
+
+    replica_t* mcast = NULL;
+    if(ntohs(group->sin_port) != 0) {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd == -1 || (mcast = add_replica(&p, fd, group, true)) == NULL) {
+            logger.log_message("failed to open multicast socket");
+            return;
+        }
+
+        logger.log_message("sending to multicast group " + mcast->name);
+    }
+
+    signal(SIGUSR1, waker_sighandler);
+
+    waker_args_t args;
+    args.veh = veh;
+    args.event_fd = event_fd;
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, waker, &args) != 0) {
+        logger.log_message("failed to start waker thread");
+        return;
+    }
+
+    uint64_t now = monotonic_ms();
+    uint64_t last_heartbeat = now;
+    uint64_t last_refresh = now;
+    uint64_t last_stats = now;
+    // bytes of budget handed out since 'budget_start', counted from the start so rounding doesn't lose any
+    uint64_t budget_start = now;
+    uint64_t credited = 0;
+
+    struct epoll_event events[32];
+    while(1) {
+        int num = epoll_wait(p.epoll_fd, events, 32, TICK);
+        if(num == -1 && errno != EINTR) {
+            logger.log_message("epoll_wait failed");
+            break;
+        }
+
+        for(int i = 0; i < num; i++) {
+            void* ptr = events[i].data.ptr;
+
+            if(ptr == &sig_fd) {
+                logger.log_message("received kill signal, cleaning up resources");
+                clean_up(&p, thread, event_fd, sig_fd, listen_fd);
+                return;
+            } else if(ptr == &event_fd) {
+                uint64_t count;
+                if(read(event_fd, &count, sizeof(count)) < 0) {
+                    // nothing there after all
+                }
+            } else if(ptr == &listen_fd) {
+                accept_replica(&p, listen_fd);
+            } else {
+                replica_t* r = (replica_t*)ptr;
+
+                // replicas never send anything, readable means they hung up
+                if(!r->multicast && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+                    uint8_t buffer[256];
+                    ssize_t n = recv(r->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+                    if(n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        drop_replica(&p, r);
+                    }
+                }
+            }
+        }
+
+        if(p.shm.reloaded()) {
+            clean_up(&p, thread, event_fd, sig_fd, listen_fd);
+            restart(argv);
+        }
+
+        now = monotonic_ms();
+
+        if(p.rate) {
+            uint64_t total = p.rate * (now - budget_start) / 1000;
+            if(total > credited) {
+                for(replica_t* r : p.replicas) {
+                    r->budget = std::min(r->budget + (total - credited), p.burst);
+                }
+                credited = total;
+            }
+        }
+
+        if(now - last_heartbeat >= REPL_HEARTBEAT_PERIOD) {
+            for(replica_t* r : p.replicas) {
+                queue_message(&p, r, REPL_HEARTBEAT, 0);
+            }
+            last_heartbeat = now;
+        }
+
+        if(mcast && now - last_refresh >= REPL_REFRESH_PERIOD) {
+            send_everything(&p, mcast);
+            last_refresh = now;
+        }
+
+        if(now - last_stats >= REPL_STATS_PERIOD) {
+            log_stats(&p);
+            last_stats = now;
+        }
+
+        pump(&p);
+    }
+
+    clean_up(&p, thread, event_fd, sig_fd, listen_fd);
+}
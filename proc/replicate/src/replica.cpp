@@ -0,0 +1,486 @@
+#include "replicate.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/IngestShm.h"
+#include "lib/nm/nm.h"
+#include "lib/dls/dls.h"
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+
+/*
+*   A replica is the only writer of its telemetry shared memory, decom (and
+*   anything writing virtual packets) shouldn't run alongside it. Everything
+*   that arrived in one read is written at once, the same as the single process
+*   decom does.
+*/
+
+using namespace dls;
+using namespace vcm;
+using namespace nm;
+
+// milliseconds poll waits at most, how often the timers are checked
+#define TICK 100
+
+// milliseconds between attempts to connect to the primary
+#define RECONNECT_PERIOD 1000
+
+// datagrams received at once from a multicast group
+#define RX_BATCH 64
+
+// everything the replica keeps
+typedef struct {
+    VCM* veh;
+    TelemetryShm shm;
+    IngestShm ingest;
+
+    // the primary's session, packets are only compared by nonce within one
+    bool have_session;
+    uint32_t session;
+    uint64_t next_seq;
+
+    // packets whose layout matches the primary's, none until its config arrives
+    bool have_config;
+    std::vector<bool> accept;
+
+    // nonce of the last write of each packet we took from the primary
+    std::vector<bool> have_nonce;
+    std::vector<uint32_t> nonces;
+
+    // packets to write once everything that arrived has been looked at
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t*> frames;
+
+    uint64_t last_message; // monotonic milliseconds
+
+    // since the stats were last logged
+    uint64_t received;
+    uint64_t written;
+    uint64_t lost;
+    uint64_t lag_total;
+    uint64_t lag_max;
+} replica_state_t;
+
+// a new stream started (a new connection or session), the sequence numbers start over
+static void new_stream(replica_state_t* st) {
+    st->next_seq = 0;
+    st->have_config = false;
+}
+
+static void take_config(replica_state_t* st, const uint8_t* body, size_t size) {
+    MsgLogger logger("REPLICATE[replica]", "take_config");
+
+    if(size < sizeof(repl_config_t)) {
+        logger.log_message("config message too short");
+        return;
+    }
+
+    repl_config_t* config = (repl_config_t*)body;
+    if(size != sizeof(repl_config_t) + ((size_t)config->num_packets * sizeof(uint64_t))) {
+        logger.log_message("config message has the wrong size");
+        return;
+    }
+
+    const uint8_t* layouts = body + sizeof(repl_config_t);
+    uint32_t matched = 0;
+    for(uint32_t i = 0; i < st->veh->num_packets; i++) {
+        uint64_t layout = 0;
+        if(i < config->num_packets) {
+            memcpy(&layout, layouts + (i * sizeof(uint64_t)), sizeof(uint64_t));
+        }
+
+        st->accept[i] = (i < config->num_packets && layout == st->veh->packet_layout(i));
+        matched += st->accept[i];
+    }
+
+    // only worth a message the first time in a stream, multicast repeats the config
+    if(!st->have_config && (matched != st->veh->num_packets || config->num_packets != st->veh->num_packets)) {
+        logger.log_message("config differs from the primary's, replicating " + std::to_string(matched) + " of " +
+                           std::to_string(st->veh->num_packets) + " packets (the primary has " +
+                           std::to_string(config->num_packets) + ")");
+    }
+
+    st->have_config = true;
+}
+
+static void take_packet(replica_state_t* st, uint8_t* body, size_t size) {
+    if(!st->have_config || size < sizeof(repl_packet_t)) {
+        return;
+    }
+
+    repl_packet_t* packet = (repl_packet_t*)body;
+    uint32_t id = packet->packet_id;
+
+    if(id >= st->veh->num_packets || !st->accept[id] || size - sizeof(repl_packet_t) != st->veh->packets[id]->size) {
+        return;
+    }
+
+    st->received++;
+
+    // already have this write (a catch up or refresh), or an older one arrived late
+    if(st->have_nonce[id] && (int32_t)(packet->nonce - st->nonces[id]) <= 0) {
+        return;
+    }
+
+    st->have_nonce[id] = true;
+    st->nonces[id] = packet->nonce;
+
+    // the clocks can be a little apart, a copy from the future arrived instantly
+    uint64_t now = realtime_ns();
+    uint64_t lag = (now > packet->seen) ? now - packet->seen : 0;
+
+    st->ingest.received(id, 1, st->veh->packets[id]->size, 0);
+    st->ingest.replicated(id, lag);
+
+    st->lag_total += lag;
+    if(lag > st->lag_max) {
+        st->lag_max = lag;
+    }
+    st->written++;
+
+    st->ids.push_back(id);
+    st->frames.push_back(body + sizeof(repl_packet_t));
+}
+
+// handle one 'size' byte message at 'msg', returns FAILURE if it isn't one
+static RetType take_message(replica_state_t* st, uint8_t* msg, size_t size) {
+    if(size < sizeof(repl_header_t)) {
+        return FAILURE;
+    }
+
+    repl_header_t* header = (repl_header_t*)msg;
+    if(header->magic != REPL_MAGIC || header->version != REPL_VERSION || header->size != size - sizeof(repl_header_t)) {
+        return FAILURE;
+    }
+
+    // the primary restarted, its nonces have nothing to do with the last session's
+    if(!st->have_session || header->session != st->session) {
+        if(st->have_session) {
+            MsgLogger logger("REPLICATE[replica]", "take_message");
+            logger.log_message("primary restarted, taking everything it sends");
+        }
+
+        st->have_session = true;
+        st->session = header->session;
+        st->have_nonce.assign(st->veh->num_packets, false);
+        new_stream(st);
+    }
+
+    // only a multicast stream can lose messages
+    if(header->seq > st->next_seq) {
+        st->lost += header->seq - st->next_seq;
+    }
+    st->next_seq = header->seq + 1;
+
+    st->last_message = monotonic_ms();
+
+    uint8_t* body = msg + sizeof(repl_header_t);
+    if(header->type == REPL_CONFIG) {
+        take_config(st, body, header->size);
+    } else if(header->type == REPL_PACKET) {
+        take_packet(st, body, header->size);
+    }
+
+    return SUCCESS;
+}
+
+// write everything taken since the last call to shared memory at once
+static void write_packets(replica_state_t* st) {
+    if(st->ids.size() == 0) {
+        return;
+    }
+
+    // no need to lock the packets for writing, we're the only writer
+    if(st->shm.write(st->ids.data(), st->frames.data(), st->ids.size()) == FAILURE) {
+        MsgLogger logger("REPLICATE[replica]", "write_packets");
+        logger.log_message("failed to write packets to shared memory");
+    }
+
+    st->ids.clear();
+    st->frames.clear();
+}
+
+static void log_stats(replica_state_t* st) {
+    MsgLogger logger("REPLICATE[replica]", "stats");
+
+    double lag_mean = st->written ? (double)st->lag_total / st->written / 1000000.0 : 0.0;
+    logger.log_message("received " + std::to_string(st->received) + " packets, wrote " + std::to_string(st->written) +
+                       ", lag mean " + std::to_string(lag_mean) + " ms, lag max " +
+                       std::to_string(st->lag_max / 1000000.0) + " ms, lost " + std::to_string(st->lost) + " messages");
+
+    st->received = 0;
+    st->written = 0;
+    st->lost = 0;
+    st->lag_total = 0;
+    st->lag_max = 0;
+}
+
+// connect to the primary at 'addr', waiting up to a second
+// returns the socket, or -1 if it couldn't connect
+static int connect_primary(struct sockaddr_in* addr) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        return -1;
+    }
+
+    if(connect(fd, (struct sockaddr*)addr, sizeof(struct sockaddr_in)) == -1 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if(poll(&pfd, 1, RECONNECT_PERIOD) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// the kill signal or a reloaded config, both mean we stop here
+static bool stopping(replica_state_t* st, int sig_fd, struct pollfd* sig, char** argv) {
+    if(sig->revents & POLLIN) {
+        MsgLogger logger("REPLICATE[replica]", "stopping");
+        logger.log_message("received kill signal, cleaning up resources");
+        close(sig_fd);
+        return true;
+    }
+
+    if(st->shm.reloaded()) {
+        close(sig_fd);
+        restart(argv);
+    }
+
+    return false;
+}
+
+// everything that happens once in a while
+static void timers(replica_state_t* st, uint64_t* last_stats) {
+    st->ingest.tick();
+
+    uint64_t now = monotonic_ms();
+    if(now - *last_stats >= REPL_STATS_PERIOD) {
+        log_stats(st);
+        *last_stats = now;
+    }
+}
+
+static void run_tcp(replica_state_t* st, struct sockaddr_in* addr, int sig_fd, char** argv) {
+    MsgLogger logger("REPLICATE[replica]", "run_tcp");
+
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+    std::string name = std::string(ip) + ":" + std::to_string(ntohs(addr->sin_port));
+
+    // always room for a whole message after part of the last one
+    std::vector<uint8_t> stream(2 * max_message_size(st->veh) + 65536);
+    size_t used = 0;
+
+    int fd = -1;
+    bool failing = false; // only the first failed attempt in a row is logged
+    uint64_t next_connect = 0;
+    uint64_t last_stats = monotonic_ms();
+
+    while(1) {
+        uint64_t now = monotonic_ms();
+
+        if(fd == -1 && now >= next_connect) {
+            fd = connect_primary(addr);
+
+            if(fd == -1) {
+                if(!failing) {
+                    logger.log_message("failed to connect to primary " + name + ", retrying");
+                }
+                failing = true;
+                next_connect = monotonic_ms() + RECONNECT_PERIOD;
+            } else {
+                // the primary starts every connection with its config and everything it has
+                logger.log_message("connected to primary " + name);
+                failing = false;
+                used = 0;
+                new_stream(st);
+                st->last_message = monotonic_ms();
+            }
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = sig_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        int num = poll(fds, (fd == -1) ? 1 : 2, TICK);
+        if(num == -1 && errno != EINTR) {
+            logger.log_message("poll failed");
+            break;
+        }
+
+        if(stopping(st, sig_fd, &fds[0], argv)) {
+            break;
+        }
+
+        bool drop = false;
+        if(fd != -1 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))) {
+            ssize_t n = recv(fd, stream.data() + used, stream.size() - used, MSG_DONTWAIT);
+
+            if(n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                logger.log_message("lost connection to primary " + name);
+                drop = true;
+            } else if(n > 0) {
+                used += n;
+
+                // every whole message, the rest waits for the next read
+                size_t start = 0;
+                while(!drop && used - start >= sizeof(repl_header_t)) {
+                    repl_header_t* header = (repl_header_t*)(stream.data() + start);
+                    size_t size = sizeof(repl_header_t) + header->size;
+
+                    if(header->magic != REPL_MAGIC || size > stream.size() / 2) {
+                        logger.log_message("bad message from primary " + name);
+                        drop = true;
+                    } else if(used - start < size) {
+                        break;
+                    } else {
+                        drop = (take_message(st, stream.data() + start, size) != SUCCESS);
+                        start += size;
+                    }
+                }
+
+                write_packets(st);
+
+                memmove(stream.data(), stream.data() + start, used - start);
+                used -= start;
+            }
+        }
+
+        if(fd != -1 && !drop && monotonic_ms() - st->last_message > REPL_TIMEOUT) {
+            logger.log_message("nothing from primary " + name + " for " + std::to_string(REPL_TIMEOUT) +
+                               " ms, reconnecting");
+            drop = true;
+        }
+
+        if(drop) {
+            st->ids.clear();
+            st->frames.clear();
+            close(fd);
+            fd = -1;
+            next_connect = monotonic_ms() + RECONNECT_PERIOD;
+        }
+
+        timers(st, &last_stats);
+    }
+
+    if(fd != -1) {
+        close(fd);
+    }
+}
+
+static void run_multicast(replica_state_t* st, struct sockaddr_in* group, int sig_fd, char** argv) {
+    MsgLogger logger("REPLICATE[replica]", "run_multicast");
+
+    NetworkReceiver net;
+    if(net.init(ntohs(group->sin_port), group->sin_addr.s_addr, 0, max_message_size(st->veh), RX_BATCH) != SUCCESS ||
+       net.set_nonblocking() != SUCCESS) {
+        logger.log_message("failed to join multicast group");
+        return;
+    }
+
+    // the primary resends everything every refresh, the first one brings us up to date
+    uint64_t last_stats = monotonic_ms();
+
+    while(1) {
+        struct pollfd fds[2];
+        fds[0].fd = sig_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = net.get_socket();
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        int num = poll(fds, 2, TICK);
+        if(num == -1 && errno != EINTR) {
+            logger.log_message("poll failed");
+            break;
+        }
+
+        if(stopping(st, sig_fd, &fds[0], argv)) {
+            break;
+        }
+
+        int n;
+        if((fds[1].revents & POLLIN) && (n = net.rx_batch()) > 0) {
+            for(int i = 0; i < n; i++) {
+                // anything else sent to the group is ignored
+                take_message(st, net.batch_buffers[i], net.batch_lengths[i]);
+            }
+
+            write_packets(st);
+        }
+
+        timers(st, &last_stats);
+    }
+}
+
+void run_replica(VCM* veh, struct sockaddr_in* addr, char** argv) {
+    MsgLogger logger("REPLICATE[replica]", "run_replica");
+
+    replica_state_t st;
+    st.veh = veh;
+    st.have_session = false;
+    st.session = 0;
+    st.next_seq = 0;
+    st.have_config = false;
+    st.accept.assign(veh->num_packets, false);
+    st.have_nonce.assign(veh->num_packets, false);
+    st.nonces.assign(veh->num_packets, 0);
+    st.last_message = monotonic_ms();
+    st.received = 0;
+    st.written = 0;
+    st.lost = 0;
+    st.lag_total = 0;
+    st.lag_max = 0;
+
+    if(st.shm.init(veh) != SUCCESS || st.shm.open() != SUCCESS) {
+        logger.log_message("failed to attach to telemetry shared memory");
+        return;
+    }
+
+    if(st.ingest.init(veh) != SUCCESS || st.ingest.open() != SUCCESS) {
+        logger.log_message("failed to attach to ingest shared memory, not keeping ingest counters");
+    }
+
+    // signals are read from the signalfd instead of interrupting us
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    if(sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        logger.log_message("failed to block kill signals");
+        return;
+    }
+
+    int sig_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if(sig_fd == -1) {
+        logger.log_message("failed to create signalfd");
+        return;
+    }
+
+    if(IN_MULTICAST(ntohl(addr->sin_addr.s_addr))) {
+        run_multicast(&st, addr, sig_fd, argv);
+    } else {
+        run_tcp(&st, addr, sig_fd, argv);
+    }
+}
@@ -0,0 +1,89 @@
+#include "replicate.h"
+#include "lib/dls/dls.h"
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+using namespace dls;
+using namespace vcm;
+
+size_t max_message_size(VCM* veh) {
+    size_t size = sizeof(repl_config_t) + (veh->num_packets * sizeof(uint64_t));
+
+    for(packet_info_t* packet : veh->packets) {
+        if(sizeof(repl_packet_t) + packet->size > size) {
+            size = sizeof(repl_packet_t) + packet->size;
+        }
+    }
+
+    return sizeof(repl_header_t) + size;
+}
+
+uint64_t realtime_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+uint64_t monotonic_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+RetType parse_addr(const std::string& str, struct sockaddr_in* addr) {
+    size_t colon = str.rfind(':');
+    if(colon == std::string::npos || colon == 0 || colon == str.size() - 1) {
+        return FAILURE;
+    }
+
+    std::string host = str.substr(0, colon);
+
+    int port;
+    try {
+        port = std::stoi(str.substr(colon + 1), NULL, 10);
+    } catch(std::exception& e) {
+        return FAILURE;
+    }
+
+    if(port <= 0 || port > 65535) {
+        return FAILURE;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+
+    struct addrinfo* res;
+    if(getaddrinfo(host.c_str(), NULL, &hints, &res) != 0 || res == NULL) {
+        return FAILURE;
+    }
+
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+    addr->sin_port = htons(port);
+
+    freeaddrinfo(res);
+    return SUCCESS;
+}
+
+void restart(char** argv) {
+    MsgLogger logger("REPLICATE", "restart");
+    logger.log_message("config reloaded, restarting");
+
+    // exec the binary /proc/self/exe points to, exec'ing the link itself would rename the process 'exe'
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if(len > 0) {
+        path[len] = '\0';
+        execv(path, argv);
+    }
+
+    logger.log_message("failed to restart");
+    exit(-1);
+}
@@ -0,0 +1,123 @@
+/*******************************************************************************
+* Name: replicate.h
+*
+* Purpose: Messages and shared pieces of the telemetry replication daemon
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef REPLICATE_H
+#define REPLICATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <netinet/in.h>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+/*
+* The primary sends a stream of messages to each replica over TCP, or one
+* stream to a multicast group, one message per datagram. Every message starts
+* with a header, and there are three kinds:
+*
+*   REPL_CONFIG    - the number of packets and the layout of each one (see
+*                    VCM::packet_layout), a replica only takes packets whose
+*                    layout matches its own config
+*   REPL_PACKET    - a packet's id, the nonce of the write on the primary,
+*                    when the primary saw the write, then the packet
+*   REPL_HEARTBEAT - nothing, sent every REPL_HEARTBEAT_PERIOD so a replica
+*                    can tell a quiet primary from a dead link
+*
+* A TCP stream starts with a config and then every packet the primary has,
+* so a replica that reconnects catches up before anything new arrives. The
+* multicast stream resends the config and every packet each
+* REPL_REFRESH_PERIOD instead, since nobody asks for it.
+*
+* A replica only writes a packet with a newer nonce than the last one it wrote
+* for the primary's session, so the catch up (or a refresh) doesn't look like
+* new data to the apps reading it. The session is picked at random when the
+* primary starts.
+*
+* Fields are in host byte order, every machine GSW runs on is little endian.
+* A big endian machine would see the wrong magic and drop everything.
+*/
+
+// 'REPL'
+#define REPL_MAGIC 0x4C504552
+#define REPL_VERSION 1
+
+// default TCP port the primary listens on
+#define REPL_DEFAULT_PORT 8300
+
+// milliseconds between heartbeats
+#define REPL_HEARTBEAT_PERIOD 1000
+
+// milliseconds without a message before a replica gives up on a TCP connection and reconnects
+#define REPL_TIMEOUT 3000
+
+// milliseconds between resending everything to a multicast group
+#define REPL_REFRESH_PERIOD 1000
+
+// milliseconds between logging what was sent or received
+#define REPL_STATS_PERIOD 10000
+
+typedef enum {
+    REPL_CONFIG = 1,
+    REPL_PACKET = 2,
+    REPL_HEARTBEAT = 3
+} repl_type_t;
+
+// starts every message
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;     // repl_type_t
+    uint16_t pad;
+    uint32_t size;    // bytes in the message after the header
+    uint32_t session; // picked at random when the primary starts
+    uint64_t seq;     // counts up by one every message in the stream
+    uint64_t time;    // CLOCK_REALTIME nanoseconds when the message was queued
+} repl_header_t;
+
+// after the header of a REPL_CONFIG, followed by 'num_packets' layouts (uint64_t)
+typedef struct __attribute__((packed)) {
+    uint32_t num_packets;
+    uint32_t pad;
+} repl_config_t;
+
+// after the header of a REPL_PACKET, followed by the packet
+typedef struct __attribute__((packed)) {
+    uint32_t packet_id;
+    uint32_t nonce;   // nonce of the write on the primary (see TelemetryShm::packet_nonce)
+    uint64_t seen;    // CLOCK_REALTIME nanoseconds when the primary saw the write
+} repl_packet_t;
+
+// biggest message for the packets of 'veh'
+size_t max_message_size(vcm::VCM* veh);
+
+// CLOCK_REALTIME in nanoseconds
+uint64_t realtime_ns();
+
+// CLOCK_MONOTONIC in milliseconds
+uint64_t monotonic_ms();
+
+// parse '[host]:[port]' into 'addr', the host can be a name
+RetType parse_addr(const std::string& str, struct sockaddr_in* addr);
+
+// start over as a new process with the same arguments, e.g. after the config was reloaded
+void restart(char** argv);
+
+// send telemetry shared memory for 'veh' to replicas, over TCP on 'tcp_port' if it's not 0 and to the
+// multicast group 'group' if its port isn't 0
+// each replica (or the group) is sent at most 'rate' bytes per second, unless 'rate' is 0
+// only returns if something bad happens
+void run_primary(vcm::VCM* veh, uint16_t tcp_port, struct sockaddr_in* group, uint64_t rate, char** argv);
+
+// write telemetry from a primary into telemetry shared memory for 'veh', connecting to the primary at 'addr'
+// over TCP, or receiving from 'addr' if it's a multicast group
+// only returns if something bad happens
+void run_replica(vcm::VCM* veh, struct sockaddr_in* addr, char** argv);
+
+#endif
@@ -2,10 +2,17 @@
 #include <string.h>
 #include <iostream>
 #include <string>
+#include <signal.h>
+#include <unistd.h>
 #include "lib/vcm/vcm.h"
+#include "lib/vcm/image.h"
+#include "lib/vcm/watch.h"
 #include "lib/shm/shm.h"
 #include "lib/dls/dls.h"
 #include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/HistoryShm.h"
+#include "lib/telemetry/EnvelopeShm.h"
+#include "lib/telemetry/IngestShm.h"
 #include "common/types.h"
 #include "lib/nm/NmShm.h"
 #include "lib/clock/clock.h"
@@ -13,7 +20,12 @@
 
 // run as shmctl -on or shmctl -off to create and destroy shared memory
 // option -f argument to specify VCM config file (current default used otherwise)
-// use as shmctl (-on | -off) [-f path_to_config_file]
+// use as shmctl (-on | -off | -reload | -watch) [-f path_to_config_file]
+//
+// -reload switches telemetry shared memory over to the current config file after it changed
+// -watch keeps running and reloads every time the config file changes
+// packets that didn't change keep their shared memory and data (see TelemetryShm::reload)
+// ingest counters start over for the new config (see IngestShm::reload)
 
 using namespace vcm;
 using namespace shm;
@@ -22,6 +34,102 @@ using namespace countdown_clock;
 
 bool on = false;
 bool off = false;
+bool reload = false;
+bool watch = false;
+
+bool killed = false;
+
+void sighandler(int) {
+    killed = true;
+}
+
+// validate the config file and switch telemetry shared memory over to it
+RetType reload_config(std::string& config_file) {
+    MsgLogger logger("SHMCTL", "reload_config");
+
+    VCM* next;
+    if(config_file == "") {
+        next = new VCM(); // use default config file
+    } else {
+        next = new VCM(config_file); // use specified config file
+    }
+
+    if(SUCCESS != next->init()) {
+        printf("new config is invalid, keeping the old one\n");
+        logger.log_message("new config is invalid, keeping the old one");
+        delete next;
+        return FAILURE;
+    }
+
+    // keep the compiled image up to date so processes starting over don't parse the config
+    std::string image_file = next->config_file + image::VCM_IMAGE_SUFFIX;
+    if(access(image_file.c_str(), F_OK) == 0 && SUCCESS != next->compile(image_file)) {
+        logger.log_message("failed to recompile VCM image, processes will parse the config instead");
+    }
+
+    // the counters are sized for the packets in the config
+    // replaced first so decom finds the new ones once it sees the reload
+    IngestShm ingest_shm;
+    if(SUCCESS != ingest_shm.init(next) || SUCCESS != ingest_shm.reload()) {
+        printf("failed to reload ingest shared memory\n");
+        logger.log_message("failed to reload ingest shared memory");
+    }
+
+    RetType ret;
+    {
+        TelemetryShm tlm_shm;
+        ret = tlm_shm.init(next);
+
+        if(SUCCESS == ret) {
+            ret = tlm_shm.reload();
+        }
+    }
+
+    if(SUCCESS == ret) {
+        printf("reloaded telemetry shared memory\n");
+        logger.log_message("reloaded telemetry shared memory");
+    } else {
+        printf("failed to reload telemetry shared memory\n");
+        logger.log_message("failed to reload telemetry shared memory");
+    }
+
+    delete next;
+    return ret;
+}
+
+// reload every time the config file changes
+RetType watch_config(VCM* vcm, std::string& config_file) {
+    MsgLogger logger("SHMCTL", "watch_config");
+
+    ConfigWatcher watcher;
+    if(SUCCESS != watcher.init(vcm)) {
+        logger.log_message("failed to watch config");
+        return FAILURE;
+    }
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+
+    logger.log_message("watching config file: " + vcm->config_file);
+
+    uint32_t changed;
+    while(!killed) {
+        if(SUCCESS != watcher.wait(&changed)) {
+            continue;
+        }
+
+        if(changed & HISTORY_CHANGED) {
+            logger.log_message("history file changed, GSW must be restarted for it to take effect");
+        }
+
+        if(changed & CONFIG_CHANGED) {
+            logger.log_message("config file changed, reloading");
+            reload_config(config_file);
+        }
+    }
+
+    return SUCCESS;
+}
 
 int main(int argc, char* argv[]) {
     MsgLogger logger("SHMCTL");
@@ -29,10 +137,14 @@ int main(int argc, char* argv[]) {
     std::string config_file = "";
 
     for(int i = 1; i < argc; i++) {
-        if(!strcmp(argv[i], "-on") && !off) {
+        if(!strcmp(argv[i], "-on") && !off && !reload && !watch) {
             on = true;
-        } else if(!strcmp(argv[i], "-off") && !on) {
+        } else if(!strcmp(argv[i], "-off") && !on && !reload && !watch) {
             off = true;
+        } else if(!strcmp(argv[i], "-reload") && !on && !off && !watch) {
+            reload = true;
+        } else if(!strcmp(argv[i], "-watch") && !on && !off && !reload) {
+            watch = true;
         } else if(!strcmp(argv[i], "-f")) {
             if(i + 1 > argc) {
                 logger.log_message("Must specify a path to the config file after using the -f option");
@@ -68,6 +180,12 @@ int main(int argc, char* argv[]) {
         return FAILURE;
     }
 
+    if(reload) {
+        return reload_config(config_file);
+    } else if(watch) {
+        return watch_config(vcm, config_file);
+    }
+
     CountdownClock cl;
     if(cl.init() == FAILURE) {
         printf("failed to initialize countdown clock\n");
@@ -91,6 +209,31 @@ int main(int argc, char* argv[]) {
         return FAILURE;
     }
 
+    // history is optional
+    HistoryShm hist_shm;
+    RetType hist_status = hist_shm.init(vcm);
+    if(FAILURE == hist_status) {
+        printf("failed to initialize history shm controller\n");
+        logger.log_message("failed to initialize history shm controller");
+        return FAILURE;
+    }
+    bool history = (SUCCESS == hist_status);
+
+    // envelopes are kept whenever history is
+    EnvelopeShm env_shm;
+    if(history && SUCCESS != env_shm.init(vcm)) {
+        printf("failed to initialize envelope shm controller\n");
+        logger.log_message("failed to initialize envelope shm controller");
+        return FAILURE;
+    }
+
+    IngestShm ingest_shm;
+    if(ingest_shm.init(vcm) == FAILURE) {
+        printf("failed to initialize ingest shm controller\n");
+        logger.log_message("failed to initialize ingest shm controller");
+        return FAILURE;
+    }
+
     RetType ret = SUCCESS;
     if(on) {
         printf("creating shared memory\n");
@@ -105,6 +248,35 @@ int main(int argc, char* argv[]) {
             logger.log_message("created telemetry shared memory");
         }
 
+        if(FAILURE == ingest_shm.create()) {
+            printf("failed to create ingest shared memory\n");
+            logger.log_message("failed to create ingest shared memory");
+            ret = FAILURE;
+        } else {
+            printf("created ingest shared memory\n");
+            logger.log_message("created ingest shared memory");
+        }
+
+        if(history) {
+            if(FAILURE == hist_shm.create()) {
+                printf("failed to create history shared memory\n");
+                logger.log_message("failed to create history shared memory");
+                ret = FAILURE;
+            } else {
+                printf("created history shared memory\n");
+                logger.log_message("created history shared memory");
+            }
+
+            if(FAILURE == env_shm.create()) {
+                printf("failed to create envelope shared memory\n");
+                logger.log_message("failed to create envelope shared memory");
+                ret = FAILURE;
+            } else {
+                printf("created envelope shared memory\n");
+                logger.log_message("created envelope shared memory");
+            }
+        }
+
         if(vcm->num_net_devices > 0) {
             if(FAILURE == nm_shm.create()) {
                 printf("failed to create network manager shared memory\n");
@@ -139,14 +311,36 @@ int main(int argc, char* argv[]) {
         printf("destroying shared memory\n");
         logger.log_message("destroying shared memory");
 
-        if(FAILURE == tlm_shm.open()) {
-            printf("telemetry shared memory not created, nothing to destroy\n");
-            logger.log_message("telemetry shared memory not created, nothing to destroy");
+        // doesn't need to be attached, shared memory may have been made from an older config
+        if(FAILURE == tlm_shm.destroy()) {
+            printf("failed to destroy telemetry shared memory\n");
+            logger.log_message("failed to destroy telemetry shared memory");
+            ret = FAILURE;
+        }
+
+        if(FAILURE == ingest_shm.open()) {
+            printf("ingest shared memory not created, nothing to destroy\n");
+            logger.log_message("ingest shared memory not created, nothing to destroy");
             ret = FAILURE;
         } else {
-            if(FAILURE == tlm_shm.destroy()) {
-                printf("failed to destroy telemetry shared memory\n");
-                logger.log_message("failed to destroy telemetry shared memory");
+            if(FAILURE == ingest_shm.destroy()) {
+                printf("failed to destroy ingest shared memory\n");
+                logger.log_message("failed to destroy ingest shared memory");
+                ret = FAILURE;
+            }
+        }
+
+        if(history) {
+            // doesn't need to be attached, history may have been made from an older history file
+            if(FAILURE == hist_shm.destroy()) {
+                printf("failed to destroy history shared memory\n");
+                logger.log_message("failed to destroy history shared memory");
+                ret = FAILURE;
+            }
+
+            if(FAILURE == env_shm.destroy()) {
+                printf("failed to destroy envelope shared memory\n");
+                logger.log_message("failed to destroy envelope shared memory");
                 ret = FAILURE;
             }
         }
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/dev/crc/crc.h"
+
+// checks CRC32C checksums (lib/dev/crc), both the CRC instructions and the table, which is otherwise only used
+// on CPUs without them
+
+// standard check value, CRC32C of "123456789"
+#define CHECK_VALUE 0xE3069283
+
+int main() {
+    srand(1);
+
+    printf("using %s\n", crc32c_hw() ? "CRC instructions" : "table");
+
+    const uint8_t* digits = (const uint8_t*)"123456789";
+    if(crc32c(0, digits, 9) != CHECK_VALUE || crc32c_table(0, digits, 9) != CHECK_VALUE) {
+        printf("Wrong check value\n");
+        return -1;
+    }
+
+    if(crc32c(0, NULL, 0) != 0 || crc32c_table(0, NULL, 0) != 0) {
+        printf("CRC of nothing isn't 0\n");
+        return -1;
+    }
+
+    // every length up to a few blocks of 8 at every alignment, whole and split in two
+    uint8_t buffer[1024 + 8];
+    for(size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = rand();
+    }
+
+    for(size_t offset = 0; offset < 8; offset++) {
+        for(size_t len = 0; len <= 1024; len++) {
+            const uint8_t* data = buffer + offset;
+            uint32_t whole = crc32c(0, data, len);
+
+            if(whole != crc32c_table(0, data, len)) {
+                printf("CRC doesn't match the table, %zu bytes at offset %zu\n", len, offset);
+                return -1;
+            }
+
+            size_t half = len / 3;
+            if(crc32c(crc32c(0, data, half), data + half, len - half) != whole ||
+               crc32c_table(crc32c_table(0, data, half), data + half, len - half) != whole) {
+                printf("Continued CRC doesn't match, %zu bytes at offset %zu\n", len, offset);
+                return -1;
+            }
+        }
+    }
+
+    // the 4 bytes of the CRC in a packet aren't part of it, wherever they are
+    uint8_t packet[64];
+    uint8_t rest[64];
+
+    for(size_t offset = 0; offset + CRC32C_SIZE <= sizeof(packet); offset++) {
+        for(size_t i = 0; i < sizeof(packet); i++) {
+            packet[i] = rand();
+        }
+
+        memcpy(rest, packet, offset);
+        memcpy(rest + offset, packet + offset + CRC32C_SIZE, sizeof(packet) - offset - CRC32C_SIZE);
+
+        uint32_t crc = crc32c_packet(packet, sizeof(packet), offset);
+        if(crc != crc32c(0, rest, sizeof(packet) - CRC32C_SIZE)) {
+            printf("Packet CRC isn't of every other byte, CRC at offset %zu\n", offset);
+            return -1;
+        }
+
+        memcpy(packet + offset, &crc, CRC32C_SIZE);
+        if(crc32c_packet(packet, sizeof(packet), offset) != crc) {
+            printf("Packet CRC changes with the CRC in the packet, CRC at offset %zu\n", offset);
+            return -1;
+        }
+    }
+
+    printf("Success\n");
+}
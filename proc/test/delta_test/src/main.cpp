@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/dev/delta/delta.h"
+
+// checks the delta encoding of telemetry packets (lib/dev/delta)
+
+// big enough for runs longer than the longest run (128 bytes)
+#define SIZE 300
+
+// change a few bytes of 'packet', sometimes a long stretch of it
+static void mutate(uint8_t* packet) {
+    int changes = rand() % 4;
+    for(int i = 0; i < changes; i++) {
+        packet[rand() % SIZE] = rand();
+    }
+
+    if(rand() % 8 == 0) {
+        size_t start = rand() % (SIZE - 200);
+        for(size_t i = start; i < start + 200; i++) {
+            packet[i] = rand();
+        }
+    }
+}
+
+typedef struct {
+    uint8_t last[SIZE];
+    uint8_t packet[SIZE];
+    delta_encoder_t enc;
+    delta_decoder_t dec;
+} pair_t;
+
+static void init_pair(pair_t* p, uint32_t keyframe_interval) {
+    delta_encoder_init(&p->enc, p->last, SIZE, keyframe_interval);
+    delta_decoder_init(&p->dec, p->packet, SIZE);
+}
+
+// encode a stream of packets and decode every one, checking each comes out the same
+static bool round_trip() {
+    pair_t p;
+    init_pair(&p, 20);
+
+    uint8_t packet[SIZE];
+    memset(packet, 0, SIZE);
+    uint8_t out[DELTA_MAX_SIZE(SIZE)];
+
+    size_t deltas = 0;
+    size_t bytes = 0;
+
+    // more than 256 so the count wraps around
+    for(int i = 0; i < 1000; i++) {
+        mutate(packet);
+
+        size_t len = delta_encode(&p.enc, packet, out);
+        bytes += len;
+        if(out[0] == DELTA_XOR) {
+            deltas++;
+        }
+
+        uint32_t missed;
+        if(delta_decode(&p.dec, out, len, &missed) != DELTA_OK || missed != 0) {
+            printf("Failed to decode datagram %d\n", i);
+            return false;
+        }
+
+        if(memcmp(p.dec.packet, packet, SIZE) != 0) {
+            printf("Decoded packet %d doesn't match the encoded one\n", i);
+            return false;
+        }
+    }
+
+    if(deltas == 0 || bytes >= 1000 * DELTA_MAX_SIZE(SIZE)) {
+        printf("Deltas aren't smaller than keyframes\n");
+        return false;
+    }
+
+    return true;
+}
+
+// keyframes come first, at least every interval, and when forced
+static bool keyframes() {
+    pair_t p;
+    init_pair(&p, 5);
+
+    uint8_t packet[SIZE];
+    memset(packet, 0, SIZE);
+    uint8_t out[DELTA_MAX_SIZE(SIZE)];
+
+    delta_encode(&p.enc, packet, out);
+    if(out[0] != DELTA_KEYFRAME) {
+        printf("First datagram isn't a keyframe\n");
+        return false;
+    }
+
+    for(int i = 1; i <= 20; i++) {
+        delta_encode(&p.enc, packet, out);
+        if((out[0] == DELTA_KEYFRAME) != (i % 5 == 0)) {
+            printf("Keyframe not every interval, datagram %d\n", i);
+            return false;
+        }
+    }
+
+    delta_encode(&p.enc, packet, out);
+    if(out[0] != DELTA_XOR || delta_encode(&p.enc, packet, out) != DELTA_HEADER_SIZE) {
+        printf("Unchanged packet isn't a delta with no runs\n");
+        return false;
+    }
+
+    delta_force_keyframe(&p.enc);
+    delta_encode(&p.enc, packet, out);
+    if(out[0] != DELTA_KEYFRAME) {
+        printf("Forced keyframe isn't a keyframe\n");
+        return false;
+    }
+
+    return true;
+}
+
+// lost, repeated and bad datagrams
+static bool losses() {
+    pair_t p;
+    init_pair(&p, 100);
+
+    uint8_t packet[SIZE];
+    memset(packet, 0, SIZE);
+    uint8_t out[4][DELTA_MAX_SIZE(SIZE)];
+    size_t len[4];
+
+    for(int i = 0; i < 4; i++) {
+        packet[i] = i + 1;
+        len[i] = delta_encode(&p.enc, packet, out[i]);
+    }
+
+    uint32_t missed;
+    if(delta_decode(&p.dec, out[0], len[0], &missed) != DELTA_OK) {
+        printf("Failed to decode keyframe\n");
+        return false;
+    }
+
+    // datagram 1 is lost
+    if(delta_decode(&p.dec, out[2], len[2], &missed) != DELTA_WAITING || missed != 1) {
+        printf("Delta after a gap doesn't wait for a keyframe\n");
+        return false;
+    }
+
+    if(delta_decode(&p.dec, out[3], len[3], &missed) != DELTA_WAITING || missed != 0) {
+        printf("Deltas don't keep waiting for a keyframe\n");
+        return false;
+    }
+
+    if(delta_decode(&p.dec, out[1], len[1], &missed) != DELTA_OLD) {
+        printf("Datagram from before the last isn't old\n");
+        return false;
+    }
+
+    if(delta_decode(&p.dec, out[3], len[3], &missed) != DELTA_OLD) {
+        printf("Repeated datagram isn't old\n");
+        return false;
+    }
+
+    delta_force_keyframe(&p.enc);
+    uint8_t key[DELTA_MAX_SIZE(SIZE)];
+    size_t key_len = delta_encode(&p.enc, packet, key);
+    if(delta_decode(&p.dec, key, key_len, &missed) != DELTA_OK || memcmp(p.dec.packet, packet, SIZE) != 0) {
+        printf("Keyframe doesn't resync\n");
+        return false;
+    }
+
+    // runs past the end of the packet
+    uint8_t bad[DELTA_MAX_SIZE(SIZE)];
+    size_t n = 0;
+    bad[n++] = DELTA_XOR;
+    bad[n++] = p.dec.next;
+    bad[n++] = 0x80 | 127;
+    bad[n++] = 0x80 | 127;
+    bad[n++] = 0x80 | 127;
+    bad[n++] = 0;
+    bad[n++] = 0xFF;
+    if(delta_decode(&p.dec, bad, n, &missed) != DELTA_ERR) {
+        printf("Runs past the end of the packet decoded\n");
+        return false;
+    }
+
+    uint8_t after[DELTA_MAX_SIZE(SIZE)];
+    packet[0]++;
+    size_t after_len = delta_encode(&p.enc, packet, after);
+    after[1] = p.dec.next;
+    if(after[0] != DELTA_XOR || delta_decode(&p.dec, after, after_len, &missed) != DELTA_WAITING) {
+        printf("Delta after a bad datagram doesn't wait for a keyframe\n");
+        return false;
+    }
+
+    // a run that says there are more bytes than the datagram has
+    n = 0;
+    bad[n++] = DELTA_XOR;
+    bad[n++] = p.dec.next;
+    bad[n++] = 10;
+    bad[n++] = 0xFF;
+    if(delta_decode(&p.dec, bad, n, &missed) != DELTA_ERR) {
+        printf("Truncated run decoded\n");
+        return false;
+    }
+
+    bad[0] = DELTA_KEYFRAME;
+    bad[1] = p.dec.next;
+    if(delta_decode(&p.dec, bad, DELTA_MAX_SIZE(SIZE) - 1, &missed) != DELTA_ERR) {
+        printf("Short keyframe decoded\n");
+        return false;
+    }
+
+    bad[0] = 0x7F;
+    bad[1] = p.dec.next;
+    if(delta_decode(&p.dec, bad, 4, &missed) != DELTA_ERR) {
+        printf("Unknown kind decoded\n");
+        return false;
+    }
+
+    if(delta_decode(&p.dec, bad, 1, &missed) != DELTA_ERR) {
+        printf("Datagram with no header decoded\n");
+        return false;
+    }
+
+    return true;
+}
+
+// the encoder restarts (e.g. the vehicle rebooted), its count starts over from 0
+static bool restart() {
+    pair_t p;
+    init_pair(&p, 100);
+
+    uint8_t packet[SIZE];
+    memset(packet, 0, SIZE);
+    uint8_t out[DELTA_MAX_SIZE(SIZE)];
+    uint32_t missed;
+
+    // far enough along that 0 looks like it's from before the last datagram
+    for(int i = 0; i < 10; i++) {
+        size_t len = delta_encode(&p.enc, packet, out);
+        delta_decode(&p.dec, out, len, &missed);
+    }
+
+    delta_encoder_init(&p.enc, p.last, SIZE, 100);
+    packet[0] = 0xAA;
+
+    size_t len = delta_encode(&p.enc, packet, out);
+    if(delta_decode(&p.dec, out, len, &missed) != DELTA_OK || memcmp(p.dec.packet, packet, SIZE) != 0) {
+        printf("Keyframe from a restarted encoder doesn't resync\n");
+        return false;
+    }
+
+    packet[1] = 0xBB;
+    len = delta_encode(&p.enc, packet, out);
+    if(delta_decode(&p.dec, out, len, &missed) != DELTA_OK || missed != 0 || memcmp(p.dec.packet, packet, SIZE) != 0) {
+        printf("Failed to decode a delta after the restart\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    srand(1);
+
+    if(!round_trip() || !keyframes() || !losses() || !restart()) {
+        return -1;
+    }
+
+    printf("Success\n");
+}
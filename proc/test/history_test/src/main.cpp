@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "lib/telemetry/HistoryShm.h"
+
+// checks every sample appended to history comes back out of shared memory bit for bit
+// uses the first measurement in the history file of the config and creates and destroys history shared memory
+// itself, so shared memory must be off (shmctl -off) and the history process not running
+// run as: ./test [config file path]
+
+// what was appended, to compare with what's read back
+typedef struct {
+    std::vector<uint64_t> times;
+    std::vector<double> values;
+} samples_t;
+
+static HistoryShm hist;
+static measurement_info_t* meas;
+
+// start over with empty history
+static bool fresh() {
+    if(SUCCESS != hist.destroy() || SUCCESS != hist.create() || SUCCESS != hist.open()) {
+        printf("Failed to recreate history shared memory\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void append(samples_t* s, uint64_t t, double v) {
+    if(SUCCESS == hist.append(meas, t, v)) {
+        s->times.push_back(t);
+        s->values.push_back(v);
+    }
+}
+
+// true if the samples read in [t0, t1] are the ones of 's' in [t0, t1], bit for bit
+// NaNs only compare equal bitwise
+static bool same(samples_t* s, uint64_t t0, uint64_t t1) {
+    std::vector<uint64_t> times;
+    std::vector<double> values;
+    if(SUCCESS != hist.read(meas, t0, t1, &times, &values)) {
+        return false;
+    }
+
+    size_t j = 0;
+    for(size_t i = 0; i < s->times.size(); i++) {
+        if(s->times[i] < t0 || s->times[i] > t1) {
+            continue;
+        }
+
+        if(j >= times.size() || times[j] != s->times[i] || memcmp(&values[j], &s->values[i], sizeof(double)) != 0) {
+            return false;
+        }
+
+        j++;
+    }
+
+    return j == times.size() && j > 0;
+}
+
+static double random_double() {
+    uint64_t bits = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ rand();
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// regular samples with jitter, slowly changing values
+static bool round_trip() {
+    if(!fresh()) {
+        return false;
+    }
+
+    samples_t s;
+    uint64_t t = 1700000000000000ULL;
+    double v = 20.0;
+
+    for(int i = 0; i < 2000; i++) {
+        t += 1000 + (rand() % 3) - 1;
+        v += (rand() % 100) / 1000.0 - 0.05;
+        append(&s, t, v);
+    }
+
+    if(s.times.size() != 2000) {
+        printf("Failed to append every sample\n");
+        return false;
+    }
+
+    if(!same(&s, 0, UINT64_MAX)) {
+        printf("Slowly changing samples read back wrong\n");
+        return false;
+    }
+
+    if(!same(&s, s.times[500], s.times[1500])) {
+        printf("Part of the history read back wrong\n");
+        return false;
+    }
+
+    return true;
+}
+
+// values that change every bit fill blocks with the most bits per sample, and timestamps that jump use the
+// widest delta of delta
+static bool full_blocks() {
+    if(!fresh()) {
+        return false;
+    }
+
+    samples_t s;
+    uint64_t t = 1700000000000000ULL;
+
+    // about 20 blocks worth, so blocks fill up right to the end
+    for(int i = 0; i < 8000; i++) {
+        switch(rand() % 4) {
+            case 0: t += 1; break;
+            case 1: t += 100000; break;
+            case 2: t += (uint64_t)rand() * 1000; break;
+            default: break; // same timestamp as the last
+        }
+
+        append(&s, t, random_double());
+    }
+
+    if(s.times.size() != 8000) {
+        printf("Failed to append every random sample\n");
+        return false;
+    }
+
+    if(!same(&s, 0, UINT64_MAX)) {
+        printf("Random samples read back wrong across full blocks\n");
+        return false;
+    }
+
+    return true;
+}
+
+// delta of deltas right at the edges of each width they're stored in, both ways
+static bool delta_widths() {
+    if(!fresh()) {
+        return false;
+    }
+
+    int64_t edges[] = {0, 1, 63, 64, 65, 127, 128, 8191, 8192, 8193, 524287, 524288, 524289, 1LL << 40};
+
+    samples_t s;
+    uint64_t t = 1700000000000000ULL;
+    int64_t delta = 1LL << 41; // big enough that the delta never goes negative
+    append(&s, t, 0.0);
+
+    for(int64_t edge : edges) {
+        for(int sign = 1; sign >= -1; sign -= 2) {
+            delta += sign * edge;
+            t += delta;
+            append(&s, t, (double)edge);
+        }
+    }
+
+    if(s.times.size() != 1 + 2 * sizeof(edges) / sizeof(edges[0])) {
+        printf("Failed to append samples at every width\n");
+        return false;
+    }
+
+    if(!same(&s, 0, UINT64_MAX)) {
+        printf("Delta of delta at the edge of a width read back wrong\n");
+        return false;
+    }
+
+    return true;
+}
+
+// doubles that are easy to get wrong
+static bool special_values() {
+    if(!fresh()) {
+        return false;
+    }
+
+    double specials[] = {0.0, -0.0, NAN, -NAN, INFINITY, -INFINITY, 5e-324, -5e-324, 1.0, 1.0, -0.0, 0.0,
+                         1.7976931348623157e308, NAN, 0.0};
+
+    samples_t s;
+    uint64_t t = 1000;
+    for(size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+        append(&s, t++, specials[i]);
+    }
+
+    // a NaN with a payload
+    uint64_t payload = 0x7FF0000000000001ULL;
+    double nan_payload;
+    memcpy(&nan_payload, &payload, sizeof(double));
+    append(&s, t++, nan_payload);
+
+    if(!same(&s, 0, UINT64_MAX)) {
+        printf("NaN, +-0, +-infinity or denormals read back wrong\n");
+        return false;
+    }
+
+    return true;
+}
+
+// timestamps going backwards are dropped, the same one again is kept
+static bool out_of_order() {
+    if(!fresh()) {
+        return false;
+    }
+
+    samples_t s;
+    append(&s, 5000, 1.0);
+    append(&s, 6000, 2.0);
+    append(&s, 6000, 3.0);
+
+    if(SUCCESS == hist.append(meas, 5500, 4.0) || SUCCESS == hist.append(meas, 0, 4.0)) {
+        printf("Older sample appended\n");
+        return false;
+    }
+
+    append(&s, 7000, 5.0);
+
+    // far ahead, then a small step, the delta of delta swings both ways
+    append(&s, 7000 + 86400000000ULL, 6.0);
+    append(&s, 7001 + 86400000000ULL, 7.0);
+
+    if(s.times.size() != 6) {
+        printf("Failed to append samples in order\n");
+        return false;
+    }
+
+    if(!same(&s, 0, UINT64_MAX)) {
+        printf("Samples around dropped ones read back wrong\n");
+        return false;
+    }
+
+    return true;
+}
+
+// more samples than the ring holds, only the oldest are lost
+static bool ring_wraps() {
+    if(!fresh()) {
+        return false;
+    }
+
+    samples_t s;
+    uint64_t t = 1700000000000000ULL;
+    for(int i = 0; i < 200000; i++) {
+        t += 1000;
+        append(&s, t, random_double());
+    }
+
+    std::vector<uint64_t> times;
+    std::vector<double> values;
+    hist.read(meas, 0, UINT64_MAX, &times, &values);
+
+    // what's left has to be the newest samples, all of them
+    size_t kept = times.size();
+    if(kept == 0 || kept >= s.times.size()) {
+        printf("Ring didn't wrap around, kept %zu of %zu samples\n", kept, s.times.size());
+        return false;
+    }
+
+    for(size_t i = 0; i < kept; i++) {
+        size_t j = s.times.size() - kept + i;
+        if(times[i] != s.times[j] || memcmp(&values[i], &s.values[j], sizeof(double)) != 0) {
+            printf("Ring lost a sample newer than the oldest kept\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    VCM* veh;
+    if(argc > 1) {
+        veh = new VCM(std::string(argv[1]));
+    } else {
+        veh = new VCM();
+    }
+
+    if(SUCCESS != veh->init()) {
+        printf("Failed to initialize VCM\n");
+        return -1;
+    }
+
+    if(SUCCESS != hist.init(veh) || hist.measurements.size() == 0) {
+        printf("No measurements in the history file\n");
+        return -1;
+    }
+
+    meas = hist.measurements[0];
+
+    if(SUCCESS != hist.create() || SUCCESS != hist.open()) {
+        printf("Failed to create history shared memory, is shared memory already on?\n");
+        return -1;
+    }
+
+    srand(1);
+
+    bool passed = round_trip() && full_blocks() && delta_widths() && special_values() && out_of_order() &&
+                  ring_wraps();
+
+    hist.destroy();
+
+    if(!passed) {
+        return -1;
+    }
+
+    printf("Success\n");
+}
@@ -0,0 +1,140 @@
+/*******************************************************************************
+* Name: main.cpp
+*
+* Purpose: Delta encoded packet sender
+*          Reads whole packets from stdin, delta encodes them like the vehicle
+*          would (see lib/dev/delta/delta.h) and sends them to the packet's port
+*          on this machine, for testing decom without the vehicle
+*
+*          Usage ./delta_send [port] [optional keyframe interval, default 10] [-f optional_path_to_VCM_file]
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include "lib/dls/dls.h"
+#include "lib/vcm/vcm.h"
+#include "lib/dev/delta/delta.h"
+#include "common/types.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+
+using namespace dls;
+using namespace vcm;
+
+#define DEFAULT_KEYFRAME_INTERVAL 10
+
+void usage() {
+    printf("usage: ./delta_send [port] [optional keyframe interval, default %u] [-f optional_path_to_VCM_file]\n",
+           DEFAULT_KEYFRAME_INTERVAL);
+}
+
+int main(int argc, char* argv[]) {
+    MsgLogger logger("DELTA_SEND");
+
+    std::string config_file = "";
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-f")) {
+            if(i + 1 >= argc) {
+                usage();
+                return -1;
+            }
+
+            config_file = argv[++i];
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if(args.size() < 1 || args.size() > 2) {
+        usage();
+        return -1;
+    }
+
+    uint16_t port;
+    uint32_t interval = DEFAULT_KEYFRAME_INTERVAL;
+    try {
+        port = std::stoi(args[0], NULL, 10);
+        if(args.size() > 1) {
+            interval = std::stoul(args[1], NULL, 10);
+        }
+    } catch(std::exception& e) {
+        usage();
+        return -1;
+    }
+
+    VCM* veh;
+    if(config_file == "") {
+        veh = new VCM(); // use default config file
+    } else {
+        veh = new VCM(config_file); // use specified config file
+    }
+
+    if(FAILURE == veh->init()) {
+        printf("failed to initialize VCM\n");
+        return -1;
+    }
+
+    packet_info_t* packet = NULL;
+    for(packet_info_t* p : veh->packets) {
+        if(!p->is_virtual && p->port == port) {
+            packet = p;
+            break;
+        }
+    }
+
+    if(packet == NULL || !packet->delta) {
+        printf("no delta encoded packet on port %u\n", port);
+        return -1;
+    }
+
+    int sd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sd == -1) {
+        printf("failed to open socket\n");
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    std::vector<uint8_t> last(packet->size);
+    std::vector<uint8_t> data(packet->size);
+    std::vector<uint8_t> out(DELTA_MAX_SIZE(packet->size));
+
+    delta_encoder_t enc;
+    delta_encoder_init(&enc, last.data(), packet->size, interval);
+
+    logger.log_message("sending delta encoded packets to port " + std::to_string(port));
+
+    uint64_t packets = 0;
+    uint64_t raw = 0;
+    uint64_t sent = 0;
+    while(fread(data.data(), packet->size, 1, stdin) == 1) {
+        size_t len = delta_encode(&enc, data.data(), out.data());
+
+        if(sendto(sd, out.data(), len, 0, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            printf("failed to send packet\n");
+            close(sd);
+            return -1;
+        }
+
+        packets++;
+        raw += packet->size;
+        sent += len;
+    }
+
+    printf("sent %lu packets, %lu bytes encoded to %lu\n", packets, raw, sent);
+
+    close(sd);
+    return 0;
+}
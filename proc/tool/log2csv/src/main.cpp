@@ -2,6 +2,8 @@
 *  Name: main.cpp
 *
 *  Purpose: Parses log files into a single CSV file of measurements
+*           Array measurements are expanded into a row per sample, each
+*           with its own timestamp
 *
 *  Usage: ./log2csv [log file directory] (vcm config file path)
 *         vcm config file path is optional, uses the default if not set
@@ -15,7 +17,6 @@
 #include "lib/convert/convert.h"
 #include <string>
 #include <vector>
-#include <unordered_map>
 
 // maximum number of rows for each output file
 // set to 10,000 so each file can be opened in LibreOffice
@@ -47,29 +48,57 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    // stores list of measurements for each packet id
-    // measurement names map to offset in packet
+    // the value in each column of the CSV for each packet id, 'meas' is NULL if the packet
+    // doesn't have the measurement of that column
+    // looked up once here so writing a row doesn't search for anything
     // assumes packet id's are sequential and ascending by 1
-    std::vector<std::unordered_map<std::string, size_t>> packets;
+    typedef struct {
+        measurement_info_t* meas;
+        size_t offset;
+    } field_t;
 
-    std::unordered_map<std::string, size_t> temp;
+    std::vector<std::vector<field_t>> packets(veh->num_packets);
     measurement_info_t* meas = NULL;
 
-    // find what measurements belong in each packet
+    // the array with the most elements in each packet (NULL if no arrays)
+    // records with arrays get a row for each of its samples
+    std::vector<measurement_info_t*> longest_array(veh->num_packets, NULL);
+
     for(uint32_t i = 0; i < veh->num_packets; i++) {
-        for(std::string s : veh->measurements) {
+        for(std::string& s : veh->measurements) {
+            field_t field;
+            field.meas = NULL;
+            field.offset = 0;
+
             meas = veh->get_info(s);
-            for(location_info_t loc : meas->locations) {
+            for(location_info_t& loc : meas->locations) {
                 if(loc.packet_index == i) {
                     // this measurement is in packet with index i
-                    temp[s] = loc.offset;
+                    field.meas = meas;
+                    field.offset = loc.offset;
                 }
             }
+
+            if(field.meas != NULL && meas->count > 1 &&
+               (longest_array[i] == NULL || meas->count > longest_array[i]->count)) {
+                longest_array[i] = meas;
+            }
+
+            packets[i].push_back(field);
         }
+    }
+
+    // time each packet was last seen (microseconds), used to spread array samples out
+    std::vector<uint64_t> last_time(veh->num_packets, 0);
 
-        packets.push_back(temp);
-        temp.clear();
+    // each row is written into this buffer and then out to the file, sized to fit every measurement
+    size_t max_row = 64; // timestamp, packet id and newline
+    for(std::string m : veh->measurements) {
+        meas = veh->get_info(m);
+        max_row += 1 + ((STRING_TYPE == meas->type) ? meas->size : MAX_CONVERSION_SIZE);
     }
+    std::vector<char> row_buf(max_row);
+    char* row_end = row_buf.data() + row_buf.size();
 
     // open the first output file
     std::ofstream of;
@@ -158,70 +187,95 @@ int main(int argc, char** argv) {
                 continue;
             }
 
-            // check if we need a new output file before we write a new line
-            if(line_cnt > MAX_OUTPUT_ROWS) {
-                // close the last output file
-                of.close();
-                printf("file written to: %s\n", of_name.c_str());
+            uint64_t rec_time = ((uint64_t)rec->timestamp.tv_sec * 1000000) + rec->timestamp.tv_usec;
+            uint64_t interval = (last_time[packet_id] == 0) ? 0 : rec_time - last_time[packet_id];
+            last_time[packet_id] = rec_time;
 
-                // open a new output file
-                num_ofile++;
-                of_name = dir;
-                of_name += "/log";
-                of_name += std::to_string(num_ofile);
-                of_name += ".csv";
+            measurement_info_t* longest = longest_array[packet_id];
+            uint32_t rows = (longest == NULL) ? 1 : longest->count;
 
-                of.open(of_name.c_str(), std::ios::out | std::ios::trunc);
+            std::vector<field_t>& fields = packets[packet_id];
 
-                if(!of.is_open()) {
-                    printf("Failed to open output file: %s\n", of_name.c_str());
-                    return -1;
-                }
+            for(uint32_t row = 0; row < rows; row++) {
+                // check if we need a new output file before we write a new line
+                if(line_cnt > MAX_OUTPUT_ROWS) {
+                    // close the last output file
+                    of.close();
+                    printf("file written to: %s\n", of_name.c_str());
+
+                    // open a new output file
+                    num_ofile++;
+                    of_name = dir;
+                    of_name += "/log";
+                    of_name += std::to_string(num_ofile);
+                    of_name += ".csv";
 
-                // write out the first entry
-                of << "timestamp,packet id,";
-                for(std::string m : veh->measurements) {
-                    of << m << ",";
+                    of.open(of_name.c_str(), std::ios::out | std::ios::trunc);
+
+                    if(!of.is_open()) {
+                        printf("Failed to open output file: %s\n", of_name.c_str());
+                        return -1;
+                    }
+
+                    // write out the first entry
+                    of << "timestamp,packet id,";
+                    for(std::string m : veh->measurements) {
+                        of << m << ",";
+                    }
+                    of << '\n';
+                    of.flush();
+
+                    // reset the line counter
+                    line_cnt = 1;
                 }
-                of << '\n';
-                of.flush();
 
-                // reset the line counter
-                line_cnt = 1;
-            }
+                // write out the record to the CSV file
+                uint64_t t = (longest == NULL) ? rec_time : sample_time(longest, rec_time, interval, row);
+
+                char* pos = row_buf.data();
+
+                pos = format(t / 1000000, pos, row_end);
+                *pos++ = '.';
 
-            // write out the record to the CSV file
-            of << std::to_string(rec->timestamp.tv_sec);
-            of << "." << std::to_string(rec->timestamp.tv_usec);
-            of << "," << std::to_string(packet_id) << ",";
-
-            std::string val;
-            measurement_info_t* meas = NULL;
-            uint8_t* data = NULL;
-            std::unordered_map<std::string, size_t>* packet_map = &(packets[packet_id]);
-
-            for(std::string m : veh->measurements) {
-                if(packet_map->find(m) != packet_map->end()) {
-                    // this measurement is in this record, add it to the csv
-                    val = "";
-                    meas = veh->get_info(m);
-                    data = rec->data + (*packet_map)[m];
-
-                    if(convert_to(veh, meas, data, &val) != SUCCESS) {
-                        printf("failed to convert value in file: %s\n", filename.c_str());
-                        val = "";
-                        // try the next measurement
-                        continue;
+                // microseconds are zero padded to 6 digits
+                uint64_t usec = t % 1000000;
+                for(uint64_t place = 100000; place > 1 && usec < place; place /= 10) {
+                    *pos++ = '0';
+                }
+                pos = format(usec, pos, row_end);
+
+                *pos++ = ',';
+                pos = format((uint64_t)packet_id, pos, row_end);
+                *pos++ = ',';
+
+                for(field_t& field : fields) {
+                    if(field.meas != NULL) {
+                        // this measurement is in this record, add it to the csv
+                        meas = field.meas;
+                        uint8_t* data = rec->data + field.offset;
+
+                        // single values go on the last row, array elements go on the row
+                        // closest to when they were sampled (the last element is on the last row)
+                        uint64_t n = meas->count;
+                        if(((row + 1) * n) % rows == 0) {
+                            data += (((row + 1) * n / rows) - 1) * meas->size;
+
+                            if(format(meas, data, pos, row_end, &pos) != SUCCESS) {
+                                printf("failed to convert value in file: %s\n", filename.c_str());
+                            }
+                        }
                     }
+
+                    // NOTE: we leave an extra comma on each line, but who cares
+                    *pos++ = ',';
                 }
 
-                // NOTE: we leave an extra comma on each line, but who cares
-                of << val << ',';
+                *pos++ = '\n';
+                of.write(row_buf.data(), pos - row_buf.data());
+                line_cnt++;
             }
 
-            of << '\n';
             of.flush();
-            line_cnt++;
 
             free_record(rec);
 
@@ -3,6 +3,8 @@
 *
 *  Purpose: Uploads log files to InfluxDB, assumes InfluxDB server is hosted
 *           at domain name 'influx.local'
+*           Each element of an array measurement is sent as its own point
+*           with its own timestamp
 *
 *  Usage: ./log2influx [log file directory] (vcm config file path)
 *         vcm config file path is optional, uses the default if not set
@@ -32,6 +34,15 @@ using namespace vcm;
 using namespace dls;
 using namespace convert;
 
+// send a line protocol message to the InfluxDB server
+static void send_line(int sockfd, struct sockaddr_in* servaddr, const char* msg, size_t len) {
+    ssize_t sent = sendto(sockfd, msg, len, 0,
+        (struct sockaddr*)servaddr, sizeof(*servaddr));
+
+    if(sent == -1) {
+        printf("failed to send UDP line protocol message\n");
+    }
+}
 
 int main(int argc, char* argv[]) {
     if(argc < 2) {
@@ -55,28 +66,33 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
-    // stores list of measurements for each packet id
-    // measurement names map to offset in packet
+    // the measurements in each packet id, in the order of the VCM measurement list
+    // looked up once here so sending a record doesn't search for anything
     // assumes packet id's are sequential and ascending by 1
-    std::vector<std::unordered_map<std::string, size_t>> packets;
+    typedef struct {
+        const std::string* name;
+        measurement_info_t* meas;
+        size_t offset;
+    } field_t;
 
-    std::unordered_map<std::string, size_t> temp;
+    std::vector<std::vector<field_t>> packets(veh->num_packets);
     measurement_info_t* meas = NULL;
 
-    // find what measurements belong in each packet
     for(uint32_t i = 0; i < veh->num_packets; i++) {
-        for(std::string s : veh->measurements) {
+        for(std::string& s : veh->measurements) {
             meas = veh->get_info(s);
-            for(location_info_t loc : meas->locations) {
+            for(location_info_t& loc : meas->locations) {
                 if(loc.packet_index == i) {
                     // this measurement is in packet with index i
-                    temp[s] = loc.offset;
+                    field_t field;
+                    field.name = &s;
+                    field.meas = meas;
+                    field.offset = loc.offset;
+                    packets[i].push_back(field);
+                    break;
                 }
             }
         }
-
-        packets.push_back(temp);
-        temp.clear();
     }
 
     // create network socket
@@ -106,6 +122,25 @@ int main(int argc, char* argv[]) {
 
     struct timeval t0 = {0, 0};
 
+    // time each packet was last seen (microseconds), used to spread array samples out
+    std::vector<uint64_t> last_time(veh->num_packets, 0);
+
+    // line protocol messages are written into this buffer, sized to fit every measurement
+    size_t max_msg = veh->device.length() + 32; // device, timestamp and separators
+    for(std::string m : veh->measurements) {
+        meas = veh->get_info(m);
+        max_msg += m.length() + 2 + ((STRING_TYPE == meas->type) ? meas->size : MAX_CONVERSION_SIZE);
+    }
+    std::vector<char> msg(max_msg);
+    char* msg_end = msg.data() + msg.size();
+
+    // array samples are sent as their own points from this buffer, starting with the device name
+    std::vector<char> point(max_msg);
+    char* point_end = point.data() + point.size();
+    memcpy(point.data(), veh->device.c_str(), veh->device.length());
+    point[veh->device.length()] = ' ';
+    char* point_fields = point.data() + veh->device.length() + 1;
+
     printf("uploading logged measurements to InfluxDB\n");
 
     while(1) {
@@ -159,72 +194,91 @@ int main(int argc, char* argv[]) {
                 continue;
             }
 
-            std::string val;
-            measurement_info_t* meas = NULL;
-            uint8_t* data = NULL;
-            std::unordered_map<std::string, size_t>* packet_map = &(packets[packet_id]);
+            // if this is our first data point, record the start timestamp
+            if(t0.tv_sec == 0 && t0.tv_usec == 0) {
+                t0 = rec->timestamp;
+            }
+
+            uint64_t rec_time = ((uint64_t)rec->timestamp.tv_sec * 1000000) + rec->timestamp.tv_usec;
+            uint64_t start_time = ((uint64_t)t0.tv_sec * 1000000) + t0.tv_usec;
+            uint64_t interval = (last_time[packet_id] == 0) ? 0 : rec_time - last_time[packet_id];
+            last_time[packet_id] = rec_time;
+
+            if(rec_time < start_time) {
+                // this should never happen
+                printf("record occurred after first record, not uploading\n");
+                free_record(rec);
+                f.peek();
+                continue;
+            }
+
+            std::vector<field_t>& fields = packets[packet_id];
             uint8_t first = 1;
 
             // write the measurement name
-            std::string msg = veh->device;
-            msg += " ";
-
-            for(std::string m : veh->measurements) {
-                if(packet_map->find(m) != packet_map->end()) {
-                    // we found a measurement in this record
-                    val = "";
-                    meas = veh->get_info(m);
-                    data = rec->data + (*packet_map)[m];
-
-                    if(convert_to(veh, meas, data, &val) != SUCCESS) {
-                        printf("failed to convert value in file: %s\n", filename.c_str());
-                        val = "";
-                        // try the next measurement
-                        continue;
+            char* pos = msg.data();
+            memcpy(pos, veh->device.c_str(), veh->device.length());
+            pos += veh->device.length();
+            *pos++ = ' ';
+
+            for(field_t& field : fields) {
+                // a measurement in this record
+                const std::string& m = *(field.name);
+                meas = field.meas;
+                uint8_t* data = rec->data + field.offset;
+
+                if(meas->count > 1) {
+                    // arrays get a point for each sample
+                    for(uint32_t i = 0; i < meas->count; i++) {
+                        char* p = point_fields;
+                        memcpy(p, m.c_str(), m.length());
+                        p += m.length();
+                        *p++ = '=';
+
+                        if(format(meas, data + (i * meas->size), p, point_end, &p) != SUCCESS) {
+                            printf("failed to convert value in file: %s\n", filename.c_str());
+                            continue;
+                        }
+
+                        uint64_t t = sample_time(meas, rec_time, interval, i) - start_time;
+
+                        *p++ = ' ';
+                        p = format(t * 1000, p, point_end);
+
+                        send_line(sockfd, &servaddr, point.data(), p - point.data());
                     }
 
-                    // write each field
-                    if(!first) {
-                        msg += ",";
-                        first = 0;
-                    }
+                    continue;
+                }
+
+                char* start = pos;
 
-                    msg += m;
-                    msg += "=";
-                    msg += val;
+                // write each field
+                if(!first) {
+                    *pos++ = ',';
                 }
-            }
 
-            // if this is our first data point, record the start timestamp
-            if(t0.tv_sec == 0 && t0.tv_usec == 0) {
-                t0 = rec->timestamp;
-            }
+                memcpy(pos, m.c_str(), m.length());
+                pos += m.length();
+                *pos++ = '=';
 
-            // calculate the timestamp relative to t0
-            long int sec = rec->timestamp.tv_sec - t0.tv_sec;
-            long int usec = rec->timestamp.tv_usec - t0.tv_usec;
+                if(format(meas, data, pos, msg_end, &pos) != SUCCESS) {
+                    printf("failed to convert value in file: %s\n", filename.c_str());
+                    pos = start;
+                    // try the next measurement
+                    continue;
+                }
 
-            if(usec < 0) {
-                sec--;
-                usec = 1000000 + usec;
+                first = 0;
             }
 
-            if(sec < 0) {
-                // this should never happen
-                printf("record occurred after first record, not uploading\n");
-            } else {
-                unsigned long int nanosec = (sec * 1000000000) + (usec * 1000);
-                msg += " ";
-                msg += std::to_string(nanosec);
+            if(!first) {
+                // timestamp relative to t0 in nanoseconds
+                *pos++ = ' ';
+                pos = format((rec_time - start_time) * 1000, pos, msg_end);
 
                 // send the message to the InfluxDB server
-                ssize_t sent = -1;
-                sent = sendto(sockfd, msg.c_str(), msg.length(), 0,
-                    (struct sockaddr*)&servaddr, sizeof(servaddr));
-
-                if(sent == -1) {
-                    printf("failed to send UDP line protocol message\n");
-                }
+                send_line(sockfd, &servaddr, msg.data(), pos - msg.data());
             }
 
             free_record(rec);
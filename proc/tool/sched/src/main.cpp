@@ -0,0 +1,203 @@
+/*******************************************************************************
+* Name: main.cpp
+*
+* Purpose: Scheduling profile tool
+*          Shows the scheduling profiles in the schedule file of a vehicle and
+*          measures the wake-up latency each one gets (see lib/sched/sched.h)
+*
+*          Usage ./sched show (vcm config file path)
+*          vcm config file path is optional, uses the default if not set
+*
+*          Usage ./sched test (seconds) (vcm config file path)
+*          every profile is tested at once, each in its own thread with that
+*          profile applied, alongside a thread on the default scheduler
+*          run it while GSW is under load to see what each process gets
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include "lib/sched/sched.h"
+#include "lib/vcm/vcm.h"
+#include "lib/dls/dls.h"
+#include "common/types.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+using namespace vcm;
+using namespace dls;
+using namespace sched;
+
+// how often each test thread wakes up (microseconds)
+#define TEST_PERIOD 1000
+
+// a thread testing one profile
+typedef struct {
+    profile_t* profile;  // NULL for the default scheduler
+    uint32_t duration;   // milliseconds
+    RetType applied;
+    RetType ret;
+    latency_t latency;
+} test_t;
+
+void* run_test(void* arg) {
+    test_t* test = (test_t*)arg;
+
+    test->applied = SUCCESS;
+    if(test->profile) {
+        test->applied = apply_profile(test->profile);
+    }
+
+    test->ret = measure_latency(TEST_PERIOD, test->duration, &test->latency);
+    return NULL;
+}
+
+void print_profile(profile_t* profile) {
+    printf("%-12s", profile->process.c_str());
+
+    if(profile->priority > 0) {
+        printf(" SCHED_FIFO %-3d", profile->priority);
+    } else {
+        printf(" %-14s", "default");
+    }
+
+    std::string cpus = "any";
+    if(profile->pinned) {
+        cpus = "";
+        for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if(CPU_ISSET(cpu, &profile->cpus)) {
+                cpus += (cpus == "" ? "" : ",") + std::to_string(cpu);
+            }
+        }
+    }
+    printf(" cpus %-12s", cpus.c_str());
+
+    const char* mlock = "none";
+    switch(profile->mlock) {
+        case LOCK_NONE: mlock = "none"; break;
+        case LOCK_CURRENT: mlock = "current"; break;
+        case LOCK_ALL: mlock = "all"; break;
+        case LOCK_ONFAULT: mlock = "onfault"; break;
+    }
+    printf(" mlock %s\n", mlock);
+}
+
+int main(int argc, char* argv[]) {
+    bool show = (argc == 2 || argc == 3) && !strcmp(argv[1], "show");
+    bool test = (argc == 3 || argc == 4) && !strcmp(argv[1], "test");
+
+    if(!show && !test) {
+        printf("usage: ./sched show (vcm config file path)\n");
+        printf("       ./sched test (seconds) (vcm config file path)\n");
+        return -1;
+    }
+
+    // config file is the last optional argument
+    int config_arg = show ? 2 : 3;
+
+    VCM* veh;
+    if(argc > config_arg) {
+        veh = new VCM(argv[config_arg]);
+    } else {
+        // use default config file location
+        veh = new VCM();
+    }
+
+    if(SUCCESS != veh->init()) {
+        printf("failed to initialize VCM: %s\n", veh->config_file.c_str());
+        return -1;
+    }
+
+    std::vector<profile_t> profiles;
+    RetType ret = parse_schedule_file(veh, &profiles);
+    if(FILENOTFOUND == ret) {
+        printf("no schedule file, every process runs on the default scheduler\n");
+    } else if(SUCCESS != ret) {
+        printf("invalid schedule file: %s\n", veh->schedule_file.c_str());
+        return -1;
+    }
+
+    if(show) {
+        for(profile_t& profile : profiles) {
+            print_profile(&profile);
+        }
+
+        delete veh;
+        return 0;
+    }
+
+    uint32_t seconds;
+    try {
+        seconds = std::stoi(argv[2], NULL, 10);
+    } catch(std::invalid_argument& ia) {
+        seconds = 0;
+    }
+
+    if(seconds == 0) {
+        printf("test must run for at least a second\n");
+        return -1;
+    }
+
+    // the first test is the default scheduler
+    std::vector<test_t> tests(profiles.size() + 1);
+    std::vector<pthread_t> threads(tests.size());
+
+    printf("testing %lu profiles for %u seconds, waking up every %u us\n", profiles.size(), seconds, TEST_PERIOD);
+
+    for(size_t i = 0; i < tests.size(); i++) {
+        tests[i].profile = (i == 0) ? NULL : &profiles[i - 1];
+        tests[i].duration = seconds * 1000;
+        tests[i].ret = FAILURE;
+
+        if(pthread_create(&threads[i], NULL, run_test, &tests[i]) != 0) {
+            printf("failed to start test thread\n");
+            return -1;
+        }
+    }
+
+    for(size_t i = 0; i < tests.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // wake-up latency (microseconds)
+    printf("\n%-12s %10s %10s %10s %10s %10s %10s\n", "process", "min", "mean", "p50", "p99", "p99.9", "max");
+    for(test_t& t : tests) {
+        const char* name = t.profile ? t.profile->process.c_str() : "(default)";
+
+        if(SUCCESS != t.ret) {
+            printf("%-12s failed\n", name);
+            continue;
+        }
+
+        printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f%s\n", name, t.latency.min, t.latency.mean,
+               t.latency.p50, t.latency.p99, t.latency.p999, t.latency.max,
+               (SUCCESS == t.applied) ? "" : "  (profile not applied, see the log)");
+    }
+
+    // how many wake-ups fell in each range
+    printf("\n%-12s", "late by (us)");
+    for(size_t b = 0; b < NUM_LATENCY_BUCKETS; b++) {
+        std::string label = (b + 1 < NUM_LATENCY_BUCKETS) ? "<" + std::to_string((int)LATENCY_BUCKETS[b + 1]) :
+                                                            ">=" + std::to_string((int)LATENCY_BUCKETS[b]);
+        printf(" %8s", label.c_str());
+    }
+    printf("\n");
+
+    for(test_t& t : tests) {
+        if(SUCCESS != t.ret) {
+            continue;
+        }
+
+        printf("%-12s", t.profile ? t.profile->process.c_str() : "(default)");
+        for(uint64_t count : t.latency.histogram) {
+            printf(" %8lu", count);
+        }
+        printf("\n");
+    }
+
+    delete veh;
+    return 0;
+}
@@ -0,0 +1,526 @@
+#include "gen.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace vcm;
+
+// C++ keywords and names already used in every packet struct, measurements can't be called these
+static const std::set<std::string> reserved = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+    "case", "catch", "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr",
+    "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast",
+    "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+    "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+    "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+    "reinterpret_cast", "return", "short", "signed", "sizeof", "static", "static_assert",
+    "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+    "volatile", "wchar_t", "while", "xor", "xor_eq",
+    "index", "port", "is_virtual", "layout", "size", "framed", "frame_id", "delta",
+    "has_crc", "crc_offset", "can_id"
+};
+
+// a measurement name as a C++ identifier
+static std::string identifier(const std::string& name) {
+    std::string id = name;
+
+    for(char& c : id) {
+        if(!isalnum((unsigned char)c) && c != '_') {
+            c = '_';
+        }
+    }
+
+    if(id.empty() || isdigit((unsigned char)id[0])) {
+        id = "m_" + id;
+    }
+
+    if(reserved.count(id)) {
+        id += "_";
+    }
+
+    return id;
+}
+
+// a double that reads back exactly
+static std::string number(double d) {
+    if(isnan(d)) {
+        return "NAN";
+    } else if(isinf(d)) {
+        return (d > 0) ? "INFINITY" : "-INFINITY";
+    }
+
+    char buff[64];
+    snprintf(buff, sizeof(buff), "%.17g", d);
+
+    std::string s = buff;
+    if(s.find_first_of(".eE") == std::string::npos) {
+        s += ".0";
+    }
+
+    return s;
+}
+
+static std::string numbers(const std::vector<double>& nums) {
+    std::string s;
+
+    for(size_t i = 0; i < nums.size(); i++) {
+        if(i > 0) {
+            s += ", ";
+        }
+        s += number(nums[i]);
+    }
+
+    return s;
+}
+
+// type a numeric measurement is read as
+static std::string value_type(measurement_info_t* meas) {
+    if(meas->cal_input) {
+        return "double";
+    } else if(meas->type == FLOAT_TYPE) {
+        return (meas->size == sizeof(float)) ? "float" : "double";
+    }
+
+    std::string t = (meas->sign == SIGNED_TYPE) ? "int" : "uint";
+    return t + ((meas->size <= sizeof(uint32_t)) ? "32_t" : "64_t");
+}
+
+// template arguments of the size and endianness of a measurement
+static std::string format(measurement_info_t* meas) {
+    return std::to_string(meas->size) + ", " + ((meas->endianness == GSW_BIG_ENDIAN) ? "true" : "false");
+}
+
+static std::string endian_name(measurement_info_t* meas) {
+    return (meas->endianness == GSW_BIG_ENDIAN) ? "big endian" : "little endian";
+}
+
+// name of unused bytes number 'n' in a packet that isn't in 'ids'
+static std::string pad_name(std::set<std::string>& ids, size_t n) {
+    std::string name = "pad" + std::to_string(n);
+
+    while(ids.count(name)) {
+        name = "_" + name;
+    }
+
+    return name;
+}
+
+// a measurement in a packet
+typedef struct {
+    measurement_info_t* meas;
+    std::string name;      // name in the config
+    std::string id;        // accessor name
+    size_t offset;
+} member_t;
+
+// write the struct of packet 'index'
+static RetType packet_struct(VCM* veh, uint32_t index, std::stringstream& out) {
+    packet_info_t* packet = veh->packets[index];
+
+    std::vector<member_t> raw;      // measurements with their own bytes in the packet
+    std::vector<member_t> derived;  // bitfields and calibrated measurements, read from another member
+
+    // number of times each measurement has been seen in this packet
+    std::map<measurement_info_t*, size_t> seen;
+
+    // ids already in the struct
+    std::set<std::string> ids;
+
+    for(std::string& name : veh->measurements) {
+        measurement_info_t* meas = veh->get_info(name);
+
+        // a redefined measurement, the last definition is the one in the packets
+        if(meas == NULL || seen.count(meas)) {
+            continue;
+        }
+        seen[meas] = 0;
+
+        for(location_info_t& loc : meas->locations) {
+            if(loc.packet_index != index) {
+                continue;
+            }
+
+            member_t m;
+            m.meas = meas;
+            m.name = name;
+            m.id = identifier(name);
+            m.offset = loc.offset;
+
+            // a measurement in the packet more than once gets a number after the first
+            if(seen[meas] > 0) {
+                m.id += "_" + std::to_string(seen[meas]);
+            }
+            seen[meas]++;
+
+            // every name the measurement adds to the struct
+            for(const char* suffix : {"", "_raw", "_count", "_size"}) {
+                for(const char* prefix : {"", "set_"}) {
+                    std::string member = prefix + m.id + suffix;
+
+                    if(ids.count(member)) {
+                        printf("measurement '%s' in packet %u has the same name in C++ as another measurement: %s\n",
+                               name.c_str(), index, member.c_str());
+                        return FAILURE;
+                    }
+
+                    ids.insert(member);
+                }
+            }
+
+            if(meas->bit_width || meas->cal_input) {
+                derived.push_back(m);
+            } else {
+                raw.push_back(m);
+            }
+        }
+    }
+
+    std::sort(raw.begin(), raw.end(), [](const member_t& a, const member_t& b) {
+        return a.offset < b.offset;
+    });
+
+    std::string type = "packet" + std::to_string(index) + "_t";
+
+    if(packet->is_virtual) {
+        out << "    // virtual packet " << index << "\n";
+    } else if(packet->framed) {
+        out << "    // packet " << index << ", frame " << packet->frame_id << " on port " << packet->port << "\n";
+    } else if(packet->transport == TRANSPORT_TCP) {
+        out << "    // packet " << index << ", TCP port " << packet->port << "\n";
+    } else if(packet->transport == TRANSPORT_UNIX) {
+        out << "    // packet " << index << ", Unix socket " << packet->endpoint << "\n";
+    } else if(packet->transport == TRANSPORT_CAN) {
+        out << "    // packet " << index << ", CAN id " << packet->can_id << " on " << packet->endpoint << "\n";
+    } else {
+        out << "    // packet " << index << ", port " << packet->port << "\n";
+    }
+
+    out << "    struct __attribute__((packed)) " << type << " {\n";
+    out << "        static constexpr uint32_t index = " << index << ";\n";
+    out << "        static constexpr uint16_t port = " << packet->port << ";\n";
+    out << "        static constexpr bool is_virtual = " << (packet->is_virtual ? "true" : "false") << ";\n";
+    out << "        static constexpr size_t size = " << packet->size << ";\n";
+    out << "        static constexpr bool framed = " << (packet->framed ? "true" : "false") << ";\n";
+    out << "        static constexpr uint32_t frame_id = " << packet->frame_id << ";\n";
+    out << "        static constexpr bool delta = " << (packet->delta ? "true" : "false") << ";\n";
+
+    // the vehicle fills in the CRC with crc32c_packet(data, size, crc_offset) (see lib/dev/crc/crc.h)
+    out << "        static constexpr bool has_crc = " << (packet->crc ? "true" : "false") << ";\n";
+    out << "        static constexpr size_t crc_offset = " << packet->crc_offset << ";\n";
+
+    // 0 unless the packet is sent over CAN
+    out << "        static constexpr uint32_t can_id = " << packet->can_id << ";\n";
+
+    char layout[32];
+    snprintf(layout, sizeof(layout), "0x%016llxULL", (unsigned long long)veh->packet_layout(index));
+    out << "        static constexpr uint64_t layout = " << layout << ";\n\n";
+
+    // raw bytes, padded to the offsets in the config
+    size_t offset = 0;
+    size_t pad = 0;
+    for(member_t& m : raw) {
+        if(m.offset < offset) {
+            printf("measurement '%s' overlaps another measurement in packet %u\n", m.name.c_str(), index);
+            return FAILURE;
+        } else if(m.offset > offset) {
+            out << "        uint8_t " << pad_name(ids, pad++) << "[" << (m.offset - offset) << "];\n";
+        }
+
+        size_t bytes = m.meas->size * m.meas->count;
+        out << "        uint8_t " << m.id << "_raw[" << bytes << "];\n";
+        offset = m.offset + bytes;
+    }
+
+    if(offset < packet->size) {
+        out << "        uint8_t " << pad_name(ids, pad++) << "[" << (packet->size - offset) << "];\n";
+    } else if(offset > packet->size) {
+        printf("measurements don't fit in packet %u\n", index);
+        return FAILURE;
+    }
+
+    // accessors of measurements with their own bytes
+    for(member_t& m : raw) {
+        measurement_info_t* meas = m.meas;
+        std::string raw_name = m.id + "_raw";
+
+        out << "\n";
+
+        if(meas->type == STRING_TYPE) {
+            out << "        // " << m.name << ", " << meas->size << " byte string (not NUL terminated if it fills the field)\n";
+            out << "        static constexpr size_t " << m.id << "_size = " << meas->size << ";\n";
+            out << "        const char* " << m.id << "() const { return (const char*)" << raw_name << "; }\n";
+            out << "        void set_" << m.id << "(const char* v) { ::vcm::gen::set_string(" << raw_name
+                << ", " << meas->size << ", v); }\n";
+            continue;
+        }
+
+        std::string vt = value_type(meas);
+        std::string get;
+        std::string set;
+
+        if(meas->type == FLOAT_TYPE) {
+            std::string big = (meas->endianness == GSW_BIG_ENDIAN) ? "true" : "false";
+            std::string f = (meas->size == sizeof(float)) ? "float" : "double";
+            get = "::vcm::gen::get_" + f + "<" + big + ">";
+            set = "::vcm::gen::set_" + f + "<" + big + ">";
+
+            out << "        // " << m.name << ", " << meas->size << " byte float, " << endian_name(meas);
+        } else {
+            get = std::string("::vcm::gen::get_") + ((meas->sign == SIGNED_TYPE) ? "int" : "uint") + "<" + format(meas) + ">";
+            set = "::vcm::gen::set_uint<" + format(meas) + ">";
+
+            out << "        // " << m.name << ", " << meas->size << " byte "
+                << ((meas->sign == SIGNED_TYPE) ? "signed" : "unsigned") << " int, " << endian_name(meas);
+        }
+
+        if(meas->count > 1) {
+            out << ", array of " << meas->count << "\n";
+            out << "        static constexpr uint32_t " << m.id << "_count = " << meas->count << ";\n";
+            out << "        " << vt << " " << m.id << "(uint32_t i) const { return (" << vt << ")" << get
+                << "(" << raw_name << " + (i * " << meas->size << ")); }\n";
+            out << "        void set_" << m.id << "(uint32_t i, " << vt << " v) { " << set
+                << "(" << raw_name << " + (i * " << meas->size << "), v); }\n";
+        } else {
+            out << "\n";
+            out << "        " << vt << " " << m.id << "() const { return (" << vt << ")" << get << "(" << raw_name << "); }\n";
+            out << "        void set_" << m.id << "(" << vt << " v) { " << set << "(" << raw_name << ", v); }\n";
+        }
+    }
+
+    // bitfields and calibrated measurements, in config order so calibration inputs come first
+    for(member_t& m : derived) {
+        measurement_info_t* meas = m.meas;
+        std::string vt = value_type(meas);
+
+        out << "\n";
+
+        if(meas->bit_width) {
+            // the parent is the integer with its own bytes at the same offset
+            const member_t* parent = NULL;
+            for(member_t& r : raw) {
+                if(r.offset == m.offset && r.meas->type == INT_TYPE && r.meas->size == meas->size && r.meas->count == 1) {
+                    parent = &r;
+                    break;
+                }
+            }
+
+            if(parent == NULL) {
+                printf("can't find the parent of bitfield '%s' in packet %u\n", m.name.c_str(), index);
+                return FAILURE;
+            }
+
+            char mask[32];
+            snprintf(mask, sizeof(mask), "0x%llxULL", (unsigned long long)meas->bit_mask);
+
+            std::string args = format(meas) + ", " + std::to_string(meas->bit_offset) + ", " + mask;
+            std::string raw_name = parent->id + "_raw";
+
+            out << "        // " << m.name << ", bits " << (unsigned)meas->bit_offset << ".."
+                << (unsigned)(meas->bit_offset + meas->bit_width - 1) << " of " << parent->name << "\n";
+
+            if(meas->sign == SIGNED_TYPE) {
+                out << "        " << vt << " " << m.id << "() const { return (" << vt << ")::vcm::gen::get_signed_bits<"
+                    << args << ", " << (unsigned)meas->bit_width << ">(" << raw_name << "); }\n";
+            } else {
+                out << "        " << vt << " " << m.id << "() const { return (" << vt << ")::vcm::gen::get_bits<"
+                    << args << ">(" << raw_name << "); }\n";
+            }
+
+            out << "        void set_" << m.id << "(" << vt << " v) { ::vcm::gen::set_bits<" << args
+                << ">(" << raw_name << ", (uint64_t)v); }\n";
+            continue;
+        }
+
+        // calibrated, the input is whatever member is at the same offset
+        const member_t* input = NULL;
+        for(std::vector<member_t>* list : {&raw, &derived}) {
+            for(member_t& r : *list) {
+                if(r.meas == meas->cal_input && r.offset == m.offset) {
+                    input = &r;
+                }
+            }
+        }
+
+        if(input == NULL) {
+            printf("can't find the input of calibrated measurement '%s' in packet %u\n", m.name.c_str(), index);
+            return FAILURE;
+        }
+
+        calibration_t* cal = meas->calibration;
+        std::string x = "(double)" + input->id + "()";
+
+        out << "        // " << m.name << ", calibrated " << input->name << "\n";
+        out << "        double " << m.id << "() const {\n";
+
+        switch(cal->kind) {
+            case CAL_POLY:
+                out << "            static constexpr double c[] = {" << numbers(cal->coeffs) << "};\n";
+                out << "            return ::convert::calibrate::poly(c, " << cal->coeffs.size() << ", " << x << ");\n";
+                break;
+
+            case CAL_PIECEWISE:
+                out << "            double x = " << x << ";\n";
+
+                for(size_t i = 0; i < cal->ranges.size(); i++) {
+                    calibration_range_t& range = cal->ranges[i];
+
+                    out << "            if(x >= " << number(range.low) << " && x <= " << number(range.high) << ") {\n";
+                    out << "                static constexpr double c[] = {" << numbers(range.coeffs) << "};\n";
+                    out << "                return ::convert::calibrate::poly(c, " << range.coeffs.size() << ", x);\n";
+                    out << "            }\n";
+                }
+
+                out << "            return NAN;\n";
+                break;
+
+            case CAL_TABLE:
+                out << "            static constexpr double xs[] = {" << numbers(cal->x) << "};\n";
+                out << "            static constexpr double ys[] = {" << numbers(cal->y) << "};\n";
+                out << "            return ::vcm::gen::table(xs, ys, " << cal->x.size() << ", " << x << ");\n";
+                break;
+        }
+
+        out << "        }\n";
+    }
+
+    out << "    };\n";
+    out << "    static_assert(sizeof(" << type << ") == " << packet->size
+        << ", \"packet " << index << " doesn't match the config\");\n\n";
+
+    return SUCCESS;
+}
+
+RetType generate(VCM* veh, std::string& header_file) {
+    std::string ns = identifier(veh->device);
+
+    // include guard from the namespace
+    std::string guard = "VCMGEN_" + ns + "_H";
+    for(char& c : guard) {
+        c = toupper((unsigned char)c);
+    }
+
+    std::string base = header_file.substr(header_file.find_last_of('/') + 1);
+
+    std::stringstream out;
+
+    out << "/*******************************************************************************\n";
+    out << "* Name: " << base << "\n";
+    out << "*\n";
+    out << "* Purpose: Telemetry packets of '" << veh->device << "'\n";
+    out << "*          Generated by 'vcm gen' from " << veh->config_file << "\n";
+    out << "*          DO NOT EDIT, regenerate it when the config changes\n";
+    out << "*\n";
+    out << "* RIT Launch Initiative\n";
+    out << "*******************************************************************************/\n";
+    out << "#ifndef " << guard << "\n";
+    out << "#define " << guard << "\n\n";
+    out << "#include <stdint.h>\n";
+    out << "#include <stddef.h>\n";
+    out << "#include <math.h>\n";
+    out << "#include \"lib/vcm/gen.h\"\n\n";
+    out << "// see lib/vcm/gen.h\n\n";
+    out << "namespace " << ns << " {\n\n";
+
+    // measurement ids, the last definition of a name is the one that's used
+    std::map<std::string, uint32_t> last;
+    for(uint32_t i = 0; i < veh->measurements.size(); i++) {
+        last[veh->measurements[i]] = i;
+    }
+
+    std::set<std::string> ids;
+
+    out << "    // measurement ids, see 'VCM::get_info(uint32_t)'\n";
+    out << "    namespace meas {\n";
+    for(uint32_t i = 0; i < veh->measurements.size(); i++) {
+        std::string& name = veh->measurements[i];
+        if(last[name] != i) {
+            continue;
+        }
+
+        std::string id = identifier(name);
+        if(ids.count(id)) {
+            printf("measurement '%s' has the same name in C++ as another measurement: %s\n", name.c_str(), id.c_str());
+            return FAILURE;
+        }
+        ids.insert(id);
+
+        out << "        constexpr uint32_t " << id << " = " << i << ";\n";
+    }
+    out << "    }\n\n";
+
+    out << "    // packet ids, the index of each packet in the config\n";
+    out << "    namespace packet {\n";
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        if(veh->packets[i]->is_virtual) {
+            out << "        constexpr uint32_t VIRTUAL_" << i << " = " << i << ";\n";
+        } else if(veh->packets[i]->framed) {
+            out << "        constexpr uint32_t PORT_" << veh->packets[i]->port << "_FRAME_" << veh->packets[i]->frame_id
+                << " = " << i << ";\n";
+        } else if(veh->packets[i]->transport == TRANSPORT_TCP) {
+            out << "        constexpr uint32_t TCP_" << veh->packets[i]->port << " = " << i << ";\n";
+        } else if(veh->packets[i]->transport == TRANSPORT_UNIX) {
+            out << "        constexpr uint32_t UNIX_" << i << " = " << i << ";\n";
+        } else if(veh->packets[i]->transport == TRANSPORT_CAN) {
+            out << "        constexpr uint32_t CAN_" << i << " = " << i << ";\n";
+        } else {
+            out << "        constexpr uint32_t PORT_" << veh->packets[i]->port << " = " << i << ";\n";
+        }
+    }
+    out << "    }\n\n";
+
+    out << "    constexpr uint32_t NUM_PACKETS = " << veh->num_packets << ";\n\n";
+
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        if(SUCCESS != packet_struct(veh, i, out)) {
+            return FAILURE;
+        }
+    }
+
+    out << "    // layout of every packet, in packet order\n";
+    out << "    constexpr uint64_t LAYOUTS[NUM_PACKETS] = {";
+    for(uint32_t i = 0; i < veh->num_packets; i++) {
+        out << ((i > 0) ? ", " : "") << "packet" << i << "_t::layout";
+    }
+    out << "};\n\n";
+
+    out << "    // true if 'vcm' has the same packets this header was generated from\n";
+    out << "    inline bool matches(::vcm::VCM* vcm) {\n";
+    out << "        return ::vcm::gen::matches(vcm, LAYOUTS, NUM_PACKETS);\n";
+    out << "    }\n\n";
+
+    out << "} // namespace " << ns << "\n\n";
+    out << "#endif\n";
+
+    // write to a temporary file and move it into place so a build never sees half a header
+    std::string tmp_file = header_file + ".tmp";
+
+    std::ofstream of(tmp_file.c_str(), std::ios::out | std::ios::trunc);
+    if(!of.is_open()) {
+        printf("failed to open header file: %s\n", tmp_file.c_str());
+        return FAILURE;
+    }
+
+    of << out.str();
+    of.close();
+
+    if(!of) {
+        printf("failed to write header file: %s\n", tmp_file.c_str());
+        unlink(tmp_file.c_str());
+        return FAILURE;
+    }
+
+    if(rename(tmp_file.c_str(), header_file.c_str()) != 0) {
+        printf("failed to move header into place: %s\n", header_file.c_str());
+        unlink(tmp_file.c_str());
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
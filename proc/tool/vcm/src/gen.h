@@ -0,0 +1,21 @@
+/*******************************************************************************
+* Name: gen.h
+*
+* Purpose: Generates a C++ header of packed packet structs from a VCM config
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#ifndef VCM_TOOL_GEN_H
+#define VCM_TOOL_GEN_H
+
+#include <string>
+#include "lib/vcm/vcm.h"
+#include "common/types.h"
+
+// write the header for the config of 'veh' to 'header_file' (see lib/vcm/gen.h)
+// returns FAILURE if a measurement can't be given a name in C++ or the packets can't be laid out as structs
+RetType generate(vcm::VCM* veh, std::string& header_file);
+
+#endif
@@ -0,0 +1,86 @@
+/*******************************************************************************
+* Name: main.cpp
+*
+* Purpose: VCM tool
+*          Compiles a VCM config file into a binary image that every process
+*          maps instead of parsing the config file (see lib/vcm/image.h)
+*
+*          Also generates a C++ header of packed packet structs for programs
+*          built against a specific vehicle (see lib/vcm/gen.h)
+*
+*          Usage ./vcm compile (vcm config file path)
+*          vcm config file path is optional, uses the default if not set
+*          the image is written next to the config file as '<config file>.img'
+*
+*          Usage ./vcm gen (header file) (vcm config file path)
+*          vcm config file path is optional, uses the default if not set
+*          to generate the header as part of a build see vcmgen.mk
+*
+* Author: Will Merges
+*
+* RIT Launch Initiative
+*******************************************************************************/
+#include "lib/vcm/vcm.h"
+#include "lib/vcm/image.h"
+#include "gen.h"
+#include "lib/dls/dls.h"
+#include "common/types.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace vcm;
+using namespace dls;
+
+
+int main(int argc, char* argv[]) {
+    bool compile = (argc == 2 || argc == 3) && !strcmp(argv[1], "compile");
+    bool gen = (argc == 3 || argc == 4) && !strcmp(argv[1], "gen");
+
+    if(!compile && !gen) {
+        printf("usage: ./vcm compile (vcm config file path)\n");
+        printf("       ./vcm gen (header file) (vcm config file path)\n");
+        return -1;
+    }
+
+    // config file is the last optional argument
+    int config_arg = compile ? 2 : 3;
+
+    VCM* veh;
+    if(argc > config_arg) {
+        veh = new VCM(argv[config_arg]);
+    } else {
+        // use default config file location
+        veh = new VCM();
+    }
+
+    if(SUCCESS != veh->init()) {
+        printf("failed to initialize VCM: %s\n", veh->config_file.c_str());
+        return -1;
+    }
+
+    if(gen) {
+        std::string header_file = argv[2];
+
+        if(SUCCESS != generate(veh, header_file)) {
+            printf("failed to generate header: %s\n", header_file.c_str());
+            return -1;
+        }
+
+        printf("header written to: %s\n", header_file.c_str());
+
+        delete veh;
+        return 0;
+    }
+
+    std::string image_file = veh->config_file + image::VCM_IMAGE_SUFFIX;
+
+    if(SUCCESS != veh->compile(image_file)) {
+        printf("failed to compile VCM image: %s\n", image_file.c_str());
+        return -1;
+    }
+
+    printf("VCM image written to: %s\n", image_file.c_str());
+
+    delete veh;
+    return 0;
+}
@@ -0,0 +1,25 @@
+# generates a header of packed packet structs for a vehicle (see lib/vcm/gen.h)
+#
+# include in a Makefile after OBJS and the 'all' target are set:
+#
+#   VEHICLE = $(GSW_HOME)/data/sample/config
+#   VEHICLE_HEADER = src/vehicle.h
+#   include $(GSW_HOME)/proc/tool/vcm/vcmgen.mk
+#
+# the header is regenerated whenever the config changes and every object is
+# rebuilt against it, add $(VEHICLE_HEADER) to the files removed by 'clean'
+#
+# VEHICLE defaults to the current default config, VEHICLE_HEADER to src/vehicle.h
+
+VCMGEN = $(GSW_HOME)/proc/tool/vcm/vcm
+
+VEHICLE ?= $(GSW_HOME)/data/default/config
+VEHICLE_HEADER ?= src/vehicle.h
+
+$(VEHICLE_HEADER): $(VEHICLE) | $(VCMGEN)
+	$(VCMGEN) gen $@ $(VEHICLE)
+
+$(VCMGEN):
+	$(MAKE) -C $(GSW_HOME)/proc/tool/vcm all
+
+$(OBJS): $(VEHICLE_HEADER)